@@ -6,9 +6,9 @@
  * License. See the file COPYING in the main directory of the Linux
  * distribution for more details. */
 
+#include <algorithm>
 #include <cmath>
-#include <QApplication>
-#include <QThreadPool>
+#include <cstring>
 #include <QMutexLocker>
 
 #include "MinutesAtPressure.h"
@@ -22,34 +22,29 @@
 
 MinutesAtPressure::MinutesAtPressure() :Layer(NoChannel)
 {
-    m_remap = nullptr;
+    m_graph = nullptr;
+    m_pressureMult = 5;
     m_minpressure = 3;
     m_maxpressure = 30;
     m_minimum_height = 0;
 }
 MinutesAtPressure::~MinutesAtPressure()
 {
-    while (recalculating()) {};
-}
-
-RecalcMAP::~RecalcMAP()
-{
-}
-void RecalcMAP::quit() {
-    m_quit = true;
-    map->mutex.lock();
-    map->mutex.unlock();
 }
 
 
 void MinutesAtPressure::SetDay(Day *day)
 {
     Layer::SetDay(day);
+    m_indexes.clear();
 
     // look at session summaryValues.
     Machine * cpap = nullptr;
     if (day) cpap = day->machine(MT_CPAP);
     if (cpap) {
+        // PRS1 pressures come in half cmH2O steps, everything else is binned by 0.2
+        m_pressureMult = (cpap->loaderName() == "PRS1") ? 2 : 5;
+
         QList<Session *>::iterator sit;
         EventDataType minpressure = 20;
         EventDataType maxpressure = 0;
@@ -100,7 +95,6 @@ void MinutesAtPressure::SetDay(Day *day)
 
 
     m_empty = false;
-    m_recalculating = false;
     m_lastminx = 0;
     m_lastmaxx = 0;
     m_empty = !m_day || !(m_day->channelExists(CPAP_Pressure) || m_day->channelExists(CPAP_EPAP));
@@ -119,8 +113,6 @@ bool MinutesAtPressure::isEmpty()
     return m_empty;
 }
 
-float pressureMult = 5;
-
 void MinutesAtPressure::paint(QPainter &painter, gGraph &graph, const QRegion &region)
 {
     QRect rect = region.boundingRect();
@@ -156,13 +148,6 @@ void MinutesAtPressure::paint(QPainter &painter, gGraph &graph, const QRegion &r
     m_lastmaxx = m_maxx;
 
     QMap<EventStoreType, int>::iterator it;
-    if (graph.printing()) {
-        // lock the other mutex...
-//        while (recalculating()) {};
-//        recalculate(&graph);
-        while (recalculating()) {};
-
-    }
 
     if (!painter.isActive()) return;
 
@@ -177,8 +162,8 @@ void MinutesAtPressure::paint(QPainter &painter, gGraph &graph, const QRegion &r
     int minpressure = qMin((EventStoreType)4, m_minpressure);
     int maxpressure = qMax((EventStoreType)16, m_maxpressure);
 
-    int min = minpressure * pressureMult;
-    int max = maxpressure * pressureMult;
+    int min = minpressure * m_pressureMult;
+    int max = maxpressure * m_pressureMult;
 
     int tot = max - min;
     double xstep = double(width) / double(tot);
@@ -230,7 +215,7 @@ void MinutesAtPressure::paint(QPainter &painter, gGraph &graph, const QRegion &r
         ////////////////////////////////////////////////////////////////////
         // Draw X Axis labels
         ////////////////////////////////////////////////////////////////////
-        double pstep = xstep * pressureMult;
+        double pstep = xstep * m_pressureMult;
 
         xp = left;// /2.0;
         for (int i = 0; i<=max-min; ++i) {
@@ -252,11 +237,11 @@ void MinutesAtPressure::paint(QPainter &painter, gGraph &graph, const QRegion &r
         QPoint mouse=graph.graphView()->currentMousePos();
         if (region.contains(mouse)) {
             float p =  minpressure + (mouse.x() - left) / pstep;
-            mouseOverKey = floor(p*pressureMult);
+            mouseOverKey = floor(p*m_pressureMult);
 
             float ipap_minutes = ipap.times[mouseOverKey] / 60.0;
             float epap_minutes = epap.times[mouseOverKey] / 60.0;
-            QString str = QString("%1%2").arg(mouseOverKey / pressureMult,3,'f',1).arg(STR_UNIT_CMH2O)+"\n";
+            QString str = QString("%1%2").arg(mouseOverKey / m_pressureMult,3,'f',1).arg(STR_UNIT_CMH2O)+"\n";
             bool good = false;
 
             if (ipap_minutes > 0) {
@@ -815,13 +800,6 @@ void MinutesAtPressure::paint(QPainter &painter, gGraph &graph, const QRegion &r
 */
     timelock.unlock();
 
-    if (m_recalculating) {
-//        painter.setFont(*defaultfont);
-//        painter.setPen(QColor(0,0,0,125));
-//        painter.drawText(region.boundingRect(), Qt::AlignCenter, QObject::tr("Recalculating..."));
-    }
-
-
 //    painter.setPen(QPen(Qt::black,1));
 //    painter.drawRect(rect);
 
@@ -830,124 +808,230 @@ void MinutesAtPressure::paint(QPainter &painter, gGraph &graph, const QRegion &r
 }
 
 
-//! \brief Updates Time At Pressure from session *sess
-void RecalcMAP::updateTimes(PressureInfo & info, Session * sess)
+quint64 PressureIndex::makeSignature(Session *sess, ChannelID code)
+{
+    QHash<ChannelID, QVector<EventList *> >::iterator ei = sess->eventlist.find(code);
+    if (ei == sess->eventlist.end()) {
+        return 0;
+    }
+
+    quint64 sig = 1;
+    const QVector<EventList *> & evec = ei.value();
+    for (int i = 0; i < evec.size(); ++i) {
+        sig = sig * 31 + quint64(quintptr(evec.at(i))) + evec.at(i)->count();
+    }
+    return sig;
+}
+
+void PressureIndex::build(Session *sess, ChannelID code, float mult, const QList<ChannelID> &chans)
 {
-    qint64 d1,d2;
-    EventDataType gain;
-    EventStoreType data, lastdata;
-    qint64 time, lasttime;
-    int ELsize, duration;
-    bool first;
-    int key;
-    EventDataType val = 0;
-
-    ChannelID code = info.code;
-    qint64 minx = info.minx;
-    qint64 maxx = info.maxx;
+    m_mult = mult;
+    m_chans = chans;
+    m_start.clear();
+    m_end.clear();
+    m_secs.clear();
+    m_key.clear();
+
+    int numchans = chans.size();
+    m_evtimes.fill(QVector<qint64>(), numchans);
+    m_evprefix.fill(QVector<double>(), numchans);
+    m_runevents.fill(QVector<EventDataType>(), numchans);
+    m_blockevents.fill(QVector<EventDataType>(), numchans);
+    m_blocktimes.clear();
+    m_minkey = m_bins = 0;
 
     if (code == 0) return;
 
-    // Find pressure channel
     QHash<ChannelID, QVector<EventList *> >::iterator ei = sess->eventlist.find(code);
-
-    // Done already if no channel
     if (ei == sess->eventlist.end())
         return;
 
+    ////////////////////////////////////////////////////////////////////
+    // Collapse the pressure samples into runs of the same bin
+    ////////////////////////////////////////////////////////////////////
     const QVector<EventList *> & evec = ei.value();
-    int esize = evec.size();
+    int minkey = 300, maxkey = 0;
 
-    pressureMult = (sess->machine()->loaderName() == "PRS1") ? 2 : 5;
-    // Loop through event lists
-    for (int ei = 0; ei < esize; ++ei) {
-        const EventList *EL = evec.at(ei);
-        gain = EL->gain();
-
-        // Don't bother with short sessions
-        ELsize = EL->count();
+    for (int i = 0; i < evec.size(); ++i) {
+        const EventList *EL = evec.at(i);
+        EventDataType gain = EL->gain();
+        int ELsize = EL->count();
         if (ELsize < 1) continue;
 
-        lasttime = 0;
-        lastdata = 0;
+        qint64 lasttime = EL->time(0);
+        EventStoreType lastdata = floor(float(EL->raw(0)) * gain * mult);
 
-        first = true;
+        for (int e = 1; e <= ELsize; ++e) {
+            qint64 time;
+            EventStoreType data;
 
-        // Skip if outside of range
-        if ((EL->first() > maxx) || (EL->last() < minx)) {
-            continue;
+            if (e < ELsize) {
+                time = EL->time(e);
+                data = floor(float(EL->raw(e)) * gain * mult);  // pressure times mult, so bins are integers
+                if (data == lastdata) continue;
+            } else {
+                // The last run lasts until the end of the list
+                time = EL->last();
+                data = lastdata;
+            }
+
+            if ((lastdata >= 0) && (lastdata < 300) && (time > lasttime)) {
+                m_start.append(lasttime);
+                m_end.append(time);
+                m_secs.append((time - lasttime) / 1000L);
+                m_key.append(lastdata);
+                minkey = qMin(minkey, int(lastdata));
+                maxkey = qMax(maxkey, int(lastdata));
+            }
+            lasttime = time;
+            lastdata = data;
         }
+    }
 
-        // Scan through pressure samples
-        for (int e = 0; e < ELsize; ++e) {
-            if (m_quit) {
-                m_done = true;
-                return;
+    int runs = m_start.size();
+    if (runs == 0) return;
+
+    m_minkey = minkey;
+    m_bins = maxkey - minkey + 1;
+
+    ////////////////////////////////////////////////////////////////////
+    // Sort each channels events, and share them out among the runs
+    ////////////////////////////////////////////////////////////////////
+    for (int c = 0; c < numchans; ++c) {
+        ChannelID cod = chans.at(c);
+        bool span = (schema::channel[cod].type() == schema::SPAN);
+
+        QVector<QPair<qint64, double> > evs;
+        QHash<ChannelID, QVector<EventList *> >::iterator ci = sess->eventlist.find(cod);
+        if (ci != sess->eventlist.end()) {
+            const QVector<EventList *> & cvec = ci.value();
+            for (int i = 0; i < cvec.size(); ++i) {
+                const EventList *EL = cvec.at(i);
+                for (quint32 e = 0; e < EL->count(); ++e) {
+                    evs.append(qMakePair(EL->time(e), span ? double(EL->raw(e)) * EL->gain() : 1.0));
+                }
             }
+        }
+        std::sort(evs.begin(), evs.end());
+
+        QVector<qint64> & times = m_evtimes[c];
+        QVector<double> & prefix = m_evprefix[c];
+        times.resize(evs.size());
+        prefix.resize(evs.size() + 1);
+        prefix[0] = 0;
+        for (int i = 0; i < evs.size(); ++i) {
+            times[i] = evs.at(i).first;
+            prefix[i + 1] = prefix[i] + evs.at(i).second;
+        }
 
-            time = EL->time(e);
-            data = floor(float(EL->raw(e)) * gain * pressureMult);  // pressure times ten, so can look at .1 intervals in an integer
+        QVector<EventDataType> & runevents = m_runevents[c];
+        runevents.resize(runs);
+        for (int r = 0; r < runs; ++r) {
+            int i1 = std::lower_bound(times.constBegin(), times.constEnd(), m_start.at(r)) - times.constBegin();
+            int i2 = std::lower_bound(times.constBegin(), times.constEnd(), m_end.at(r)) - times.constBegin();
+            runevents[r] = prefix.at(i2) - prefix.at(i1);
+        }
+    }
 
-            Q_ASSERT(data < 300);
+    ////////////////////////////////////////////////////////////////////
+    // Running totals at each block boundary
+    ////////////////////////////////////////////////////////////////////
+    int blocks = runs / BlockSize;
+    m_blocktimes.fill(0, (blocks + 1) * m_bins);
+    for (int c = 0; c < numchans; ++c) {
+        m_blockevents[c].fill(0, (blocks + 1) * m_bins);
+    }
 
-            if ((time < minx) || first) {
-                lasttime = time;
-                lastdata = data;
+    for (int b = 0; b < blocks; ++b) {
+        int * tcur = m_blocktimes.data() + b * m_bins;
+        int * tnext = tcur + m_bins;
+        memcpy(tnext, tcur, m_bins * sizeof(int));
 
-                first = false;
-                continue;
+        for (int c = 0; c < numchans; ++c) {
+            EventDataType * ecur = m_blockevents[c].data() + b * m_bins;
+            memcpy(ecur + m_bins, ecur, m_bins * sizeof(EventDataType));
+        }
+
+        for (int r = b * BlockSize; r < (b + 1) * BlockSize; ++r) {
+            int k = m_key.at(r) - m_minkey;
+            tnext[k] += m_secs.at(r);
+            for (int c = 0; c < numchans; ++c) {
+                m_blockevents[c][(b + 1) * m_bins + k] += m_runevents.at(c).at(r);
             }
+        }
+    }
+}
 
-            if (lastdata != data) {
-                d1 = qMax(minx, lasttime);
-                d2 = qMin(maxx, time);
+void PressureIndex::addRun(PressureInfo &info, int run) const
+{
+    int key = m_key.at(run);
+    info.times[key] += m_secs.at(run);
 
-                duration = (d2 - d1) / 1000L;
-                key = lastdata;
-                info.times[key] += duration;
+    for (int c = 0; c < m_chans.size(); ++c) {
+        info.events[m_chans.at(c)][key] += m_runevents.at(c).at(run);
+    }
+}
 
-                int cs = info.chans.size();
+void PressureIndex::addClipped(PressureInfo &info, int run, qint64 minx, qint64 maxx) const
+{
+    qint64 d1 = qMax(minx, m_start.at(run));
+    qint64 d2 = qMin(maxx, m_end.at(run));
+    if (d2 <= d1) return;
+
+    int key = m_key.at(run);
+    info.times[key] += (d2 - d1) / 1000L;
+
+    for (int c = 0; c < m_chans.size(); ++c) {
+        const QVector<qint64> & times = m_evtimes.at(c);
+        int i1 = std::lower_bound(times.constBegin(), times.constEnd(), d1) - times.constBegin();
+        int i2 = std::lower_bound(times.constBegin(), times.constEnd(), d2) - times.constBegin();
+        info.events[m_chans.at(c)][key] += m_evprefix.at(c).at(i2) - m_evprefix.at(c).at(i1);
+    }
+}
 
-                for (int c = 0; c < cs; ++c) {
-                    ChannelID cod = info.chans.at(c);
-                    schema::Channel & chan = schema::channel[cod];
-                    if (chan.type() == schema::SPAN) {
-                        info.events[cod][key] += val = sess->rangeSum(cod, d1, d2);
-                    } else {
-                        info.events[cod][key] += val = sess->rangeCount(cod, d1, d2);
-                    }
-                }
+void PressureIndex::query(PressureInfo &info, qint64 minx, qint64 maxx) const
+{
+    if (m_start.isEmpty() || (maxx <= minx)) return;
 
-                lasttime = time;
-                lastdata = data;
-            }
-            if (time > maxx) {
-                break;
-            }
+    // Runs overlapping the range are those ending after minx and starting before maxx
+    int a = std::upper_bound(m_end.constBegin(), m_end.constEnd(), minx) - m_end.constBegin();
+    int b = std::lower_bound(m_start.constBegin(), m_start.constEnd(), maxx) - m_start.constBegin();
 
-        }
-        if ((lasttime < maxx) || (lastdata == data)) {
-            d1 = qMax(lasttime, minx);
-            d2 = qMin(maxx, EL->last());
-
-            duration = (d2 - d1) / 1000L;
-            key = lastdata;
-            info.times[key] += duration;
-            int cs = info.chans.size();
-
-            for (int c = 0; c < cs; ++c) {
-                ChannelID cod = info.chans.at(c);
-                schema::Channel & chan = schema::channel[cod];
-                if (chan.type() == schema::SPAN) {
-                    info.events[cod][key] += sess->rangeSum(cod, d1, d2);
-                } else {
-                    info.events[cod][key] += sess->rangeCount(cod, d1, d2);
-                }
-            }
+    // Only the two outermost runs can stick out of the range
+    if ((a < b) && ((m_start.at(a) < minx) || (m_end.at(a) > maxx))) {
+        addClipped(info, a++, minx, maxx);
+    }
+    if ((a < b) && ((m_start.at(b - 1) < minx) || (m_end.at(b - 1) > maxx))) {
+        addClipped(info, --b, minx, maxx);
+    }
+    if (a >= b) return;
 
-        }
+    int ba = (a + BlockSize - 1) / BlockSize;
+    int bb = b / BlockSize;
+
+    if (ba >= bb) {
+        for (int r = a; r < b; ++r) addRun(info, r);
+        return;
+    }
+
+    for (int r = a; r < ba * BlockSize; ++r) addRun(info, r);
 
+    const int * t1 = m_blocktimes.constData() + ba * m_bins;
+    const int * t2 = m_blocktimes.constData() + bb * m_bins;
+    for (int k = 0; k < m_bins; ++k) {
+        info.times[m_minkey + k] += t2[k] - t1[k];
     }
+
+    for (int c = 0; c < m_chans.size(); ++c) {
+        const EventDataType * e1 = m_blockevents.at(c).constData() + ba * m_bins;
+        const EventDataType * e2 = m_blockevents.at(c).constData() + bb * m_bins;
+        QVector<int> & events = info.events[m_chans.at(c)];
+        for (int k = 0; k < m_bins; ++k) {
+            events[m_minkey + k] += e2[k] - e1[k];
+        }
+    }
+
+    for (int r = bb * BlockSize; r < b; ++r) addRun(info, r);
 }
 
 
@@ -1012,20 +1096,24 @@ void PressureInfo::finishCalcs()
 }
 
 
-void RecalcMAP::run()
+const PressureIndex &MinutesAtPressure::pressureIndex(Session *sess, ChannelID code, const QList<ChannelID> &chans)
 {
-    QMutexLocker locker(&map->mutex);
-    map->m_recalculating = true;
-    Day * day = map->m_day;
-    if (!day) return;
-
-    QList<Session *>::iterator sit;
-    QList<Session *>::iterator sess_end = day->end();
+    PressureIndex & index = m_indexes[qMakePair(sess, code)];
+    quint64 sig = PressureIndex::makeSignature(sess, code);
 
+    if ((index.signature != sig) || !index.matches(m_pressureMult, chans)) {
+        index.build(sess, code, m_pressureMult, chans);
+        index.signature = sig;
+    }
+    return index;
+}
 
-    QMap<EventStoreType, int> times;
+void MinutesAtPressure::recalculate(gGraph * graph)
+{
+    m_graph = graph;
 
-    QHash<ChannelID, QMap<EventStoreType, EventDataType> > events;
+    Day * day = m_day;
+    if (!day) return;
 
     // Get the channels for specified Channel types
     QList<ChannelID> chans = day->getSortedMachineChannels(schema::FLAG);
@@ -1034,254 +1122,34 @@ void RecalcMAP::run()
     chans.removeAll(CPAP_VSnore2);
     chans.removeAll(CPAP_FlowLimit);
     chans.removeAll(CPAP_RERA);
-//    for (int i=0;i<chans.size();i++) {
-//        schema::Channel &chan = schema::channel[chans.at(i)];
-//        qDebug() << chan.fullname();
-//    }
 
     ChannelID ipapcode = (day->channelExists(CPAP_IPAP)) ? CPAP_IPAP : CPAP_Pressure;
     ChannelID epapcode = (day->channelExists(CPAP_EPAP)) ? CPAP_EPAP : 0;
 
     qint64 minx, maxx;
-    map->m_graph->graphView()->GetXBounds(minx, maxx);
+    graph->graphView()->GetXBounds(minx, maxx);
     PressureInfo IPAP(ipapcode, minx, maxx), EPAP(epapcode, minx, maxx);
 
     IPAP.AddChannels(chans);
     EPAP.AddChannels(chans);
 
-    ChannelID code;
-
-//    QList<ChannelID> badchans;
-//    for (int i=0 ; i < chans.size(); ++i) {
-//        code = chans.at(i);
-//      //  if (!day->channelExists(code)) badchans.push_back(code);
-//    }
-
-//    for (int i=0; i < badchans.size(); ++i) {
-//        code = badchans.at(i);
-//        chans.removeAll(code);
-//    }
-
-
-//    int numchans = chans.size();
-//    // Zero the pressure counts
-//    for (int i=map->m_minpressure; i <= map->m_maxpressure; i++) {
-//        times[i] = 0;
-
-//        for (int c = 0; c < numchans; ++c) {
-//            code = chans.at(c);
-//            events[code].insert(i, 0);
-//        }
-//    }
-
-
-
-    for (sit = day->begin(); sit != sess_end; ++sit) {
+    // Sessions are binned once, after that each range is a handful of lookups per session
+    QList<Session *>::iterator sess_end = day->end();
+    for (QList<Session *>::iterator sit = day->begin(); sit != sess_end; ++sit) {
         Session * sess = (*sit);
 
-        updateTimes(EPAP, sess);
-        updateTimes(IPAP, sess);
-
-        if (m_quit) {
-            m_done = true;
-            return;
+        if (epapcode) {
+            pressureIndex(sess, epapcode, chans).query(EPAP, minx, maxx);
         }
-
-
-/*        QHash<ChannelID, QVector<EventList *> >::iterator ei = sess->eventlist.find(ipapcode);
-        if (ei == sess->eventlist.end())
-            continue;
-
-        const QVector<EventList *> & evec = ei.value();
-        int esize = evec.size();
-        for (int ei = 0; ei < esize; ++ei) {
-            const EventList *EL = evec.at(ei);
-            EventDataType gain = EL->gain();
-            quint32 ELsize = EL->count();
-            if (ELsize < 1)  return;
-            qint64 lasttime = 0; //EL->time(0);
-            EventStoreType lastdata = 0; // EL->raw(0);
-
-            bool first = true;
-            if ((EL->first() > maxx) || (EL->last() < minx)) {
-                continue;
-            }
-
-            for (quint32 e = 0; e < ELsize; ++e) {
-                qint64 time = EL->time(e);
-                EventStoreType data = EL->raw(e);
-
-                if ((time < minx)) {
-                    lasttime = time;
-                    lastdata = data;
-                    first = false;
-                    goto skip;
-                }
-
-                if (first) {
-                    lasttime = time;
-                    lastdata = data;
-                    first = false;
-                }
-
-                if (lastdata != data) {
-                    qint64 d1 = qMax(minx, lasttime);
-                    qint64 d2 = qMin(maxx, time);
-
-
-                    int duration = (d2 - d1) / 1000L;
-                    EventStoreType key = floor(lastdata * gain);
-                    if (key <= 30) {
-                        times[key] += duration;
-                        for (int c = 0; c < chans.size(); ++c) {
-                            ChannelID code = chans.at(c);
-                            schema::Channel & chan = schema::channel[code];
-                            if (chan.type() == schema::SPAN) {
-                                events[code][key] += sess->rangeSum(code, d1, d2);
-                            } else {
-                                events[code][key] += sess->rangeCount(code, d1, d2);
-                            }
-                        }
-                    }
-                    lasttime = time;
-                    lastdata = data;
-                }
-                if (time > maxx) {
-
-                    break;
-                }
-skip:
-                if (m_quit) {
-                    m_done = true;
-                    return;
-                }
-            }
-            if (lasttime < maxx) {
-                qint64 d1 = qMax(lasttime, minx);
-                qint64 d2 = qMin(maxx, EL->last());
-
-                int duration = (d2 - d1) / 1000L;
-                EventStoreType key = floor(lastdata * gain);
-                if (key <= 30) {
-                    times[key] += duration;
-                    for (int c = 0; c < chans.size(); ++c) {
-                        ChannelID code = chans.at(c);
-                        schema::Channel & chan = schema::channel[code];
-                        if (chan.type() == schema::SPAN) {
-                            events[code][key] += sess->rangeSum(code, d1, d2);
-                        } else {
-                            events[code][key] += sess->rangeCount(code, d1, d2);
-                        }
-                    }
-                }
-
-            }
-
-
-        } */
+        pressureIndex(sess, ipapcode, chans).query(IPAP, minx, maxx);
     }
 
-
     EPAP.finishCalcs();
     IPAP.finishCalcs();
 
-/*    QMap<EventStoreType, int>::iterator it;
-    QMap<EventStoreType, int>::iterator times_end = times.end();
-    int maxtime = 0;
-
-    QList<EventStoreType> trash;
-    for (it = times.begin(); it != times_end; ++it) {
-        //EventStoreType key = it.key();
-        int value = it.value();
-//        if (value == 0) {
-//            trash.append(key);
-//        } else {
-            maxtime = qMax(value, maxtime);
-//        }
-    }
-    chans.push_front(CPAP_AHI);
-
-    int maxevents = 0, val;
-
-    for (int i = map->m_minpressure; i <= map->m_maxpressure; i++) {
-        val = events[CPAP_Obstructive][i] +
-              events[CPAP_Hypopnea][i] +
-              events[CPAP_Apnea][i] +
-              events[CPAP_ClearAirway][i];
-
-        events[CPAP_AHI].insert(i, val);
-     //   maxevents = qMax(val, maxevents);
-    }
-
-    for (int i = map->m_minpressure; i <= map->m_maxpressure; i++) {
-        for (int j=0 ; j < chans.size(); ++j) {
-            code = chans.at(j);
-            if ((code == CPAP_AHI) || (schema::channel[code].type() == schema::SPAN)) continue;
-            val = events[code][i];
-            maxevents = qMax(val, maxevents);
-        }
-    }
-    QHash<ChannelID, QMap<EventStoreType, EventDataType> >::iterator eit;
-
-//    for (int i=0; i< trash.size(); ++i) {
-//        EventStoreType key = trash.at(i);
-
-//        times.remove(key);
-//        for (eit = events.begin(); eit != events.end(); ++eit) {
-//            eit.value().remove(key);
-//        }
-//    }
-*/
-
-    QMutexLocker timelock(&map->timelock);
-//    map->times = times;
-//    map->events = events;
-    map->epap = EPAP;
-    map->ipap = IPAP;
-//    map->chans = chans;
- //   map->m_presChannel = ipapcode;
-    timelock.unlock();
-
-    map->recalcFinished();
-    m_done = true;
-}
-
-void MinutesAtPressure::recalculate(gGraph * graph)
-{
-
-    while (recalculating())
-        m_remap->quit();
-
-    m_remap = new RecalcMAP(this);
-    m_remap->setAutoDelete(true);
-
-    m_graph = graph;
-
-    QThreadPool * tp = QThreadPool::globalInstance();
-//    tp->reserveThread();
-
-    if (graph->printing()) {
-        m_remap->run();
-    } else {
-        while(!tp->tryStart(m_remap));
-    }
-
-
-    // Start recalculating in another thread, organize a callback to redraw when done..
-
-
-}
-
-void MinutesAtPressure::recalcFinished()
-{
-    if (m_graph) {
-        m_graph->timedRedraw(0);
-    }
-    m_recalculating = false;
-    m_remap = nullptr;
-//    QThreadPool * tp = QThreadPool::globalInstance();
-//    tp->releaseThread();
-
+    QMutexLocker locker(&timelock);
+    epap = EPAP;
+    ipap = IPAP;
 }
 
 
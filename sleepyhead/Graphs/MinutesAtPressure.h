@@ -62,25 +62,65 @@ struct PressureInfo
     QList<ChannelID> chans;
 };
 
-class RecalcMAP:public QRunnable
+/*! \class PressureIndex
+    \brief One sessions pressure channel, as runs of constant pressure binned ahead of time
+
+    Runs are grouped in blocks, with running totals of seconds and events per pressure bin kept
+    at each block boundary. Any time range is then the difference of two block totals, plus the
+    few runs left over at either edge.
+    */
+class PressureIndex
 {
-    friend class MinutesAtPressure;
-public:
-    explicit RecalcMAP(MinutesAtPressure * map) :map(map), m_quit(false), m_done(false) {}
-    virtual ~RecalcMAP();
-    virtual void run();
+  public:
+    PressureIndex() : signature(0), m_mult(0), m_minkey(0), m_bins(0) {}
 
-    void quit();
-protected:
-    void updateTimes(PressureInfo & info, Session * sess);
-    MinutesAtPressure * map;
-    volatile bool m_quit;
-    volatile bool m_done;
+    //! \brief Bins code's pressure runs at mult steps per cmH2O, counting chans events in each
+    void build(Session *sess, ChannelID code, float mult, const QList<ChannelID> &chans);
+
+    //! \brief Adds the seconds and events at each pressure between minx and maxx into info
+    void query(PressureInfo &info, qint64 minx, qint64 maxx) const;
+
+    //! \brief Returns true if this index was built for the same channels and multiplier
+    bool matches(float mult, const QList<ChannelID> &chans) const { return (m_mult == mult) && (m_chans == chans); }
+
+    //! \brief Cheap fingerprint of the event lists an index would be built from
+    static quint64 makeSignature(Session *sess, ChannelID code);
+
+    quint64 signature;
+
+  protected:
+    void addRun(PressureInfo &info, int run) const;
+    void addClipped(PressureInfo &info, int run, qint64 minx, qint64 maxx) const;
+
+    static const int BlockSize = 64;
+
+    float m_mult;
+    QList<ChannelID> m_chans;
+
+    //! \brief Runs of constant pressure, in time order
+    QVector<qint64> m_start, m_end;
+    QVector<int> m_secs;
+    QVector<EventStoreType> m_key;
+
+    int m_minkey, m_bins;
+
+    //! \brief Running totals per bin at each block boundary, indexed [block * m_bins + bin]
+    QVector<int> m_blocktimes;
+    QVector<QVector<EventDataType> > m_blockevents;
+
+    //! \brief Events (or span seconds) per channel falling in each run
+    QVector<QVector<EventDataType> > m_runevents;
+
+    //! \brief Each channels event times, with a running count (or span seconds) alongside
+    QVector<QVector<qint64> > m_evtimes;
+    QVector<QVector<double> > m_evprefix;
 };
 
+/*! \class MinutesAtPressure
+    \brief Time and events at each pressure for the visible range, recalculated as the range changes
+    */
 class MinutesAtPressure:public Layer
 {
-    friend class RecalcMAP;
 public:
     MinutesAtPressure();
     virtual ~MinutesAtPressure();
@@ -92,6 +132,8 @@ public:
     virtual bool isEmpty();
     virtual int minimumHeight();
 
+    virtual const char *traceName() const { return "MinutesAtPressure"; }
+
     //! Draw filled rectangles behind Event Flag's, and an outlines around them all, Calls the individual paint for each gFlagLine
     virtual void paint(QPainter &painter, gGraph &w, const QRegion &region);
 
@@ -99,7 +141,6 @@ public:
     bool mousePressEvent(QMouseEvent *event, gGraph *graph);
     bool mouseReleaseEvent(QMouseEvent *event, gGraph *graph);
 
-    virtual void recalcFinished();
     virtual Layer * Clone() {
         MinutesAtPressure * map = new MinutesAtPressure();
         Layer::CloneInto(map);
@@ -108,7 +149,6 @@ public:
     }
 
     void CloneInto(MinutesAtPressure * layer) {
-        mutex.lock();
         timelock.lock();
         layer->m_empty = m_empty;
         layer->m_minimum_height = m_minimum_height;
@@ -121,17 +161,19 @@ public:
         layer->maxevents = maxevents;
         layer->m_presChannel = m_presChannel;
         layer->m_minpressure = m_minpressure;
+        layer->m_pressureMult = m_pressureMult;
         layer->m_maxpressure = m_maxpressure;
         layer->max_mins = max_mins;
 
         layer->ahis = ahis;
 
-        mutex.unlock();
         timelock.unlock();
     }
 protected:
+    //! \brief Returns sess's index for code, building it if the session's events have changed
+    const PressureIndex &pressureIndex(Session *sess, ChannelID code, const QList<ChannelID> &chans);
+
     QMutex timelock;
-    QMutex mutex;
 
     bool m_empty;
     int m_minimum_height;
@@ -139,7 +181,6 @@ protected:
     qint64 m_lastminx;
     qint64 m_lastmaxx;
     gGraph * m_graph;
-    RecalcMAP * m_remap;
     QMap<EventStoreType, int> times;
     QMap<EventStoreType, int> epap_times;
     QList<ChannelID> chans;
@@ -150,6 +191,11 @@ protected:
     EventStoreType m_minpressure;
     EventStoreType m_maxpressure;
 
+    //! \brief Pressure bins per cmH2O
+    float m_pressureMult;
+
+    QHash<QPair<Session *, ChannelID>, PressureIndex> m_indexes;
+
     PressureInfo epap, ipap;
 
     EventDataType max_mins;
@@ -9,6 +9,7 @@
 #include <cmath>
 #include <QVector>
 #include "SleepLib/profiles.h"
+#include "SleepLib/trace.h"
 #include "gFlagsLine.h"
 #include "gYAxis.h"
 
@@ -191,7 +192,10 @@ void gFlagsGroup::paint(QPainter &painter, gGraph &g, const QRegion &region)
         // Paint the actual flags
         QRect rect(left, linetop, width, m_barh);
         visflags[i]->m_rect = rect;
-        visflags[i]->paint(painter, g, QRegion(rect));
+        {
+            TRACE_SCOPE(Trace::CAT_Render, visflags[i]->traceName());
+            visflags[i]->paint(painter, g, QRegion(rect));
+        }
         linetop += m_barh;
     }
 
@@ -286,143 +290,117 @@ void gFlagsLine::paint(QPainter &painter, gGraph &w, const QRegion &region)
     // Draw text label
     w.renderText(chan.label(), left - m_lx - 10, top + (height / 2) + (m_ly / 2));
 
-    float x1, x2;
+    double x1, x2;
 
     float bartop = top + 2;
     float bottom = top + height - 2;
-    qint64 X, X2, L;
-
-    qint64 start;
-    quint32 *tptr;
-    EventStoreType *dptr, * eptr;
-    int idx;
-    QHash<ChannelID, QVector<EventList *> >::iterator cei;
-
-    qint64 clockdrift = qint64(p_profile->cpap->clockDrift()) * 1000L;
-    qint64 drift = 0;
+    qint64 X, X2;
 
-    QVector<QLine> vlines;
+    const FlagTimeline &timeline = m_day->flagTimeline(m_code);
 
     QColor color=schema::channel[m_code].defaultColor();
-    QBrush brush(color);
+    QPoint mouse = w.graphView()->currentMousePos();
+    bool canhover = !w.selectingArea();
 
-    bool hover = false;
-    for (QList<Session *>::iterator s = m_day->begin(); s != m_day->end(); s++) {
-        if (!(*s)->enabled()) {
-            continue;
-        }
+    if (chan.type() == schema::SPAN) {
+        ///////////////////////////////////////////////////////////////////////////
+        // Draw Event Flag Spans
+        ///////////////////////////////////////////////////////////////////////////
 
-        drift = ((*s)->type() == MT_CPAP) ? clockdrift : 0;
+        // Spans are ordered by their end, so any starting before maxx ends before maxx + the longest one
+        int idx = timeline.lowerBound(minx);
+        int end = timeline.upperBound(qint64(maxx) + timeline.maxDuration());
 
-        cei = (*s)->eventlist.find(m_code);
+        QVector<QRectF> rects;
+        QRectF hoverrect;
+        int hover = -1;
 
-        if (cei == (*s)->eventlist.end()) {
-            continue;
-        }
+        for (; idx < end; ++idx) {
+            X = timeline.time(idx);
+            X2 = X - qint64(timeline.data(idx)) * 1000L;
 
-        QVector<EventList *> &evlist = cei.value();
-
-        for (int k = 0; k < evlist.size(); k++) {
-            EventList &el = *(evlist[k]);
-            start = el.first() + drift;
-            tptr = el.rawTime();
-            dptr = el.rawData();
-            int np = el.count();
-            eptr = dptr + np;
+            if (X2 > maxx) {
+                continue;
+            }
 
-            for (idx = 0; dptr < eptr; dptr++, tptr++, idx++) {
-                X = start + *tptr;
-                L = *dptr * 1000;
+            x1 = double(X - minx) * xmult + left;
+            x2 = double(X2 - minx) * xmult + left;
 
-                if (X >= minx) {
-                    break;
-                }
+            QRectF rect(x2, bartop, x1-x2, bottom-bartop);
 
-                X2 = X - L;
+            if (canhover && (hover < 0) && rect.contains(mouse)) {
+                hover = idx;
+                hoverrect = rect;
+            }
 
-                if (X2 >= minx) {
-                    break;
-                }
+            // Merge spans touching in pixel space, so dense rows go out as a handful of rects
+            if (!rects.isEmpty() && (x2 <= rects.last().right() + 1)) {
+                rects.last() = rects.last().united(rect);
+            } else {
+                rects.append(rect);
+            }
+        }
 
+        painter.setPen(Qt::NoPen);
+        painter.setBrush(QBrush(color));
+        painter.drawRects(rects.constData(), rects.size());
+        painter.setBrush(Qt::NoBrush);
+
+        if (hover >= 0) {
+            painter.setPen(QPen(Qt::red,1));
+            painter.drawRect(hoverrect);
+
+            int s = timeline.data(hover);
+            int m = s / 60;
+            s %= 60;
+            QString lab = QString("%1").arg(schema::channel[m_code].fullname());
+            if (m>0) {
+                lab += QObject::tr(" (%2 min, %3 sec)").arg(m).arg(s);
+            } else {
+                lab += QObject::tr(" (%3 sec)").arg(m).arg(s);
             }
+            w.ToolTip(lab, hoverrect.x() - 10, bartop + (3 * w.printScaleY()), TT_AlignRight, p_profile->general->tooltipTimeout());
+        }
 
-            np -= idx;
-
-            if (chan.type() == schema::SPAN) {
-                ///////////////////////////////////////////////////////////////////////////
-                // Draw Event Flag Spans
-                ///////////////////////////////////////////////////////////////////////////
-
-                for (; dptr < eptr; dptr++) {
-                    X = start + * tptr++;
-
-
-                    L = *dptr * 1000L;
-                    X2 = X - L;
-                    if (X2 > maxx) {
-                        break;
-                    }
-
-                    x1 = double(X - minx) * xmult + left;
-                    x2 = double(X2 - minx) * xmult + left;
-
-                    brush = QBrush(color);
-                    painter.fillRect(x2, bartop, x1-x2, bottom-bartop, brush);
-                    if (!w.selectingArea() && !hover && QRect(x2, bartop, x1-x2, bottom-bartop).contains(w.graphView()->currentMousePos())) {
-                        hover = true;
-                        painter.setPen(QPen(Qt::red,1));
-
-                        painter.drawRect(x2, bartop, x1-x2, bottom-bartop);
-                        int x,y;
-                        int s = *dptr;
-                        int m = s / 60;
-                        s %= 60;
-                        QString lab = QString("%1").arg(schema::channel[m_code].fullname());
-                        if (m>0) {
-                            lab += QObject::tr(" (%2 min, %3 sec)").arg(m).arg(s);
-                        } else {
-                            lab += QObject::tr(" (%3 sec)").arg(m).arg(s);
-                        }
-                        GetTextExtent(lab, x, y);
-                        w.ToolTip(lab, x2 - 10, bartop + (3 * w.printScaleY()), TT_AlignRight, p_profile->general->tooltipTimeout());
-
-                    }
-                }
+    } else { //if (chan.type() == schema::FLAG) {
+        ///////////////////////////////////////////////////////////////////////////
+        // Draw Event Flag Bars
+        ///////////////////////////////////////////////////////////////////////////
 
-            } else { //if (chan.type() == schema::FLAG) {
-                ///////////////////////////////////////////////////////////////////////////
-                // Draw Event Flag Bars
-                ///////////////////////////////////////////////////////////////////////////
+        int idx = timeline.lowerBound(minx);
+        int end = timeline.upperBound(maxx);
 
-                for (int i = 0; i < np; i++, dptr++) {
-                    X = start + *tptr++;
+        QVector<QLine> vlines;
+        vlines.reserve(qMin(end - idx, width + 1));
 
-                    if (X > maxx) {
-                        break;
-                    }
+        while (idx < end) {
+            x1 = (timeline.time(idx) - minx) * xmult + left;
+            int px = x1;
+            vlines.append(QLine(px, bartop, px, bottom));
 
-                    x1 = (X - minx) * xmult + left;
+            // Any more flags landing in this pixel column would draw the same line
+            idx = timeline.lowerBound(qint64(minx) + qint64(ceil(double(px + 1 - left) / xmult)), idx + 1);
+        }
 
-                    if (!w.selectingArea() && !hover && QRect(x1-3, bartop-2, 6, bottom-bartop+4).contains(w.graphView()->currentMousePos())) {
-                        hover = true;
-                        painter.setPen(QPen(Qt::red,1));
+        painter.setPen(color);
+        painter.drawLines(vlines);
 
-                        painter.drawRect(x1-2, bartop-2, 4, bottom-bartop+4);
-                        int x,y;
-                        QString lab = QString("%1 (%2)").arg(schema::channel[m_code].fullname()).arg(*dptr);
-                        GetTextExtent(lab, x, y);
+        if (canhover && (mouse.y() >= bartop - 2) && (mouse.y() < bottom + 2)) {
+            // Matches the 6 pixel wide hover box around each flag
+            qint64 from = qint64(minx) + qint64(floor(double(mouse.x() - 2 - left) / xmult));
+            qint64 to = qint64(minx) + qint64(ceil(double(mouse.x() + 3 - left) / xmult));
+            int hover = timeline.find(qMax(from, qint64(minx)), qMin(to, qint64(maxx)));
+            if (hover >= 0) {
+                x1 = (timeline.time(hover) - minx) * xmult + left;
 
-                        w.ToolTip(lab, x1 - 10, bartop + (3 * w.printScaleY()), TT_AlignRight, p_profile->general->tooltipTimeout());
-                    }
+                painter.setPen(QPen(Qt::red,1));
+                painter.drawRect(x1-2, bartop-2, 4, bottom-bartop+4);
+                QString lab = QString("%1 (%2)").arg(schema::channel[m_code].fullname()).arg(timeline.data(hover));
 
-                    vlines.append(QLine(x1, bartop, x1, bottom));
-                }
+                w.ToolTip(lab, x1 - 10, bartop + (3 * w.printScaleY()), TT_AlignRight, p_profile->general->tooltipTimeout());
             }
         }
     }
-
-    painter.setPen(color);
-    painter.drawLines(vlines);
 }
 
 bool gFlagsLine::mouseMoveEvent(QMouseEvent *event, gGraph *graph)
@@ -21,6 +21,8 @@ class gLabelArea: public gSpacer
 {
   public:
     gLabelArea(Layer * layer);
+    virtual const char *traceName() const { return "gLabelArea"; }
+
     virtual void paint(QPainter &painter, gGraph &w, const QRegion &region) {
         Q_UNUSED(w);
         Q_UNUSED(painter);
@@ -61,6 +63,8 @@ class gFlagsLine: public Layer
     gFlagsLine(ChannelID code);
     virtual ~gFlagsLine();
 
+    virtual const char *traceName() const { return "gFlagsLine"; }
+
     //! \brief Drawing code to add the flags and span markers to the Vertex buffers.
     virtual void paint(QPainter &painter, gGraph &w, const QRegion &region);
 
@@ -103,6 +107,8 @@ class gFlagsGroup: public LayerGroup
     gFlagsGroup();
     virtual ~gFlagsGroup();
 
+    virtual const char *traceName() const { return "gFlagsGroup"; }
+
     //! Draw filled rectangles behind Event Flag's, and an outlines around them all, Calls the individual paint for each gFlagLine
     virtual void paint(QPainter &painter, gGraph &w, const QRegion &region);
 
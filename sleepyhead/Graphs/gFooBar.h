@@ -20,6 +20,8 @@ class gShadowArea: public Layer
     gShadowArea(QColor shadow_color = QColor(40, 40, 40, 40), QColor line_color = Qt::blue);
     virtual ~gShadowArea();
 
+    virtual const char *traceName() const { return "gShadowArea"; }
+
     virtual void paint(QPainter &painter, gGraph &w, const QRegion &region);
 
   protected:
@@ -41,6 +43,8 @@ class gFooBar: public Layer
             QColor line_color = QColor("dark grey"));
     virtual ~gFooBar();
 
+    virtual const char *traceName() const { return "gFooBar"; }
+
     virtual void paint(QPainter &painter, gGraph &w, const QRegion &region);
 
   protected:
@@ -17,6 +17,7 @@
 #include "Graphs/gGraphView.h"
 #include "Graphs/layer.h"
 #include "SleepLib/profiles.h"
+#include "SleepLib/trace.h"
 
 extern MainWindow *mainwin;
 
@@ -426,6 +427,7 @@ void gGraph::paint(QPainter &painter, const QRegion &region)
         if (ll->position() == LayerTop) {
             QRect rect(originX + left, originY + top, width - left - right, tmp);
             ll->m_rect = rect;
+            TRACE_SCOPE(Trace::CAT_Render, ll->traceName());
             ll->paint(painter, *this, QRegion(rect));
             top += tmp;
         }
@@ -434,6 +436,7 @@ void gGraph::paint(QPainter &painter, const QRegion &region)
             bottom += tmp * printScaleY();
             QRect rect(originX + left, originY + height - bottom, width - left - right, tmp);
             ll->m_rect = rect;
+            TRACE_SCOPE(Trace::CAT_Render, ll->traceName());
             ll->paint(painter, *this, QRegion(rect));
         }
     }
@@ -451,6 +454,7 @@ void gGraph::paint(QPainter &painter, const QRegion &region)
         if (ll->position() == LayerCenter) {
             QRect rect(originX + left, originY + top, width - left - right, height - top - bottom);
             ll->m_rect = rect;
+            TRACE_SCOPE(Trace::CAT_Render, ll->traceName());
             ll->paint(painter, *this, QRegion(rect));
         }
     }
@@ -461,6 +465,7 @@ void gGraph::paint(QPainter &painter, const QRegion &region)
 
         if (!ll->visible()) { continue; }
         if ((ll->position() == LayerLeft) || (ll->position() == LayerRight)) {
+            TRACE_SCOPE(Trace::CAT_Render, ll->traceName());
             ll->paint(painter, *this, QRegion(ll->m_rect));
         }
     }
@@ -481,6 +486,20 @@ void gGraph::paint(QPainter &painter, const QRegion &region)
 }
 
 QPixmap gGraph::renderPixmap(int w, int h, bool printing)
+{
+    QPixmap pm(w,h);
+    renderTo(&pm, w, h, printing);
+    return pm;
+}
+
+QImage gGraph::renderImage(int w, int h, bool printing)
+{
+    QImage image(w, h, QImage::Format_ARGB32_Premultiplied);
+    renderTo(&image, w, h, printing);
+    return image;
+}
+
+void gGraph::renderTo(QPaintDevice *device, int w, int h, bool printing)
 {
 
     QFont *_defaultfont = defaultfont;
@@ -509,13 +528,12 @@ QPixmap gGraph::renderPixmap(int w, int h, bool printing)
     mediumfont = &fb;
     bigfont = &fc;
 
-    QPixmap pm(w,h);
-
-
     bool pixcaching = p_profile->appearance->usePixmapCaching();
     graphView()->setUsePixmapCache(false);
     p_profile->appearance->setUsePixmapCaching(false);
-    QPainter painter(&pm);
+    // One-off renders at print scale would only fill the atlases with glyphs the screen never uses
+    graphView()->setUseGlyphAtlas(false);
+    QPainter painter(device);
     painter.fillRect(0,0,w,h,QBrush(QColor(Qt::white)));
     QRegion region(0,0,w,h);
     paint(painter, region);
@@ -524,6 +542,7 @@ QPixmap gGraph::renderPixmap(int w, int h, bool printing)
 
     graphView()->setUsePixmapCache(pixcaching);
     p_profile->appearance->setUsePixmapCaching(pixcaching);
+    graphView()->setUseGlyphAtlas(true);
     graphView()->setPrintScaleX(1);
     graphView()->setPrintScaleY(1);
 
@@ -532,8 +551,6 @@ QPixmap gGraph::renderPixmap(int w, int h, bool printing)
     mediumfont = _mediumfont;
     bigfont = _bigfont;
     m_printing = false;
-
-    return pm;
 }
 
 // Sets a new Min & Max X clipping, refreshing the graph and all it's layers.
@@ -83,6 +83,9 @@ class gGraph : public QObject
         */
     QPixmap renderPixmap(int width, int height, bool printing = false);
 
+    //! \brief Same as renderPixmap, but straight into a QImage, for printing without a pixmap round trip
+    QImage renderImage(int width, int height, bool printing = false);
+
     //! \brief Set Graph visibility status
     void setVisible(bool b) { m_visible = b; }
 
@@ -331,6 +334,9 @@ class gGraph : public QObject
     inline bool printing() const { return m_printing; }
 
   protected:
+    //! \brief Paints the graph at width x height onto device, with the printing fonts & scales if requested
+    void renderTo(QPaintDevice *device, int width, int height, bool printing);
+
     //! \brief Mouse Wheel events
     virtual void wheelEvent(QWheelEvent *event);
 
@@ -36,6 +36,7 @@
 #include "Graphs/gYAxis.h"
 #include "Graphs/gFlagsLine.h"
 #include "SleepLib/profiles.h"
+#include "SleepLib/trace.h"
 
 
 extern MainWindow *mainwin;
@@ -356,6 +357,7 @@ gGraphView::gGraphView(QWidget *parent, gGraphView *shared)
     m_fadedir = false;
     m_blockUpdates = false;
     use_pixmap_cache = p_profile->appearance->usePixmapCaching();
+    use_glyph_atlas = true;
 
     pin_graph = nullptr;
    // pixmapcache.setCacheLimit(10240*2);
@@ -703,9 +705,10 @@ void gGraphView::DrawTextQue(QPainter &painter)
 }
 
 #else
-// Render graphs with QPainter or pixmap caching, depending on preferences
+// Render graphs with QPainter, drawing what text it can from the glyph atlases
 void gGraphView::DrawTextQue(QPainter &painter)
 {
+    bool atlas = use_glyph_atlas;
     {
         // process the text drawing queue
         int m_textque_items = m_textque.size();
@@ -715,86 +718,50 @@ void gGraphView::DrawTextQue(QPainter &painter)
         for (int i = 0; i < m_textque_items; ++i) {
             const TextQue &q = m_textque.at(i);
 
-            // can do antialiased text via texture cache fine on mac
-            if (usePixmapCache()) {
-                // Generate the pixmap cache "key"
-                QString hstr = QString("%1:%2:%3").
-                        arg(q.text).
-                        arg(q.color.name()).
-                        arg(q.font->pointSize());
-
-                QPixmap pm;
-                const int buf = 8;
-                if (!QPixmapCache::find(hstr, &pm)) {
-
-                    QFontMetrics fm(*q.font);
-                   // QRect rect=fm.tightBoundingRect(q.text);
-                    w = fm.width(q.text);
-                    h = fm.height()+buf;
-
-                    pm=QPixmap(w, h);
-                    pm.fill(Qt::transparent);
-
-                    QPainter imgpainter(&pm);
-
-                    imgpainter.setPen(q.color);
-
-                    imgpainter.setFont(*q.font);
-
-                    imgpainter.setRenderHint(QPainter::TextAntialiasing, q.antialias);
-                    imgpainter.drawText(0, h-buf, q.text);
-                    imgpainter.end();
-
-                    QPixmapCache::insert(hstr, pm);
-                    strings_drawn_this_frame++;
+            if (atlas) {
+                if (q.angle == 0) {
+                    if (m_glyphs.add(q.text, QPointF(q.x, q.y), 0, QPointF(0, 0), *q.font, q.color, q.antialias)) {
+                        strings_cached_this_frame++;
+                        continue;
+                    }
                 } else {
-                    //cached
-                    strings_cached_this_frame++;
+                    // Same placement as the drawText path below
+                    qreal tw = m_glyphs.width(q.text, *q.font, q.color, q.antialias);
+                    if (tw >= 0) {
+                        h = QFontMetrics(*q.font).xHeight() + 2;
+                        QPointF base(floor(-tw / 2.0) - 6, floor(-h / 2.0));
+                        if (m_glyphs.add(q.text, QPointF(q.x, q.y), q.angle, base, *q.font, q.color, q.antialias)) {
+                            strings_cached_this_frame++;
+                            continue;
+                        }
+                    }
                 }
+            }
 
-                h = pm.height();
-                w = pm.width();
-                if (q.angle != 0) {
-                    float xxx = q.x - h - (h / 2);
-                    float yyy = q.y + w / 2; // + buf / 2;
+            if (atlas) {
+                // Anything queued from the atlases so far was meant to go underneath this
+                m_glyphs.flush(painter);
+            }
 
-                    xxx+=4;
-                    yyy+=4;
+            // Just draw the fonts..
+            painter.setPen(QColor(q.color));
+            painter.setFont(*q.font);
 
-                    painter.translate(xxx, yyy);
-                    painter.rotate(-q.angle);
-                    painter.drawPixmap(QRect(0, h / 2, w, h), pm);
-                    painter.rotate(+q.angle);
-                    painter.translate(-xxx, -yyy);
-                } else {
-                    QRect r1(q.x - buf / 2 + 4, q.y - h + buf, w, h);
-                    painter.drawPixmap(r1, pm);
-                }
+            if (q.angle == 0) {
+                painter.drawText(q.x, q.y, q.text);
             } else {
-                // Just draw the fonts..
-                painter.setPen(QColor(q.color));
                 painter.setFont(*q.font);
 
-                if (q.angle == 0) {
-                    painter.drawText(q.x, q.y, q.text);
-                } else {
-                    painter.setFont(*q.font);
-
-                    w = painter.fontMetrics().width(q.text);
-                    h = painter.fontMetrics().xHeight() + 2;
-
-                    painter.translate(q.x, q.y);
-                    painter.rotate(-q.angle);
-                    painter.drawText(floor(-w / 2.0)-6, floor(-h / 2.0), q.text);
-                    painter.rotate(+q.angle);
-                    painter.translate(-q.x, -q.y);
-                }
-                strings_drawn_this_frame++;
+                w = painter.fontMetrics().width(q.text);
+                h = painter.fontMetrics().xHeight() + 2;
 
+                painter.translate(q.x, q.y);
+                painter.rotate(-q.angle);
+                painter.drawText(floor(-w / 2.0)-6, floor(-h / 2.0), q.text);
+                painter.rotate(+q.angle);
+                painter.translate(-q.x, -q.y);
             }
-
-            //q.text.clear();
-            //q.text.squeeze();
+            strings_drawn_this_frame++;
         }
 
         m_textque.clear();
@@ -808,95 +775,56 @@ void gGraphView::DrawTextQue(QPainter &painter)
     for (int i = 0; i < items; ++i) {
         const TextQueRect &q = m_textqueRect.at(i);
 
-        // can do antialiased text via texture cache fine on mac
-        if (usePixmapCache()) {
-            // Generate the pixmap cache "key"
-            QString hstr = QString("%1:%2:%3").
-                    arg(q.text).
-                    arg(q.color.name()).
-                    arg(q.font->pointSize());
-
-            QPixmap pm;
-            if (!QPixmapCache::find(hstr, &pm)) {
-
-                ww = q.rect.width();
-                hh = q.rect.height();
-
-                pm=QPixmap(ww, hh);
-
-                //int aaw1 = pm.width();
-                pm.fill(Qt::transparent);
-
-                QPainter imgpainter(&pm);
-
-                //int aaw2 = pm.width();
-                imgpainter.setPen(q.color);
-
-                imgpainter.setFont(*q.font);
-
-                imgpainter.setRenderHint(QPainter::Antialiasing, true);
-                imgpainter.setRenderHint(QPainter::TextAntialiasing, true);
-                QRectF rect(0,0, ww, hh);
-                imgpainter.drawText(rect, q.flags, q.text);
-                //int aaw3 = pm.width();
-                imgpainter.end();
-
-                QPixmapCache::insert(hstr, pm);
-                //int aaw4 = pm.width();
-                strings_drawn_this_frame++;
+        if (atlas) {
+            if (q.angle == 0) {
+                if (m_glyphs.add(q.text, q.rect, q.flags, *q.font, q.color, q.antialias)) {
+                    strings_cached_this_frame++;
+                    continue;
+                }
             } else {
-                //cached
-                strings_cached_this_frame++;
+                qreal tw = m_glyphs.width(q.text, *q.font, q.color, q.antialias);
+                if (tw >= 0) {
+                    hh = QFontMetrics(*q.font).xHeight() + 2;
+                    QPointF base(floor(-tw / 2.0), floor(-hh / 2.0));
+                    if (m_glyphs.add(q.text, q.rect.topLeft(), q.angle, base, *q.font, q.color, q.antialias)) {
+                        strings_cached_this_frame++;
+                        continue;
+                    }
+                }
             }
+        }
 
-            hh = pm.height();
-            ww = pm.width();
-            if (q.angle != 0) {
-                float xxx = q.rect.x() - hh - (hh / 2);
-                float yyy = q.rect.y() + ww / 2; // + buf / 2;
+        if (atlas) {
+            m_glyphs.flush(painter);
+        }
 
-                xxx+=4;
-                yyy+=4;
+        // Just draw the fonts..
+        painter.setPen(QColor(q.color));
+        painter.setFont(*q.font);
 
-                painter.translate(xxx, yyy);
-                painter.rotate(-q.angle);
-                painter.drawPixmap(QRect(0, hh / 2, ww, hh), pm);
-                painter.rotate(+q.angle);
-                painter.translate(-xxx, -yyy);
-            } else {
-                //painter.drawPixmap(QPoint(q.rect.x(), q.rect.y()), pm);
-                painter.drawPixmap(q.rect,pm, QRect(0,0,ww,hh));
-            }
+        if (q.angle == 0) {
+            painter.drawText(q.rect, q.flags, q.text);
         } else {
-            // Just draw the fonts..
-
-            painter.setPen(QColor(q.color));
             painter.setFont(*q.font);
 
-            if (q.angle == 0) {
-                painter.drawText(q.rect, q.flags, q.text);
-            } else {
-                painter.setFont(*q.font);
-
-                ww = painter.fontMetrics().width(q.text);
-                hh = painter.fontMetrics().xHeight() + 2;
-
-                painter.translate(q.rect.x(), q.rect.y());
-                painter.rotate(-q.angle);
-                painter.drawText(floor(-ww / 2.0), floor(-hh / 2.0), q.text);
-                painter.rotate(+q.angle);
-                painter.translate(-q.rect.x(), -q.rect.y());
-            }
-            strings_drawn_this_frame++;
+            ww = painter.fontMetrics().width(q.text);
+            hh = painter.fontMetrics().xHeight() + 2;
 
+            painter.translate(q.rect.x(), q.rect.y());
+            painter.rotate(-q.angle);
+            painter.drawText(floor(-ww / 2.0), floor(-hh / 2.0), q.text);
+            painter.rotate(+q.angle);
+            painter.translate(-q.rect.x(), -q.rect.y());
         }
-
-        //q.text.clear();
-        //q.text.squeeze();
+        strings_drawn_this_frame++;
     }
 
     m_textqueRect.clear();
 
+    if (atlas) {
+        // Whatever came from an atlas since the last fallback goes out in one call per atlas page
+        m_glyphs.flush(painter);
+    }
 }
 #endif
 
@@ -1154,6 +1082,8 @@ void gGraphView::setScrollBar(MyScrollBar *sb)
 
 bool gGraphView::renderGraphs(QPainter &painter)
 {
+    TRACE_SCOPE(Trace::CAT_Render, "gGraphView::renderGraphs");
+
     float px = m_offsetX;
     float py = -m_offsetY;
     int numgraphs = 0;
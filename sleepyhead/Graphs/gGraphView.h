@@ -37,6 +37,7 @@
 
 #include <Graphs/gGraph.h>
 #include <Graphs/glcommon.h>
+#include <Graphs/glyphatlas.h>
 #include <SleepLib/day.h>
 
 
@@ -486,6 +487,12 @@ class gGraphView
     //! \brief Return whether or not the Pixmap Cache for text rendering is being used.
     bool usePixmapCache();
 
+    //! \brief Enable or disable drawing queued text from the glyph atlases (on by default, off for offscreen renders)
+    void setUseGlyphAtlas(bool b) { use_glyph_atlas = b; }
+
+    //! \brief Drop the glyph atlases, so text is rasterized again after font or appearance changes
+    void clearTextCache() { m_glyphs.clear(); }
+
     //! \brief Graph drawing routines, returns true if there weren't any graphs to draw
     bool renderGraphs(QPainter &painter);
 
@@ -628,6 +635,9 @@ class gGraphView
     //! \brief ANother text que with rect alignment capabilities...
     QVector<TextQueRect> m_textqueRect;
 
+    //! \brief Glyph atlases queued text is drawn from, unless use_glyph_atlas is off
+    GlyphCache m_glyphs;
+
     int m_lastxpos, m_lastypos;
 
     QString m_emptytext;
@@ -655,6 +665,7 @@ class gGraphView
     QTime m_animationStarted;
 
     bool use_pixmap_cache;
+    bool use_glyph_atlas;
 
     QPixmapCache pixmapcache;
 
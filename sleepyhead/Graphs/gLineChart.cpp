@@ -12,11 +12,13 @@
 #include <QDebug>
 
 #include <math.h>
+#include <string.h>
 
 #include "Graphs/glcommon.h"
 #include "Graphs/gGraph.h"
 #include "Graphs/gGraphView.h"
 #include "SleepLib/profiles.h"
+#include "SleepLib/trace.h"
 #include "Graphs/gLineOverlay.h"
 
 #define EXTRA_ASSERTS 1
@@ -61,6 +63,12 @@ gLineChart::gLineChart(ChannelID code, bool square_plot, bool disable_accel)
     lines.reserve(50000);
     lasttime = 0;
     m_layertype = LT_LineChart;
+
+    m_strip_chart = false;
+    m_strip_list = nullptr;
+    m_strip_maxx = m_strip_xmult = 0;
+    m_strip_miny = m_strip_ymult = 0;
+    m_strip_next = 0;
 }
 gLineChart::~gLineChart()
 {
@@ -103,6 +111,9 @@ void gLineChart::SetDay(Day *d)
     m_miny = 0, m_maxy = 0;
     m_physminy = 0, m_physmaxy = 0;
 
+    m_retained = QImage();
+    m_retain_key = RetainKey();
+
     if (!d) {
         return;
     }
@@ -392,6 +403,162 @@ QString gLineChart::getMetaString(qint64 time)
     return lasttext;
 }
 
+static inline quint64 retainMix(quint64 h, quint64 v)
+{
+    return (h ^ v) * 1099511628211ULL;
+}
+
+quint64 gLineChart::retainState()
+{
+    quint64 h = 14695981039346656037ULL;
+
+    float thickness = p_profile->appearance->lineThickness();
+    quint32 tbits;
+    memcpy(&tbits, &thickness, sizeof(tbits));
+
+    h = retainMix(h, tbits);
+    h = retainMix(h, p_profile->appearance->antiAliasing());
+    h = retainMix(h, p_profile->cpap->clockDrift());
+    h = retainMix(h, m_square_plot);
+    h = retainMix(h, m_disable_accel);
+
+    for (int gi = 0; gi < m_codes.size(); gi++) {
+        ChannelID code = m_codes.at(gi);
+        h = retainMix(h, code);
+        h = retainMix(h, m_enabled[code]);
+        h = retainMix(h, schema::channel[code].defaultColor().rgba());
+    }
+
+    for (int i = 0; i < m_day->size(); ++i) {
+        Session *sess = (*m_day)[i];
+        h = retainMix(h, quintptr(sess));
+        h = retainMix(h, sess->enabled());
+
+        // Sample counts catch lists that grow or get reloaded
+        QHash<ChannelID, QVector<EventList *> >::iterator ci;
+        for (ci = sess->eventlist.begin(); ci != sess->eventlist.end(); ++ci) {
+            const QVector<EventList *> &evec = ci.value();
+            for (int j = 0; j < evec.size(); ++j) {
+                h = retainMix(h, quintptr(evec.at(j)));
+                h = retainMix(h, evec.at(j)->count());
+            }
+        }
+    }
+    return h;
+}
+
+bool gLineChart::paintStrip(QPainter &painter, QRect plot, double maxx, double xmult, EventDataType miny, EventDataType ymult)
+{
+    if ((plot.width() <= 0) || (plot.height() <= 0) || (xmult <= 0)) {
+        return false;
+    }
+
+    // Live views have a single session with one growing waveform list
+    EventList *el = nullptr;
+    ChannelID code = m_codes.isEmpty() ? NoChannel : m_codes.at(0);
+
+    for (int i = 0; (i < m_day->size()) && !el; ++i) {
+        Session *sess = (*m_day)[i];
+        QHash<ChannelID, QVector<EventList *> >::iterator ci = sess->eventlist.find(code);
+
+        if ((ci != sess->eventlist.end()) && !ci.value().isEmpty() && (ci.value().at(0)->type() == EVL_Waveform)) {
+            el = ci.value().at(0);
+        }
+    }
+
+    if (!el || (el->rate() <= 0)) {
+        return false;
+    }
+
+    int width = plot.width();
+    int height = plot.height();
+    double rate = el->rate();
+
+    int shift = width;
+
+    if ((m_strip.width() == width) && (m_strip.height() == height) && (m_strip_list == el)
+            && (m_strip_xmult == xmult) && (m_strip_miny == miny) && (m_strip_ymult == ymult)
+            && (maxx >= m_strip_maxx)) {
+        // Whole pixels elapsed since the last frame. The remainder carries over to the next one
+        shift = int((maxx - m_strip_maxx) * xmult);
+    }
+
+    if (shift >= width) {
+        // Nothing worth keeping, start over
+        if ((m_strip.width() != width) || (m_strip.height() != height)) {
+            m_strip = QImage(width, height, QImage::Format_ARGB32_Premultiplied);
+        }
+        m_strip.fill(Qt::transparent);
+
+        m_strip_list = el;
+        m_strip_xmult = xmult;
+        m_strip_miny = miny;
+        m_strip_ymult = ymult;
+        m_strip_maxx = maxx;
+
+        double left_edge = maxx - double(width) / xmult;
+        m_strip_next = qMax(0, int((left_edge - el->first()) / rate));
+    } else if (shift > 0) {
+        // Blit the retained pixels left, and clear the newly exposed columns
+        int bytes = shift * 4;
+        int keep = (width - shift) * 4;
+
+        for (int y = 0; y < height; ++y) {
+            uchar *line = m_strip.scanLine(y);
+            memmove(line, line + bytes, keep);
+            memset(line + keep, 0, bytes);
+        }
+
+        m_strip_maxx += double(shift) / xmult;
+    }
+
+    int count = el->count();
+
+    if (m_strip_next < count) {
+        double left_edge = m_strip_maxx - double(width) / xmult;
+        int yst = height - 1;
+
+        // Only draw up to the buffers right edge, anything later waits for the next scroll
+        int last = qMin(count - 1, int((m_strip_maxx - el->first()) / rate));
+
+        // Start one back, to join onto the line already drawn
+        int i = qMax(0, m_strip_next - 1);
+
+        if (last > i) {
+            lines.clear();
+
+            double time = el->time(i);
+            EventDataType lastpx = (time - left_edge) * xmult;
+            EventDataType lastpy = yst - ((el->data(i) - miny) * ymult);
+
+            for (++i; i <= last; ++i) {
+                time += rate;
+                EventDataType px = (time - left_edge) * xmult;
+                EventDataType py = yst - ((el->data(i) - miny) * ymult);
+
+                lines.append(QLine(lastpx, lastpy, px, py));
+                lastpx = px;
+                lastpy = py;
+            }
+
+            QPainter strip(&m_strip);
+            strip.setRenderHint(QPainter::Antialiasing, p_profile->appearance->antiAliasing());
+            strip.setPen(QPen(schema::channel[code].defaultColor(), p_profile->appearance->lineThickness()));
+            strip.drawLines(lines);
+            strip.end();
+
+            lines.clear();
+        }
+
+        if (last >= m_strip_next) {
+            m_strip_next = last + 1;
+        }
+    }
+
+    painter.drawImage(plot.topLeft(), m_strip);
+    return true;
+}
+
 // Time Domain Line Chart
 void gLineChart::paint(QPainter &painter, gGraph &w, const QRegion &region)
 {
@@ -521,6 +688,10 @@ void gLineChart::paint(QPainter &painter, gGraph &w, const QRegion &region)
     width--;
     height -= 2;
 
+    if (m_strip_chart && paintStrip(painter, QRect(left + 1, top, width, height + 2), maxx, xmult, miny, ymult)) {
+        return;
+    }
+
     int num_points = 0;
     int visible_points = 0;
     int total_points = 0;
@@ -554,6 +725,41 @@ void gLineChart::paint(QPainter &painter, gGraph &w, const QRegion &region)
     Session * sess = nullptr;
     ChannelID code;
 
+    // The plotted lines are retained between frames, so cursor and hover redraws don't re-walk the data.
+    // Printing and snapshots render fresh, and leave the on screen copy alone.
+    bool retain = !w.printing() && (painter.device() == w.graphView());
+    bool reuse = false;
+    QPainter retained;
+
+    if (retain) {
+        RetainKey key;
+        key.day = m_day;
+        key.minx = minx;
+        key.maxx = maxx;
+        key.miny = miny;
+        key.maxy = maxy;
+        key.rect = QRect(left, top, width, height + 1);
+        key.dpr = painter.device()->devicePixelRatio();
+        key.state = retainState();
+
+        reuse = !m_retained.isNull() && (key == m_retain_key);
+
+        if (!reuse) {
+            m_retain_key = key;
+            m_retained = QImage(key.rect.size() * key.dpr, QImage::Format_ARGB32_Premultiplied);
+            m_retained.setDevicePixelRatio(key.dpr);
+            m_retained.fill(Qt::transparent);
+            m_retained_points.fill(0, m_codes.size());
+
+            retained.begin(&m_retained);
+            retained.translate(-left, -top);
+            retained.setClipRect(key.rect);
+            retained.setRenderHint(QPainter::Antialiasing, p_profile->appearance->antiAliasing());
+        }
+    }
+
+    QPainter &plot = retained.isActive() ? retained : painter;
+
     for (int gi = 0; gi < m_codes.size(); gi++) {
         code = m_codes[gi];
         schema::Channel &chan = schema::channel[code];
@@ -585,8 +791,13 @@ void gLineChart::paint(QPainter &painter, gGraph &w, const QRegion &region)
 
         codepoints = 0;
 
+        if (reuse) {
+            codepoints = m_retained_points.at(gi);
+            total_points += codepoints;
+        }
+
         // For each session...
-        int daysize = m_day->size();
+        int daysize = reuse ? 0 : m_day->size();
         for (int svi = 0; svi < daysize; svi++) {
             sess = (*m_day)[svi];
 
@@ -599,11 +810,11 @@ void gLineChart::paint(QPainter &painter, gGraph &w, const QRegion &region)
 
             if (!sess->enabled()) { continue; }
 
-            schema::Channel ch = schema::channel[code];
+            const schema::Channel & ch = schema::channel[code];
             bool fndbetter = false;
 
-            QList<schema::Channel *>::iterator mlend=ch.m_links.end();
-            for (QList<schema::Channel *>::iterator l = ch.m_links.begin(); l != mlend; l++) {
+            QList<schema::Channel *>::const_iterator mlend=ch.m_links.constEnd();
+            for (QList<schema::Channel *>::const_iterator l = ch.m_links.constBegin(); l != mlend; l++) {
                 schema::Channel &c = *(*l);
                 ci = (*m_day)[svi]->eventlist.find(c.id());
 
@@ -765,64 +976,72 @@ void gLineChart::paint(QPainter &painter, gGraph &w, const QRegion &region)
 
                     time = el.time(idx) + drift;
                     double rate = double(sr) * double(sam);
-                    EventStoreType *ptr = el.rawData() + idx;
                     if ((unsigned) siz > el.count())
                         siz = el.count();
 
+                    // Samples are gained a block at a time, dataRange() already applies gain
+                    const quint32 blocksize = 1024;
+                    EventDataType block[blocksize];
+                    EventDataType offset = el.offset() * gain;
+
                     if (accel) {
                         //////////////////////////////////////////////////////////////////
                         // Accelerated Waveform Plot
                         //////////////////////////////////////////////////////////////////
 
-                        for (int i = idx; i <= siz; i += sam, ptr += sam) {
-                            time += rate;
-                            // This is much faster than QVector access.
-                            data = *ptr + el.offset();
-                            data *= gain;
+                        for (int i = idx; (i < siz) && !done;) {
+                            quint32 n = el.dataRange(i, blocksize, block, sam);
+                            if (n == 0) { break; }
+                            i += n * sam;
 
-                            // Scale the time scale X to pixel scale X
-                            px = ((time - minx) * xmult);
+                            for (quint32 k = 0; k < n; ++k) {
+                                time += rate;
+                                data = block[k] + offset;
 
-                            // Same for Y scale, with gain factored in nmult
-                            py = ((data - miny) * ymult);
+                                // Scale the time scale X to pixel scale X
+                                px = ((time - minx) * xmult);
 
-                            // In accel mode, each pixel has a min/max Y value.
-                            // m_drawlist's index is the pixel index for the X pixel axis.
-                            int z = round(px); // Hmmm... round may screw this up.
+                                // Same for Y scale, with gain factored in nmult
+                                py = ((data - miny) * ymult);
 
-                            if (z < minz) {
-                                minz = z;    // minz=First pixel
-                            }
+                                // In accel mode, each pixel has a min/max Y value.
+                                // m_drawlist's index is the pixel index for the X pixel axis.
+                                int z = round(px); // Hmmm... round may screw this up.
 
-                            if (z > maxz) {
-                                maxz = z;    // maxz=Last pixel
-                            }
+                                if (z < minz) {
+                                    minz = z;    // minz=First pixel
+                                }
 
-                            if (minz < 0) {
-                                qDebug() << "gLineChart::Plot() minz<0  should never happen!! minz =" << minz;
-                                minz = 0;
-                            }
+                                if (z > maxz) {
+                                    maxz = z;    // maxz=Last pixel
+                                }
 
-                            if (maxz > max_drawlist_size) {
-                                qDebug() << "gLineChart::Plot() maxz>max_drawlist_size!!!! maxz = " << maxz <<
-                                         " max_drawlist_size =" << max_drawlist_size;
-                                maxz = max_drawlist_size;
-                            }
+                                if (minz < 0) {
+                                    qDebug() << "gLineChart::Plot() minz<0  should never happen!! minz =" << minz;
+                                    minz = 0;
+                                }
 
-                            // Update the Y pixel bounds.
-                            if (py < m_drawlist[z].x()) {
-                                m_drawlist[z].setX(py);
-                            }
+                                if (maxz > max_drawlist_size) {
+                                    qDebug() << "gLineChart::Plot() maxz>max_drawlist_size!!!! maxz = " << maxz <<
+                                             " max_drawlist_size =" << max_drawlist_size;
+                                    maxz = max_drawlist_size;
+                                }
 
-                            if (py > m_drawlist[z].y()) {
-                                m_drawlist[z].setY(py);
-                            }
+                                // Update the Y pixel bounds.
+                                if (py < m_drawlist[z].x()) {
+                                    m_drawlist[z].setX(py);
+                                }
 
-                            if (time > maxx) {
-                                done = true;
-                                break;
-                            }
+                                if (py > m_drawlist[z].y()) {
+                                    m_drawlist[z].setY(py);
+                                }
+
+                                if (time > maxx) {
+                                    done = true;
+                                    break;
+                                }
 
+                            }
                         }
 
                         // Plot compressed accelerated vertex list
@@ -848,35 +1067,44 @@ void gLineChart::paint(QPainter &painter, gGraph &w, const QRegion &region)
                         //////////////////////////////////////////////////////////////////
                         // Normal Waveform Plot
                         //////////////////////////////////////////////////////////////////
-                        // Prime first point
-                        data = (*ptr + el.offset()) * gain;
-                        lastpx = xst + ((time - minx) * xmult);
-                        lastpy = yst - ((data - miny) * ymult);
-                        siz--;
-                        for (int i = idx; i < siz; i += sam) {
-                            ptr += sam;
-                            time += rate;
+                        bool primed = false;
 
-                            data = (*ptr + el.offset()) * gain;
+                        for (int i = idx; (i < siz) && !done;) {
+                            quint32 n = el.dataRange(i, blocksize, block, sam);
+                            if (n == 0) { break; }
+                            i += n * sam;
 
-                            px = xst + ((time - minx) * xmult); // Scale the time scale X to pixel scale X
-                            py = yst - ((data - miny) * ymult); // Same for Y scale, with precomputed gain
-                            //py=yst-((data - ymin) * nmult);   // Same for Y scale, with precomputed gain
+                            for (quint32 k = 0; k < n; ++k) {
+                                data = block[k] + offset;
 
-                            lines.append(QLine(lastpx, lastpy, px, py));
+                                if (!primed) {
+                                    // Prime first point
+                                    lastpx = xst + ((time - minx) * xmult);
+                                    lastpy = yst - ((data - miny) * ymult);
+                                    primed = true;
+                                    continue;
+                                }
 
-                            lastpx = px;
-                            lastpy = py;
+                                time += rate;
 
-                            if (time >= maxx) {
-                                done = true;
-                                break;
+                                px = xst + ((time - minx) * xmult); // Scale the time scale X to pixel scale X
+                                py = yst - ((data - miny) * ymult); // Same for Y scale, with precomputed gain
+                                //py=yst-((data - ymin) * nmult);   // Same for Y scale, with precomputed gain
+
+                                lines.append(QLine(lastpx, lastpy, px, py));
+
+                                lastpx = px;
+                                lastpy = py;
+
+                                if (time >= maxx) {
+                                    done = true;
+                                    break;
+                                }
                             }
-                        }
                     }
 
-                    painter.setPen(QPen(chan.defaultColor(), p_profile->appearance->lineThickness()));
-                    painter.drawLines(lines);
+                    plot.setPen(QPen(chan.defaultColor(), p_profile->appearance->lineThickness()));
+                    plot.drawLines(lines);
                     w.graphView()->lines_drawn_this_frame += lines.count();
                     lines.clear();
 
@@ -999,8 +1227,8 @@ void gLineChart::paint(QPainter &painter, gGraph &w, const QRegion &region)
                             }
                         }
                     }
-                    painter.setPen(QPen(chan.defaultColor(),p_profile->appearance->lineThickness()));
-                    painter.drawLines(lines);
+                    plot.setPen(QPen(chan.defaultColor(),p_profile->appearance->lineThickness()));
+                    plot.drawLines(lines);
                     w.graphView()->lines_drawn_this_frame+=lines.count();
                     lines.clear();
 
@@ -1016,6 +1244,10 @@ void gLineChart::paint(QPainter &painter, gGraph &w, const QRegion &region)
 //        w.graphView()->lines_drawn_this_frame+=lines.count();
 //        lines.clear();
 
+        if (retained.isActive()) {
+            m_retained_points[gi] = codepoints;
+        }
+
         ////////////////////////////////////////////////////////////////////
         // Draw Legends on the top line
         ////////////////////////////////////////////////////////////////////
@@ -1045,6 +1277,13 @@ void gLineChart::paint(QPainter &painter, gGraph &w, const QRegion &region)
     }
     painter.setClipping(false);
 
+    if (retained.isActive()) {
+        retained.end();
+    }
+    if (retain) {
+        painter.drawImage(m_retain_key.rect.topLeft(), m_retained);
+    }
+
     ////////////////////////////////////////////////////////////////////
     // Draw Channel Threshold legend markers
     ////////////////////////////////////////////////////////////////////
@@ -1140,7 +1379,10 @@ void gLineChart::paint(QPainter &painter, gGraph &w, const QRegion &region)
             if ((!m_flags_enabled[code]) || (!m_day->channelExists(code))) continue;
             gLineOverlayBar * lob = fit.value();
             lob->setBlockHover(blockhover);
-            lob->paint(painter, w, region);
+            {
+                TRACE_SCOPE(Trace::CAT_Render, lob->traceName());
+                lob->paint(painter, w, region);
+            }
             if (lob->hover()) blockhover = true; // did it render a hover over?
 
             if (ahilist.contains(code)) {
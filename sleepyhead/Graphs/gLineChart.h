@@ -10,6 +10,7 @@
 #define GLINECHART_H
 
 #include <QPainter>
+#include <QImage>
 #include <QVector>
 
 #include "Graphs/layer.h"
@@ -75,6 +76,8 @@ class gLineChart: public Layer
     gLineChart(ChannelID code, bool square_plot = false, bool disable_accel = false);
     virtual ~gLineChart();
 
+    virtual const char *traceName() const { return "gLineChart"; }
+
     //! \brief The drawing code that fills the vertex buffers
     virtual void paint(QPainter &painter, gGraph &w, const QRegion &region);
 
@@ -120,6 +123,12 @@ class gLineChart: public Layer
 
     QString getMetaString(qint64 time);
 
+    /*! \brief Strip chart mode, for live waveforms whose view only scrolls forward.
+        The plot is kept in a back buffer that gets scrolled by the elapsed time, and only samples that arrived
+        since the last frame are drawn. Threshold lines, flags and legends are skipped in this mode. */
+    void setStripChart(bool b) { m_strip_chart = b; m_strip = QImage(); }
+    bool stripChart() const { return m_strip_chart; }
+
     void addDotLine(DottedLine dot) { m_dotlines.append(dot); }
     QVector<DottedLine> m_dotlines;
     QHash<ChannelID, bool> m_flags_enabled;
@@ -154,6 +163,43 @@ class gLineChart: public Layer
     //! \brief Mouse moved over this layers area (shows the hover-over tooltips here)
     virtual bool mouseMoveEvent(QMouseEvent *event, gGraph *graph);
 
+    //! \brief Brings the strip chart back buffer up to maxx and draws it. Returns false if there's no waveform to strip
+    bool paintStrip(QPainter &painter, QRect plot, double maxx, double xmult, EventDataType miny, EventDataType ymult);
+
+    //! \brief Everything the plotted lines depend on, so they can be reused when only overlays change
+    struct RetainKey {
+        RetainKey() : day(nullptr), minx(0), maxx(0), miny(0), maxy(0), dpr(0), state(0) {}
+        bool operator==(const RetainKey &other) const {
+            return (day == other.day) && (minx == other.minx) && (maxx == other.maxx) && (miny == other.miny)
+                && (maxy == other.maxy) && (rect == other.rect) && (dpr == other.dpr) && (state == other.state);
+        }
+
+        Day *day;
+        double minx, maxx;
+        EventDataType miny, maxy;
+        QRect rect;
+        int dpr;
+        //! \brief Hash of settings, enabled plots and sessions, and their sample counts
+        quint64 state;
+    };
+
+    quint64 retainState();
+
+    RetainKey m_retain_key;
+    //! \brief The plotted lines from the last full render, drawn under cursor, hover and flag overlays
+    QImage m_retained;
+    QVector<int> m_retained_points;
+
+    bool m_strip_chart;
+    QImage m_strip;
+    EventList *m_strip_list;
+    //! \brief Time at the right edge of the back buffer
+    double m_strip_maxx;
+    double m_strip_xmult;
+    EventDataType m_strip_miny, m_strip_ymult;
+    //! \brief First sample not yet drawn into the back buffer
+    int m_strip_next;
+
 
     bool m_report_empty;
     bool m_square_plot;
@@ -71,245 +71,198 @@ void gLineOverlayBar::paint(QPainter &painter, gGraph &w, const QRegion &region)
 
     EventStoreType raw;
 
-    quint32 *tptr;
-    EventStoreType *dptr, *eptr;
-    qint64 stime;
-
     OverlayDisplayType odt = m_odt;
-    QHash<ChannelID, QVector<EventList *> >::iterator cei;
-    int count;
 
-    qint64 clockdrift = qint64(p_profile->cpap->clockDrift()) * 1000L;
-    qint64 drift = 0;
-    //bool hover = false;
+    const FlagTimeline &timeline = m_day->flagTimeline(m_code);
+    bool canhover = !w.selectingArea() && !m_blockhover;
 
-    // For each session, process it's eventlist
-    for (QList<Session *>::iterator s = m_day->begin(); s != m_day->end(); s++) {
+    if (m_flt == FT_Span) {
+        ////////////////////////////////////////////////////////////////////////////
+        // FT_Span
+        ////////////////////////////////////////////////////////////////////////////
 
-        if (!(*s)->enabled()) { continue; }
+        // Spans are ordered by their end, so any starting before max_x ends before max_x + the longest one
+        int idx = timeline.lowerBound(w.min_x);
+        int end = timeline.upperBound(w.max_x + timeline.maxDuration());
+
+        QVector<QRectF> rects;
+
+        for (; idx < end; ++idx) {
+            X = timeline.time(idx);
+            raw = timeline.data(idx);
+            Y = X - (qint64(raw) * 1000.0L); // duration
+
+            if (Y > w.max_x) {
+                continue;
+            }
+
+            x1 = jj * double(X - w.min_x) + left;
+            m_count++;
+            m_sum += raw;
+            x2 = jj * double(Y - w.min_x) + left;
+
+            if (int(x1) == int(x2)) {
+                x2 += 1;
+            }
+
+            if (x2 < left) {
+                x2 = left;
+            }
+
+            if (x1 > width + left) {
+                x1 = width + left;
+            }
+
+            // Merge spans touching in pixel space, so dense rows go out as a handful of rects
+            QRectF rect(int(x2), start_py, int(x1) - int(x2), height);
+            if (!rects.isEmpty() && (rect.left() <= rects.last().right() + 1)) {
+                rects.last() = rects.last().united(rect);
+            } else {
+                rects.append(rect);
+            }
+        }
 
-        cei = (*s)->eventlist.find(m_code);
+        painter.setPen(Qt::NoPen);
+        painter.setBrush(QBrush(m_flag_color));
+        painter.drawRects(rects.constData(), rects.size());
+        painter.setBrush(Qt::NoBrush);
 
-        if (cei == (*s)->eventlist.end()) { continue; }
+    } else if ((m_flt == FT_Bar) || (m_flt == FT_Dot)) {
+        ////////////////////////////////////////////////////////////////////////////
+        // FT_Bar
+        ////////////////////////////////////////////////////////////////////////////
+        int idx = timeline.lowerBound(w.min_x);
+        int end = timeline.upperBound(w.max_x);
 
-        QVector<EventList *> &evlist = cei.value();
+        m_count = end - idx;
+        m_sum = timeline.sum(idx, end);
 
-        if (evlist.size() == 0) { continue; }
+        int z = start_py + height;
 
-        drift = ((*s)->type() == MT_CPAP) ? clockdrift : 0;
+        if ((m_flt == FT_Bar) && (odt == ODT_Bars)) { // || (xx < 3600000)) {
+            QVector<QPoint> dots;
+            QVector<QLine> lines;
+            int hover = -1;
+            int lastpx = -1;
 
-        // Could loop through here, but nowhere uses more than one yet..
-        for (int k = 0; k < evlist.size(); k++) {
-            EventList &el = *(evlist[k]);
-            count = el.count();
-            stime = el.first() + drift;
-            dptr = el.rawData();
-            eptr = dptr + count;
-            tptr = el.rawTime();
+            for (; idx < end; ++idx) {
+                X = timeline.time(idx);
+                raw = timeline.data(idx);
 
-            ////////////////////////////////////////////////////////////////////////////
-            // Skip data previous to minx bounds
-            ////////////////////////////////////////////////////////////////////////////
-            for (; dptr < eptr; dptr++) {
-                X = stime + *tptr;
+                x1 = jj * (double(X) - double(w.min_x)) + left;
+                double d1 = jj * double(raw) * 1000.0;
 
-                if (X >= w.min_x) {
-                    break;
+                if (canhover && (hover < 0) && QRect(x1-d1, top, d1+4, height).contains(mouse)) {
+                    hover = idx;
+                    continue;
                 }
 
-                tptr++;
-            }
+                // Flags sharing a pixel column would only draw over each other
+                if (int(x1) == lastpx) {
+                    continue;
+                }
+                lastpx = x1;
 
-            if (m_flt == FT_Span) {
-                ////////////////////////////////////////////////////////////////////////////
-                // FT_Span
-                ////////////////////////////////////////////////////////////////////////////
-                for (; dptr < eptr; dptr++) {
-                    //hover = false;
-
-                    X = stime + *tptr++;
-                    raw = *dptr;
-                    Y = X - (qint64(raw) * 1000.0L); // duration
-
-                    if (Y > w.max_x) {
-                        break;
-                    }
-
-                    x1 = jj * double(X - w.min_x) + left;
-                    m_count++;
-                    m_sum += raw;
-                    x2 = jj * double(Y - w.min_x) + left;
-
-                    if (int(x1) == int(x2)) {
-                        x2 += 1;
-                    }
-
-                    if (x2 < left) {
-                        x2 = left;
-                    }
-
-                    if (x1 > width + left) {
-                        x1 = width + left;
-                    }
-
-                    QRect rect(x2, start_py, x1-x2, height);
-                    QColor col = m_flag_color;
-//                    if (rect.contains(mouse)) {
-//                        hover = true;
-//                    }
-
-                    painter.fillRect(rect, QBrush(col));
+                dots.append(QPoint(x1, top));
+                lines.append(QLine(x1, top, x1, bottom));
+
+                if (xx < (3600000)) {
+                    QString lab = QString("%1").arg(m_label);
+                    GetTextExtent(lab, x, y);
+                    w.renderText(lab, x1 - (x / 2), top - y + (5 * w.printScaleY()),0);
                 }
-            }/* else if (m_flt == FT_Dot) {
-                ////////////////////////////////////////////////////////////////////////////
-                // FT_Dot
-                ////////////////////////////////////////////////////////////////////////////
-                for (; dptr < eptr; dptr++) {
-                    hover = false;
-
-                    X = stime + *tptr++; //el.time(i);
-                    raw = *dptr; //el.data(i);
-
-                    if (X > w.max_x) {
-                        break;
-                    }
-
-                    x1 = jj * double(X - w.min_x) + left;
-                    m_count++;
-                    m_sum += raw;
-
-//                    if ((odt == ODT_Bars) || (xx < 3600000)) {
-                        // show the fat dots in the middle
-                        painter.setPen(QPen(m_flag_color,4));
-
-                        painter.drawPoint(x1, double(height) / double(yy)*double(-20 - w.min_y) + topp);
-                        painter.setPen(QPen(m_flag_color,1));
-
-//                    } else {
-//                        // thin lines down the bottom
-//                        painter.drawLine(x1, start_py + 1, x1, start_py + 1 + 12);
-//                    }
+            }
+
+            painter.setPen(QPen(m_flag_color,4));
+            painter.drawPoints(dots.constData(), dots.size());
+            painter.setPen(QPen(m_flag_color,1));
+            painter.drawLines(lines);
+
+            if (hover >= 0) {
+                m_hover = true;
+                raw = timeline.data(hover);
+                x1 = jj * (double(timeline.time(hover)) - double(w.min_x)) + left;
+                double d1 = jj * double(raw) * 1000.0;
+
+                QColor col2(230,230,230,128);
+                QRect rect((x1-d1), start_py+2, d1, height-2);
+                if (rect.x() < left) {
+                    rect.setX(left);
                 }
-            } */else if ((m_flt == FT_Bar) || (m_flt == FT_Dot)) {
-                ////////////////////////////////////////////////////////////////////////////
-                // FT_Bar
-                ////////////////////////////////////////////////////////////////////////////
-                for (; dptr < eptr; dptr++) {
-                   // hover = false;
-                    X = stime + *tptr++;
-                    raw = *dptr;
-
-                    if (X > w.max_x) {
-                        break;
-                    }
-
-                    x1 = jj * (double(X) - double(w.min_x)) + left;
-                    m_count++;
-                    m_sum += raw;
-                    int z = start_py + height;
-
-                    double d1 = jj * double(raw) * 1000.0;
-
-
-                    if ((m_flt == FT_Bar) && (odt == ODT_Bars)) { // || (xx < 3600000)) {
-                        QRect rect(x1-d1, top, d1+4, height);
-                        QColor col = m_flag_color;
-
-
-                        painter.setPen(QPen(col,4));
-                        painter.drawPoint(x1, top);
-
-                        if (!w.selectingArea() && !m_blockhover && rect.contains(mouse) && !m_hover) {
-                            m_hover = true;
-
-
-                            QColor col2(230,230,230,128);
-                            QRect rect((x1-d1), start_py+2, d1, height-2);
-                            if (rect.x() < left) {
-                                rect.setX(left);
-                            }
-
-                            painter.fillRect(rect, QBrush(col2));
-                            painter.setPen(col);
-                            painter.drawRect(rect);
-
-                            // Draw text label
-                            QString lab = QString("%1 (%2)").arg(schema::channel[m_code].fullname()).arg(raw);
-                            GetTextExtent(lab, x, y);
-
-                            w.ToolTip(lab, x1 - 10, start_py + 24 + (3 * w.printScaleY()), TT_AlignRight, p_profile->general->tooltipTimeout());
-
-                            //painter.fillRect(x1 - (x / 2) - x, start_py + 14 + (3 * w.printScaleY()), x+4,y+4, QBrush(QColor(255,255,255,245)));
-//                            painter.setPen(QPen(Qt::gray,1));
-//                            painter.drawRect(x1 - (x / 2) - x, start_py + 14 + (3 * w.printScaleY()), x+4,y+4);
-//                            w.renderText(lab, x1 - (x / 2)+2 - x, start_py + 14 + y + (3 * w.printScaleY()),0);
-
-//                            painter.drawLine(rect.x(), top, rect.x()+d1, top);
-//                            painter.drawLine(rect.x(), bottom, rect.x()+d1, bottom);
-//                            painter.drawLine(rect.x(), top, rect.x(), bottom);
-
-                           // col = COLOR_Gold;
-//                            hover = true;
-                            painter.setPen(QPen(col,3));
-                        } else {
-                            painter.setPen(QPen(col,1));
-                        }
-                        painter.drawLine(x1, top, x1, bottom);
-                        if (xx < (3600000)) {
-                            QString lab = QString("%1").arg(m_label);
-                            GetTextExtent(lab, x, y);
-                            w.renderText(lab, x1 - (x / 2), top - y + (5 * w.printScaleY()),0);
-                        }
-
-
-                    } else {
-                        //////////////////////////////////////////////////////////////////////////////////////
-                        // Top and bottom markers
-                        //////////////////////////////////////////////////////////////////////////////////////
-                        //bool b = false;
-                        if (!w.selectingArea() && !m_blockhover && QRect(x1-2, topp, 6, height).contains(mouse) && !m_hover) {
-                            // only want to draw the highlight/label once per frame
-                            m_hover = true;
-                            //b = true;
-
-                            // Draw text label
-                            QString lab = QString("%1 (%2)").arg(schema::channel[m_code].fullname()).arg(raw);
-                            GetTextExtent(lab, x, y, defaultfont);
-
-                            w.ToolTip(lab, x1 - 10, start_py + 24 + (3 * w.printScaleY()), TT_AlignRight, p_profile->general->tooltipTimeout());
-
-//                            painter.fillRect(x1 - (x / 2) - x, start_py + 14 + (3 * w.printScaleY()), x+4,y+4, QBrush(QColor(255,255,255,245)));
-//                            painter.setPen(QPen(Qt::gray,1));
-//                            painter.drawRect(x1 - (x / 2) - x, start_py + 14 + (3 * w.printScaleY()), x+4,y+4);
-//                            w.renderText(lab, x1 - (x / 2)+2 - x, start_py + 14 + y + (3 * w.printScaleY()),0);
-
-                            //x1-=1;
-                            QColor col = m_flag_color;
-                            col.setAlpha(60);
-                            painter.setPen(QPen(col, 4));
-
-                            painter.drawLine(x1, start_py+14, x1, z - 12);
-                            painter.setPen(QPen(m_flag_color,4));
-
-                            painter.drawLine(x1, z, x1, z - 14);
-                            painter.drawLine(x1, start_py+2, x1, start_py + 16);
-                        } else {
-                            QColor col = m_flag_color;
-                            col.setAlpha(10);
-                            painter.setPen(QPen(col,1));
-                            painter.drawLine(x1, start_py+14, x1, z);
-                            painter.setPen(QPen(m_flag_color,1));
-                          //  painter.drawLine(x1, z, x1, z - 12);
-                            painter.drawLine(x1, start_py+2, x1, start_py + 14);
-                        }
 
-
-                    }
+                painter.fillRect(rect, QBrush(col2));
+                painter.setPen(m_flag_color);
+                painter.drawRect(rect);
+
+                // Draw text label
+                QString lab = QString("%1 (%2)").arg(schema::channel[m_code].fullname()).arg(raw);
+                w.ToolTip(lab, x1 - 10, start_py + 24 + (3 * w.printScaleY()), TT_AlignRight, p_profile->general->tooltipTimeout());
+
+                painter.setPen(QPen(m_flag_color,4));
+                painter.drawPoint(x1, top);
+                painter.setPen(QPen(m_flag_color,3));
+                painter.drawLine(x1, top, x1, bottom);
+
+                if (xx < (3600000)) {
+                    QString lab = QString("%1").arg(m_label);
+                    GetTextExtent(lab, x, y);
+                    w.renderText(lab, x1 - (x / 2), top - y + (5 * w.printScaleY()),0);
                 }
             }
 
-        }
+        } else {
+            //////////////////////////////////////////////////////////////////////////////////////
+            // Top and bottom markers
+            //////////////////////////////////////////////////////////////////////////////////////
+            QVector<QLine> faint, marks;
+            faint.reserve(qMin(end - idx, width + 1));
+            marks.reserve(qMin(end - idx, width + 1));
+
+            while (idx < end) {
+                x1 = jj * (double(timeline.time(idx)) - double(w.min_x)) + left;
+                int px = x1;
+
+                faint.append(QLine(px, start_py+14, px, z));
+                marks.append(QLine(px, start_py+2, px, start_py + 14));
+
+                // Any more flags landing in this pixel column would draw the same lines
+                idx = timeline.lowerBound(qint64(w.min_x) + qint64(ceil(double(px + 1 - left) / jj)), idx + 1);
+            }
 
+            QColor col = m_flag_color;
+            col.setAlpha(10);
+            painter.setPen(QPen(col,1));
+            painter.drawLines(faint);
+            painter.setPen(QPen(m_flag_color,1));
+            painter.drawLines(marks);
+
+            if (canhover && (mouse.y() >= topp) && (mouse.y() < topp + height)) {
+                // Matches the 6 pixel wide hover box around each flag
+                qint64 from = qint64(w.min_x) + qint64(floor(double(mouse.x() - 3 - left) / jj));
+                qint64 to = qint64(w.min_x) + qint64(ceil(double(mouse.x() + 2 - left) / jj));
+                int hover = timeline.find(qMax(from, qint64(w.min_x)), qMin(to, qint64(w.max_x)));
+
+                if (hover >= 0) {
+                    // only want to draw the highlight/label once per frame
+                    m_hover = true;
+                    raw = timeline.data(hover);
+                    x1 = jj * (double(timeline.time(hover)) - double(w.min_x)) + left;
+
+                    // Draw text label
+                    QString lab = QString("%1 (%2)").arg(schema::channel[m_code].fullname()).arg(raw);
+                    w.ToolTip(lab, x1 - 10, start_py + 24 + (3 * w.printScaleY()), TT_AlignRight, p_profile->general->tooltipTimeout());
+
+                    col.setAlpha(60);
+                    painter.setPen(QPen(col, 4));
+
+                    painter.drawLine(x1, start_py+14, x1, z - 12);
+                    painter.setPen(QPen(m_flag_color,4));
+
+                    painter.drawLine(x1, z, x1, z - 14);
+                    painter.drawLine(x1, start_py+2, x1, start_py + 16);
+                }
+            }
+        }
     }
 }
 bool gLineOverlayBar::mouseMoveEvent(QMouseEvent *event, gGraph *graph)
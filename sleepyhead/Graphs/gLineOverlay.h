@@ -24,6 +24,8 @@ class gLineOverlayBar: public Layer
     gLineOverlayBar(ChannelID code, QColor col, QString _label = "", FlagType _flt = FT_Bar);
     virtual ~gLineOverlayBar();
 
+    virtual const char *traceName() const { return "gLineOverlayBar"; }
+
     //! \brief The drawing code that fills the OpenGL vertex GLBuffers
     virtual void paint(QPainter &painter, gGraph &w, const QRegion &region);
 
@@ -66,6 +68,8 @@ class gLineOverlaySummary: public Layer
     gLineOverlaySummary(QString text, int x, int y);
     virtual ~gLineOverlaySummary();
 
+    virtual const char *traceName() const { return "gLineOverlaySummary"; }
+
     virtual void paint(QPainter &painter, gGraph &w, const QRegion &region);
     virtual EventDataType Miny() { return 0; }
     virtual EventDataType Maxy() { return 0; }
@@ -37,7 +37,9 @@ void gSegmentChart::SetDay(Day *d)
         m_values[c] = 0;
 
         for (QList<Session *>::iterator s = m_day->begin(); s != m_day->end(); ++s) {
-            if ((*s)->enabled() && (*s)->m_cnt.contains(m_codes[c])) {
+            if (!(*s)->enabled()) { continue; }
+            (*s)->requireSummary();
+            if ((*s)->m_cnt.contains(m_codes[c])) {
                 EventDataType cnt = (*s)->count(m_codes[c]);
                 m_values[c] += cnt;
                 m_total += cnt;
@@ -23,6 +23,8 @@ class gSegmentChart : public Layer
                   QColor outline_color = Qt::black);
     virtual ~gSegmentChart();
 
+    virtual const char *traceName() const { return "gSegmentChart"; }
+
     //! \brief The drawing code that fills the Vertex buffers
     virtual void paint(QPainter &painter, gGraph &w, const QRegion &region);
 
@@ -63,6 +65,8 @@ class gSegmentChart : public Layer
 class gTAPGraph: public gSegmentChart
 {
   public:
+    virtual const char *traceName() const { return "gTAPGraph"; }
+
     gTAPGraph(ChannelID code, GraphSegmentType gt = GST_CandleStick,
               QColor gradient_color = Qt::lightGray, QColor outline_color = Qt::black);
     virtual ~gTAPGraph();
@@ -161,6 +161,8 @@ public:
     gSummaryChart(ChannelID code, MachineType machtype);
     virtual ~gSummaryChart();
 
+    virtual const char *traceName() const { return "gSummaryChart"; }
+
     //! \brief Renders the graph to the QPainter object
     virtual void paint(QPainter &, gGraph &, const QRegion &);
 
@@ -291,6 +293,8 @@ public:
     virtual void customCalc(Day *, QVector<SummaryChartSlice> & slices);
     virtual void afterDraw(QPainter &, gGraph &, QRect);
 
+    virtual const char *traceName() const { return "gSessionTimesChart"; }
+
     //! \brief Renders the graph to the QPainter object
     virtual void paint(QPainter &painter, gGraph &graph, const QRegion &region);
 
@@ -317,6 +321,8 @@ public:
 class gUsageChart : public gSummaryChart
 {
 public:
+    virtual const char *traceName() const { return "gUsageChart"; }
+
     gUsageChart()
         :gSummaryChart("Usage", MT_CPAP) {
         addCalc(NoChannel, ST_HOURS, QColor(64,128,255));
@@ -351,6 +357,8 @@ private:
 class gTTIAChart : public gSummaryChart
 {
 public:
+    virtual const char *traceName() const { return "gTTIAChart"; }
+
     gTTIAChart()
         :gSummaryChart("TTIA", MT_CPAP) {
         addCalc(NoChannel, ST_CNT, QColor(255,147,150));
@@ -379,6 +387,8 @@ private:
 class gAHIChart : public gSummaryChart
 {
 public:
+    virtual const char *traceName() const { return "gAHIChart"; }
+
     gAHIChart()
         :gSummaryChart("AHIChart", MT_CPAP) {
         addCalc(CPAP_ClearAirway, ST_CPH);
@@ -432,6 +442,8 @@ public:
 class gPressureChart : public gSummaryChart
 {
 public:
+    virtual const char *traceName() const { return "gPressureChart"; }
+
     gPressureChart();
     virtual ~gPressureChart() {}
 
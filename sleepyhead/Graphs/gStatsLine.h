@@ -19,6 +19,8 @@ class gStatsLine : public Layer
 {
   public:
     gStatsLine(ChannelID code, QString label = "", QColor textcolor = Qt::black);
+    virtual const char *traceName() const { return "gStatsLine"; }
+
     virtual void paint(QPainter &painter, gGraph &w, const QRegion &region);
     void SetDay(Day *d);
 
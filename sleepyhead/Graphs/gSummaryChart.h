@@ -31,6 +31,8 @@ class SummaryChart: public Layer
     SummaryChart(QString label, GraphType type = GT_BAR);
     virtual ~SummaryChart();
 
+    virtual const char *traceName() const { return "SummaryChart"; }
+
     //! \brief Renders the graph to the QPainter object
     virtual void paint(QPainter &painter, gGraph &w, const QRegion &region);
 
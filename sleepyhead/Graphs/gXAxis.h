@@ -24,6 +24,8 @@ class gXAxis: public Layer
     gXAxis(QColor col = Qt::black, bool fadeout = true);
     virtual ~gXAxis();
 
+    virtual const char *traceName() const { return "gXAxis"; }
+
     virtual void paint(QPainter &painter, gGraph &w, const QRegion &region);
     void SetShowMinorLines(bool b) { m_show_minor_lines = b; }
     void SetShowMajorLines(bool b) { m_show_major_lines = b; }
@@ -98,6 +100,8 @@ class gXAxisDay: public Layer
     gXAxisDay(QColor col = Qt::black);
     virtual ~gXAxisDay();
 
+    virtual const char *traceName() const { return "gXAxisDay"; }
+
     virtual void paint(QPainter &painter, gGraph &w, const QRegion &region);
     void SetShowMinorLines(bool b) { m_show_minor_lines = b; }
     void SetShowMajorLines(bool b) { m_show_major_lines = b; }
@@ -156,6 +160,8 @@ public:
   gXAxisPressure(QColor col = Qt::black);
   virtual ~gXAxisPressure();
 
+  virtual const char *traceName() const { return "gXAxisPressure"; }
+
   virtual void paint(QPainter &painter, gGraph &w, const QRegion &region);
 
     virtual int minimumHeight();
@@ -22,6 +22,8 @@ class gXGrid: public Layer
     gXGrid(QColor col = QColor("black"));
     virtual ~gXGrid();
 
+    virtual const char *traceName() const { return "gXGrid"; }
+
     //! \brief Draw the horizontal lines by adding the to the Vertex GLbuffers
     virtual void paint(QPainter &painter, gGraph &w, const QRegion &region);
 
@@ -72,6 +74,8 @@ class gYAxis: public Layer
     gYAxis(QColor col = Qt::black);
     virtual ~gYAxis();
 
+    virtual const char *traceName() const { return "gYAxis"; }
+
     //! \brief Draw the horizontal tickers display
     virtual void paint(QPainter &painter, gGraph &w, const QRegion &region);
 
@@ -134,6 +138,8 @@ class gYAxis: public Layer
 class gYAxisTime: public gYAxis
 {
   public:
+    virtual const char *traceName() const { return "gYAxisTime"; }
+
     //! \brief Construct a gYAxisTime object, with QColor col for tickers & times
     gYAxisTime(bool hr12 = true, QColor col = Qt::black) : gYAxis(col), show_12hr(hr12) {}
     virtual ~gYAxisTime() {}
@@ -165,6 +171,8 @@ class gYAxisTime: public gYAxis
 class gYAxisWeight: public gYAxis
 {
   public:
+    virtual const char *traceName() const { return "gYAxisWeight"; }
+
     //! \brief Construct a gYAxisWeight object, with QColor col for tickers & weight values
     gYAxisWeight(UnitSystem us = US_Metric, QColor col = Qt::black) : gYAxis(col), m_unitsystem(us) {}
     virtual ~gYAxisWeight() {}
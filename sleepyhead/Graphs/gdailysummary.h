@@ -22,6 +22,8 @@ public:
 
     virtual bool isEmpty();
 
+    virtual const char *traceName() const { return "gDailySummary"; }
+
     //! Draw filled rectangles behind Event Flag's, and an outlines around them all, Calls the individual paint for each gFlagLine
     virtual void paint(QPainter &painter, gGraph &w, const QRegion &region);
 
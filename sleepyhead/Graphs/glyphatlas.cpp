@@ -0,0 +1,268 @@
+/* Glyph Atlas Implementation
+ *
+ * Copyright (c) 2011-2016 Mark Watkins <jedimark@users.sourceforge.net>
+ *
+ * This file is subject to the terms and conditions of the GNU General Public
+ * License. See the file COPYING in the main directory of the Linux
+ * distribution for more details. */
+
+#include <QTransform>
+#include <cmath>
+
+#include "glyphatlas.h"
+
+GlyphAtlas::GlyphAtlas(const QFont &font, QColor color, bool antialias)
+    : m_font(font), m_color(color), m_antialias(antialias), m_metrics(font)
+{
+    m_pad = qMax(2, int(ceil(m_metrics.height() / 8.0)));
+    m_shelf_x = m_shelf_y = m_shelf_h = 0;
+}
+
+bool GlyphAtlas::place(int w, int h, int &page, QPoint &pos)
+{
+    if ((w > PageSize) || (h > PageSize)) {
+        return false;
+    }
+
+    if (m_images.isEmpty() || (m_shelf_x + w > PageSize)) {
+        // Start a new shelf
+        m_shelf_x = 0;
+        m_shelf_y += m_shelf_h;
+        m_shelf_h = 0;
+    }
+
+    if (m_images.isEmpty() || (m_shelf_y + h > PageSize)) {
+        if (m_images.size() >= MaxPages) {
+            return false;
+        }
+
+        QImage image(PageSize, PageSize, QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::transparent);
+        m_images.append(image);
+        m_pixmaps.append(QPixmap());
+        m_dirty.append(true);
+        m_shelf_x = m_shelf_y = m_shelf_h = 0;
+    }
+
+    page = m_images.size() - 1;
+    pos = QPoint(m_shelf_x, m_shelf_y);
+
+    m_shelf_x += w;
+    m_shelf_h = qMax(m_shelf_h, h);
+    return true;
+}
+
+const GlyphAtlas::Glyph *GlyphAtlas::glyph(QChar ch)
+{
+    ushort uc = ch.unicode();
+    Glyph *g;
+
+    if (uc < 256) {
+        g = &m_latin[uc];
+    } else {
+        g = &m_glyphs[uc];
+    }
+
+    if (g->page >= 0) {
+        return g;
+    }
+
+    qreal advance = m_metrics.width(ch);
+    int w = int(ceil(advance)) + m_pad * 2;
+    int h = int(ceil(m_metrics.height())) + m_pad * 2;
+
+    int page;
+    QPoint pos;
+    if (!place(w, h, page, pos)) {
+        return nullptr;
+    }
+
+    QPainter painter(&m_images[page]);
+    painter.setFont(m_font);
+    painter.setPen(m_color);
+    painter.setRenderHint(QPainter::TextAntialiasing, m_antialias);
+    painter.drawText(QPointF(pos.x() + m_pad, pos.y() + m_pad + m_metrics.ascent()), QString(ch));
+    painter.end();
+
+    m_dirty[page] = true;
+
+    g->page = page;
+    g->source = QRectF(pos.x(), pos.y(), w, h);
+    g->advance = advance;
+    return g;
+}
+
+const QPixmap &GlyphAtlas::page(int i)
+{
+    if (m_dirty.at(i)) {
+        m_pixmaps[i] = QPixmap::fromImage(m_images.at(i));
+        m_dirty[i] = false;
+    }
+    return m_pixmaps.at(i);
+}
+
+GlyphCache::~GlyphCache()
+{
+    clear();
+}
+
+void GlyphCache::clear()
+{
+    m_batches.clear();
+    qDeleteAll(m_atlases);
+    m_atlases.clear();
+}
+
+bool GlyphCache::canRender(const QString &text)
+{
+    int size = text.size();
+    const QChar *data = text.constData();
+
+    for (int i = 0; i < size; ++i) {
+        ushort uc = data[i].unicode();
+
+        // Latin, Greek & Cyrillic, plus punctuation, units and math symbols
+        if (uc < 0x20) {
+            return false;
+        } else if ((uc >= 0x0300) && (uc < 0x0370)) {
+            return false; // combining marks need shaping
+        } else if ((uc >= 0x0530) && ((uc < 0x2000) || (uc >= 0x2300))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+GlyphAtlas *GlyphCache::atlas(const QFont &font, QColor color, bool antialias)
+{
+    QString key = QString("%1:%2:%3").arg(font.key()).arg(color.rgba(), 0, 16).arg(antialias);
+
+    QHash<QString, GlyphAtlas *>::iterator it = m_atlases.find(key);
+    if (it != m_atlases.end()) {
+        return it.value();
+    }
+
+    GlyphAtlas *atlas = new GlyphAtlas(font, color, antialias);
+    m_atlases.insert(key, atlas);
+    return atlas;
+}
+
+qreal GlyphCache::width(const QString &text, const QFont &font, QColor color, bool antialias)
+{
+    if (!canRender(text)) {
+        return -1;
+    }
+
+    GlyphAtlas *a = atlas(font, color, antialias);
+    qreal w = 0;
+
+    for (int i = 0; i < text.size(); ++i) {
+        const GlyphAtlas::Glyph *g = a->glyph(text.at(i));
+        if (!g) {
+            return -1;
+        }
+        w += g->advance;
+    }
+    return w;
+}
+
+bool GlyphCache::add(const QString &text, QPointF origin, float angle, QPointF base, const QFont &font, QColor color, bool antialias)
+{
+    if (!canRender(text)) {
+        return false;
+    }
+
+    GlyphAtlas *a = atlas(font, color, antialias);
+    int size = text.size();
+
+    // Make sure every glyph is available before queuing any of them
+    m_line.resize(size);
+    for (int i = 0; i < size; ++i) {
+        const GlyphAtlas::Glyph *g = a->glyph(text.at(i));
+        if (!g) {
+            return false;
+        }
+        m_line[i] = g;
+    }
+
+    const qreal pad = a->pad();
+    const qreal ascent = a->metrics().ascent();
+
+    QTransform t;
+    t.translate(origin.x(), origin.y());
+    if (angle != 0) {
+        t.rotate(-angle);
+    }
+
+    qreal x = base.x();
+    qreal y = floor(base.y() - ascent - pad + 0.5);
+
+    for (int i = 0; i < size; ++i) {
+        const GlyphAtlas::Glyph *g = m_line.at(i);
+
+        // Fragments are positioned by their centre, and rotate around it
+        QPointF topleft(floor(x + 0.5) - pad, y);
+        QPointF centre = t.map(topleft + QPointF(g->source.width() / 2.0, g->source.height() / 2.0));
+
+        m_batches[qMakePair(a, g->page)].append(QPainter::PixmapFragment::create(centre, g->source, 1, 1, -angle));
+        x += g->advance;
+    }
+    return true;
+}
+
+bool GlyphCache::add(const QString &text, const QRectF &rect, quint32 flags, const QFont &font, QColor color, bool antialias)
+{
+    if (flags & (Qt::TextWordWrap | Qt::TextWrapAnywhere)) {
+        return false;
+    }
+
+    qreal w = width(text, font, color, antialias);
+    if (w < 0) {
+        return false;
+    }
+
+    const QFontMetricsF &fm = atlas(font, color, antialias)->metrics();
+    qreal x, y;
+
+    if (flags & Qt::AlignRight) {
+        x = rect.x() + rect.width() - w;
+    } else if (flags & Qt::AlignHCenter) {
+        x = rect.x() + (rect.width() - w) / 2.0;
+    } else {
+        x = rect.x();
+    }
+
+    if (flags & Qt::AlignBottom) {
+        y = rect.y() + rect.height() - fm.height();
+    } else if (flags & Qt::AlignVCenter) {
+        y = rect.y() + (rect.height() - fm.height()) / 2.0;
+    } else {
+        y = rect.y();
+    }
+
+    return add(text, QPointF(0, 0), 0, QPointF(x, y + fm.ascent()), font, color, antialias);
+}
+
+void GlyphCache::flush(QPainter &painter)
+{
+    QHash<QPair<GlyphAtlas *, int>, QVector<QPainter::PixmapFragment> >::iterator it;
+    for (it = m_batches.begin(); it != m_batches.end(); ++it) {
+        const QVector<QPainter::PixmapFragment> &frags = it.value();
+        if (frags.isEmpty()) {
+            continue;
+        }
+        painter.drawPixmapFragments(frags.constData(), frags.size(), it.key().first->page(it.key().second));
+    }
+
+    if (m_atlases.size() > MaxAtlases) {
+        // Something is churning colours or fonts, start over rather than grow without bound.
+        // Done here, once the frame's text is out, as the queued fragments point into these atlases
+        clear();
+        return;
+    }
+
+    // Keep the vectors' capacity for next frame
+    for (it = m_batches.begin(); it != m_batches.end(); ++it) {
+        it.value().resize(0);
+    }
+}
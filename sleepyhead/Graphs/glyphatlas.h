@@ -0,0 +1,118 @@
+/* Glyph Atlas Header
+ *
+ * Copyright (c) 2011-2016 Mark Watkins <jedimark@users.sourceforge.net>
+ *
+ * This file is subject to the terms and conditions of the GNU General Public
+ * License. See the file COPYING in the main directory of the Linux
+ * distribution for more details. */
+
+#ifndef GLYPHATLAS_H
+#define GLYPHATLAS_H
+
+#include <QFont>
+#include <QFontMetricsF>
+#include <QColor>
+#include <QHash>
+#include <QImage>
+#include <QPixmap>
+#include <QPainter>
+#include <QVector>
+#include <QString>
+
+/*! \class GlyphAtlas
+    \brief The glyphs of one font, colour and antialias setting, each rasterized once into shared pages
+    */
+class GlyphAtlas
+{
+  public:
+    struct Glyph {
+        Glyph() : page(-1), advance(0) {}
+
+        //! \brief Page holding this glyph, -1 if it couldn't be placed
+        int page;
+        //! \brief The glyphs cell within the page, padding included
+        QRectF source;
+        qreal advance;
+    };
+
+    GlyphAtlas(const QFont &font, QColor color, bool antialias);
+
+    //! \brief Returns the glyph for ch, rasterizing it on first use. nullptr if the pages are full
+    const Glyph *glyph(QChar ch);
+
+    //! \brief Returns page i as a pixmap, uploading any glyphs added since it was last drawn
+    const QPixmap &page(int i);
+
+    //! \brief Space around each glyph in its cell, so overhanging glyphs don't get clipped
+    int pad() const { return m_pad; }
+
+    const QFontMetricsF &metrics() const { return m_metrics; }
+
+    static const int PageSize = 512;
+    static const int MaxPages = 4;
+
+  protected:
+    bool place(int w, int h, int &page, QPoint &pos);
+
+    QFont m_font;
+    QColor m_color;
+    bool m_antialias;
+    QFontMetricsF m_metrics;
+    int m_pad;
+
+    //! \brief Latin-1 glyphs looked up directly, everything else via hash
+    Glyph m_latin[256];
+    QHash<ushort, Glyph> m_glyphs;
+
+    QVector<QImage> m_images;
+    QVector<QPixmap> m_pixmaps;
+    QVector<bool> m_dirty;
+
+    // Shelf packing position in the last page
+    int m_shelf_x, m_shelf_y, m_shelf_h;
+};
+
+/*! \class GlyphCache
+    \brief Draws queued text from glyph atlases, batched into one drawPixmapFragments call per atlas page
+
+    Replaces caching a pixmap per distinct string, which churned the QPixmapCache on every pan or zoom.
+    Text it can't lay out glyph by glyph (line breaks, word wrap, complex scripts) is refused, so the
+    caller can fall back to QPainter::drawText.
+    */
+class GlyphCache
+{
+  public:
+    GlyphCache() {}
+    ~GlyphCache();
+
+    /*! \brief Queue text, rotated by -angle degrees around origin, with its baseline starting at base
+        (relative to origin, before rotation). Returns false if the text needs drawing some other way */
+    bool add(const QString &text, QPointF origin, float angle, QPointF base, const QFont &font, QColor color, bool antialias);
+
+    //! \brief Queue text aligned inside rect by Qt alignment flags, as QPainter::drawText(rect, flags, text) would
+    bool add(const QString &text, const QRectF &rect, quint32 flags, const QFont &font, QColor color, bool antialias);
+
+    //! \brief Returns the laid out width of text, or -1 if it can't be drawn from an atlas
+    qreal width(const QString &text, const QFont &font, QColor color, bool antialias);
+
+    //! \brief Draw everything queued so far. Call before drawing anything that must appear above it
+    void flush(QPainter &painter);
+
+    //! \brief Throw away all atlases, such as after font preferences change
+    void clear();
+
+  protected:
+    GlyphAtlas *atlas(const QFont &font, QColor color, bool antialias);
+
+    static bool canRender(const QString &text);
+
+    QHash<QString, GlyphAtlas *> m_atlases;
+
+    //! \brief Queued fragments for each atlas page
+    QHash<QPair<GlyphAtlas *, int>, QVector<QPainter::PixmapFragment> > m_batches;
+    QVector<const GlyphAtlas::Glyph *> m_line;
+
+    static const int MaxAtlases = 64;
+};
+
+#endif // GLYPHATLAS_H
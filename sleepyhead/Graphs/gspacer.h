@@ -19,6 +19,8 @@ class gSpacer: public Layer
 {
   public:
     gSpacer(int space = 20); // orientation?
+    virtual const char *traceName() const { return "gSpacer"; }
+
     virtual void paint(QPainter &painter, gGraph &g, const QRegion &region) {
         Q_UNUSED(painter);
         Q_UNUSED(g);
@@ -50,7 +50,6 @@ class Layer
           m_X(0), m_Y(0),
           m_order(0),
           m_position(LayerCenter),
-          m_recalculating(false),
           m_layertype(LT_Other)
     { }
 
@@ -127,8 +126,6 @@ class Layer
     //! \brief Return this layers Moveability status (not really used yet)
     inline bool movable() const { return m_movable; }
 
-    inline bool recalculating() const { return m_recalculating; }
-
     virtual void dataChanged() {}
 
     /*! \brief Override this for the drawing code, using GLBuffer components for drawing
@@ -140,6 +137,9 @@ class Layer
       */
     virtual void paint(QPainter &painter, gGraph &gv, const QRegion &region) = 0;
 
+    //! \brief Static name for trace scopes, overridden by each layer class
+    virtual const char *traceName() const { return "Layer"; }
+
     //! \brief Set the layout position and order for this layer.
     void setLayout(LayerPosition position, short width, short height, short order);
 
@@ -185,7 +185,6 @@ class Layer
     LayerPosition m_position;
     QRect m_rect;
     bool m_mouseover;
-    volatile bool m_recalculating;
     LayerType m_layertype;
 public:
 
@@ -237,6 +236,8 @@ public:
 class LayerGroup : public Layer
 {
   public:
+    virtual const char *traceName() const { return "LayerGroup"; }
+
     LayerGroup()
         : Layer(NoChannel)
     { }
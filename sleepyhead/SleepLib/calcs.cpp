@@ -15,6 +15,7 @@
 
 #include "calcs.h"
 #include "profiles.h"
+#include "trace.h"
 
 bool SearchEvent(Session * session, ChannelID code, qint64 time, int dur, bool update=true)
 {
@@ -409,6 +410,8 @@ void FlowParser::calcPeaks(EventDataType *input, int samples)
 // These are grouped together because, a) it's faster, and b) some of these calculations rely on others.
 void FlowParser::calc(bool calcResp, bool calcTv, bool calcTi, bool calcTe, bool calcMv)
 {
+    TRACE_SCOPE(Trace::CAT_Calc, "FlowParser::calc");
+
     if (!m_session) {
         return;
     }
@@ -851,6 +854,8 @@ void FlowParser::flagUserEvents(ChannelID code, EventDataType restriction, Event
 
 void FlowParser::flagEvents()
 {
+    TRACE_SCOPE(Trace::CAT_Calc, "FlowParser::flagEvents");
+
     if (!p_profile->cpap->userEventFlagging()) { return; }
 
     int numbreaths = breaths.size();
@@ -863,6 +868,8 @@ void FlowParser::flagEvents()
 
 void calcRespRate(Session *session, FlowParser *flowparser)
 {
+    TRACE_SCOPE(Trace::CAT_Calc, "calcRespRate");
+
     if (session->type() != MT_CPAP) { return; }
 
     //    if (session->machine()->loaderName() != STR_MACH_PRS1) return;
@@ -995,6 +1002,8 @@ EventDataType calcAHI(Session *session, qint64 start, qint64 end)
 
 int calcAHIGraph(Session *session)
 {
+    TRACE_SCOPE(Trace::CAT_Calc, "calcAHIGraph");
+
     bool calcrdi = session->machine()->loaderName() == "PRS1";
 
     const qint64 window_step = 30000; // 30 second windows
@@ -1541,6 +1550,8 @@ EventDataType zMaskProfile::calcLeak(EventStoreType pressure)
 
 void zMaskProfile::updateProfile(Session *session)
 {
+    TRACE_SCOPE(Trace::CAT_Calc, "zMaskProfile::updateProfile");
+
     scanPressure(session);
     scanLeaks(session);
 
@@ -1719,6 +1730,8 @@ bool mmaskFirst = true;
 
 int calcLeaks(Session *session)
 {
+    TRACE_SCOPE(Trace::CAT_Calc, "calcLeaks");
+
     if (!p_profile->cpap->calculateUnintentionalLeaks()) { return 0; }
 
     if (session->type() != MT_CPAP) { return 0; }
@@ -1811,6 +1824,8 @@ int calcLeaks(Session *session)
 
 void flagLargeLeaks(Session *session)
 {
+    TRACE_SCOPE(Trace::CAT_Calc, "flagLargeLeaks");
+
     // Already contains?
     if (session->eventlist.contains(CPAP_LargeLeak))
         return;
@@ -1876,6 +1891,8 @@ void flagLargeLeaks(Session *session)
 
 int calcPulseChange(Session *session)
 {
+    TRACE_SCOPE(Trace::CAT_Calc, "calcPulseChange");
+
     if (session->eventlist.contains(OXI_PulseChange)) { return 0; }
 
     QHash<ChannelID, QVector<EventList *> >::iterator it = session->eventlist.find(OXI_Pulse);
@@ -1897,14 +1914,25 @@ int calcPulseChange(Session *session)
 
     int max;
 
+    QVector<EventDataType> vals;
+    QVector<qint64> times;
+
     int size = it.value().size();
     for (int e = 0; e < size; ++e) {
         EventList &el = *(it.value()[e]);
 
+        // Convert the whole list in bulk, the scan ahead revisits each sample many times
         int elcount=el.count();
+        vals.resize(elcount);
+        times.resize(elcount);
+        elcount = qMin(el.dataRange(0, elcount, vals.data()), el.timeRange(0, elcount, times.data()));
+
+        const EventDataType *v = vals.constData();
+        const qint64 *t = times.constData();
+
         for (int i = 0; i < elcount; ++i) {
-            val = el.data(i);
-            time = el.time(i);
+            val = v[i];
+            time = t[i];
 
 
             lastt = 0;
@@ -1912,11 +1940,11 @@ int calcPulseChange(Session *session)
             max = 0;
 
             for (int j = i + 1; j < elcount; ++j) { // scan ahead in the window
-                time2 = el.time(j);
+                time2 = t[j];
 
                 if (time2 > time + window) { break; }
 
-                val2 = el.data(j);
+                val2 = v[j];
                 tmp = qAbs(val2 - val);
 
                 if (tmp > lv) {
@@ -1955,6 +1983,8 @@ int calcPulseChange(Session *session)
 
 int calcSPO2Drop(Session *session)
 {
+    TRACE_SCOPE(Trace::CAT_Calc, "calcSPO2Drop");
+
     if (session->eventlist.contains(OXI_SPO2Drop)) { return 0; }
 
     QHash<ChannelID, QVector<EventList *> >::iterator it = session->eventlist.find(OXI_SPO2);
@@ -1986,14 +2016,21 @@ int calcSPO2Drop(Session *session)
     // Calculate median baseline
     QList<EventDataType> med;
 
+    QVector<EventDataType> vals;
+    QVector<qint64> times;
+
     int evsize = it.value().size();
     for (int e = 0; e < evsize; ++e) {
         EventList &el = *(it.value()[e]);
 
         int elcount = el.count();
+        vals.resize(elcount);
+        times.resize(elcount);
+        elcount = qMin(el.dataRange(0, elcount, vals.data()), el.timeRange(0, elcount, times.data()));
+
         for (int i = 0; i < elcount; i++) {
-            val = el.data(i);
-            time = el.time(i);
+            val = vals[i];
+            time = times[i];
 
             if (val > 0) { med.push_back(val); }
 
@@ -2029,12 +2066,19 @@ int calcSPO2Drop(Session *session)
         EventList &el = *(it.value()[e]);
 
         int elcount = el.count();
+        vals.resize(elcount);
+        times.resize(elcount);
+        elcount = qMin(el.dataRange(0, elcount, vals.data()), el.timeRange(0, elcount, times.data()));
+
+        const EventDataType *v = vals.constData();
+        const qint64 *t = times.constData();
+
         for (int i = 0; i < elcount; ++i) {
-            current = el.data(i);
+            current = v[i];
 
             if (!current) { continue; }
 
-            time = el.time(i);
+            time = t[i];
             /*ring[rp]=val;
             rtime[rp]=time;
             rp++;
@@ -2066,9 +2110,9 @@ int calcSPO2Drop(Session *session)
             min = val;
 
             for (int j = i; j < elcount; ++j) { // scan ahead in the window
-                time2 = el.time(j);
+                time2 = t[j];
                 //if (time2 > time+window) break;
-                val2 = el.data(j);
+                val2 = v[j];
 
                 if (val2 > baseline - change) { break; }
 
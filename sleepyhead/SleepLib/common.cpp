@@ -11,6 +11,7 @@
 #include <zlib.h>
 
 #include "profiles.h"
+#include "filesource.h"
 
 // Used by internal settings
 
@@ -96,24 +97,26 @@ bool removeDir(const QString &path)
 
 void copyPath(QString src, QString dst)
 {
-    QDir dir(src);
-    if (!dir.exists())
+    // src may also be a folder inside a zipped card
+    if (!FileSource::isDir(src))
         return;
 
+    QDir dir;
+
     // Recursively handle directories
-    foreach (QString d, dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+    foreach (QString d, FileSource::entryList(src, QDir::Dirs | QDir::NoDotAndDotDot)) {
         QString dst_path = dst + QDir::separator() + d;
         dir.mkpath(dst_path);
         copyPath(src + QDir::separator() + d, dst_path);
     }
 
     // Files
-    foreach (QString f, dir.entryList(QDir::Files)) {
+    foreach (QString f, FileSource::entryList(src, QDir::Files)) {
         QString srcFile = src + QDir::separator() + f;
         QString destFile = dst + QDir::separator() + f;
 
         if (!QFile::exists(destFile)) {
-            QFile::copy(srcFile, destFile);
+            FileSource::copy(srcFile, destFile);
         }
     }
 }
@@ -22,9 +22,15 @@
 QByteArray gCompress(const QByteArray& data);
 QByteArray gUncompress(const QByteArray &data);
 
+//! \brief Returns the CRC-32 (as used by zip and gzip) of data
+quint32 crc32buf(const QByteArray &data);
+
 const quint16 filetype_summary = 0;
 const quint16 filetype_data = 1;
 const quint16 filetype_sessenabled = 5;
+const quint16 filetype_prefsnapshot = 6;
+const quint16 filetype_machinesnapshot = 7;
+const quint16 filetype_channelsnapshot = 8;
 
 enum UnitSystem { US_Undefined, US_Metric, US_Archiac };
 
@@ -121,6 +121,11 @@ void Day::addSession(Session *s)
     }
 
     sessions.push_back(s);
+    d_timelines.clear();
+
+    if (p_profile) {
+        p_profile->invalidateDayIndex();
+    }
 }
 EventDataType Day::calcMiddle(ChannelID code)
 {
@@ -204,7 +209,10 @@ EventDataType Day::timeAboveThreshold(ChannelID code, EventDataType threshold)
     for (QList<Session *>::iterator it = sessions.begin(); it != end; ++it) {
         Session &sess = *(*it);
 
-        if (sess.enabled() && sess.m_availableChannels.contains(code)) {
+        if (!sess.enabled()) { continue; }
+        sess.requireSummary();
+
+        if (sess.m_availableChannels.contains(code)) {
             val += sess.timeAboveThreshold(code,threshold);
         }
     }
@@ -366,6 +374,7 @@ EventDataType Day::percentile(ChannelID code, EventDataType percentile)
     for (QList<Session *>::iterator sess_it = sessions.begin(); sess_it != sess_end; ++sess_it) {
         Session &sess = *(*sess_it);
         if (!sess.enabled()) { continue; }
+        sess.requireSummary();
 
         QHash<ChannelID, QHash<EventStoreType, EventStoreType> >::iterator ei = sess.m_valuesummary.find(code);
 
@@ -667,7 +676,10 @@ EventDataType Day::sum(ChannelID code)
     for (QList<Session *>::iterator it = sessions.begin(); it != end; ++it) {
         Session &sess = *(*it);
 
-        if (sess.enabled() && sess.m_sum.contains(code)) {
+        if (!sess.enabled()) { continue; }
+        sess.requireSummary();
+
+        if (sess.m_sum.contains(code)) {
             val += sess.sum(code);
         }
     }
@@ -685,7 +697,10 @@ EventDataType Day::wavg(ChannelID code)
     for (QList<Session *>::iterator it = sessions.begin(); it != end; ++it) {
         Session &sess = *(*it);
 
-        if (sess.enabled() && sess.m_wavg.contains(code)) {
+        if (!sess.enabled()) { continue; }
+        sess.requireSummary();
+
+        if (sess.m_wavg.contains(code)) {
             d = sess.length(); //.last(code)-sess.first(code);
             s0 = double(d) / 3600000.0;
 
@@ -953,7 +968,10 @@ EventDataType Day::Min(ChannelID code)
     for (QList<Session *>::iterator it = sessions.begin(); it != end; it++) {
         Session & sess = *(*it);
 
-        if (sess.enabled() && sess.m_min.contains(code)) {
+        if (!sess.enabled()) { continue; }
+        sess.requireSummary();
+
+        if (sess.m_min.contains(code)) {
 
             tmp = sess.Min(code);
 
@@ -979,7 +997,10 @@ EventDataType Day::physMin(ChannelID code)
     for (QList<Session *>::iterator it = sessions.begin(); it != end; ++it) {
         Session & sess = *(*it);
 
-        if (sess.enabled() && sess.m_min.contains(code)) {
+        if (!sess.enabled()) { continue; }
+        sess.requireSummary();
+
+        if (sess.m_min.contains(code)) {
 
             tmp = sess.physMin(code);
 
@@ -1006,6 +1027,8 @@ bool Day::hasData(ChannelID code, SummaryType type)
         if (sess.type() == MT_JOURNAL) continue;
 
         if (sess.enabled()) {
+            sess.requireSummary();
+
             switch (type) {
             //        case ST_90P:
             //            has=sess->m_90p.contains(code);
@@ -1075,7 +1098,10 @@ EventDataType Day::Max(ChannelID code)
     for (QList<Session *>::iterator it = sessions.begin(); it != end; ++it) {
         Session & sess = *(*it);
 
-        if (sess.enabled() && sess.m_max.contains(code)) {
+        if (!sess.enabled()) { continue; }
+        sess.requireSummary();
+
+        if (sess.m_max.contains(code)) {
 
             tmp = sess.Max(code);
 
@@ -1101,7 +1127,10 @@ EventDataType Day::physMax(ChannelID code)
     for (QList<Session *>::iterator it = sessions.begin(); it != end; ++it) {
         Session & sess = *(*it);
 
-        if (sess.enabled() && sess.m_max.contains(code)) {
+        if (!sess.enabled()) { continue; }
+        sess.requireSummary();
+
+        if (sess.m_max.contains(code)) {
             tmp = sess.physMax(code);
 
             if (first) {
@@ -1125,7 +1154,10 @@ EventDataType Day::cph(ChannelID code)
     for (QList<Session *>::iterator it = sessions.begin(); it != end; ++it) {
         Session & sess = *(*it);
 
-        if (sess.enabled() && sess.m_cnt.contains(code)) {
+        if (!sess.enabled()) { continue; }
+        sess.requireSummary();
+
+        if (sess.m_cnt.contains(code)) {
             sum += sess.count(code);
         }
     }
@@ -1143,7 +1175,10 @@ EventDataType Day::sph(ChannelID code)
     for (QList<Session *>::iterator it = sessions.begin(); it != end; ++it) {
         Session & sess = *(*it);
 
-        if (sess.enabled() && sess.m_sum.contains(code)) {
+        if (!sess.enabled()) { continue; }
+        sess.requireSummary();
+
+        if (sess.m_sum.contains(code)) {
             sum += sess.sum(code) / 3600.0; //*sessions[i]->hours();
             //h+=sessions[i]->hours();
         }
@@ -1162,7 +1197,10 @@ EventDataType Day::count(ChannelID code)
     for (QList<Session *>::iterator it = sessions.begin(); it != end; ++it) {
         Session & sess = *(*it);
 
-        if (sess.enabled() && sess.m_cnt.contains(code)) {
+        if (!sess.enabled()) { continue; }
+        sess.requireSummary();
+
+        if (sess.m_cnt.contains(code)) {
             total += sess.count(code);
         }
     }
@@ -1242,6 +1280,8 @@ bool Day::channelHasData(ChannelID id)
         Session & sess = *(*it);
 
         if (sess.enabled()) {
+            sess.requireSummary();
+
             if (sess.m_cnt.contains(id)) {
                 return true;
             }
@@ -1272,7 +1312,7 @@ void Day::OpenEvents()
 
 void Day::OpenSummary()
 {
-    if (d_summaries_open) return;
+    // No shortcut on d_summaries_open, the EventCache may have put some away since
     Q_FOREACH(Session * session, sessions) {
         session->LoadSummary();
     }
@@ -1285,60 +1325,37 @@ void Day::CloseEvents()
     Q_FOREACH(Session * session, sessions) {
         session->TrashEvents();
     }
+    d_timelines.clear();
     d_events_open = false;
 }
 
 QList<ChannelID> Day::getSortedMachineChannels(MachineType type, quint32 chantype)
 {
-    QList<ChannelID> available;
-    QHash<MachineType, Machine *>::iterator mi_end = machines.end();
-    for (QHash<MachineType, Machine *>::iterator mi = machines.begin(); mi != mi_end; mi++) {
-        if (mi.key() != type) continue;
-        available.append(mi.value()->availableChannels(chantype));
-    }
-
-    QMultiMap<int, ChannelID> order;
-
-    for (int i=0; i < available.size(); ++i) {
-        ChannelID code = available.at(i);
-        order.insert(schema::channel[code].order(), code);
-    }
-
-    QMultiMap<int, ChannelID>::iterator it;
-
-    QList<ChannelID> channels;
-    for (it = order.begin(); it != order.end(); ++it) {
-        ChannelID code = it.value();
-        channels.append(code);
+    // Only one machine of each type per day, and it keeps its list sorted already
+    QHash<MachineType, Machine *>::iterator mi = machines.find(type);
+    if (mi == machines.end()) {
+        return QList<ChannelID>();
     }
-    return channels;
+    return mi.value()->sortedChannels(chantype);
 }
 
 
 QList<ChannelID> Day::getSortedMachineChannels(quint32 chantype)
 {
     QList<ChannelID> available;
+    int count = 0;
     QHash<MachineType, Machine *>::iterator mi_end = machines.end();
     for (QHash<MachineType, Machine *>::iterator mi = machines.begin(); mi != mi_end; mi++) {
         if (mi.key() == MT_JOURNAL) continue;
-        available.append(mi.value()->availableChannels(chantype));
-    }
-
-    QMultiMap<int, ChannelID> order;
-
-    for (int i=0; i < available.size(); ++i) {
-        ChannelID code = available.at(i);
-        order.insert(schema::channel[code].order(), code);
+        available.append(mi.value()->sortedChannels(chantype));
+        ++count;
     }
 
-    QMultiMap<int, ChannelID>::iterator it;
-
-    QList<ChannelID> channels;
-    for (it = order.begin(); it != order.end(); ++it) {
-        ChannelID code = it.value();
-        channels.append(code);
+    // Channels from more than one machine need merging back into display order
+    if (count > 1) {
+        available = schema::channel.sorted(available, chantype);
     }
-    return channels;
+    return available;
 }
 
 qint64 Day::first(MachineType type)
@@ -1453,8 +1470,121 @@ bool Day::removeSession(Session *sess)
     if (!searchMachine(mt)) {
         machines.remove(mt);
     }
+    invalidate();
+    d_timelines.clear();
+
+    if (p_profile) {
+        p_profile->invalidateDayIndex();
+    }
     return b;
 }
+
+quint64 FlagTimeline::signature(Day *day, ChannelID code, qint64 clockdrift)
+{
+    quint64 sig = quint64(clockdrift);
+
+    for (int i = 0; i < day->sessions.size(); ++i) {
+        Session *sess = day->sessions.at(i);
+        if (!sess->enabled()) {
+            continue;
+        }
+
+        QHash<ChannelID, QVector<EventList *> >::iterator cei = sess->eventlist.find(code);
+        if (cei == sess->eventlist.end()) {
+            continue;
+        }
+
+        const QVector<EventList *> &evlist = cei.value();
+        for (int k = 0; k < evlist.size(); ++k) {
+            sig = sig * 31 + quint64(quintptr(evlist.at(k))) + evlist.at(k)->count();
+        }
+    }
+    return sig;
+}
+
+void FlagTimeline::build(Day *day, ChannelID code, qint64 clockdrift)
+{
+    QVector<QPair<qint64, EventStoreType> > events;
+
+    for (int i = 0; i < day->sessions.size(); ++i) {
+        Session *sess = day->sessions.at(i);
+        if (!sess->enabled()) {
+            continue;
+        }
+
+        QHash<ChannelID, QVector<EventList *> >::iterator cei = sess->eventlist.find(code);
+        if (cei == sess->eventlist.end()) {
+            continue;
+        }
+
+        qint64 drift = (sess->type() == MT_CPAP) ? clockdrift : 0;
+
+        const QVector<EventList *> &evlist = cei.value();
+        for (int k = 0; k < evlist.size(); ++k) {
+            EventList &el = *evlist.at(k);
+            qint64 start = el.first() + drift;
+            quint32 *tptr = el.rawTime();
+            EventStoreType *dptr = el.rawData();
+            int cnt = el.count();
+
+            events.reserve(events.size() + cnt);
+            for (int j = 0; j < cnt; ++j) {
+                events.append(qMakePair(start + tptr[j], dptr[j]));
+            }
+        }
+    }
+
+    // Sessions can overlap, and flags can arrive slightly out of order within one
+    std::stable_sort(events.begin(), events.end());
+
+    int size = events.size();
+    m_time.resize(size);
+    m_data.resize(size);
+    m_prefix.resize(size + 1);
+    m_maxduration = 0;
+
+    double sum = 0;
+    m_prefix[0] = 0;
+    for (int i = 0; i < size; ++i) {
+        m_time[i] = events.at(i).first;
+        m_data[i] = events.at(i).second;
+        sum += events.at(i).second;
+        m_prefix[i + 1] = sum;
+        m_maxduration = qMax(m_maxduration, qint64(events.at(i).second) * 1000L);
+    }
+}
+
+int FlagTimeline::lowerBound(qint64 t, int first) const
+{
+    return std::lower_bound(m_time.constBegin() + first, m_time.constEnd(), t) - m_time.constBegin();
+}
+
+int FlagTimeline::upperBound(qint64 t) const
+{
+    return std::upper_bound(m_time.constBegin(), m_time.constEnd(), t) - m_time.constBegin();
+}
+
+int FlagTimeline::find(qint64 from, qint64 to) const
+{
+    int i = lowerBound(from);
+    if ((i < m_time.size()) && (m_time.at(i) <= to)) {
+        return i;
+    }
+    return -1;
+}
+
+const FlagTimeline &Day::flagTimeline(ChannelID code)
+{
+    qint64 clockdrift = qint64(p_profile->cpap->clockDrift()) * 1000L;
+    quint64 sig = FlagTimeline::signature(this, code, clockdrift);
+
+    FlagTimeline &timeline = d_timelines[code];
+    if ((timeline.m_signature != sig) || (timeline.m_prefix.isEmpty())) {
+        timeline.build(this, code, clockdrift);
+        timeline.m_signature = sig;
+    }
+    return timeline;
+}
 bool Day::searchMachine(MachineType mt) {
     for (int i=0;  i < sessions.size(); ++i) {
         if (sessions.at(i)->type() == mt)
@@ -24,6 +24,53 @@ class OneTypePerDay
 
 class Machine;
 class Session;
+class Day;
+
+/*! \class FlagTimeline
+    \brief One flag or span channel of a whole day, merged across sessions into time order
+
+    Times have clock drift already applied. Flag layers binary search the visible slice
+    instead of walking every event of every session on each repaint.
+    */
+class FlagTimeline
+{
+  public:
+    FlagTimeline() : m_signature(0), m_maxduration(0) {}
+
+    //! \brief Merges the enabled sessions events for code
+    void build(Day *day, ChannelID code, qint64 clockdrift);
+
+    int size() const { return m_time.size(); }
+    inline qint64 time(int i) const { return m_time.at(i); }
+    inline EventStoreType data(int i) const { return m_data.at(i); }
+
+    //! \brief Returns the index of the first event at or after t, searching from index first
+    int lowerBound(qint64 t, int first = 0) const;
+
+    //! \brief Returns the index of the first event after t
+    int upperBound(qint64 t) const;
+
+    //! \brief Returns the index of the first event between from and to inclusive, or -1
+    int find(qint64 from, qint64 to) const;
+
+    //! \brief Returns the sum of raw data for events first up to (not including) last
+    double sum(int first, int last) const { return m_prefix.at(last) - m_prefix.at(first); }
+
+    //! \brief Longest raw duration in milliseconds, for finding spans that started before a given time
+    qint64 maxDuration() const { return m_maxduration; }
+
+    //! \brief Cheap fingerprint of what this timeline was built from
+    static quint64 signature(Day *day, ChannelID code, qint64 clockdrift);
+
+  protected:
+    QVector<qint64> m_time;
+    QVector<EventStoreType> m_data;
+    QVector<double> m_prefix;
+    quint64 m_signature;
+    qint64 m_maxduration;
+
+    friend class Day;
+};
 
 /*! \class Day
     \brief Contains a list of all Sessions for single date, for a single machine
@@ -216,6 +263,9 @@ class Day
     //! \brief Removes a session from this day
     bool removeSession(Session *sess);
 
+    //! \brief Returns code's events for all enabled sessions in time order, rebuilt when sessions, events or clock drift change
+    const FlagTimeline &flagTimeline(ChannelID code);
+
     //! \brief Returns a list of channels of supplied types, according to channel orders
     QList<ChannelID> getSortedMachineChannels(quint32 chantype);
 
@@ -318,6 +368,7 @@ class Day
     QHash<MachineType, EventDataType> d_machhours;
     QHash<ChannelID, long> d_count;
     QHash<ChannelID, double> d_sum;
+    QHash<ChannelID, FlagTimeline> d_timelines;
     bool d_invalidate;
     QDate d_date;
 };
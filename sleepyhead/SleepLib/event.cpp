@@ -7,15 +7,24 @@
  * distribution for more details. */
 
 #include <QDebug>
+#include <QPair>
+#include <algorithm>
+
 #include "event.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define EVENTLIST_SSE2
+#endif
+
 EventList::EventList(EventListType et, EventDataType gain, EventDataType offset, EventDataType min,
                      EventDataType max, double rate, bool second_field)
     : m_type(et), m_gain(gain), m_offset(offset), m_min(min), m_max(max), m_rate(rate),
       m_second_field(second_field)
 {
-    m_first = m_last = 0;
+    m_first = m_last = m_base = 0;
     m_count = 0;
+    m_unsorted = false;
 
     if (min == max) { // Update Min & Max unless forceably set here..
         m_update_minmax = true;
@@ -25,9 +34,7 @@ EventList::EventList(EventListType et, EventDataType gain, EventDataType offset,
         m_update_minmax = false;
     }
 
-    m_data.reserve(2048);
-
-    // Reserve a few to increase performace??
+    // No blanket reservation, most lists hold a handful of flags. Loaders that know better call reserve()
 }
 
 void EventList::clear()
@@ -35,8 +42,9 @@ void EventList::clear()
     m_min2 = m_min = 999999999.0F;
     m_max2 = m_max = -999999999.0F;
     m_update_minmax = true;
-    m_first = m_last = 0;
+    m_first = m_last = m_base = 0;
     m_count = 0;
+    m_unsorted = false;
 
     m_data.clear();
     m_data2.clear();
@@ -44,10 +52,89 @@ void EventList::clear()
 
 }
 
+void EventList::reserve(quint32 count)
+{
+    m_data.reserve(count);
+
+    if (m_second_field) {
+        m_data2.reserve(count);
+    }
+
+    if (m_type == EVL_Event) {
+        m_time.reserve(count);
+    }
+}
+
+void EventList::finalize()
+{
+    if (m_unsorted) {
+        sortEvents();
+        m_unsorted = false;
+    }
+
+    // Reserve hints are often upper bounds, hand back anything well beyond what got used
+    if (m_data.capacity() > m_data.size() + m_data.size() / 4 + 16) {
+        m_data.squeeze();
+    }
+
+    if (m_data2.capacity() > m_data2.size() + m_data2.size() / 4 + 16) {
+        m_data2.squeeze();
+    }
+
+    if (m_time.capacity() > m_time.size() + m_time.size() / 4 + 16) {
+        m_time.squeeze();
+    }
+}
+
+void EventList::sortEvents()
+{
+    quint32 count = qMin(m_count, quint32(m_time.size()));
+
+    if ((m_type != EVL_Event) || (count == 0)) {
+        return;
+    }
+
+    // Sort on signed delta, with the original index breaking ties so equal times keep their order
+    QVector<QPair<qint32, quint32> > order(count);
+
+    for (quint32 i = 0; i < count; ++i) {
+        order[i] = qMakePair(qint32(m_time[i]), i);
+    }
+
+    std::sort(order.begin(), order.end());
+
+    // Rebase onto the earliest event so every delta is positive again
+    qint32 base = order[0].first;
+    bool second = m_data2.size() >= int(count);
+
+    QVector<EventStoreType> data(count), data2(second ? count : 0);
+    QVector<quint32> time(count);
+
+    for (quint32 i = 0; i < count; ++i) {
+        quint32 j = order[i].second;
+        data[i] = m_data[j];
+        time[i] = quint32(order[i].first - base);
+
+        if (second) {
+            data2[i] = m_data2[j];
+        }
+    }
+
+    m_data = data;
+    m_time = time;
+
+    if (second) {
+        m_data2 = data2;
+    }
+
+    m_base += base;
+    m_first = m_base;
+}
+
 qint64 EventList::time(quint32 i) const
 {
     if (m_type == EVL_Event) {
-        return m_first + qint64(m_time[i]);
+        return m_base + qint64(qint32(m_time[i]));
     }
 
     return m_first + qint64((EventDataType(i) * m_rate));
@@ -63,6 +150,133 @@ EventDataType EventList::data2(quint32 i)
     return EventDataType(m_data2[i]);
 }
 
+// Multiplies contiguous 16 bit samples by gain, eight at a time where SSE2 is available
+static void convertSamples(const EventStoreType *src, quint32 count, EventDataType gain, EventDataType *out)
+{
+    quint32 i = 0;
+
+#ifdef EVENTLIST_SSE2
+    // Relies on EventStoreType being a signed 16 bit int
+    const __m128 g = _mm_set1_ps(gain);
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i raw = _mm_loadu_si128((const __m128i *)(src + i));
+
+        // Sign extend to two lots of four 32 bit ints
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(raw, raw), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(raw, raw), 16);
+
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), g));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), g));
+    }
+#endif
+
+    for (; i < count; ++i) {
+        out[i] = EventDataType(src[i]) * gain;
+    }
+}
+
+quint32 EventList::dataRange(quint32 start, quint32 count, EventDataType *out, quint32 stride) const
+{
+    quint32 size = qMin(m_count, quint32(m_data.size()));
+
+    if (start >= size) {
+        return 0;
+    }
+
+    if (stride < 1) { stride = 1; }
+
+    quint32 avail = (size - start + stride - 1) / stride;
+    if (count > avail) { count = avail; }
+
+    const EventStoreType *src = m_data.constData() + start;
+
+    if (stride == 1) {
+        convertSamples(src, count, m_gain, out);
+    } else {
+        for (quint32 i = 0; i < count; ++i, src += stride) {
+            out[i] = EventDataType(*src) * m_gain;
+        }
+    }
+
+    return count;
+}
+
+quint32 EventList::data2Range(quint32 start, quint32 count, EventDataType *out) const
+{
+    quint32 size = qMin(m_count, quint32(m_data2.size()));
+
+    if (start >= size) {
+        return 0;
+    }
+
+    if (count > size - start) { count = size - start; }
+
+    // data2 is never gained
+    convertSamples(m_data2.constData() + start, count, 1.0F, out);
+
+    return count;
+}
+
+quint32 EventList::timeRange(quint32 start, quint32 count, qint64 *out) const
+{
+    quint32 size = (m_type == EVL_Event) ? qMin(m_count, quint32(m_time.size())) : m_count;
+
+    if (start >= size) {
+        return 0;
+    }
+
+    if (count > size - start) { count = size - start; }
+
+    quint32 i = 0;
+
+#ifdef EVENTLIST_SSE2
+    __m128i base = _mm_loadl_epi64((const __m128i *)((m_type == EVL_Event) ? &m_base : &m_first));
+    base = _mm_unpacklo_epi64(base, base);
+    const __m128i zero = _mm_setzero_si128();
+#endif
+
+    if (m_type == EVL_Event) {
+        const quint32 *src = m_time.constData() + start;
+
+#ifdef EVENTLIST_SSE2
+        // Sign extend the 32 bit deltas and add them to first, four at a time
+        for (; i + 4 <= count; i += 4) {
+            __m128i d = _mm_loadu_si128((const __m128i *)(src + i));
+            __m128i sign = _mm_srai_epi32(d, 31);
+            _mm_storeu_si128((__m128i *)(out + i), _mm_add_epi64(base, _mm_unpacklo_epi32(d, sign)));
+            _mm_storeu_si128((__m128i *)(out + i + 2), _mm_add_epi64(base, _mm_unpackhi_epi32(d, sign)));
+        }
+#endif
+
+        for (; i < count; ++i) {
+            out[i] = m_base + qint64(qint32(src[i]));
+        }
+    } else {
+#ifdef EVENTLIST_SSE2
+        // Single precision multiply like time(), only while the offset fits a 32 bit truncation
+        if (double(start + count) * double(m_rate) < 2000000000.0) {
+            const __m128 rate = _mm_set1_ps(m_rate);
+            const __m128i four = _mm_set1_epi32(4);
+            __m128i idx = _mm_set_epi32(start + 3, start + 2, start + 1, start);
+
+            for (; i + 4 <= count; i += 4) {
+                __m128i ms = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(idx), rate));
+                _mm_storeu_si128((__m128i *)(out + i), _mm_add_epi64(base, _mm_unpacklo_epi32(ms, zero)));
+                _mm_storeu_si128((__m128i *)(out + i + 2), _mm_add_epi64(base, _mm_unpackhi_epi32(ms, zero)));
+                idx = _mm_add_epi32(idx, four);
+            }
+        }
+#endif
+
+        for (; i < count; ++i) {
+            out[i] = m_first + qint64(EventDataType(start + i) * m_rate);
+        }
+    }
+
+    return count;
+}
+
 void EventList::AddEvent(qint64 time, EventStoreType data)
 {
     // Apply gain & offset
@@ -78,29 +292,23 @@ void EventList::AddEvent(qint64 time, EventStoreType data)
     }
 
     if (!m_first) {
-        m_first = time;
+        m_first = m_base = time;
         m_last = time;
     }
 
-    if (m_first > time) {
-        // Crud.. Update all the previous records
-        // This really shouldn't happen.
-        qDebug() << "Unordered time detected in AddEvent().";
-
-        qint32 delta = (m_first - time);
-
-        for (quint32 i = 0; i < m_count; ++i) {
-            m_time[i] -= delta;
-        }
-
-        m_first = time;
-    }
-
     if (m_last < time) {
         m_last = time;
+    } else if (time < m_last) {
+        // Leave the delta relative to m_base, even if negative, rather than shifting every earlier
+        // record. finalize() sorts and rebases the lot in one go
+        m_unsorted = true;
+
+        if (time < m_first) {
+            m_first = time;
+        }
     }
 
-    quint32 delta = (time - m_first);
+    quint32 delta = quint32(time - m_base);
 
     m_data.push_back(data);
     m_time.push_back(delta);
@@ -330,3 +538,93 @@ void EventList::AddWaveform(qint64 start, char *data, int recs, qint64 duration)
         }
     }
 }
+
+int EventList::interleavedCount(int size, int offset, int interleave, int stride)
+{
+    if ((stride <= 0) || (interleave <= 0)) {
+        return 0;
+    }
+
+    // Whole groups, plus whatever of this channel made it into a trailing partial one
+    int blocks = size / stride;
+    int tail = size - blocks * stride - offset;
+
+    return blocks * interleave + qBound(0, tail, interleave);
+}
+
+template <typename T>
+void EventList::addInterleaved(qint64 start, const T *data, int recs, qint64 duration, int interleave, int stride)
+{
+    if (m_type != EVL_Waveform) {
+        qWarning() << "Attempted to add waveform data to non-waveform object";
+        return;
+    }
+
+    if (!m_rate) {
+        qWarning() << "Attempted to add waveform without setting sample rate";
+        return;
+    }
+
+    if ((recs <= 0) || (interleave <= 0)) {
+        return;
+    }
+
+    qint64 last = start + duration;
+
+    if (!m_first) {
+        m_first = start;
+        m_last = last;
+    } else if (m_last < last) {
+        m_last = last;
+    }
+
+    int r = m_count;
+    m_count += recs;
+    m_data.resize(m_count);
+
+    EventStoreType *dp = m_data.data() + r;
+    EventStoreType *ep = dp + recs;
+    const T *sp = data;
+
+    // Strided copy straight into the sample buffer
+    if (interleave == 1) {
+        for (; dp < ep; sp += stride) {
+            *dp++ = *sp;
+        }
+    } else {
+        while (dp < ep) {
+            int n = qMin(int(ep - dp), interleave);
+            for (int i = 0; i < n; ++i) {
+                dp[i] = sp[i];
+            }
+            dp += n;
+            sp += stride;
+        }
+    }
+
+    if (m_update_minmax) {
+        // Gain & offset are linear, so the raw extremes give the gained ones
+        const EventStoreType *p = m_data.constData() + r;
+        EventStoreType lo = *p, hi = *p;
+        for (const EventStoreType *pe = p + recs; p < pe; ++p) {
+            if (lo > *p) { lo = *p; }
+            if (hi < *p) { hi = *p; }
+        }
+        EventDataType v1 = EventDataType(lo) * m_gain + m_offset;
+        EventDataType v2 = EventDataType(hi) * m_gain + m_offset;
+        if (v1 > v2) { qSwap(v1, v2); }
+
+        if (m_min > v1) { m_min = v1; }
+        if (m_max < v2) { m_max = v2; }
+    }
+}
+
+void EventList::AddWaveform(qint64 start, const char *data, int recs, qint64 duration, int interleave, int stride)
+{
+    addInterleaved(start, data, recs, duration, interleave, stride);
+}
+
+void EventList::AddWaveform(qint64 start, const unsigned char *data, int recs, qint64 duration, int interleave, int stride)
+{
+    addInterleaved(start, data, recs, duration, interleave, stride);
+}
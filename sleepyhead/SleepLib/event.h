@@ -32,6 +32,13 @@ class EventList
     //! \brief Wipe the event list so it can be reused
     void clear();
 
+    //! \brief Reserve room for count records up front, when a loader knows (or can bound) how many are coming
+    void reserve(quint32 count);
+
+    /*! \brief Sorts any events that arrived out of order and gives back unused reserved capacity.
+        Called once a list is complete, before it's summarised or stored */
+    void finalize();
+
     /*! \brief Add an event starting at time, containing data to this event list
       Note, data2 is only used if second_field is specified in the constructor */
     void AddEvent(qint64 time, EventStoreType data);
@@ -40,6 +47,14 @@ class EventList
     void AddWaveform(qint64 start, unsigned char *data, int recs, qint64 duration);
     void AddWaveform(qint64 start, char *data, int recs, qint64 duration);
 
+    /*! \brief Add recs samples picked out of interleaved data, without splitting it apart first.
+        Takes interleave samples at a time, stepping stride bytes between groups */
+    void AddWaveform(qint64 start, const char *data, int recs, qint64 duration, int interleave, int stride);
+    void AddWaveform(qint64 start, const unsigned char *data, int recs, qint64 duration, int interleave, int stride);
+
+    //! \brief Returns how many samples a channel at offset holds in size bytes of interleaved data
+    static int interleavedCount(int size, int offset, int interleave, int stride);
+
     //! \brief Returns a count of records contained in this EventList
     inline quint32 count() const { return m_count; }
 
@@ -58,9 +73,29 @@ class EventList
     //! \brief Returns a data2 value multiplied by gain from index position i
     EventDataType data2(quint32 i);
 
-    //! \brief Returns either the timestamp for the i'th event, or calculates the waveform time position i
+    /*! \brief Returns either the timestamp for the i'th event, or calculates the waveform time position i
+        Events added earlier than the first one carry negative deltas until finalize() rebases them */
     qint64 time(quint32 i) const;
 
+    /*! \brief Converts count values starting at index start to gained values, same as data(i)
+        Takes every stride'th sample, clamped to the end of the list. Returns the number written to out */
+    quint32 dataRange(quint32 start, quint32 count, EventDataType *out, quint32 stride = 1) const;
+
+    //! \brief Copies count data2 values starting at index start into out, same as data2(i)
+    quint32 data2Range(quint32 start, quint32 count, EventDataType *out) const;
+
+    //! \brief Writes absolute timestamps for count records starting at index start into out, same as time(i)
+    quint32 timeRange(quint32 start, quint32 count, qint64 *out) const;
+
+    //! \brief Contiguous read-only view of the raw data, valid until this EventList is modified
+    inline const EventStoreType *constData() const { return m_data.constData(); }
+
+    //! \brief Contiguous read-only view of the raw data2, valid until this EventList is modified
+    inline const EventStoreType *constData2() const { return m_data2.constData(); }
+
+    //! \brief Contiguous read-only view of the time deltas from first(), only used in EVL_Event types. Only valid after finalize()
+    inline const quint32 *constTime() const { return m_time.constData(); }
+
     //! \brief Returns true if this EventList uses the second data field
     bool hasSecondField() { return m_second_field; }
 
@@ -73,8 +108,8 @@ class EventList
     //! \brief Returns the timespan covered by this EventList, in milliseconds since epoch
     inline qint64 duration() { return m_last - m_first; }
 
-    //! \brief Sets the first events/waveforms starting time in milliseconds since epoch
-    void setFirst(qint64 val) { m_first = val; }
+    //! \brief Sets the first events/waveforms starting time in milliseconds since epoch, moving existing events with it
+    void setFirst(qint64 val) { m_base += val - m_first; m_first = val; }
     //! \brief Sets the last events/waveforms ending time in milliseconds since epoch
     void setLast(qint64 val) { m_last = val; }
 
@@ -147,6 +182,12 @@ class EventList
     //! \brief Returns the time storage vector (only used in EVL_Event types)
     QVector<quint32> &getTime() { return m_time; }
 
+    //! \brief Returns the approximate number of bytes held by this EventList's storage
+    qint64 memoryUsage() const {
+        return sizeof(EventList) + qint64(m_data.capacity() + m_data2.capacity()) * sizeof(EventStoreType)
+                + qint64(m_time.capacity()) * sizeof(quint32);
+    }
+
     // Don't mess with these without considering the consequences
     void rawDataResize(quint32 i) { m_data.resize(i); m_count = i; }
     void rawData2Resize(quint32 i) { m_data2.resize(i); m_count = i; }
@@ -156,6 +197,9 @@ class EventList
     quint32 *rawTime() { return m_time.data(); }
 
   protected:
+    template <typename T>
+    void addInterleaved(qint64 start, const T *data, int recs, qint64 duration, int interleave, int stride);
+
     //! \brief The time storage vector, in 32bits delta format, added as offsets to m_first
     QVector<quint32> m_time;
 
@@ -181,8 +225,16 @@ class EventList
     QString m_dimension;
 
     qint64 m_first, m_last;
+
+    //! \brief What m_time deltas are relative to. Same as m_first, unless events arrived early and finalize() hasn't run yet
+    qint64 m_base;
     bool m_update_minmax;
     bool m_second_field;
+
+    //! \brief Set when an event arrives earlier than the latest one, finalize() sorts them
+    bool m_unsorted;
+
+    void sortEvents();
 };
 
 #endif // EVENT_H
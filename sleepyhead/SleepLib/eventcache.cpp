@@ -0,0 +1,324 @@
+/* SleepLib Event Cache Implementation
+ *
+ * Copyright (c) 2011-2016 Mark Watkins <jedimark@users.sourceforge.net>
+ *
+ * This file is subject to the terms and conditions of the GNU General Public
+ * License. See the file COPYING in the main directory of the Linux
+ * distribution for more details. */
+
+#include <QRunnable>
+#include <QThreadPool>
+#include <QSet>
+#include <QMap>
+#include <QDebug>
+
+#include "eventcache.h"
+#include "profiles.h"
+#include "session.h"
+#include "day.h"
+#include "trace.h"
+
+/*! \class EventPrefetchTask
+    \brief Opens the events of a list of sessions, giving up as soon as a newer request arrives
+    */
+class EventPrefetchTask: public QRunnable
+{
+  public:
+    EventPrefetchTask(EventCache *cache, const QList<Session *> &sessions, int generation)
+        : m_cache(cache), m_sessions(sessions), m_generation(generation) {}
+    virtual ~EventPrefetchTask() {}
+
+    virtual void run() {
+        TRACE_SCOPE(Trace::CAT_Session, "EventCache::prefetch");
+
+        for (int i = 0; i < m_sessions.size(); ++i) {
+            if (m_cache->m_generation.load() != m_generation) {
+                break;
+            }
+            // Old format files rewrite their summary while upgrading, that's left to the GUI thread
+            m_sessions.at(i)->OpenEvents(false);
+        }
+        m_cache->prefetchDone();
+    }
+
+  protected:
+    EventCache *m_cache;
+    QList<Session *> m_sessions;
+    int m_generation;
+};
+
+EventCache *EventCache::instance()
+{
+    // Deliberately never destroyed, Sessions may still be deleted during shutdown
+    static EventCache *cache = new EventCache();
+    return cache;
+}
+
+EventCache::EventCache()
+{
+    m_total = 0;
+    m_budget = 0;
+    m_packed_total = 0;
+    m_packed_budget = 0;
+    m_summary_clock = 0;
+    m_summary_budget = 0;
+    m_running = 0;
+}
+
+void EventCache::touch(Session *sess)
+{
+    qint64 bytes = sess->eventMemoryUsage();
+
+    QMutexLocker lock(&m_mutex);
+    QHash<Session *, qint64>::iterator it = m_sizes.find(sess);
+
+    if (it != m_sizes.end()) {
+        m_total -= it.value();
+        it.value() = bytes;
+        m_lru.removeOne(sess);
+    } else {
+        m_sizes[sess] = bytes;
+    }
+
+    m_total += bytes;
+    m_lru.push_front(sess);
+}
+
+void EventCache::forget(Session *sess)
+{
+    QMutexLocker lock(&m_mutex);
+    QHash<Session *, qint64>::iterator it = m_sizes.find(sess);
+
+    if (it == m_sizes.end()) {
+        return;
+    }
+
+    m_total -= it.value();
+    m_sizes.erase(it);
+    m_lru.removeOne(sess);
+}
+
+void EventCache::touchPacked(Session *sess, qint64 bytes)
+{
+    QMutexLocker lock(&m_mutex);
+    QHash<Session *, qint64>::iterator it = m_packed_sizes.find(sess);
+
+    if (it != m_packed_sizes.end()) {
+        m_packed_total -= it.value();
+        it.value() = bytes;
+        m_packed_lru.removeOne(sess);
+    } else {
+        m_packed_sizes[sess] = bytes;
+    }
+
+    m_packed_total += bytes;
+    m_packed_lru.push_front(sess);
+}
+
+void EventCache::forgetPacked(Session *sess)
+{
+    QMutexLocker lock(&m_mutex);
+    QHash<Session *, qint64>::iterator it = m_packed_sizes.find(sess);
+
+    if (it == m_packed_sizes.end()) {
+        return;
+    }
+
+    m_packed_total -= it.value();
+    m_packed_sizes.erase(it);
+    m_packed_lru.removeOne(sess);
+}
+
+qint64 EventCache::packedSize()
+{
+    QMutexLocker lock(&m_mutex);
+    return m_packed_total;
+}
+
+void EventCache::touchSummary(Session *sess)
+{
+    QMutexLocker lock(&m_mutex);
+    m_summary_stamps[sess] = ++m_summary_clock;
+}
+
+void EventCache::forgetSummary(Session *sess)
+{
+    QMutexLocker lock(&m_mutex);
+    m_summary_stamps.remove(sess);
+}
+
+qint64 EventCache::size()
+{
+    QMutexLocker lock(&m_mutex);
+    return m_total;
+}
+
+void EventCache::trim(Day *keep)
+{
+    if ((m_budget <= 0) && (m_summary_budget <= 0)) {
+        return;
+    }
+
+    TRACE_SCOPE(Trace::CAT_Session, "EventCache::trim");
+
+    // Anything on screen can't be put away
+    QSet<Session *> pinned;
+
+    if (keep) {
+        for (int i = 0; i < keep->sessions.size(); ++i) {
+            pinned.insert(keep->sessions.at(i));
+        }
+    }
+
+    if (p_profile) {
+        QMap<QDate, Day *>::iterator it_end = p_profile->daylist.end();
+        for (QMap<QDate, Day *>::iterator it = p_profile->daylist.begin(); it != it_end; ++it) {
+            Day *day = it.value();
+
+            if (day->useCounter() > 0) {
+                for (int i = 0; i < day->sessions.size(); ++i) {
+                    pinned.insert(day->sessions.at(i));
+                }
+            }
+        }
+    }
+
+    trimSummaries(pinned);
+
+    if (m_budget <= 0) {
+        return;
+    }
+
+    QList<Session *> victims;
+    {
+        QMutexLocker lock(&m_mutex);
+        qint64 total = m_total;
+
+        for (int i = m_lru.size() - 1; (i >= 0) && (total > m_budget); --i) {
+            Session *sess = m_lru.at(i);
+
+            if (pinned.contains(sess)) {
+                continue;
+            }
+
+            total -= m_sizes[sess];
+            victims.push_back(sess);
+        }
+    }
+
+    // PackEvents and TrashEvents call back in here, so this must happen outside the lock
+    bool pack = m_packed_budget > 0;
+    for (int i = 0; i < victims.size(); ++i) {
+        Session *sess = victims.at(i);
+
+        if (!pack || !sess->PackEvents()) {
+            sess->TrashEvents();
+        }
+    }
+
+    if (victims.size() > 0) {
+        trimPacked();
+        qDebug() << "EventCache put away" << victims.size() << "sessions," << size() / 1048576L << "MB still cached,"
+                 << packedSize() / 1048576L << "MB packed";
+    }
+}
+
+void EventCache::trimPacked()
+{
+    QList<Session *> victims;
+    {
+        QMutexLocker lock(&m_mutex);
+        qint64 total = m_packed_total;
+
+        for (int i = m_packed_lru.size() - 1; (i >= 0) && (total > m_packed_budget); --i) {
+            Session *sess = m_packed_lru.at(i);
+            total -= m_packed_sizes[sess];
+            victims.push_back(sess);
+        }
+    }
+
+    // DropPackedEvents calls forgetPacked(), so this must happen outside the lock
+    for (int i = 0; i < victims.size(); ++i) {
+        victims.at(i)->DropPackedEvents();
+    }
+}
+
+void EventCache::trimSummaries(const QSet<Session *> &pinned)
+{
+    if (m_summary_budget <= 0) {
+        return;
+    }
+
+    // Somebody is walking summaries in the background, try again next time
+    if (!m_summary_lock.tryLockForWrite()) {
+        return;
+    }
+
+    QMap<quint64, Session *> oldest;
+    int excess;
+    {
+        QMutexLocker lock(&m_mutex);
+        excess = m_summary_stamps.size() - m_summary_budget;
+
+        if (excess > 0) {
+            QHash<Session *, quint64>::iterator it_end = m_summary_stamps.end();
+            for (QHash<Session *, quint64>::iterator it = m_summary_stamps.begin(); it != it_end; ++it) {
+                if (!pinned.contains(it.key())) {
+                    oldest.insert(it.value(), it.key());
+                }
+            }
+        }
+    }
+
+    // unloadSummary calls forgetSummary(), so this must happen outside the lock
+    int count = 0;
+    QMap<quint64, Session *>::iterator it_end = oldest.end();
+    for (QMap<quint64, Session *>::iterator it = oldest.begin(); (it != it_end) && (count < excess); ++it) {
+        if (it.value()->unloadSummary()) {
+            ++count;
+        }
+    }
+
+    m_summary_lock.unlock();
+
+    if (count > 0) {
+        qDebug() << "EventCache put away" << count << "session summaries";
+    }
+}
+
+void EventCache::prefetch(const QList<Session *> &sessions)
+{
+    int generation = m_generation.fetchAndAddOrdered(1) + 1;
+
+    if (sessions.isEmpty()) {
+        return;
+    }
+
+    {
+        QMutexLocker lock(&m_mutex);
+        m_running++;
+    }
+    QThreadPool::globalInstance()->start(new EventPrefetchTask(this, sessions, generation));
+}
+
+void EventCache::prefetchDone()
+{
+    QMutexLocker lock(&m_mutex);
+
+    if (--m_running == 0) {
+        m_idle.wakeAll();
+    }
+}
+
+void EventCache::cancelPrefetch(bool wait)
+{
+    m_generation.fetchAndAddOrdered(1);
+
+    if (wait) {
+        QMutexLocker lock(&m_mutex);
+
+        while (m_running > 0) {
+            m_idle.wait(&m_mutex);
+        }
+    }
+}
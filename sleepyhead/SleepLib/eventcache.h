@@ -0,0 +1,133 @@
+/* SleepLib Event Cache Header
+ *
+ * Copyright (c) 2011-2016 Mark Watkins <jedimark@users.sourceforge.net>
+ *
+ * This file is subject to the terms and conditions of the GNU General Public
+ * License. See the file COPYING in the main directory of the Linux
+ * distribution for more details. */
+
+#ifndef EVENTCACHE_H
+#define EVENTCACHE_H
+
+#include <QMutex>
+#include <QList>
+#include <QHash>
+#include <QSet>
+#include <QAtomicInt>
+#include <QReadWriteLock>
+#include <QWaitCondition>
+
+class Session;
+class Day;
+
+/*! \class EventCache
+    \brief Keeps recently used Session events in memory, within a byte budget
+
+    Sessions register themselves when their events are opened and unregister when trashed.
+    trim() puts away the least recently used sessions once the budget is exceeded,
+    never touching the day being viewed or days pinned by snapshot graphs.
+
+    Also runs a single background prefetch job, loading events for the days the user is
+    likely to step to next.
+
+    With a packed budget set, trim() compresses sessions into memory rather than trashing them,
+    so stepping back to a recent night inflates them instead of reading and decoding from disk.
+    The oldest packed sessions are dropped once that budget is exceeded too.
+
+    Session summaries are tracked the same way, by count rather than bytes. They fault back in
+    from disk when next touched, so trim() only puts away the oldest loaded ones.
+    */
+class EventCache
+{
+  public:
+    static EventCache *instance();
+
+    //! \brief Sets the memory budget in bytes. Zero means keep everything
+    void setBudget(qint64 bytes) { m_budget = bytes; }
+    qint64 budget() const { return m_budget; }
+
+    //! \brief Mark sess as most recently used, (re)measuring its event memory
+    void touch(Session *sess);
+
+    //! \brief Drop sess from the cache bookkeeping, called when its events are trashed
+    void forget(Session *sess);
+
+    //! \brief Pack or trash least recently used events until back under budget. GUI thread only
+    void trim(Day *keep = nullptr);
+
+    //! \brief Bytes of event data currently held by tracked sessions
+    qint64 size();
+
+    //! \brief Sets the memory budget for compressed events in bytes. Zero disables packing
+    void setPackedBudget(qint64 bytes) { m_packed_budget = bytes; }
+    qint64 packedBudget() const { return m_packed_budget; }
+
+    //! \brief Note sess now holds bytes of compressed events
+    void touchPacked(Session *sess, qint64 bytes);
+
+    //! \brief Drop sess from packed bookkeeping, called when its compressed events are inflated or discarded
+    void forgetPacked(Session *sess);
+
+    //! \brief Bytes of compressed event data currently held
+    qint64 packedSize();
+
+    //! \brief Load events for sessions on a worker thread, cancelling any earlier request
+    void prefetch(const QList<Session *> &sessions);
+
+    //! \brief Cancel any prefetch in progress, optionally waiting for the worker to stop
+    void cancelPrefetch(bool wait = false);
+
+    //! \brief Returns the current prefetch generation, bumped on every request or cancel
+    int generation() { return m_generation.load(); }
+
+    //! \brief Sets how many session summaries to keep in memory. Zero means keep everything
+    void setSummaryBudget(int sessions) { m_summary_budget = sessions; }
+
+    //! \brief Note sess has just loaded its summary
+    void touchSummary(Session *sess);
+
+    //! \brief Drop sess from summary bookkeeping, called when its summary is put away or it's deleted
+    void forgetSummary(Session *sess);
+
+    //! \brief Background jobs walking summaries hold this for reading, trim() won't put any away meanwhile
+    QReadWriteLock *summaryLock() { return &m_summary_lock; }
+
+  protected:
+    EventCache();
+
+    QMutex m_mutex;
+
+    //! \brief Most recently used at the front
+    QList<Session *> m_lru;
+    QHash<Session *, qint64> m_sizes;
+    qint64 m_total;
+    qint64 m_budget;
+
+    //! \brief Packed sessions, most recently put away at the front
+    QList<Session *> m_packed_lru;
+    QHash<Session *, qint64> m_packed_sizes;
+    qint64 m_packed_total;
+    qint64 m_packed_budget;
+
+    QAtomicInt m_generation;
+
+    //! \brief Prefetch jobs queued or running, guarded by m_mutex
+    int m_running;
+    QWaitCondition m_idle;
+
+    //! \brief Called by a prefetch job as it finishes
+    void prefetchDone();
+
+    //! \brief Load order stamp of each session with its summary in memory
+    QHash<Session *, quint64> m_summary_stamps;
+    quint64 m_summary_clock;
+    int m_summary_budget;
+    QReadWriteLock m_summary_lock;
+
+    void trimSummaries(const QSet<Session *> &pinned);
+    void trimPacked();
+
+    friend class EventPrefetchTask;
+};
+
+#endif // EVENTCACHE_H
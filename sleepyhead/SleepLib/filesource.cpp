@@ -0,0 +1,558 @@
+/* SleepLib Virtual File Source Implementation
+ *
+ * Copyright (c) 2011-2016 Mark Watkins <jedimark@users.sourceforge.net>
+ *
+ * This file is subject to the terms and conditions of the GNU General Public
+ * License. See the file COPYING in the main directory of the Linux
+ * distribution for more details. */
+
+#include <QFile>
+#include <QFileInfo>
+#include <QBuffer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QHash>
+#include <QSet>
+#include <QSharedPointer>
+#include <QDebug>
+
+#include <quazip/quazip.h>
+#include <quazip/quazipfileinfo.h>
+#include <quazip/unzip.h>
+
+#include "zlib.h"
+#include "filesource.h"
+#include "trace.h"
+
+struct ZipEntry {
+    QString name;       // as stored in the archive
+    unz_file_pos pos;   // central directory position, so lookups never scan
+    qint64 size;        // both sizes are only what the central directory claims
+    qint64 csize;
+};
+
+struct ZipFolder {
+    QStringList dirs;
+    QStringList files;
+};
+
+/*! \class ZipArchive
+    \brief Central directory index of one archive, plus a pool of unzip handles to read it with
+    */
+class ZipArchive
+{
+  public:
+    ZipArchive(const QString & filename) : m_filename(filename) {}
+    ~ZipArchive();
+
+    //! \brief Reads the central directory, returns false if this isn't a usable archive
+    bool index();
+
+    const ZipEntry * findFile(const QString & key) const {
+        QHash<QString, ZipEntry>::const_iterator it = m_files.find(key);
+        return (it != m_files.end()) ? &it.value() : nullptr;
+    }
+    const ZipFolder * findFolder(const QString & key) const {
+        QHash<QString, ZipFolder>::const_iterator it = m_folders.find(key);
+        return (it != m_folders.end()) ? &it.value() : nullptr;
+    }
+
+    QByteArray read(const ZipEntry & entry, qint64 maxlen);
+
+  protected:
+    QuaZip * acquire();
+    void release(QuaZip * zip);
+
+    QString m_filename;
+
+    // Both keyed by lower case path within the archive, "" being the root folder
+    QHash<QString, ZipEntry> m_files;
+    QHash<QString, ZipFolder> m_folders;
+
+    // unzip handles keep a read position, so every concurrent reader needs its own
+    QMutex m_mutex;
+    QList<QuaZip *> m_idle;
+};
+
+ZipArchive::~ZipArchive()
+{
+    for (int i = 0; i < m_idle.size(); ++i) {
+        m_idle.at(i)->close();
+        delete m_idle.at(i);
+    }
+}
+
+bool ZipArchive::index()
+{
+    TRACE_SCOPE(Trace::CAT_Loader, "ZipArchive::index");
+
+    QuaZip * zip = new QuaZip(m_filename);
+
+    if (!zip->open(QuaZip::mdUnzip)) {
+        qDebug() << "Couldn't open archive" << m_filename << "error" << zip->getZipError();
+        delete zip;
+        return false;
+    }
+
+    m_folders[QString()] = ZipFolder();
+
+    QuaZipFileInfo info;
+
+    for (bool more = zip->goToFirstFile(); more; more = zip->goToNextFile()) {
+        if (!zip->getCurrentFileInfo(&info)) {
+            continue;
+        }
+
+        QString name = info.name;
+        name.replace("\\", "/");
+        bool isdir = name.endsWith("/");
+
+        QStringList parts = QDir::cleanPath(name).split("/", QString::SkipEmptyParts);
+        if (!parts.isEmpty() && (parts.at(0) == ".")) {
+            parts.removeFirst();
+        }
+        if (parts.isEmpty()) {
+            continue;
+        }
+
+        // Register every parent folder, archives don't always carry entries for them
+        QString parent;
+        int folders = isdir ? parts.size() : parts.size() - 1;
+
+        for (int i = 0; i < folders; ++i) {
+            QString key = parent.isEmpty() ? parts.at(i).toLower() : parent + "/" + parts.at(i).toLower();
+
+            if (!m_folders.contains(key)) {
+                m_folders[parent].dirs.append(parts.at(i));
+                m_folders[key] = ZipFolder();
+            }
+            parent = key;
+        }
+
+        if (isdir) {
+            continue;
+        }
+
+        QString key = parent.isEmpty() ? parts.last().toLower() : parent + "/" + parts.last().toLower();
+        if (m_files.contains(key)) {
+            qDebug() << "Skipping duplicate archive entry" << name;
+            continue;
+        }
+
+        ZipEntry & entry = m_files[key];
+        entry.name = info.name;
+        entry.size = info.uncompressedSize;
+        entry.csize = info.compressedSize;
+        unzGetFilePos(zip->getUnzFile(), &entry.pos);
+
+        m_folders[parent].files.append(parts.last());
+    }
+
+    QHash<QString, ZipFolder>::iterator it_end = m_folders.end();
+    for (QHash<QString, ZipFolder>::iterator it = m_folders.begin(); it != it_end; ++it) {
+        it.value().dirs.sort();
+        it.value().files.sort();
+    }
+
+    qDebug() << "Indexed" << m_files.size() << "files in archive" << m_filename;
+
+    m_idle.append(zip);
+    return true;
+}
+
+QuaZip * ZipArchive::acquire()
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        if (!m_idle.isEmpty()) {
+            return m_idle.takeLast();
+        }
+    }
+
+    // Opening another handle only reads the end of central directory record
+    QuaZip * zip = new QuaZip(m_filename);
+    if (!zip->open(QuaZip::mdUnzip)) {
+        qDebug() << "Couldn't reopen archive" << m_filename;
+        delete zip;
+        return nullptr;
+    }
+    return zip;
+}
+
+void ZipArchive::release(QuaZip * zip)
+{
+    QMutexLocker lock(&m_mutex);
+    m_idle.append(zip);
+}
+
+QByteArray ZipArchive::read(const ZipEntry & entry, qint64 maxlen)
+{
+    TRACE_SCOPE(Trace::CAT_Loader, "ZipArchive::read");
+
+    QByteArray data;
+    QuaZip * zip = acquire();
+
+    if (!zip) {
+        return data;
+    }
+
+    unzFile uf = zip->getUnzFile();
+    unz_file_pos pos = entry.pos;
+
+    if ((unzGoToFilePos(uf, &pos) != UNZ_OK) || (unzOpenCurrentFile(uf) != UNZ_OK)) {
+        qDebug() << "Couldn't open archive entry" << entry.name;
+        release(zip);
+        return data;
+    }
+
+    // Nothing a machine writes comes near this, anything bigger is a corrupt or hostile directory entry
+    const qint64 max_entry_size = 256 * 1024 * 1024;
+
+    // Deflate can't do better than about 1032:1
+    const qint64 max_ratio = 1032;
+
+    if ((entry.size < 0) || (entry.size > max_entry_size) || (entry.size > (entry.csize + 1) * max_ratio)) {
+        qDebug() << "Archive entry" << entry.name << "claims an implausible size of" << entry.size << "bytes";
+        unzCloseCurrentFile(uf);
+        release(zip);
+        return data;
+    }
+
+    qint64 len = (maxlen >= 0) ? qMin(maxlen, entry.size) : entry.size;
+    data.resize(len);
+
+    qint64 got = 0;
+    while (got < len) {
+        int res = unzReadCurrentFile(uf, data.data() + got, unsigned(len - got));
+        if (res <= 0) {
+            if (res < 0) {
+                qDebug() << "Error" << res << "inflating archive entry" << entry.name;
+            }
+            break;
+        }
+        got += res;
+    }
+    data.resize(got);
+
+    // Only checks the CRC when the whole entry was read
+    if (unzCloseCurrentFile(uf) == UNZ_CRCERROR) {
+        qDebug() << "CRC error in archive entry" << entry.name;
+    }
+
+    release(zip);
+    return data;
+}
+
+// Shared, so release() can't pull an archive out from under a reader still using it
+typedef QSharedPointer<ZipArchive> ZipArchivePtr;
+
+static QMutex archiveMutex;
+static QHash<QString, ZipArchivePtr> archives;
+
+// Folders named .zip and broken archives, so every path through them doesn't retry the open
+static QSet<QString> notArchives;
+
+static ZipArchivePtr findArchive(const QString & filename)
+{
+    QMutexLocker lock(&archiveMutex);
+
+    QHash<QString, ZipArchivePtr>::iterator it = archives.find(filename);
+    if (it != archives.end()) {
+        return it.value();
+    }
+
+    if (notArchives.contains(filename)) {
+        return ZipArchivePtr();
+    }
+
+    // A folder that just happens to be named .zip stays on the file system
+    if (!QFileInfo(filename).isFile()) {
+        notArchives.insert(filename);
+        return ZipArchivePtr();
+    }
+
+    ZipArchivePtr archive(new ZipArchive(filename));
+    if (!archive->index()) {
+        notArchives.insert(filename);
+        return ZipArchivePtr();
+    }
+
+    archives[filename] = archive;
+    return archive;
+}
+
+// Splits path into an archive and the lower case key of the path inside it.
+// Returns a null pointer when path doesn't run through an archive.
+static ZipArchivePtr lookupArchive(const QString & path, QString & key)
+{
+    QString p = path;
+    p.replace("\\", "/");
+
+    int idx = 0;
+    while ((idx = p.indexOf(".zip", idx, Qt::CaseInsensitive)) >= 0) {
+        int end = idx + 4;
+
+        if ((end == p.size()) || (p.at(end) == '/')) {
+            ZipArchivePtr archive = findArchive(p.left(end));
+
+            if (archive) {
+                QStringList parts = p.mid(end).toLower().split("/", QString::SkipEmptyParts);
+                parts.removeAll(".");
+                key = parts.join("/");
+                return archive;
+            }
+        }
+        idx = end;
+    }
+    return ZipArchivePtr();
+}
+
+bool FileSource::isArchive(const QString & path)
+{
+    QString key;
+    return !lookupArchive(path, key).isNull() && key.isEmpty();
+}
+
+bool FileSource::inArchive(const QString & path)
+{
+    QString key;
+    return !lookupArchive(path, key).isNull();
+}
+
+bool FileSource::exists(const QString & path)
+{
+    QString key;
+    ZipArchivePtr archive = lookupArchive(path, key);
+
+    if (!archive) {
+        return QFileInfo(path).exists();
+    }
+    return archive->findFile(key) || archive->findFolder(key);
+}
+
+bool FileSource::isDir(const QString & path)
+{
+    QString key;
+    ZipArchivePtr archive = lookupArchive(path, key);
+
+    if (!archive) {
+        return QFileInfo(path).isDir();
+    }
+    return archive->findFolder(key) != nullptr;
+}
+
+QStringList FileSource::entryList(const QString & path, QDir::Filters filters)
+{
+    QString key;
+    ZipArchivePtr archive = lookupArchive(path, key);
+
+    if (!archive) {
+        return QDir(path).entryList(filters | QDir::NoDotAndDotDot, QDir::Name);
+    }
+
+    QStringList list;
+    const ZipFolder * folder = archive->findFolder(key);
+
+    if (folder) {
+        if (filters & QDir::Dirs) {
+            list.append(folder->dirs);
+        }
+        if (filters & QDir::Files) {
+            list.append(folder->files);
+        }
+        list.sort();
+    }
+    return list;
+}
+
+qint64 FileSource::size(const QString & path)
+{
+    QString key;
+    ZipArchivePtr archive = lookupArchive(path, key);
+
+    if (!archive) {
+        QFileInfo fi(path);
+        return fi.isFile() ? fi.size() : -1;
+    }
+
+    const ZipEntry * entry = archive->findFile(key);
+    return entry ? entry->size : -1;
+}
+
+QByteArray FileSource::read(const QString & path, qint64 maxlen)
+{
+    QString key;
+    ZipArchivePtr archive = lookupArchive(path, key);
+
+    if (!archive) {
+        QFile f(path);
+        if (!f.open(QFile::ReadOnly)) {
+            return QByteArray();
+        }
+        return (maxlen >= 0) ? f.read(maxlen) : f.readAll();
+    }
+
+    const ZipEntry * entry = archive->findFile(key);
+    if (!entry) {
+        return QByteArray();
+    }
+    return archive->read(*entry, maxlen);
+}
+
+QIODevice * FileSource::open(const QString & path)
+{
+    QString key;
+    ZipArchivePtr archive = lookupArchive(path, key);
+
+    if (!archive) {
+        QFile * f = new QFile(path);
+        if (!f->open(QFile::ReadOnly)) {
+            delete f;
+            return nullptr;
+        }
+        return f;
+    }
+
+    const ZipEntry * entry = archive->findFile(key);
+    if (!entry) {
+        return nullptr;
+    }
+
+    QBuffer * buf = new QBuffer();
+    buf->setData(archive->read(*entry, -1));
+    buf->open(QIODevice::ReadOnly);
+    return buf;
+}
+
+bool FileSource::copy(const QString & src, const QString & dst)
+{
+    if (!inArchive(src)) {
+        return QFile::copy(src, dst);
+    }
+
+    if (QFile::exists(dst) || (size(src) < 0)) {
+        return false;
+    }
+
+    QByteArray data = read(src);
+
+    QFile out(dst);
+    if (!out.open(QFile::WriteOnly)) {
+        qDebug() << "FileSource::copy() Couldn't open" << dst << "for writing";
+        return false;
+    }
+    return out.write(data) == data.size();
+}
+
+QByteArray FileSource::gunzip(const QByteArray & data, qint64 maxlen)
+{
+    QByteArray out;
+
+    // Smallest possible gzip member is a 10 byte header and an 8 byte trailer
+    if ((data.size() < 18) || (maxlen == 0)) {
+        return out;
+    }
+
+    // Largest a QByteArray can hold
+    const qint64 max_size = 0x7fffffff - 32;
+
+    // Only a starting guess, a damaged trailer could claim anything up to 4GB
+    const qint64 max_guess = 64 * 1024 * 1024;
+
+    qint64 limit = (maxlen > 0) ? qMin(maxlen, max_size) : max_size;
+    qint64 guess;
+
+    if (maxlen > 0) {
+        guess = maxlen;
+    } else {
+        // Trailer of the last member holds its uncompressed size modulo 4GB
+        const unsigned char * tail = (const unsigned char *)data.constData() + data.size() - 4;
+        guess = quint32(tail[0] | (tail[1] << 8) | (tail[2] << 16) | (quint32(tail[3]) << 24));
+    }
+
+    guess = qMin(qMax(guess, qint64(qMin(data.size(), 4096))), qMin(max_guess, limit));
+    out.resize(int(guess));
+
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+
+    // 16 + MAX_WBITS asks zlib for a gzip wrapper rather than raw zlib
+    if (inflateInit2(&strm, 16 + MAX_WBITS) != Z_OK) {
+        return QByteArray();
+    }
+
+    strm.next_in = (Bytef *)data.constData();
+    strm.avail_in = data.size();
+
+    qint64 total = 0;
+    int members = 0;
+
+    while (true) {
+        if (total == out.size()) {
+            if (total >= limit) {
+                // Whatever maxlen asked for is in
+                break;
+            }
+            out.resize(int(qMin(total * 2, limit)));
+        }
+
+        strm.next_out = (Bytef *)out.data() + total;
+        strm.avail_out = uInt(out.size() - total);
+
+        int res = inflate(&strm, Z_NO_FLUSH);
+        total = (char *)strm.next_out - out.data();
+
+        if (res == Z_STREAM_END) {
+            members++;
+
+            // Concatenated members decode into one stream, as gzip -d does
+            if ((strm.avail_in == 0) || (inflateReset(&strm) != Z_OK)) {
+                break;
+            }
+        } else if (res == Z_BUF_ERROR) {
+            if (strm.avail_out > 0) {
+                // Ran out of input, a truncated file just stops early
+                break;
+            }
+        } else if (res != Z_OK) {
+            // Junk after the last member is allowed, anything else is worth a mention
+            if (members == 0) {
+                qDebug() << "FileSource::gunzip() failed with zlib error" << res;
+            }
+            break;
+        }
+    }
+
+    out.resize(int(total));
+    inflateEnd(&strm);
+
+    return out;
+}
+
+void FileSource::release(const QString & path)
+{
+    QString p = path;
+    p.replace("\\", "/");
+
+    QMutexLocker lock(&archiveMutex);
+
+    // Readers still holding an archive keep it alive until they're done
+    QHash<QString, ZipArchivePtr>::iterator it = archives.begin();
+    while (it != archives.end()) {
+        if (p.startsWith(it.key(), Qt::CaseInsensitive)) {
+            it = archives.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // Give anything that wasn't an archive before another look next time
+    QSet<QString>::iterator nit = notArchives.begin();
+    while (nit != notArchives.end()) {
+        if (p.startsWith(*nit, Qt::CaseInsensitive)) {
+            nit = notArchives.erase(nit);
+        } else {
+            ++nit;
+        }
+    }
+}
@@ -0,0 +1,66 @@
+/* SleepLib Virtual File Source Header
+ *
+ * Copyright (c) 2011-2016 Mark Watkins <jedimark@users.sourceforge.net>
+ *
+ * This file is subject to the terms and conditions of the GNU General Public
+ * License. See the file COPYING in the main directory of the Linux
+ * distribution for more details. */
+
+#ifndef FILESOURCE_H
+#define FILESOURCE_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QIODevice>
+#include <QDir>
+
+/*! \class FileSource
+    \brief Read-only access to machine data, either on disk or inside a .zip archive of an SD card
+
+    Any path running through a .zip file, like "/home/me/card.zip/DATALOG/20160101_000000_BRP.edf",
+    is served straight out of the archive. Everything else goes to the file system as usual,
+    so loaders can keep building paths the way they always have.
+
+    Archive lookups ignore case, the same as the FAT formatted cards they were made from.
+    Each thread reading an archive borrows its own unzip handle, so import tasks inflate
+    entries in parallel rather than queueing on a single stream.
+    */
+class FileSource
+{
+  public:
+    //! \brief Returns true if path names a .zip file itself
+    static bool isArchive(const QString & path);
+
+    //! \brief Returns true if path is an archive, or something inside one
+    static bool inArchive(const QString & path);
+
+    //! \brief Returns true if path is an existing file or folder
+    static bool exists(const QString & path);
+
+    //! \brief Returns true if path is an existing folder (an archive counts as one)
+    static bool isDir(const QString & path);
+
+    //! \brief Returns the names of folders and/or files directly inside path, sorted by name
+    static QStringList entryList(const QString & path, QDir::Filters filters);
+
+    //! \brief Returns the uncompressed size of a file, or -1 if it doesn't exist
+    static qint64 size(const QString & path);
+
+    //! \brief Reads a whole file, or just the first maxlen bytes of it
+    static QByteArray read(const QString & path, qint64 maxlen = -1);
+
+    //! \brief Opens a file for reading. The caller owns the returned device, nullptr on failure
+    static QIODevice * open(const QString & path);
+
+    //! \brief Copies src to the file system at dst, like QFile::copy() won't overwrite
+    static bool copy(const QString & src, const QString & dst);
+
+    //! \brief Decompresses gzip data in memory, stopping after maxlen bytes if given
+    static QByteArray gunzip(const QByteArray & data, qint64 maxlen = -1);
+
+    //! \brief Forgets the index of the archive containing path, its handles close once the last reader is done
+    static void release(const QString & path);
+};
+
+#endif // FILESOURCE_H
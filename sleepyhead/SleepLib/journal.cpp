@@ -15,6 +15,7 @@
 #include <QTextStream>
 #include <QDir>
 #include <QMessageBox>
+#include <algorithm>
 
 const int journal_data_version = 1;
 
@@ -181,6 +182,7 @@ void JournalEntry::addBookmark(qint64 start, qint64 end, QString note)
 {
     bookmarks.append(Bookmark(start,end,note));
     session->SetChanged(true);
+    p_profile->journalIndex()->setBookmarks(m_date, bookmarks);
 }
 
 void JournalEntry::delBookmark(qint64 start, qint64 end)
@@ -199,6 +201,7 @@ void JournalEntry::delBookmark(qint64 start, qint64 end)
             }
         }
     } while (removed); // clean up any stupid duplicates just in case.. :P
+    p_profile->journalIndex()->setBookmarks(m_date, bookmarks);
     // if I wanted to be nice above, I could add the note string to the search as well..
     // (some users might be suprised to see the lot go with the same start and end index)
 }
@@ -279,6 +282,200 @@ void BackupJournal(QString filename)
     file.close();
 }
 
+void JournalIndex::invalidate()
+{
+    m_entries.clear();
+    m_bookmark_words.clear();
+    m_built = false;
+}
+
+void JournalIndex::build()
+{
+    invalidate();
+    m_built = true;
+
+    // One pass over the journal, opening each summary once. Edits keep it current from here on
+    QMap<QDate, Day *>::iterator it_end = p_profile->daylist.end();
+    for (QMap<QDate, Day *>::iterator it = p_profile->daylist.begin(); it != it_end; ++it) {
+        Session *journal = it.value()->firstSession(MT_JOURNAL);
+
+        if (journal) {
+            journal->requireSummary();
+            update(it.key(), journal);
+        }
+    }
+}
+
+void JournalIndex::update(QDate date, Session *journal)
+{
+    if (!m_built) {
+        return;
+    }
+
+    QList<Bookmark> list;
+
+    if (journal && journal->settings.contains(Bookmark_Start)) {
+        QVariantList start = journal->settings[Bookmark_Start].toList();
+        QVariantList end = journal->settings[Bookmark_End].toList();
+        QStringList text = journal->settings[Bookmark_Notes].toStringList();
+
+        int size = qMin(start.size(), qMin(end.size(), text.size()));
+        for (int i = 0; i < size; ++i) {
+            list.append(Bookmark(start.at(i).toLongLong(), end.at(i).toLongLong(), text.at(i)));
+        }
+    }
+
+    setBookmarks(date, list);
+}
+
+void JournalIndex::setBookmarks(QDate date, const QList<Bookmark> &bookmarks)
+{
+    if (!m_built) {
+        return;
+    }
+
+    Entry entry = m_entries.value(date);
+    indexEntry(date, entry, false);
+    entry.bookmarks = bookmarks;
+    indexEntry(date, entry, true);
+}
+
+void JournalIndex::indexEntry(QDate date, const Entry &entry, bool add)
+{
+    QStringList words;
+
+    for (int i = 0; i < entry.bookmarks.size(); ++i) {
+        words = tokenize(entry.bookmarks.at(i).notes);
+
+        for (int j = 0; j < words.size(); ++j) {
+            if (add) {
+                m_bookmark_words[words.at(j)].insert(date);
+            } else {
+                QHash<QString, QSet<QDate> >::iterator it = m_bookmark_words.find(words.at(j));
+                if (it != m_bookmark_words.end()) {
+                    it.value().remove(date);
+                    if (it.value().isEmpty()) { m_bookmark_words.erase(it); }
+                }
+            }
+        }
+    }
+
+    if (!add) {
+        m_entries.remove(date);
+    } else if (!entry.bookmarks.isEmpty()) {
+        m_entries[date] = entry;
+    }
+}
+
+QStringList JournalIndex::tokenize(const QString &text)
+{
+    QStringList words;
+    QString word;
+
+    int size = text.size();
+    for (int i = 0; i <= size; ++i) {
+        QChar c = (i < size) ? text.at(i) : QChar(' ');
+
+        if (c.isLetterOrNumber()) {
+            word += c.toLower();
+        } else if (!word.isEmpty()) {
+            words.append(word);
+            word.clear();
+        }
+    }
+
+    words.removeDuplicates();
+    return words;
+}
+
+QSet<QDate> JournalIndex::candidates(const QHash<QString, QSet<QDate> > &words, const QString &text) const
+{
+    QStringList terms = tokenize(text);
+    QSet<QDate> result;
+
+    if (terms.isEmpty()) {
+        // Nothing to look up, so every indexed day is a candidate
+        QMap<QDate, Entry>::const_iterator it_end = m_entries.end();
+        for (QMap<QDate, Entry>::const_iterator it = m_entries.begin(); it != it_end; ++it) {
+            result.insert(it.key());
+        }
+        return result;
+    }
+
+    // A term may sit anywhere inside a word of the original text, so scan the vocabulary rather than the days
+    for (int i = 0; i < terms.size(); ++i) {
+        const QString &term = terms.at(i);
+        QSet<QDate> found;
+
+        QHash<QString, QSet<QDate> >::const_iterator it_end = words.end();
+        for (QHash<QString, QSet<QDate> >::const_iterator it = words.begin(); it != it_end; ++it) {
+            if (it.key().contains(term)) {
+                found.unite(it.value());
+            }
+        }
+
+        if (i == 0) {
+            result = found;
+        } else {
+            result.intersect(found);
+        }
+
+        if (result.isEmpty()) {
+            break;
+        }
+    }
+    return result;
+}
+
+bool JournalIndex::bookmarkMatches(const Entry &entry, const QString &text)
+{
+    for (int i = 0; i < entry.bookmarks.size(); ++i) {
+        if (entry.bookmarks.at(i).notes.contains(text, Qt::CaseInsensitive)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+QList<QDate> JournalIndex::bookmarkDays(const QString &filter)
+{
+    if (!m_built) {
+        build();
+    }
+
+    QList<QDate> days;
+
+    if (filter.isEmpty()) {
+        QMap<QDate, Entry>::iterator it = m_entries.end();
+        while (it != m_entries.begin()) {
+            --it;
+            if (!it.value().bookmarks.isEmpty()) {
+                days.append(it.key());
+            }
+        }
+        return days;
+    }
+
+    QList<QDate> found = candidates(m_bookmark_words, filter).toList();
+    std::sort(found.begin(), found.end());
+
+    for (int i = found.size() - 1; i >= 0; --i) {
+        if (bookmarkMatches(m_entries.value(found.at(i)), filter)) {
+            days.append(found.at(i));
+        }
+    }
+    return days;
+}
+
+QList<Bookmark> JournalIndex::bookmarks(QDate date)
+{
+    if (!m_built) {
+        build();
+    }
+
+    return m_entries.value(date).bookmarks;
+}
+
 DayController::DayController()
 {
     journal = nullptr;
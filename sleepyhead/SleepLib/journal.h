@@ -10,6 +10,8 @@
 #ifndef JOURNAL_H
 #define JOURNAL_H
 
+#include <QSet>
+
 #include "SleepLib/profiles.h"
 
 void BackupJournal(QString filename);
@@ -62,6 +64,51 @@ protected:
 
 void BackupJournal(QString filename);
 
+/*! \class JournalIndex
+    \brief In-memory index of every journal day's bookmarks, so filtering them doesn't open each day
+
+    Holds a date sorted table of bookmarks plus a word index over their notes.
+    Built from the journal sessions on first use, then kept current by whoever edits a day's journal.
+    */
+class JournalIndex
+{
+  public:
+    JournalIndex() : m_built(false) {}
+
+    //! \brief Throw everything away, it gets rebuilt from the journal sessions when next used
+    void invalidate();
+
+    //! \brief Reindex a day from its journal session's settings, or drop it if journal is nullptr
+    void update(QDate date, Session *journal);
+
+    //! \brief Replace a day's bookmarks
+    void setBookmarks(QDate date, const QList<Bookmark> &bookmarks);
+
+    //! \brief Days with a bookmark note containing filter (case insensitive, all if empty), newest first
+    QList<QDate> bookmarkDays(const QString &filter);
+
+    //! \brief Returns the bookmarks indexed for date
+    QList<Bookmark> bookmarks(QDate date);
+
+  protected:
+    struct Entry {
+        QList<Bookmark> bookmarks;
+    };
+
+    void build();
+    void indexEntry(QDate date, const Entry &entry, bool add);
+
+    //! \brief Candidate days for text: those with words containing every word of text. Exact matches still need checking
+    QSet<QDate> candidates(const QHash<QString, QSet<QDate> > &words, const QString &text) const;
+
+    static QStringList tokenize(const QString &text);
+    static bool bookmarkMatches(const Entry &entry, const QString &text);
+
+    bool m_built;
+    QMap<QDate, Entry> m_entries;
+    QHash<QString, QSet<QDate> > m_bookmark_words;
+};
+
 
 class DayController
 {
@@ -29,6 +29,7 @@
 using namespace std;
 
 #include "cms50_loader.h"
+#include "SleepLib/trace.h"
 #include "SleepLib/machine.h"
 #include "SleepLib/session.h"
 
@@ -45,6 +46,7 @@ CMS50Loader::CMS50Loader()
     cms50dplus = false;
 
     oxirec = nullptr;
+    m_framelen = 0;
 
     startTimer.setParent(this);
     resetTimer.setParent(this);
@@ -67,6 +69,8 @@ bool CMS50Loader::Detect(const QString &path)
 
 int CMS50Loader::Open(QString path)
 {
+    TRACE_SCOPE(Trace::CAT_Loader, "CMS50Loader::Open");
+
     // Only one active Oximeter module at a time, set in preferences
 
     m_itemCnt = 0;
@@ -119,6 +123,10 @@ int CMS50Loader::Open(QString path)
         oxisessions[m_startTime] = oxirec;
 
         setStatus(LIVE);
+
+        // Nothing more gets written to the device, so reading can move off the GUI thread
+        m_framelen = 0;
+        startReader();
         return 1;
     }
     QString ext = path.section(".",1);
@@ -411,6 +419,35 @@ int CMS50Loader::doLiveMode()
     return idx;
 }
 
+void CMS50Loader::processLiveBytes(const quint8 *bytes, int size)
+{
+    Q_ASSERT(oxirec != nullptr);
+
+    for (int i = 0; i < size; ++i) {
+        quint8 c = bytes[i];
+
+        if (c & 0x80) {
+            // Sync bit marks the start of a frame
+            m_framelen = 0;
+        } else if (m_framelen == 0) {
+            continue; // out of sequence, wait for the next sync byte
+        }
+
+        m_frame[m_framelen++] = c;
+
+        if (m_framelen == 5) {
+            quint8 pbeat = m_frame[2];
+            int pulse = (m_frame[3] & 0x7f) | ((pbeat & 0x40) << 1);
+            int spo2 = m_frame[4] & 0x7f;
+
+            oxirec->append(OxiRecord(pulse, spo2));
+            m_plethy.append(char(m_frame[1]));
+
+            m_framelen = 0;
+        }
+    }
+}
+
 void CMS50Loader::resetDevice() // Switch CMS50D+ device to live streaming mode
 {
     //qDebug() << "Sending reset code to CMS50 device";
@@ -56,6 +56,7 @@ protected:
 
     bool readSpoRFile(QString path);
     virtual void processBytes(QByteArray bytes);
+    virtual void processLiveBytes(const quint8 *bytes, int size);
 
     int doImportMode();
     int doLiveMode();
@@ -76,6 +77,10 @@ protected:
 
     QByteArray buffer;
 
+    //! \brief Live mode frame being assembled, carried across reads
+    quint8 m_frame[5];
+    int m_framelen;
+
     bool started_import;
     bool finished_import;
     bool started_reading;
@@ -30,6 +30,8 @@
 using namespace std;
 
 #include "cms50f37_loader.h"
+#include "SleepLib/trace.h"
+#include "logger.h"
 #include "SleepLib/machine.h"
 #include "SleepLib/session.h"
 
@@ -114,6 +116,8 @@ bool CMS50F37Loader::Detect(const QString &path)
 
 int CMS50F37Loader::Open(QString path)
 {
+    TRACE_SCOPE(Trace::CAT_Loader, "CMS50F37Loader::Open");
+
     // Only one active Oximeter module at a time, set in preferences
 
     m_itemCnt = 0;
@@ -356,7 +360,7 @@ void CMS50F37Loader::processBytes(QByteArray bytes)
                     if (res == resimport) break;
                 }
                 // add a dummy to make up for it.
-                qDebug() << "lost sync, padding...";
+                LOG_LIMITED(10, qDebug() << "lost sync, padding...");
                 oxirec->append(OxiRecord(0,0,0));
             }
             continue;
@@ -554,7 +558,8 @@ void CMS50F37Loader::processBytes(QByteArray bytes)
         imp_callbacks++;
     }
 
-    buffer = buffer.mid(idx);
+    // Drop the consumed bytes in place rather than copying the remainder into a new array
+    buffer.remove(0, idx);
 }
 
 
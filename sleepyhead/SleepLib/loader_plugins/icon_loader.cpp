@@ -14,6 +14,7 @@
 #include <cmath>
 
 #include "icon_loader.h"
+#include "SleepLib/trace.h"
 
 extern QProgressBar *qprogress;
 
@@ -75,6 +76,8 @@ bool FPIconLoader::Detect(const QString & givenpath)
 
 int FPIconLoader::Open(QString path)
 {
+    TRACE_SCOPE(Trace::CAT_Loader, "FPIconLoader::Open");
+
     QString newpath;
 
     path = path.replace("\\", "/");
@@ -427,6 +430,8 @@ hour=(ts >> 12) & 0x1f; */
 // 0x0200-0x0203 32bit timestamp in
 bool FPIconLoader::OpenFLW(Machine *mach, QString filename)
 {
+    TRACE_SCOPE(Trace::CAT_Loader, "FPIconLoader::OpenFLW");
+
     Q_UNUSED(mach);
 
     quint32 ts;
@@ -623,6 +628,8 @@ bool FPIconLoader::OpenFLW(Machine *mach, QString filename)
 ////////////////////////////////////////////////////////////////////////////////////////////
 bool FPIconLoader::OpenSummary(Machine *mach, QString filename)
 {
+    TRACE_SCOPE(Trace::CAT_Loader, "FPIconLoader::OpenSummary");
+
     qDebug() << filename;
     QByteArray header;
     QFile file(filename);
@@ -773,6 +780,8 @@ bool FPIconLoader::OpenSummary(Machine *mach, QString filename)
 
 bool FPIconLoader::OpenDetail(Machine *mach, QString filename)
 {
+    TRACE_SCOPE(Trace::CAT_Loader, "FPIconLoader::OpenDetail");
+
     Q_UNUSED(mach);
 
     qDebug() << filename;
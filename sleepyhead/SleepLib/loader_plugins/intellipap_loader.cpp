@@ -12,6 +12,8 @@
 #include <QProgressBar>
 
 #include "intellipap_loader.h"
+#include "SleepLib/trace.h"
+#include "SleepLib/textreader.h"
 
 extern QProgressBar *qprogress;
 
@@ -70,6 +72,8 @@ bool IntellipapLoader::Detect(const QString & givenpath)
 
 int IntellipapLoader::Open(QString path)
 {
+    TRACE_SCOPE(Trace::CAT_Loader, "IntellipapLoader::Open");
+
     // Check for SL directory
     // Check for DV5MFirm.bin?
     path = path.replace("\\", "/");
@@ -94,15 +98,12 @@ int IntellipapLoader::Open(QString path)
     // Parse the Settings File
     //////////////////////////
     filename = newpath + "/SET1";
-    QFile f(filename);
+    TextReader set1file;
 
-    if (!f.exists()) {
+    if (!set1file.open(filename)) {
         return -1;
     }
 
-    f.open(QFile::ReadOnly);
-    QTextStream tstream(&f);
-
     const QString INT_PROP_Serial = "Serial";
     const QString INT_PROP_Model = "Model";
     const QString INT_PROP_Mode = "Mode";
@@ -181,27 +182,26 @@ int IntellipapLoader::Open(QString path)
     EventDataType ramp_pressure = 0, set_epap = 0, ramp_time = 0;
 
     int papmode = 0, smartflex = 0, smartflexmode = 0;
-    while (1) {
-        QString line = tstream.readLine();
-
-        if ((line.length() <= 2) ||
-                (line.isNull())) { break; }
+    TextRef line;
+    while (set1file.readLine(line)) {
+        if (line.size() <= 2) { break; }
 
-        QString key = line.section("\t", 0, 0).trimmed();
+        int tab = line.indexOf('\t');
+        QString key = ((tab < 0) ? line : line.mid(0, tab)).trimmed().toString();
         hi = lookup.find(key);
 
         if (hi != lookup.end()) {
             key = hi.value();
         }
 
-        QString value = line.section("\t", 1).trimmed();
+        TextRef value = (tab < 0) ? TextRef() : line.mid(tab + 1).trimmed();
 
         if (key == INT_PROP_Mode) {
             papmode = value.toInt(&ok);
         } else if (key == INT_PROP_Serial) {
-            info.serial = value;
+            info.serial = value.toString();
         } else if (key == INT_PROP_Model) {
-            info.model = value;
+            info.model = value.toString();
         } else if (key == INT_PROP_MinPressure) {
             //min_pressure = value.toFloat() / 10.0;
         } else if (key == INT_PROP_MaxPressure) {
@@ -209,21 +209,21 @@ int IntellipapLoader::Open(QString path)
         } else if (key == INT_PROP_IPAP) {
             //set_ipap = value.toFloat() / 10.0;
         } else if (key == INT_PROP_EPAP) {
-            set_epap = value.toFloat() / 10.0;
+            set_epap = value.toDouble() / 10.0;
         } else if (key == INT_PROP_PS) {
             //set_ps = value.toFloat() / 10.0;
         } else if (key == INT_PROP_RampPressure) {
-            ramp_pressure = value.toFloat() / 10.0;
+            ramp_pressure = value.toDouble() / 10.0;
         } else if (key == INT_PROP_RampTime) {
-            ramp_time = value.toFloat() / 10.0;
+            ramp_time = value.toDouble() / 10.0;
         } else if (key == INT_PROP_SmartFlex) {
             smartflex = value.toInt();
         } else if (key == INT_PROP_SmartFlexMode) {
             smartflexmode = value.toInt();
         } else {
-            set1[key] = value;
+            set1[key] = value.toString();
         }
-        qDebug() << key << "=" << value;
+        qDebug() << key << "=" << value.toString();
     }
 
     CPAPMode mode = MODE_UNKNOWN;
@@ -261,16 +261,15 @@ int IntellipapLoader::Open(QString path)
         mach->properties[i.key()] = i.value();
     }
 
-    f.close();
+    set1file.close();
 
     ///////////////////////////////////////////////
     // Parse the Session Index (U File)
     ///////////////////////////////////////////////
-    unsigned char buf[27];
     filename = newpath + "/U";
-    f.setFileName(filename);
+    TextReader ufile;
 
-    if (!f.exists()) { return -1; }
+    if (!ufile.open(filename)) { return -1; }
 
     QVector<quint32> SessionStart;
     QVector<quint32> SessionEnd;
@@ -278,13 +277,17 @@ int IntellipapLoader::Open(QString path)
 
     quint32 ts1, ts2;//, length;
     //unsigned char cs;
-    f.open(QFile::ReadOnly);
-    int cnt = 0;
     QDateTime epoch(QDate(2002, 1, 1), QTime(0, 0, 0), Qt::UTC); // Intellipap Epoch
     int ep = epoch.toTime_t();
 
-    do {
-        cnt = f.read((char *)buf, 9);
+    // Nine byte records, read straight out of the mapped file
+    TextRef index = ufile.contents();
+    int records = index.size() / 9;
+    SessionStart.reserve(records);
+    SessionEnd.reserve(records);
+
+    for (int r = 0; r < records; ++r) {
+        const unsigned char *buf = (const unsigned char *)index.data() + r * 9;
         // big endian
         ts1 = (buf[0] << 24) | (buf[1] << 16) | (buf[2] << 8) | buf[3];
         ts2 = (buf[4] << 24) | (buf[5] << 16) | (buf[6] << 8) | buf[7];
@@ -293,16 +296,16 @@ int IntellipapLoader::Open(QString path)
         ts2 += ep;
         SessionStart.append(ts1);
         SessionEnd.append(ts2);
-    } while (cnt > 0);
+    }
 
     qDebug() << "U file logs" << SessionStart.size() << "sessions.";
-    f.close();
+    ufile.close();
 
     ///////////////////////////////////////////////
     // Parse the Session Data (L File)
     ///////////////////////////////////////////////
     filename = newpath + "/L";
-    f.setFileName(filename);
+    QFile f(filename);
 
     if (!f.exists()) { return -1; }
 
@@ -29,6 +29,7 @@
 using namespace std;
 
 #include "md300w1_loader.h"
+#include "SleepLib/trace.h"
 #include "SleepLib/machine.h"
 #include "SleepLib/session.h"
 
@@ -63,6 +64,8 @@ bool MD300W1Loader::Detect(const QString &path)
 
 int MD300W1Loader::Open(QString path)
 {
+    TRACE_SCOPE(Trace::CAT_Loader, "MD300W1Loader::Open");
+
     // Only one active Oximeter module at a time, set in preferences
 
     m_itemCnt = 0;
@@ -10,6 +10,7 @@
 #include <QProgressBar>
 
 #include "mseries_loader.h"
+#include "SleepLib/trace.h"
 extern QProgressBar *qprogress;
 
 
@@ -111,6 +112,8 @@ blockLayoutOffsets   {
 
 int MSeriesLoader::Open(QString path)
 {
+    TRACE_SCOPE(Trace::CAT_Loader, "MSeriesLoader::Open");
+
     // Until a smartcard reader is written, this is not an auto-scanner.. it just opens a block file..
 
     QFile file(path);
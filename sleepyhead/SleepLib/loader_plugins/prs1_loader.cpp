@@ -18,6 +18,8 @@
 #include <cmath>
 #include "SleepLib/schema.h"
 #include "prs1_loader.h"
+#include "SleepLib/trace.h"
+#include "logger.h"
 #include "SleepLib/session.h"
 #include "SleepLib/calcs.h"
 
@@ -169,44 +171,43 @@ QString PRS1Loader::checkDir(const QString & path)
         newpath = path + "/" + PR_STR_PSeries;
     }
 
-    QDir dir(newpath);
-
-    if ((!dir.exists() || !dir.isReadable())) {
+    // The card may be on disk or zipped up
+    if (!FileSource::isDir(newpath)) {
         return QString();
     }
     qDebug() << "PRS1Loader::Detect path=" << newpath;
 
-    QFile lastfile(newpath+"/last.txt");
+    QString lastfile = newpath+"/last.txt";
 
     bool exists = true;
-    if (!lastfile.exists()) {
-        lastfile.setFileName(newpath+"/LAST.TXT");
-        if (!lastfile.exists())
+    if (!FileSource::exists(lastfile)) {
+        lastfile = newpath+"/LAST.TXT";
+        if (!FileSource::exists(lastfile))
             exists = false;
     }
 
     QString machpath;
     if (exists) {
-        if (!lastfile.open(QIODevice::ReadOnly)) {
+        QIODevice * f = FileSource::open(lastfile);
+        if (!f) {
             qDebug() << "PRS1Loader: last.txt exists but I couldn't open it!";
         } else {
-            QTextStream ts(&lastfile);
+            QTextStream ts(f);
             QString serial = ts.readLine(64).trimmed();
-            lastfile.close();
+            delete f;
 
             machpath = newpath+"/"+serial;
 
-            if (!QDir(machpath).exists()) {
+            if (!FileSource::isDir(machpath)) {
                 machpath = QString();
             }
         }
     }
 
     if (machpath.isEmpty()) {
-        QDir dir(newpath);
-        QStringList dirs = dir.entryList(QDir::NoDotAndDotDot | QDir::Dirs);
+        QStringList dirs = FileSource::entryList(newpath, QDir::NoDotAndDotDot | QDir::Dirs);
         if (dirs.size() > 0) {
-            machpath = dir.cleanPath(newpath+"/"+dirs[0]);
+            machpath = QDir::cleanPath(newpath+"/"+dirs[0]);
 
         }
     }
@@ -292,11 +293,11 @@ void parseModel(MachineInfo & info, QString modelnum)
 
 bool PRS1Loader::PeekProperties(MachineInfo & info, QString filename, Machine * mach)
 {
-    QFile f(filename);
-    if (!f.open(QFile::ReadOnly)) {
+    QIODevice * f = FileSource::open(filename);
+    if (!f) {
         return false;
     }
-    QTextStream in(&f);
+    QTextStream in(f);
     QString modelnum;
     int ptype=0;
     int dfv=0;
@@ -329,6 +330,8 @@ bool PRS1Loader::PeekProperties(MachineInfo & info, QString filename, Machine *
 
     } while (!in.atEnd());
 
+    delete f;
+
     if (!modelnum.isEmpty()) {
         parseModel(info, modelnum);
     }
@@ -366,6 +369,8 @@ MachineInfo PRS1Loader::PeekInfo(const QString & path)
 
 int PRS1Loader::Open(QString path)
 {
+    TRACE_SCOPE(Trace::CAT_Loader, "PRS1Loader::Open");
+
     QString newpath;
     path = path.replace("\\", "/");
 
@@ -377,42 +382,32 @@ int PRS1Loader::Open(QString path)
 
     qDebug() << "PRS1Loader::Open path=" << newpath;
 
-    QDir dir(newpath);
-
-    if ((!dir.exists() || !dir.isReadable())) {
+    if (!FileSource::isDir(newpath)) {
         return -1;
     }
 
-    dir.setFilter(QDir::NoDotAndDotDot | QDir::Dirs | QDir::Files | QDir::Hidden | QDir::NoSymLinks);
-    dir.setSorting(QDir::Name);
-    QFileInfoList flist = dir.entryInfoList();
+    QStringList flist = FileSource::entryList(newpath, QDir::NoDotAndDotDot | QDir::Dirs | QDir::Files | QDir::Hidden | QDir::NoSymLinks);
 
     QStringList SerialNumbers;
     QStringList::iterator sn;
 
     for (int i = 0; i < flist.size(); i++) {
-        QFileInfo fi = flist.at(i);
-        QString filename = fi.fileName();
+        QString filename = flist.at(i);
+        QString file = newpath + "/" + filename;
 
-        if (fi.isDir() && (filename.size() > 4) && (isdigit(filename[1])) && (isdigit(filename[2]))) {
+        if (FileSource::isDir(file) && (filename.size() > 4) && (isdigit(filename[1])) && (isdigit(filename[2]))) {
             SerialNumbers.push_back(filename);
         } else if (filename.toLower() == "last.txt") { // last.txt points to the current serial number
-            QString file = fi.canonicalFilePath();
-            QFile f(file);
+            QIODevice * f = FileSource::open(file);
 
-            if (!fi.isReadable()) {
-                qDebug() << "PRS1Loader: last.txt exists but I couldn't read it!";
-                continue;
-            }
-
-            if (!f.open(QIODevice::ReadOnly)) {
+            if (!f) {
                 qDebug() << "PRS1Loader: last.txt exists but I couldn't open it!";
                 continue;
             }
 
-            last = f.readLine(64);
+            last = f->readLine(64);
             last = last.trimmed();
-            f.close();
+            delete f;
         }
     }
 
@@ -495,18 +490,17 @@ int PRS1Loader::Open(QString path)
 
 int PRS1Loader::OpenMachine(QString path)
 {
+    TRACE_SCOPE(Trace::CAT_Loader, "PRS1Loader::OpenMachine");
+
     Q_ASSERT(p_profile != nullptr);
 
     qDebug() << "Opening PRS1 " << path;
-    QDir dir(path);
-
-    if (!dir.exists() || (!dir.isReadable())) {
+    if (!FileSource::isDir(path)) {
         return 0;
     }
 
-    dir.setFilter(QDir::NoDotAndDotDot | QDir::Dirs | QDir::Files | QDir::Hidden | QDir::NoSymLinks);
-    dir.setSorting(QDir::Name);
-    QFileInfoList flist = dir.entryInfoList();
+    const QDir::Filters filters = QDir::NoDotAndDotDot | QDir::Dirs | QDir::Files | QDir::Hidden | QDir::NoSymLinks;
+    QStringList flist = FileSource::entryList(path, filters);
 
     QString filename;
 
@@ -519,22 +513,22 @@ int PRS1Loader::OpenMachine(QString path)
     QString propertyfile;
 
     for (int i = 0; i < flist.size(); i++) {
-        QFileInfo fi = flist.at(i);
-        filename = fi.fileName();
+        filename = flist.at(i);
+        QString fullname = path + "/" + filename;
 
-        if (fi.isDir()) {
+        if (FileSource::isDir(fullname)) {
             if ((filename[0].toLower() == 'p') && (isdigit(filename[1]))) {
                 // p0, p1, p2.. etc.. folders contain the session data
-                paths.push_back(fi.canonicalFilePath());
+                paths.push_back(fullname);
             } else if (filename.toLower() == "e") {
                 // Error files..
                 // Reminder: I have been given some info about these. should check it over.
             }
         } else if (filename.compare("properties.txt",Qt::CaseInsensitive) == 0) {
-            propertyfile = fi.canonicalFilePath();
+            propertyfile = fullname;
         } else if (filename.compare("PROP.TXT",Qt::CaseInsensitive) == 0) {
             sessionid_base = 16;
-            propertyfile = fi.canonicalFilePath();
+            propertyfile = fullname;
         }
     }
 
@@ -618,24 +612,22 @@ int PRS1Loader::OpenMachine(QString path)
 
     // for each p0/p1/p2/etc... folder
     for (int p=0; p < size; ++p) {
-        dir.setPath(paths.at(p));
-
-        if (!dir.exists() || !dir.isReadable()) { continue; }
+        if (!FileSource::isDir(paths.at(p))) { continue; }
 
-        flist = dir.entryInfoList();
+        flist = FileSource::entryList(paths.at(p), filters);
 
         // Scan for individual session files
         for (int i = 0; i < flist.size(); i++) {
-            QFileInfo fi = flist.at(i);
+            QString fullname = paths.at(p) + "/" + flist.at(i);
 
-            QString ext_s = fi.fileName().section(".", -1);
+            QString ext_s = flist.at(i).section(".", -1);
             ext = ext_s.toInt(&ok);
             if (!ok) {
                 // not a numerical extension
                 continue;
             }
 
-            QString session_s = fi.fileName().section(".", 0, -2);
+            QString session_s = flist.at(i).section(".", 0, -2);
             sid = session_s.toInt(&ok, sessionid_base);
             if (!ok) {
                 // not a numerical session ID
@@ -663,17 +655,17 @@ int PRS1Loader::OpenMachine(QString path)
 
                 if (ext == 5) {
                     if (!task->wavefile.isEmpty()) continue;
-                    task->wavefile = fi.canonicalFilePath();
+                    task->wavefile = fullname;
                 } else if (ext == 6) {
                     if (!task->oxifile.isEmpty()) continue;
-                    task->oxifile = fi.canonicalFilePath();
+                    task->oxifile = fullname;
                 }
 
                 continue;
             }
 
             // Parse the data chunks and read the files..
-            QList<PRS1DataChunk *> Chunks = ParseFile(fi.canonicalFilePath());
+            QList<PRS1DataChunk *> Chunks = ParseFile(fullname);
 
             for (int i=0; i < Chunks.size(); ++i) {
                 PRS1DataChunk * chunk = Chunks.at(i);
@@ -800,6 +792,16 @@ bool PRS1Import::ParseF5Events()
     int size = event->m_data.size();
     unsigned char * buffer = (unsigned char *)event->m_data.data();
 
+    // Every 0x0d graph record is at least 13 bytes, which bounds how many samples this chunk can add
+    quint32 graphcnt = size / 13;
+    EventList *graphs[] = { IPAP, IPAPLo, IPAPHi, TOTLEAK, RR, PTB, MV, TV, SNORE, EPAP, PS };
+    for (unsigned i = 0; i < sizeof(graphs) / sizeof(EventList *); ++i) {
+        graphs[i]->reserve(graphcnt);
+    }
+    if (calcLeaks) {
+        LEAK->reserve(graphcnt);
+    }
+
     while (pos < size) {
         lastcode3 = lastcode2;
         lastcode2 = lastcode;
@@ -898,7 +900,7 @@ bool PRS1Import::ParseF5Events()
         case 0x08: // ???
             data0 = buffer[pos++];
             tt -= qint64(data0) * 1000L; // Subtract Time Offset
-            qDebug() << "Code 8 found at " << hex << pos - 1 << " " << tt;
+            LOG_LIMITED(10, qDebug() << "Code 8 found at " << hex << pos - 1 << " " << tt);
 
             if (!Code[10]) {
                 if (!(Code[10] = session->AddEventList(cpapcode, EVL_Event))) { return false; }
@@ -953,7 +955,7 @@ bool PRS1Import::ParseF5Events()
         case 0x0c:
             data0 = buffer[pos++];
             tt -= qint64(data0) * 1000L; // Subtract Time Offset
-            qDebug() << "Code 12 found at " << hex << pos - 1 << " " << tt;
+            LOG_LIMITED(10, qDebug() << "Code 12 found at " << hex << pos - 1 << " " << tt);
 
             if (!Code[8]) {
                 if (!(Code[8] = session->AddEventList(cpapcode, EVL_Event))) { return false; }
@@ -1120,6 +1122,12 @@ bool PRS1Import::ParseF3Events()
     int size = event->m_data.size()/0x10;
     unsigned char * h = (unsigned char *)event->m_data.data();
 
+    // One sample per 0x10 byte record
+    EventList *graphs[] = { IPAP, EPAP, LEAK, TV, FLOW, PTB, RR, MV, ULK };
+    for (unsigned i = 0; i < sizeof(graphs) / sizeof(EventList *); ++i) {
+        graphs[i]->reserve(size);
+    }
+
     int hy, oa, ca;
     qint64 div = 0;
 
@@ -1297,6 +1305,14 @@ bool PRS1Import::ParseF0Events()
 
     CPAPMode mode = (CPAPMode) session->settings[CPAP_Mode].toInt();
 
+    // Every 0x11 leak & snore record is at least 5 bytes, which bounds how many samples this chunk can add
+    quint32 graphcnt = size / 5;
+    TOTLEAK->reserve(graphcnt);
+    SNORE->reserve(graphcnt);
+    if (calcLeaks) {
+        LEAK->reserve(graphcnt);
+    }
+
     for (pos = 0; pos < size;) {
         lastcode3 = lastcode2;
         lastcode2 = lastcode;
@@ -2268,6 +2284,7 @@ bool PRS1Import::ParseSummaryF0V6()
 
 bool PRS1Import::ParseSummary()
 {
+    TRACE_SCOPE(Trace::CAT_Loader, "PRS1Import::ParseSummary");
 
     // Family 0 = XPAP
     // Family 3 = BIPAP AVAPS
@@ -2353,6 +2370,8 @@ bool PRS1Import::ParseSummary()
 
 bool PRS1Import::ParseEvents()
 {
+    TRACE_SCOPE(Trace::CAT_Loader, "PRS1Import::ParseEvents");
+
     bool res = false;
     if (!event) return false;
     switch (event->family) {
@@ -2420,6 +2439,8 @@ bool PRS1Import::ParseEvents()
 
 bool PRS1Import::ParseOximetery()
 {
+    TRACE_SCOPE(Trace::CAT_Loader, "PRS1Import::ParseOximetery");
+
     int size = oximetery.size();
 
     for (int i=0; i < size; ++i) {
@@ -2464,6 +2485,8 @@ bool PRS1Import::ParseOximetery()
 
 bool PRS1Import::ParseWaveforms()
 {
+    TRACE_SCOPE(Trace::CAT_Loader, "PRS1Import::ParseWaveforms");
+
     int size = waveforms.size();
     quint64 s1, s2;
 
@@ -2491,30 +2514,28 @@ bool PRS1Import::ParseWaveforms()
         }
 
         if (num > 1) {
-            // Process interleaved samples
-            QVector<QByteArray> data;
-            data.resize(num);
+            // Process interleaved samples. Each block holds interleave samples of every signal in turn,
+            // so pick flow & pressure straight out of the chunk rather than splitting it up first
+            int stride = 0;
+            for (int n=0; n < num; n++) {
+                stride += waveform->waveformInfo.at(n).interleave;
+            }
 
-            int pos = 0;
-            do {
-                for (int n=0; n < num; n++) {
-                    int interleave = waveform->waveformInfo.at(n).interleave;
-                    data[n].append(waveform->m_data.mid(pos, interleave));
-                    pos += interleave;
-                }
-            } while (pos < size);
+            int il1 = waveform->waveformInfo.at(0).interleave;
+            int il2 = waveform->waveformInfo.at(1).interleave;
+            const char * raw = waveform->m_data.constData();
 
-            s1 = data[0].size();
-            s2 = data[1].size();
+            s1 = EventList::interleavedCount(size, 0, il1, stride);
+            s2 = EventList::interleavedCount(size, il1, il2, stride);
 
             if (s1 > 0) {
                 EventList * flow = session->AddEventList(CPAP_FlowRate, EVL_Waveform, 1.0, 0.0, 0.0, 0.0, double(dur) / double(s1));
-                flow->AddWaveform(ti, (char *)data[0].data(), data[0].size(), dur);
+                flow->AddWaveform(ti, raw, s1, dur, il1, stride);
             }
 
             if (s2 > 0) {
                 EventList * pres = session->AddEventList(CPAP_MaskPressureHi, EVL_Waveform, 0.1, 0.0, 0.0, 0.0, double(dur) / double(s2));
-                pres->AddWaveform(ti, (unsigned char *)data[1].data(), data[1].size(), dur);
+                pres->AddWaveform(ti, (const unsigned char *)raw + il1, s2, dur, il2, stride);
             }
 
         } else {
@@ -2530,6 +2551,8 @@ bool PRS1Import::ParseWaveforms()
 
 void PRS1Import::run()
 {
+    TRACE_SCOPE(Trace::CAT_Loader, "PRS1Import::run");
+
     if (mach->unsupported())
         return;
     session = new Session(mach, sessionid);
@@ -2574,27 +2597,31 @@ void PRS1Import::run()
 
 QList<PRS1DataChunk *> PRS1Loader::ParseFile(QString path)
 {
+    TRACE_SCOPE(Trace::CAT_Loader, "PRS1Loader::ParseFile");
+
     QList<PRS1DataChunk *> CHUNKS;
 
     if (path.isEmpty())
         return CHUNKS;
 
-    QFile f(path);
-
-    if (!f.exists()) {
+    if (!FileSource::exists(path)) {
         return CHUNKS;
     }
 
-    if (!f.open(QIODevice::ReadOnly)) {
-        return CHUNKS;
-    }
+    // Pull the whole file into memory in one go, it may be coming straight out of a zipped card.
+    // Headers are then parsed where they sit, only the data blocks get copied out.
+    const QByteArray file = FileSource::read(path);
+    const unsigned char * base = (const unsigned char *)file.constData();
+    const int filesize = file.size();
+    int pos = 0;
 
     PRS1DataChunk *chunk = nullptr, *lastchunk = nullptr;
 
     quint16 blocksize;
     quint16 wvfm_signals;
 
-    unsigned char * header;
+    const unsigned char * header;
+    int headersize;
     int cnt = 0;
 
     //int lastheadersize = 0;
@@ -2605,11 +2632,11 @@ QList<PRS1DataChunk *> PRS1Loader::ParseFile(QString path)
 
 
     do {
-        QByteArray headerBA = f.read(16);
-        if (headerBA.size() != 16) {
+        if (filesize - pos < 16) {
             break;
         }
-        header = (unsigned char *)headerBA.data();
+        header = base + pos;
+        headersize = 16;
 
         blocksize = (header[2] << 8) | header[1];
         if (blocksize == 0) break;
@@ -2634,9 +2661,12 @@ QList<PRS1DataChunk *> PRS1Loader::ParseFile(QString path)
                 && (lastchunk->family != chunk->family)
                 && (lastchunk->familyVersion != chunk->familyVersion)
                 && (lastchunk->htype != chunk->htype)) {
-                QByteArray junk = f.read(lastblocksize - 16);
+                // Skip over the junk
+                pos += 16;
+                if (lastblocksize > 16) {
+                    pos = qMin(pos + lastblocksize - 16, filesize);
+                }
 
-                Q_UNUSED(junk)
                 if (lastchunk->ext == 5) {
                     // The data is random crap
 //                    lastchunk->m_data.append(junk.mid(lastheadersize-16));
@@ -2657,14 +2687,12 @@ QList<PRS1DataChunk *> PRS1Loader::ParseFile(QString path)
         // Family 3 (1060P)
         //////////////////////////////////////////////////////////
         if ((chunk->family == 3) && (chunk->ext == 2)) {
-            QByteArray extra = f.read(47);
-            if (extra.size() != 47) {
+            if (filesize - pos < headersize + 47) {
                 delete chunk;
                 break;
             }
-            headerBA.append(extra);
-            header = (unsigned char *)headerBA.data();
-            chunk->m_headerblock = headerBA.right(48);
+            headersize += 47;
+            chunk->m_headerblock = QByteArray((const char *)header + headersize - 48, 48);
 
         }
 
@@ -2674,14 +2702,11 @@ QList<PRS1DataChunk *> PRS1Loader::ParseFile(QString path)
         //////////////////////////////////////////////////////////
         if ((chunk->ext == 5) || (chunk->ext == 6)) {
             // Get extra 8 bytes in waveform header.
-            QByteArray extra = f.read(4);
-            if (extra.size() != 4) {
+            if (filesize - pos < headersize + 4) {
                 delete chunk;
                 break;
             }
-            headerBA.append(extra);
-            // Get the header address again to be safe
-            header = (unsigned char *)headerBA.data();
+            headersize += 4;
 
             chunk->duration = header[0x0f] | header[0x10] << 8;
 
@@ -2690,28 +2715,26 @@ QList<PRS1DataChunk *> PRS1Loader::ParseFile(QString path)
             int ws_size = (chunk->fileVersion == 3) ? 4 : 3;
 
             int sbsize = wvfm_signals * ws_size + 1;
-            QByteArray sbextra = f.read(sbsize);
-            if (sbextra.size() != sbsize) {
+            if (filesize - pos < headersize + sbsize) {
                 delete chunk;
                 break;
             }
-            headerBA.append(sbextra);
-            header = (unsigned char *)headerBA.data();
+            headersize += sbsize;
 
             // Read the waveform information in reverse.
-            int pos = 0x14 + (wvfm_signals - 1) * ws_size;
+            int hpos = 0x14 + (wvfm_signals - 1) * ws_size;
             for (int i = 0; i < wvfm_signals; ++i) {
-                quint16 interleave = header[pos] | header[pos + 1] << 8; // samples per block (Usually 05 00)
+                quint16 interleave = header[hpos] | header[hpos + 1] << 8; // samples per block (Usually 05 00)
 
                 if (chunk->fileVersion == 2) {
-                    quint8 sample_format = header[pos + 2];
+                    quint8 sample_format = header[hpos + 2];
                     chunk->waveformInfo.push_back(PRS1Waveform(interleave, sample_format));
-                    pos -= 3;
+                    hpos -= 3;
                 } else if (chunk->fileVersion == 3) {
-                    //quint16 sample_size = header[pos + 2] | header[pos + 3] << 8; // size in bits?? (08 00)
+                    //quint16 sample_size = header[hpos + 2] | header[hpos + 3] << 8; // size in bits?? (08 00)
                     // Possibly this is size in bits, and sign bit for the other byte?
                     chunk->waveformInfo.push_back(PRS1Waveform(interleave, 0));
-                    pos -= 4;
+                    hpos -= 4;
                 }
             }
             if (lastchunk != nullptr) {
@@ -2720,7 +2743,7 @@ QList<PRS1DataChunk *> PRS1Loader::ParseFile(QString path)
             }
         }
 
-        int headersize = headerBA.size();
+        pos += headersize;
 
         lastblocksize = blocksize;
         blocksize -= headersize;
@@ -2750,13 +2773,12 @@ QList<PRS1DataChunk *> PRS1Loader::ParseFile(QString path)
             blocksize -= h2len;
 
             // Read the extra data block
-            chunk->m_headerblock = f.read(h2len);
-
-            if (chunk->m_headerblock.size() < h2len) {
+            if ((h2len <= 0) || (filesize - pos < h2len)) {
                 delete chunk;
                 return CHUNKS;
             }
-            unsigned char * header2 = (unsigned char*) chunk->m_headerblock.data();
+            const unsigned char * header2 = base + pos;
+            pos += h2len;
 
             // Checksum the whole header
             for (int i=0; i < h2len-1; ++i) csum += header2[i];
@@ -2766,6 +2788,7 @@ QList<PRS1DataChunk *> PRS1Loader::ParseFile(QString path)
                 delete chunk;
                 return CHUNKS;
             }
+            chunk->m_headerblock = QByteArray((const char *)header2, h2len);
 
         } else {
             // uhhhh.. should not of got this far. because this is an unknown or corrupt file format.
@@ -2774,26 +2797,25 @@ QList<PRS1DataChunk *> PRS1Loader::ParseFile(QString path)
         }
 
 
-        // Read data block
-        chunk->m_data = f.read(blocksize);
-
-        if (chunk->m_data.size() < blocksize) {
+        // Data block
+        if (filesize - pos < blocksize) {
             delete chunk;
             break;
         }
+        const char * data = (const char *)base + pos;
+        pos += blocksize;
 
+        int datasize;
         if (chunk->fileVersion==3) {
-            //int ds = chunk->m_data.size();
-            //quint32 crc16 = chunk->m_data.at(ds-2) | chunk->m_data.at(ds-1) << 8;
-            chunk->m_data.chop(4);
+            //quint32 crc16 = data[blocksize-2] | data[blocksize-1] << 8;
+            datasize = qMax(int(blocksize) - 4, 0);
         } else {
             // last two bytes contain crc16 checksum.
-            int ds = chunk->m_data.size();
-            quint16 crc16 = chunk->m_data.at(ds-2) | chunk->m_data.at(ds-1) << 8;
-            chunk->m_data.chop(2);
+            datasize = qMax(int(blocksize) - 2, 0);
 #ifdef PRS1_CRC_CHECK
             // This fails.. it needs to include the header!
-            quint16 calc16 = CRC16((unsigned char *)chunk->m_data.data(), chunk->m_data.size());
+            quint16 crc16 = quint8(data[blocksize-2]) | quint8(data[blocksize-1]) << 8;
+            quint16 calc16 = CRC16((unsigned char *)data, datasize);
             if (calc16 != crc16) {
                 // corrupt data block.. bleh..
             //   qDebug() << "CRC16 doesn't match for chunk" << chunk->sessionid << "for" << path;
@@ -2808,8 +2830,8 @@ QList<PRS1DataChunk *> PRS1Loader::ParseFile(QString path)
                 Q_ASSERT(lastchunk->sessionid == chunk->sessionid);
 
                 if (diff == 0) {
-                    // In sync, so append waveform data to previous chunk
-                    lastchunk->m_data.append(chunk->m_data);
+                    // In sync, so append waveform data straight onto the previous chunk
+                    lastchunk->m_data.append(data, datasize);
                     lastchunk->duration += chunk->duration;
                     delete chunk;
                     cnt++;
@@ -2820,11 +2842,13 @@ QList<PRS1DataChunk *> PRS1Loader::ParseFile(QString path)
             }
         }
 
+        chunk->m_data = QByteArray(data, datasize);
+
         CHUNKS.append(chunk);
 
         lastchunk = chunk;
         cnt++;
-    } while (!f.atEnd());
+    } while (pos < filesize);
     return CHUNKS;
 }
 
@@ -19,8 +19,10 @@
 #include <cmath>
 
 #include "resmed_loader.h"
+#include "SleepLib/trace.h"
 #include "SleepLib/session.h"
 #include "SleepLib/calcs.h"
+#include "SleepLib/textreader.h"
 
 #ifdef DEBUG_EFFICIENCY
 #include <QElapsedTimer>  // only available in 4.8
@@ -131,8 +133,6 @@ EDFParser::~EDFParser()
     for (QVector<EDFSignal>::iterator s = edfsignals.begin(); s != edfsignals.end(); s++) {
         if ((*s).data) { delete [](*s).data; }
     }
-
-    if (buffer) { delete [] buffer; }
 }
 
 void ResmedLoader::ParseSTR(Machine *mach, QStringList strfiles)
@@ -543,7 +543,7 @@ qint16 EDFParser::Read16()
 
 #ifdef Q_LITTLE_ENDIAN
     // Intel, etc...
-    qint16 res = *(qint16 *)&buffer[pos];
+    qint16 res = *(const qint16 *)&buffer[pos];
 #else
     // ARM, PPC, etc..
     qint16 res = quint8(buffer[pos]) | (qint8(buffer[pos+1]) << 8);
@@ -566,6 +566,8 @@ QString EDFParser::Read(unsigned n)
 }
 bool EDFParser::Parse()
 {
+    TRACE_SCOPE(Trace::CAT_Loader, "EDFParser::Parse");
+
     bool ok;
     QString temp, temp2;
 
@@ -720,64 +722,33 @@ bool EDFParser::Parse()
 }
 bool EDFParser::Open(QString name)
 {
+    TRACE_SCOPE(Trace::CAT_Loader, "EDFParser::Open");
+
     Q_ASSERT(buffer == nullptr);
 
-    if (name.endsWith(STR_ext_gz)) {
-        // Open and decempress file to buffer
+    // Comes from disk or straight out of a zipped card
+    filedata = FileSource::read(name);
 
+    if (name.endsWith(STR_ext_gz)) {
+        // Decompress the whole file in memory
         filename = name.mid(0, -3);
-
-        // Get file length from inside gzip file
-        QFile fi(name);
-
-        if (!fi.open(QFile::ReadOnly) || !fi.seek(fi.size() - 4)) {
-            goto badfile;
-        }
-
-        unsigned char ch[4];
-        fi.read((char *)ch, 4);
-        filesize = ch[0] | (ch [1] << 8) | (ch[2] << 16) | (ch[3] << 24);
-
-        datasize = filesize - EDFHeaderSize;
-        if (datasize < 0) {
-            goto badfile;
-        }
-
-        // Open gzip file for reading
-        gzFile f = gzopen(name.toLatin1(), "rb");
-        if (!f) {
-            goto badfile;
-        }
-
-        // Decompressed header and data block
-        gzread(f, (char *)&header, EDFHeaderSize);
-        buffer = new char [datasize];
-        gzread(f, buffer, datasize);
-        gzclose(f);
+        filedata = FileSource::gunzip(filedata);
     } else {
-
-        // Open and read uncompressed file
-        QFile f(name);
-
-        if (!f.open(QIODevice::ReadOnly)) {
-            goto badfile;
-        }
-
         filename = name;
-        filesize = f.size();
-        datasize = filesize - EDFHeaderSize;
-
-        if (datasize < 0) {
-            goto badfile;
-        }
+    }
 
-        f.read((char *)&header, EDFHeaderSize);
+    filesize = filedata.size();
+    datasize = filesize - EDFHeaderSize;
 
-        buffer = new char [datasize];
-        f.read(buffer, datasize);
-        f.close();
+    if (datasize < 0) {
+        filedata.clear();
+        goto badfile;
     }
 
+    // The header is copied out for its text fields, the data block is read where it lies
+    memcpy((char *)&header, filedata.constData(), EDFHeaderSize);
+    buffer = filedata.constData() + EDFHeaderSize;
+
     pos = 0;
     return true;
 
@@ -789,6 +760,8 @@ badfile:
 
 void ResmedImport::run()
 {
+    TRACE_SCOPE(Trace::CAT_Loader, "ResmedImport::run");
+
     loader->saveMutex.lock();
 
     Session * sess = mach->SessionExists(sessionid);
@@ -1096,6 +1069,8 @@ ResmedLoader::~ResmedLoader()
 
 void ResmedImportStage2::run()
 {
+    TRACE_SCOPE(Trace::CAT_Loader, "ResmedImportStage2::run");
+
     if (R.maskon == R.maskoff) return;
     Session * sess = new Session(mach, R.maskon);
 
@@ -1245,19 +1220,17 @@ const QString RMS9_STR_strfile = "STR.";
 
 bool ResmedLoader::Detect(const QString & givenpath)
 {
-    QDir dir(givenpath);
-
-    if (!dir.exists()) {
+    if (!FileSource::isDir(givenpath)) {
         return false;
     }
 
     // ResMed drives contain a folder named "DATALOG".
-    if (!dir.exists(RMS9_STR_datalog)) {
+    if (!FileSource::isDir(givenpath + "/" + RMS9_STR_datalog)) {
         return false;
     }
 
     // They also contain a file named "STR.edf".
-    if (!dir.exists("STR.edf")) {
+    if (!FileSource::exists(givenpath + "/STR.edf")) {
         return false;
     }
 
@@ -1265,56 +1238,78 @@ bool ResmedLoader::Detect(const QString & givenpath)
 }
 
 
-MachineInfo ResmedLoader::PeekInfo(const QString & path)
+// Parses Identification.tgt, a list of "#KEY value" lines. Keys that don't go into info are handed back in idmap
+static bool parseIdentification(const QString & filename, MachineInfo & info, QHash<QString, QString> * idmap = nullptr)
 {
-    if (!Detect(path)) return MachineInfo();
+    TextReader reader;
 
-    QFile f(path+"/"+RMS9_STR_idfile+"tgt");
-
-    // Abort if this file is dodgy..
-    if (!f.exists() || !f.open(QIODevice::ReadOnly)) {
-        return MachineInfo();
+    if (!reader.open(filename)) {
+        return false;
     }
-    MachineInfo info = newInfo();
 
-    // Parse # entries into idmap.
-    while (!f.atEnd()) {
-        QString line = f.readLine().trimmed();
-
-        if (!line.isEmpty()) {
-            QString key = line.section(" ", 0, 0).section("#", 1);
-            QString value = line.section(" ", 1);
-
-            if (key == "SRN") { // Serial Number
-                info.serial = value;
-
-            } else if (key == "PNA") {  // Product Name
-                value.replace("_"," ");
-
-                if (value.contains(STR_ResMed_S9)) {
-                    value.replace(STR_ResMed_S9, "");
-                    info.series = STR_ResMed_S9;
-                } else if (value.contains(STR_ResMed_AirSense10)) {
-                    value.replace(STR_ResMed_AirSense10, "");
-                    info.series = STR_ResMed_AirSense10;
-                } else if (value.contains(STR_ResMed_AirCurve10)) {
-                    value.replace(STR_ResMed_AirCurve10, "");
-                    info.series = STR_ResMed_AirCurve10;
-                }
-                value.replace("(","");
-                value.replace(")","");
-                if (value.contains("Adapt", Qt::CaseInsensitive)) {
-                    if (!value.contains("VPAP")) {
-                        value.replace("Adapt", QObject::tr("VPAP Adapt"));
-                    }
+    TextRef line;
+    while (reader.readLine(line)) {
+        line = line.trimmed();
+
+        if (line.isEmpty()) {
+            continue;
+        }
+
+        int space = line.indexOf(' ');
+        TextRef tag = (space < 0) ? line : line.mid(0, space);
+        int hash = tag.indexOf('#');
+
+        QString key = (hash < 0) ? QString() : tag.mid(hash + 1).toString();
+        QString value = (space < 0) ? QString() : line.mid(space + 1).toString();
+
+        if (key == "SRN") { // Serial Number
+            info.serial = value;
+
+        } else if (key == "PNA") {  // Product Name
+            value.replace("_"," ");
+
+            if (value.contains(STR_ResMed_S9)) {
+                value.replace(STR_ResMed_S9, "");
+                info.series = STR_ResMed_S9;
+            } else if (value.contains(STR_ResMed_AirSense10)) {
+                value.replace(STR_ResMed_AirSense10, "");
+                info.series = STR_ResMed_AirSense10;
+            } else if (value.contains(STR_ResMed_AirCurve10)) {
+                value.replace(STR_ResMed_AirCurve10, "");
+                info.series = STR_ResMed_AirCurve10;
+            }
+            value.replace("(","");
+            value.replace(")","");
+
+            if (value.contains("Adapt", Qt::CaseInsensitive)) {
+                if (!value.contains("VPAP")) {
+                    value.replace("Adapt", QObject::tr("VPAP Adapt"));
                 }
-                info.model = value.trimmed();
-            } else if (key == "PCD") { // Product Code
-                info.modelnumber = value;
             }
+            info.model = value.trimmed();
+
+        } else if (key == "PCD") { // Product Code
+            info.modelnumber = value;
+
+        } else if (idmap) {
+            (*idmap)[key] = value;
         }
     }
 
+    return true;
+}
+
+MachineInfo ResmedLoader::PeekInfo(const QString & path)
+{
+    if (!Detect(path)) return MachineInfo();
+
+    MachineInfo info = newInfo();
+
+    // Abort if this file is dodgy..
+    if (!parseIdentification(path+"/"+RMS9_STR_idfile+"tgt", info)) {
+        return MachineInfo();
+    }
+
     return info;
 }
 
@@ -1487,66 +1482,25 @@ EDFduration getEDFDuration(QString filename)
 
     QDateTime startDate;
 
-    if (!filename.endsWith(".gz", Qt::CaseInsensitive)) {
-        QFile file(filename);
-        if (!file.open(QFile::ReadOnly)) {
-            return EDFduration(0, 0, filename);
-        }
-
-        if (!file.seek(0xa8)) {
-            file.close();
-            return EDFduration(0, 0, filename);
-        }
-
-        QByteArray bytes = file.read(16).trimmed();
-
-        startDate = QDateTime::fromString(QString::fromLatin1(bytes, 16), "dd.MM.yyHH.mm.ss");
-
-        if (!file.seek(0xec)) {
-            file.close();
-            return EDFduration(0, 0, filename);
-        }
+    // Only the fixed part of the header is needed, up to the record duration field
+    const int peeksize = 0xfc;
+    QByteArray bytes;
 
-        bytes = file.read(8).trimmed();
-        num_records = bytes.toInt(&ok1);
-        bytes = file.read(8).trimmed();
-        rec_duration = bytes.toDouble(&ok2);
-
-        file.close();
+    if (filename.endsWith(".gz", Qt::CaseInsensitive)) {
+        // Inflating a short run of the compressed file is plenty for a mostly ASCII header
+        bytes = FileSource::gunzip(FileSource::read(filename, 4096), peeksize);
     } else {
-        gzFile f = gzopen(filename.toLatin1(), "rb");
-        if (!f) {
-            return EDFduration(0, 0, filename);
-        }
-
-        if (!gzseek(f, 0xa8, SEEK_SET)) {
-            gzclose(f);
-            return EDFduration(0, 0, filename);
-        }
-        char datebytes[17] = {0};
-        gzread(f, (char *)&datebytes, 16);
-        QString str = QString(QString::fromLatin1(datebytes,16)).trimmed();
-
-        startDate = QDateTime::fromString(str, "dd.MM.yyHH.mm.ss");
-
-        if (!gzseek(f, 0xec-0xa8-16, SEEK_CUR)) { // 0xec
-            gzclose(f);
-            return EDFduration(0, 0, filename);
-        }
-
-        // Decompressed header and data block
-        char cbytes[9] = {0};
-        gzread(f, (char *)&cbytes, 8);
-        str = QString(cbytes).trimmed();
-        num_records = str.toInt(&ok1);
+        bytes = FileSource::read(filename, peeksize);
+    }
 
-        gzread(f, (char *)&cbytes, 8);
-        str = QString(cbytes).trimmed();
-        rec_duration = str.toDouble(&ok2);
+    if (bytes.size() < peeksize) {
+        return EDFduration(0, 0, filename);
+    }
 
-        gzclose(f);
+    startDate = QDateTime::fromString(QString::fromLatin1(bytes.constData() + 0xa8, 16).trimmed(), "dd.MM.yyHH.mm.ss");
 
-    }
+    num_records = bytes.mid(0xec, 8).trimmed().toInt(&ok1);
+    rec_duration = bytes.mid(0xf4, 8).trimmed().toDouble(&ok2);
 
     QDate d2 = startDate.date();
 
@@ -1605,6 +1559,8 @@ EDFduration getEDFDuration(QString filename)
 
 int ResmedLoader::scanFiles(Machine * mach, QString datalog_path)
 {
+    TRACE_SCOPE(Trace::CAT_Loader, "ResmedLoader::scanFiles");
+
     QHash<QString, SessionID> skipfiles;
 
     bool create_backups = true; //p_profile->session->backupCardData();
@@ -1619,23 +1575,24 @@ int ResmedLoader::scanFiles(Machine * mach, QString datalog_path)
     }
 
     // Read the "already imported" file list
-    QFile impfile(mach->getDataPath()+"/imported_files.csv");
-    if (impfile.open(QFile::ReadOnly)) {
-        QTextStream impstream(&impfile);
-        QString serial;
-        impstream >> serial;
-        if (mach->serial() == serial) {
-            QString line, file, str;
-            SessionID sid;
-            bool ok;
-            do {
-                line = impstream.readLine();
-                file = line.section(',',0,0);
-                str = line.section(',',1);
-                sid = str.toInt(&ok);
+    TextReader impfile;
+    if (impfile.open(mach->getDataPath()+"/imported_files.csv")) {
+        // Serial number on the first line, then filename,sessionid
+        TextRef line;
+        impfile.readLine(line);
+
+        if (line.trimmed().toString() == mach->serial()) {
+            skipfiles.reserve(impfile.contents().size() / 32);
+
+            while (impfile.readLine(line)) {
+                int comma = line.indexOf(',');
+
+                if (comma < 0) {
+                    continue;
+                }
 
-                skipfiles[file] = sid;
-            } while (!impstream.atEnd());
+                skipfiles[line.mid(0, comma).toString()] = line.mid(comma + 1).toInt();
+            }
         }
     }
     impfile.close();
@@ -1643,32 +1600,29 @@ int ResmedLoader::scanFiles(Machine * mach, QString datalog_path)
     QStringList dirs;
     dirs.push_back(datalog_path);
 
-    QDir dir(datalog_path);
-
-    dir.setFilter(QDir::Dirs | QDir::Hidden | QDir::NoDotAndDotDot);
-    QFileInfoList flist = dir.entryInfoList();
+    // Folders may be on disk or inside a zipped card
+    QStringList flist = FileSource::entryList(datalog_path, QDir::Dirs | QDir::Hidden);
     QString filename;
     bool ok, gz;
 
 
     // Scan for any sub folders
     for (int i = 0; i < flist.size(); i++) {
-        QFileInfo fi = flist.at(i);
-        filename = fi.fileName();
+        filename = flist.at(i);
 
         if (filename.length() == 4) {
             // year folder (used in backups)
             filename.toInt(&ok);
 
             if (ok) {
-                dirs.push_back(fi.canonicalFilePath());
+                dirs.push_back(QDir::cleanPath(datalog_path + "/" + filename));
             }
         } else if (filename.length() == 8) {
             // S10 stores sessions per day folders
             filename.toInt(&ok);
 
             if (ok) {
-                dirs.push_back(fi.canonicalFilePath());
+                dirs.push_back(QDir::cleanPath(datalog_path + "/" + filename));
             }
         }
     }
@@ -1681,24 +1635,17 @@ int ResmedLoader::scanFiles(Machine * mach, QString datalog_path)
 
     // Scan through all folders looking for EDF files, skip any already imported and peek inside to get durations
     for (int d=0; d < dirs.size(); ++d) {
-        dir.setPath(dirs.at(d));
-        dir.setFilter(QDir::Files | QDir::Hidden | QDir::NoSymLinks);
-        dir.setSorting(QDir::Name);
+        QString dirpath = QDir::cleanPath(dirs.at(d));
 
-        flist = dir.entryInfoList();
+        // Forget about anything that can't be read.
+        flist = FileSource::entryList(dirpath, QDir::Files | QDir::Hidden | QDir::NoSymLinks | QDir::Readable);
 
         // get number of files in current directory being processed
         int size = flist.size();
 
         // For each file in flist...
         for (int i = 0; i < size; i++) {
-            QFileInfo fi = flist.at(i);
-            filename = fi.fileName();
-
-            // Forget about it if it can't be read.
-            if (!fi.isReadable()) {
-                continue;
-            }
+            filename = flist.at(i);
 
             // Chop off the .gz component if it exists
             if (filename.endsWith(STR_ext_gz)) {
@@ -1725,14 +1672,14 @@ int ResmedLoader::scanFiles(Machine * mach, QString datalog_path)
             }
 
 
-            QString fullname = fi.canonicalFilePath();
+            QString fullname = dirpath + "/" + flist.at(i);
 
             // Peek inside the EDF file and get the EDFDuration record for the session matching that follows
             EDFduration dur = getEDFDuration(fullname);
             dur.filename = filename;
 
             if (dur.start != dur.end) { // make sure empty EVE's are skipped
-                QMap<QString, EDFduration>::iterator it = newfiles.insert(filename, getEDFDuration(fullname));
+                QMap<QString, EDFduration>::iterator it = newfiles.insert(filename, dur);
                 filesbytype[dur.type].append(&it.value());
             }
         }
@@ -1967,9 +1914,8 @@ int ResmedLoader::scanFiles(Machine * mach, QString datalog_path)
 
 int ResmedLoader::Open(QString path)
 {
+    TRACE_SCOPE(Trace::CAT_Loader, "ResmedLoader::Open");
 
-    QString key, value;
-    QString line;
     QString newpath;
     QString filename;
 
@@ -1994,7 +1940,7 @@ int ResmedLoader::Open(QString path)
     path += "/";
 
     // Check DATALOG folder exists and is readable
-    if (!QDir().exists(newpath)) {
+    if (!FileSource::isDir(newpath)) {
         return -1;
     }
 
@@ -2002,59 +1948,12 @@ int ResmedLoader::Open(QString path)
     // Parse Identification.tgt file (containing serial number and machine information)
     ///////////////////////////////////////////////////////////////////////////////////
     filename = path + RMS9_STR_idfile + STR_ext_TGT;
-    QFile f(filename);
+    MachineInfo info = newInfo();
 
     // Abort if this file is dodgy..
-    if (!f.exists() || !f.open(QIODevice::ReadOnly)) {
+    if (!parseIdentification(filename, info, &idmap)) {
         return -1;
     }
-    MachineInfo info = newInfo();
-
-    // Parse # entries into idmap.
-    while (!f.atEnd()) {
-        line = f.readLine().trimmed();
-
-        if (!line.isEmpty()) {
-            key = line.section(" ", 0, 0).section("#", 1);
-            value = line.section(" ", 1);
-
-            if (key == "SRN") { // Serial Number
-                info.serial = value;
-                continue;
-
-            } else if (key == "PNA") {  // Product Name
-                value.replace("_"," ");
-                if (value.contains(STR_ResMed_S9)) {
-                    value.replace(STR_ResMed_S9, "");
-                    info.series = STR_ResMed_S9;
-                } else if (value.contains(STR_ResMed_AirSense10)) {
-                    value.replace(STR_ResMed_AirSense10, "");
-                    info.series = STR_ResMed_AirSense10;
-                } else if (value.contains(STR_ResMed_AirCurve10)) {
-                    value.replace(STR_ResMed_AirCurve10, "");
-                    info.series = STR_ResMed_AirCurve10;
-                }
-                value.replace("(","");
-                value.replace(")","");
-
-                if (value.contains("Adapt", Qt::CaseInsensitive)) {
-                    if (!value.contains("VPAP")) {
-                        value.replace("Adapt", QObject::tr("VPAP Adapt"));
-                    }
-                }
-                info.model = value.trimmed();
-                continue;
-
-            } else if (key == "PCD") { // Product Code
-                info.modelnumber = value;
-                continue;
-            }
-
-            idmap[key] = value;
-        }
-    }
-
-    f.close();
 
     // Abort if no serial number
     if (info.serial.isEmpty()) {
@@ -2064,13 +1963,11 @@ int ResmedLoader::Open(QString path)
 
     // Early check for STR.edf file, so we can early exit before creating faulty machine record.
     QString strpath = path + RMS9_STR_strfile + STR_ext_EDF; // STR.edf file
-    f.setFileName(strpath);
 
-    if (!f.exists()) { // No STR.edf.. Do we have a STR.edf.gz?
+    if (!FileSource::exists(strpath)) { // No STR.edf.. Do we have a STR.edf.gz?
         strpath += STR_ext_gz;
-        f.setFileName(strpath);
 
-        if (!f.exists()) {
+        if (!FileSource::exists(strpath)) {
             qDebug() << "Missing STR.edf file";
             return -1;
         }
@@ -2103,17 +2000,14 @@ int ResmedLoader::Open(QString path)
     ///////////////////////////////////////////////////////////////////////////////////
     QStringList strfiles;
     strfiles.push_back(strpath);
-    QDir dir(path + "STR_Backup");
-    dir.setFilter(QDir::Files | QDir::Hidden | QDir::Readable);
-    QFileInfoList flist = dir.entryInfoList();
+    QStringList flist = FileSource::entryList(path + "STR_Backup", QDir::Files | QDir::Hidden | QDir::Readable);
 
     {
     int size = flist.size();
     for (int i = 0; i < size; i++) {
-        QFileInfo fi = flist.at(i);
-        filename = fi.fileName();
+        filename = flist.at(i);
         if (filename.startsWith("STR", Qt::CaseInsensitive)) {
-            strfiles.push_back(fi.filePath());
+            strfiles.push_back(path + "STR_Backup/" + filename);
         }
     }
     }
@@ -2133,7 +2027,7 @@ int ResmedLoader::Open(QString path)
 
 
     // Creating early as we need the object
-    dir.setPath(newpath);
+    QDir dir;
 
 
     ///////////////////////////////////////////////////////////////////////////////////
@@ -2148,8 +2042,8 @@ int ResmedLoader::Open(QString path)
         }
 
         // Copy Identification files to backup folder
-        QFile::copy(path + RMS9_STR_idfile + STR_ext_TGT, backup_path + RMS9_STR_idfile + STR_ext_TGT);
-        QFile::copy(path + RMS9_STR_idfile + STR_ext_CRC, backup_path + RMS9_STR_idfile + STR_ext_CRC);
+        FileSource::copy(path + RMS9_STR_idfile + STR_ext_TGT, backup_path + RMS9_STR_idfile + STR_ext_TGT);
+        FileSource::copy(path + RMS9_STR_idfile + STR_ext_CRC, backup_path + RMS9_STR_idfile + STR_ext_CRC);
 
         QDateTime dts = QDateTime::fromMSecsSinceEpoch(stredf.startdate, Qt::UTC);
         dir.mkpath(backup_path + "STR_Backup");
@@ -2157,7 +2051,7 @@ int ResmedLoader::Open(QString path)
 
         //copy STR files to backup folder
         if (strpath.endsWith(STR_ext_gz)) { // Already compressed. Don't bother decompressing..
-            QFile::copy(strpath, backup_path + RMS9_STR_strfile + STR_ext_EDF + STR_ext_gz);
+            FileSource::copy(strpath, backup_path + RMS9_STR_strfile + STR_ext_EDF + STR_ext_gz);
         } else { // Compress STR file to backup folder
             QString strf = backup_path + RMS9_STR_strfile + STR_ext_EDF;
 
@@ -2173,7 +2067,7 @@ int ResmedLoader::Open(QString path)
             compress_backups ?
             compressFile(strpath, strf)
             :
-            QFile::copy(strpath, strf);
+            FileSource::copy(strpath, strf);
 
         }
 
@@ -2182,11 +2076,11 @@ int ResmedLoader::Open(QString path)
             compress_backups ?
             compressFile(strpath, strmonthly)
             :
-            QFile::copy(strpath, strmonthly);
+            FileSource::copy(strpath, strmonthly);
         }
 
         // Meh.. these can be calculated if ever needed for ResScan SDcard export
-        QFile::copy(path + "STR.crc", backup_path + "STR.crc");
+        FileSource::copy(path + "STR.crc", backup_path + "STR.crc");
     }
 
     ///////////////////////////////////////////////////////////////////////////////////
@@ -2403,12 +2297,12 @@ QString ResmedLoader::backup(QString fullname, QString backup_path)
     if (!QFile::exists(newname)) {
         if (compress) {
             gz ?
-            QFile::copy(fullname, newname)      // Already compressed.. copy it to the right location
+            FileSource::copy(fullname, newname)      // Already compressed.. copy it to the right location
             :
             compressFile(fullname, newname);
         } else {
             // dont really care if it's compressed and not meant to be, leave it that way
-            QFile::copy(fullname, newname);
+            FileSource::copy(fullname, newname);
         }
     } // else backup already exists...
 
@@ -2443,6 +2337,8 @@ QString ResmedLoader::backup(QString fullname, QString backup_path)
 
 bool ResmedLoader::LoadCSL(Session *sess, const QString & path)
 {
+    TRACE_SCOPE(Trace::CAT_Loader, "ResmedLoader::LoadCSL");
+
     EDFParser edf(path);
     if (!edf.Parse())
         return false;
@@ -2587,6 +2483,8 @@ bool ResmedLoader::LoadCSL(Session *sess, const QString & path)
 
 bool ResmedLoader::LoadEVE(Session *sess, const QString & path)
 {
+    TRACE_SCOPE(Trace::CAT_Loader, "ResmedLoader::LoadEVE");
+
     EDFParser edf(path);
     if (!edf.Parse())
         return false;
@@ -2614,6 +2512,11 @@ bool ResmedLoader::LoadEVE(Session *sess, const QString & path)
     HY = sess->AddEventList(CPAP_Hypopnea, EVL_Event);
     UA = sess->AddEventList(CPAP_Apnea, EVL_Event);
 
+    // The data record count is a fair size hint for the annotations to come, finalize() trims what isn't used
+    OA->reserve(edf.GetNumDataRecords());
+    HY->reserve(edf.GetNumDataRecords());
+    UA->reserve(edf.GetNumDataRecords());
+
     // Process event annotation records
     for (int s = 0; s < edf.GetNumSignals(); s++) {
         recs = edf.edfsignals[s].nr * edf.GetNumDataRecords() * 2;
@@ -2740,6 +2643,8 @@ bool ResmedLoader::LoadEVE(Session *sess, const QString & path)
 
 bool ResmedLoader::LoadBRP(Session *sess, const QString & path)
 {
+    TRACE_SCOPE(Trace::CAT_Loader, "ResmedLoader::LoadBRP");
+
     EDFParser edf(path);
     if (!edf.Parse())
         return false;
@@ -2843,6 +2748,9 @@ void ResmedLoader::ToTimeDelta(Session *sess, EDFParser &edf, EDFSignal &es, Cha
                 max = tmp;
                 el = sess->AddEventList(code, EVL_Event, es.gain, es.offset, 0, 0);
 
+                // Every remaining sample could be a change, twice over for square plots. finalize() trims the rest
+                el->reserve(quint32(eptr - sptr) * (square ? 2 : 1) + 1);
+
                 el->AddEvent(tt, last);
                 tt += rate;
 
@@ -2948,6 +2856,8 @@ void ResmedLoader::ToTimeDelta(Session *sess, EDFParser &edf, EDFSignal &es, Cha
 // Load SAD Oximetry Signals
 bool ResmedLoader::LoadSAD(Session *sess, const QString & path)
 {
+    TRACE_SCOPE(Trace::CAT_Loader, "ResmedLoader::LoadSAD");
+
     EDFParser edf(path);
     if (!edf.Parse())
         return false;
@@ -2996,6 +2906,8 @@ bool ResmedLoader::LoadSAD(Session *sess, const QString & path)
 
 bool ResmedLoader::LoadPLD(Session *sess, const QString & path)
 {
+    TRACE_SCOPE(Trace::CAT_Loader, "ResmedLoader::LoadPLD");
+
     EDFParser edf(path);
     if (!edf.Parse())
         return false;
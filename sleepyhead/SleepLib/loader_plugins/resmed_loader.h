@@ -308,7 +308,12 @@ class EDFParser
 
     //! \brief Parse the EDF+ file into the list of EDFSignals.. Must be call Open(..) first.
     bool Parse();
-    char *buffer;
+
+    //! \brief The data block, pointing into filedata just past the header
+    const char *buffer;
+
+    //! \brief The whole (decompressed) file, parsed in place
+    QByteArray filedata;
 
     //! \brief  The EDF+ files header structure, used as a place holder while processing the text data.
     EDFHeader header;
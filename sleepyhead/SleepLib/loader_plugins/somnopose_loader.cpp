@@ -14,9 +14,10 @@
 //********************************************************************************************
 
 #include <QDir>
-#include <QTextStream>
 #include "somnopose_loader.h"
+#include "SleepLib/trace.h"
 #include "SleepLib/machine.h"
+#include "SleepLib/textreader.h"
 
 SomnoposeLoader::SomnoposeLoader()
 {
@@ -28,6 +29,8 @@ SomnoposeLoader::~SomnoposeLoader()
 }
 int SomnoposeLoader::Open(QString path)
 {
+    TRACE_SCOPE(Trace::CAT_Loader, "SomnoposeLoader::Open");
+
     Q_UNUSED(path)
 
     QString newpath;
@@ -54,10 +57,12 @@ int SomnoposeLoader::Open(QString path)
 
 int SomnoposeLoader::OpenFile(QString filename)
 {
-    QFile file(filename);
+    TRACE_SCOPE(Trace::CAT_Loader, "SomnoposeLoader::OpenFile");
+
+    TextReader ts;
 
     if (filename.toLower().endsWith(".csv")) {
-        if (!file.open(QFile::ReadOnly)) {
+        if (!ts.open(filename)) {
             qDebug() << "Couldn't open Somnopose data file" << filename;
             return 0;
         }
@@ -66,29 +71,15 @@ int SomnoposeLoader::OpenFile(QString filename)
     }
 
     qDebug() << "Opening file" << filename;
-    QTextStream ts(&file);
 
     // Read header line and determine order of fields
-    QString hdr = ts.readLine();
-    QStringList headers = hdr.split(",");
-
-    int col_inclination = -1, col_orientation = -1, col_timestamp = -1;
-
-    int hdr_size = headers.size();
-
-    for (int i = 0; i < hdr_size; i++) {
-        if (headers.at(i).compare("timestamp", Qt::CaseInsensitive) == 0) {
-            col_timestamp = i;
-        }
-
-        if (headers.at(i).compare("inclination", Qt::CaseInsensitive) == 0) {
-            col_inclination = i;
-        }
+    TextRef line;
+    ts.readLine(line);
 
-        if (headers.at(i).compare("orientation", Qt::CaseInsensitive) == 0) {
-            col_orientation = i;
-        }
-    }
+    int hdr_size = ts.split(line, ',');
+    int col_timestamp = ts.fieldIndex("timestamp", Qt::CaseInsensitive);
+    int col_inclination = ts.fieldIndex("inclination", Qt::CaseInsensitive);
+    int col_orientation = ts.fieldIndex("orientation", Qt::CaseInsensitive);
 
     // Check we have all fields available
     if ((col_timestamp < 0) || (col_inclination < 0) || (col_orientation < 0)) {
@@ -99,8 +90,6 @@ int SomnoposeLoader::OpenFile(QString filename)
     qint64 ep = qint64(epoch.toTime_t()) * 1000, time;
 
     double timestamp, orientation, inclination;
-    QString data;
-    QStringList fields;
     bool ok;
 
     bool first = true;
@@ -111,22 +100,20 @@ int SomnoposeLoader::OpenFile(QString filename)
 
     EventList *ev_orientation = nullptr, *ev_inclination = nullptr;
 
-    while (!(data = ts.readLine()).isEmpty()) {
-        fields = data.split(",");
-
-        if (fields.size() < hdr_size) { // missing fields.. skip this record
+    while (ts.readLine(line) && !line.isEmpty()) {
+        if (ts.split(line, ',') < hdr_size) { // missing fields.. skip this record
             continue;
         }
 
-        timestamp = fields[col_timestamp].toDouble(&ok);
+        timestamp = ts.field(col_timestamp).toDouble(&ok);
 
         if (!ok) { continue; }
 
-        orientation = fields[col_orientation].toDouble(&ok);
+        orientation = ts.field(col_orientation).toDouble(&ok);
 
         if (!ok) { continue; }
 
-        inclination = fields[col_inclination].toDouble(&ok);
+        inclination = ts.field(col_inclination).toDouble(&ok);
 
         if (!ok) { continue; }
 
@@ -152,6 +139,10 @@ int SomnoposeLoader::OpenFile(QString filename)
         ev_inclination->AddEvent(time, inclination);
     }
 
+    if (!sess) { // No usable records
+        return 0;
+    }
+
     sess->setMin(POS_Orientation, ev_orientation->Min());
     sess->setMax(POS_Orientation, ev_orientation->Max());
     sess->setMin(POS_Inclination, ev_inclination->Min());
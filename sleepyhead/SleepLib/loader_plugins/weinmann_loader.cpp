@@ -15,6 +15,7 @@
 
 
 #include "weinmann_loader.h"
+#include "SleepLib/trace.h"
 
 extern QProgressBar *qprogress;
 
@@ -116,6 +117,7 @@ void HighPass(char * data, int samples, float cutoff, float dt)
 
 int WeinmannLoader::Open(QString path)
 {
+    TRACE_SCOPE(Trace::CAT_Loader, "WeinmannLoader::Open");
 
     path = path.replace("\\", "/");
 
@@ -14,8 +14,9 @@
 //********************************************************************************************
 
 #include <QDir>
-#include <QTextStream>
 #include "zeo_loader.h"
+#include "SleepLib/trace.h"
+#include "SleepLib/textreader.h"
 #include "SleepLib/machine.h"
 
 ZEOLoader::ZEOLoader()
@@ -29,6 +30,8 @@ ZEOLoader::~ZEOLoader()
 
 int ZEOLoader::Open(QString path)
 {
+    TRACE_SCOPE(Trace::CAT_Loader, "ZEOLoader::Open");
+
     Q_UNUSED(path)
 
     QString newpath;
@@ -82,10 +85,12 @@ int ZEOLoader::Open(QString path)
 
 int ZEOLoader::OpenFile(QString filename)
 {
-    QFile file(filename);
+    TRACE_SCOPE(Trace::CAT_Loader, "ZEOLoader::OpenFile");
+
+    TextReader text;
 
     if (filename.toLower().endsWith(".csv")) {
-        if (!file.open(QFile::ReadOnly)) {
+        if (!text.open(filename)) {
             qDebug() << "Couldn't open zeo file" << filename;
             return 0;
         }
@@ -95,11 +100,9 @@ int ZEOLoader::OpenFile(QString filename)
         // not supported.
     }
 
-    QTextStream text(&file);
-    QString headerdata = text.readLine();
-    QStringList header = headerdata.split(",");
-    QString line;
-    QStringList linecomp;
+    TextRef line;
+    text.readLine(line);
+    text.split(line, ',');
     QDateTime start_of_night, end_of_night, rise_time;
     SessionID sid;
 
@@ -115,157 +118,155 @@ int ZEOLoader::OpenFile(QString filename)
 
     QDateTime FirstAlarmRing, LastAlarmRing, FirstSnoozeTime, LastSnoozeTime, SetAlarmTime;
 
-    QStringList SG, DSG;
+    QVector<TextRef> DSG;
 
     MachineInfo info = newInfo();
     Machine *mach = CreateMachine(info);
 
 
-    int idxZQ = header.indexOf("ZQ");
-    //int idxTotalZ = header.indexOf("Total Z");
-    int idxAwakenings = header.indexOf("Awakenings");
-    int idxSG = header.indexOf("Sleep Graph");
-    int idxDSG = header.indexOf("Detailed Sleep Graph");
-    int idxTimeInWake = header.indexOf("Time in Wake");
-    int idxTimeToZ = header.indexOf("Time to Z");
-    int idxTimeInREM = header.indexOf("Time in REM");
-    int idxTimeInLight = header.indexOf("Time in Light");
-    int idxTimeInDeep = header.indexOf("Time in Deep");
-    int idxStartOfNight = header.indexOf("Start of Night");
-    int idxEndOfNight = header.indexOf("End of Night");
-    int idxRiseTime = header.indexOf("Rise Time");
-//    int idxAlarmReason = header.indexOf("Alarm Reason");
-//    int idxSnoozeTime = header.indexOf("Snooze Time");
-//    int idxWakeTone = header.indexOf("Wake Tone");
-//    int idxWakeWindow = header.indexOf("Wake Window");
-//    int idxAlarmType = header.indexOf("Alarm Type");
-    int idxFirstAlaramRing = header.indexOf("First Alarm Ring");
-    int idxLastAlaramRing = header.indexOf("Last Alarm Ring");
-    int idxFirstSnoozeTime = header.indexOf("First Snooze Time");
-    int idxLastSnoozeTime = header.indexOf("Last Snooze Time");
-    int idxSetAlarmTime = header.indexOf("Set Alarm Time");
-    int idxMorningFeel = header.indexOf("Morning Feel");
-    int idxFirmwareVersion = header.indexOf("Firmware Version");
-    int idxMyZEOVersion = header.indexOf("My ZEO Version");
+    int idxZQ = text.fieldIndex("ZQ");
+    //int idxTotalZ = text.fieldIndex("Total Z");
+    int idxAwakenings = text.fieldIndex("Awakenings");
+    //int idxSG = text.fieldIndex("Sleep Graph");
+    int idxDSG = text.fieldIndex("Detailed Sleep Graph");
+    int idxTimeInWake = text.fieldIndex("Time in Wake");
+    int idxTimeToZ = text.fieldIndex("Time to Z");
+    int idxTimeInREM = text.fieldIndex("Time in REM");
+    int idxTimeInLight = text.fieldIndex("Time in Light");
+    int idxTimeInDeep = text.fieldIndex("Time in Deep");
+    int idxStartOfNight = text.fieldIndex("Start of Night");
+    int idxEndOfNight = text.fieldIndex("End of Night");
+    int idxRiseTime = text.fieldIndex("Rise Time");
+//    int idxAlarmReason = text.fieldIndex("Alarm Reason");
+//    int idxSnoozeTime = text.fieldIndex("Snooze Time");
+//    int idxWakeTone = text.fieldIndex("Wake Tone");
+//    int idxWakeWindow = text.fieldIndex("Wake Window");
+//    int idxAlarmType = text.fieldIndex("Alarm Type");
+    int idxFirstAlaramRing = text.fieldIndex("First Alarm Ring");
+    int idxLastAlaramRing = text.fieldIndex("Last Alarm Ring");
+    int idxFirstSnoozeTime = text.fieldIndex("First Snooze Time");
+    int idxLastSnoozeTime = text.fieldIndex("Last Snooze Time");
+    int idxSetAlarmTime = text.fieldIndex("Set Alarm Time");
+    int idxMorningFeel = text.fieldIndex("Morning Feel");
+    int idxFirmwareVersion = text.fieldIndex("Firmware Version");
+    int idxMyZEOVersion = text.fieldIndex("My ZEO Version");
 
     bool ok;
     bool dodgy;
 
-    do {
-        line = text.readLine();
+    while (text.readLine(line)) {
         dodgy = false;
 
         if (line.isEmpty()) { continue; }
 
-        linecomp = line.split(",");
-        ZQ = linecomp[idxZQ].toInt(&ok);
+        text.split(line, ',');
+        ZQ = text.field(idxZQ).toInt(&ok);
 
         if (!ok) { dodgy = true; }
 
-//        TotalZ = linecomp[idxTotalZ].toInt(&ok);
+//        TotalZ = text.field(idxTotalZ).toInt(&ok);
 
 //        if (!ok) { dodgy = true; }
 
-        TimeToZ = linecomp[idxTimeToZ].toInt(&ok);
+        TimeToZ = text.field(idxTimeToZ).toInt(&ok);
 
         if (!ok) { dodgy = true; }
 
-        TimeInWake = linecomp[idxTimeInWake].toInt(&ok);
+        TimeInWake = text.field(idxTimeInWake).toInt(&ok);
 
         if (!ok) { dodgy = true; }
 
-        TimeInREM = linecomp[idxTimeInREM].toInt(&ok);
+        TimeInREM = text.field(idxTimeInREM).toInt(&ok);
 
         if (!ok) { dodgy = true; }
 
-        TimeInLight = linecomp[idxTimeInLight].toInt(&ok);
+        TimeInLight = text.field(idxTimeInLight).toInt(&ok);
 
         if (!ok) { dodgy = true; }
 
-        TimeInDeep = linecomp[idxTimeInDeep].toInt(&ok);
+        TimeInDeep = text.field(idxTimeInDeep).toInt(&ok);
 
         if (!ok) { dodgy = true; }
 
-        Awakenings = linecomp[idxAwakenings].toInt(&ok);
+        Awakenings = text.field(idxAwakenings).toInt(&ok);
 
         if (!ok) { dodgy = true; }
 
-        start_of_night = QDateTime::fromString(linecomp[idxStartOfNight], "MM/dd/yyyy HH:mm");
+        start_of_night = text.field(idxStartOfNight).toDateTime("MM/dd/yyyy HH:mm");
 
         if (!start_of_night.isValid()) { dodgy = true; }
 
-        end_of_night = QDateTime::fromString(linecomp[idxEndOfNight], "MM/dd/yyyy HH:mm");
+        end_of_night = text.field(idxEndOfNight).toDateTime("MM/dd/yyyy HH:mm");
 
         if (!end_of_night.isValid()) { dodgy = true; }
 
-        rise_time = QDateTime::fromString(linecomp[idxRiseTime], "MM/dd/yyyy HH:mm");
+        rise_time = text.field(idxRiseTime).toDateTime("MM/dd/yyyy HH:mm");
 
         if (!rise_time.isValid()) { dodgy = true; }
 
-//        AlarmReason = linecomp[idxAlarmReason].toInt(&ok);
+//        AlarmReason = text.field(idxAlarmReason).toInt(&ok);
 
 //        if (!ok) { dodgy = true; }
 
-//        SnoozeTime = linecomp[idxSnoozeTime].toInt(&ok);
+//        SnoozeTime = text.field(idxSnoozeTime).toInt(&ok);
 
 //        if (!ok) { dodgy = true; }
 
-//        WakeTone = linecomp[idxWakeTone].toInt(&ok);
+//        WakeTone = text.field(idxWakeTone).toInt(&ok);
 
 //        if (!ok) { dodgy = true; }
 
-//        WakeWindow = linecomp[idxWakeWindow].toInt(&ok);
+//        WakeWindow = text.field(idxWakeWindow).toInt(&ok);
 
 //        if (!ok) { dodgy = true; }
 
-//        AlarmType = linecomp[idxAlarmType].toInt(&ok);
+//        AlarmType = text.field(idxAlarmType).toInt(&ok);
 
 //        if (!ok) { dodgy = true; }
 
-        if (!linecomp[idxFirstAlaramRing].isEmpty()) {
-            FirstAlarmRing = QDateTime::fromString(linecomp[idxFirstAlaramRing], "MM/dd/yyyy HH:mm");
+        if (!text.field(idxFirstAlaramRing).isEmpty()) {
+            FirstAlarmRing = text.field(idxFirstAlaramRing).toDateTime("MM/dd/yyyy HH:mm");
 
             if (!FirstAlarmRing.isValid()) { dodgy = true; }
         }
 
-        if (!linecomp[idxLastAlaramRing].isEmpty()) {
-            LastAlarmRing = QDateTime::fromString(linecomp[idxLastAlaramRing], "MM/dd/yyyy HH:mm");
+        if (!text.field(idxLastAlaramRing).isEmpty()) {
+            LastAlarmRing = text.field(idxLastAlaramRing).toDateTime("MM/dd/yyyy HH:mm");
 
             if (!LastAlarmRing.isValid()) { dodgy = true; }
         }
 
-        if (!linecomp[idxFirstSnoozeTime].isEmpty()) {
-            FirstSnoozeTime = QDateTime::fromString(linecomp[idxFirstSnoozeTime], "MM/dd/yyyy HH:mm");
+        if (!text.field(idxFirstSnoozeTime).isEmpty()) {
+            FirstSnoozeTime = text.field(idxFirstSnoozeTime).toDateTime("MM/dd/yyyy HH:mm");
 
             if (!FirstSnoozeTime.isValid()) { dodgy = true; }
         }
 
-        if (!linecomp[idxLastSnoozeTime].isEmpty()) {
-            LastSnoozeTime = QDateTime::fromString(linecomp[idxLastSnoozeTime], "MM/dd/yyyy HH:mm");
+        if (!text.field(idxLastSnoozeTime).isEmpty()) {
+            LastSnoozeTime = text.field(idxLastSnoozeTime).toDateTime("MM/dd/yyyy HH:mm");
 
             if (!LastSnoozeTime.isValid()) { dodgy = true; }
         }
 
-        if (!linecomp[idxSetAlarmTime].isEmpty()) {
-            SetAlarmTime = QDateTime::fromString(linecomp[idxSetAlarmTime], "MM/dd/yyyy HH:mm");
+        if (!text.field(idxSetAlarmTime).isEmpty()) {
+            SetAlarmTime = text.field(idxSetAlarmTime).toDateTime("MM/dd/yyyy HH:mm");
 
             if (!SetAlarmTime.isValid()) { dodgy = true; }
         }
 
-        MorningFeel = linecomp[idxMorningFeel].toInt(&ok);
+        MorningFeel = text.field(idxMorningFeel).toInt(&ok);
 
         if (!ok) { MorningFeel = 0; }
 
-        FirmwareVersion = linecomp[idxFirmwareVersion];
-
-        if (idxMyZEOVersion >= 0) { MyZeoVersion = linecomp[idxMyZEOVersion]; }
-
         if (dodgy) {
             continue;
         }
 
-        SG = linecomp[idxSG].split(" ");
-        DSG = linecomp[idxDSG].split(" ");
+        FirmwareVersion = text.field(idxFirmwareVersion).toString();
+
+        if (idxMyZEOVersion >= 0) { MyZeoVersion = text.field(idxMyZEOVersion).toString(); }
+
+        text.field(idxDSG).split(' ', DSG);
 
         const int WindowSize = 30000;
         sid = start_of_night.toTime_t();
@@ -295,7 +296,7 @@ int ZEOLoader::OpenFile(QString filename)
         EventList *sleepstage = sess->AddEventList(ZEO_SleepStage, EVL_Event, 1, 0, 0, 4);
 
         for (int i = 0; i < DSG.size(); i++) {
-            stage = DSG[i].toInt(&ok);
+            stage = DSG.at(i).toInt(&ok);
 
             if (ok) {
                 sleepstage->AddEvent(tt, stage);
@@ -310,10 +311,10 @@ int ZEOLoader::OpenFile(QString filename)
         mach->AddSession(sess);
 
 
-        qDebug() << linecomp[0] << start_of_night << end_of_night << rise_time << size <<
+        qDebug() << text.field(0).toString() << start_of_night << end_of_night << rise_time << size <<
                  "30 second chunks";
 
-    } while (!line.isNull());
+    }
 
     mach->Save();
     return true;
@@ -11,6 +11,7 @@
 #include <QDebug>
 #include <QString>
 #include <QObject>
+#include <QThread>
 #include <QThreadPool>
 #include <QFile>
 #include <QDataStream>
@@ -25,6 +26,8 @@
 #include "mainwindow.h"
 
 #include "progressdialog.h"
+#include "trace.h"
+#include "eventcache.h"
 
 #include <time.h>
 
@@ -61,6 +64,7 @@ Machine::Machine(MachineID id)
    // qDebug() << "Create Machine: " << hex << m_id; //%lx",m_id);
     m_type = MT_UNKNOWN;
     firstsession = true;
+    m_sortedRevision = -1;
 }
 Machine::~Machine()
 {
@@ -256,7 +260,8 @@ bool Machine::AddSession(Session *s)
     int closest_session = 0;
 
 
-    // Multithreaded import screws this up. :(
+    // Depends on the neighbouring days, so sessions must be added serially and in start time
+    // order. Threaded loaders collect them with MachineLoader::addSession() instead.
 
     if (time < split_time) {
         date = date.addDays(-1);
@@ -411,6 +416,9 @@ bool Machine::Purge(int secret)
     // Boring api key to stop this function getting called by accident :)
     if (secret != 3478216) { return false; }
 
+    // Don't let a background event prefetch touch sessions about to be deleted
+    EventCache::instance()->cancelPrefetch(true);
+
     QString path = getDataPath();
 
     QDir dir(path);
@@ -536,8 +544,68 @@ const QString Machine::getBackupPath()
     return p_profile->Get("{" + STR_GEN_DataFolder + "}/" + info.loadername + "_" + (info.serial.isEmpty() ? hexid() : info.serial)  + "/Backup/");
 }
 
-bool Machine::Load()
+/*! \class SummaryLoadTask
+    \brief Decodes a run of Session summary files on a worker thread
+    */
+class SummaryLoadTask : public QRunnable
+{
+  public:
+    SummaryLoadTask(const QList<Session *> &sessions, int start, int end, bool *loaded, QAtomicInt *done)
+        : m_sessions(sessions), m_start(start), m_end(end), m_loaded(loaded), m_done(done) {}
+    virtual ~SummaryLoadTask() {}
+
+    virtual void run() {
+        for (int i = m_start; i < m_end; ++i) {
+            m_loaded[i] = m_sessions.at(i)->LoadSummary();
+            m_done->fetchAndAddRelaxed(1);
+        }
+    }
+
+  protected:
+    QList<Session *> m_sessions;
+    int m_start;
+    int m_end;
+    bool *m_loaded;
+    QAtomicInt *m_done;
+};
+
+void Machine::LoadSessionSummaries(const QList<Session *> &sessions, QVector<bool> &loaded, QProgressBar *progress)
 {
+    TRACE_SCOPE(Trace::CAT_Machine, "Machine::LoadSessionSummaries");
+
+    int size = sessions.size();
+    loaded.fill(false, size);
+
+    if (progress) {
+        progress->setMinimum(0);
+        progress->setMaximum(size);
+        progress->setValue(0);
+    }
+
+    // Private pool, so import tasks or event prefetching on the global one can't hold this up
+    QThreadPool pool;
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+    QAtomicInt done;
+
+    const int batch = 64;
+    for (int i = 0; i < size; i += batch) {
+        pool.start(new SummaryLoadTask(sessions, i, qMin(i + batch, size), loaded.data(), &done));
+    }
+
+    while (!pool.waitForDone(50)) {
+        if (progress) {
+            progress->setValue(done.load());
+            QApplication::processEvents();
+        }
+    }
+
+    if (progress) { progress->setValue(size); }
+}
+
+bool Machine::Load(QList<Session *> *index)
+{
+    TRACE_SCOPE(Trace::CAT_Machine, "Machine::Load");
+
     QString path = getDataPath();
 
     QDir dir(path);
@@ -556,7 +624,7 @@ bool Machine::Load()
 
     QProgressBar * progress = popup->progress;
 
-    if (!LoadSummary(progress)) {
+    if (!LoadSummary(progress, index)) {
         // No XML index file, so assume upgrading, or it simply just got screwed up or deleted...
         QTime time;
         time.start();
@@ -630,31 +698,37 @@ bool Machine::Load()
         SessionID sessid;
         bool ok;
 
+        QList<Session *> sessions;
         for (int i=0; i < size; i++) {
-
-            if ((i % 50) == 0) { // This is slow.. :-/
-                if (progress) { progress->setValue(i); }
-
-                QApplication::processEvents();
-            }
-
             QString filename = filelist.at(i);
             sesstr = filename.section(".", 0, -2);
             sessid = sesstr.toLong(&ok, 16);
 
             if (!ok) { continue; }
 
-            Session *sess = new Session(this, sessid);
+            sessions.append(new Session(this, sessid));
+        }
+
+        // Forced to load them all, because know nothing about these sessions..
+        QVector<bool> loaded;
+        LoadSessionSummaries(sessions, loaded, progress);
 
-            // Forced to load it, because know nothing about this session..
-            if (sess->LoadSummary()) {
-                AddSession(sess);
+        QMap<qint64, Session *> sess_order;
+        for (int i=0; i < sessions.size(); i++) {
+            Session *sess = sessions.at(i);
+            if (loaded.at(i)) {
+                sess_order.insertMulti(sess->first(), sess);
             } else {
-                qWarning() << "Error loading summary file" << filename;
+                qWarning() << "Error loading summary file" << QString().sprintf("%08lx.000", sess->session());
                 delete sess;
             }
         }
 
+        // Then attach them in one pass, in start time order
+        for (QMap<qint64, Session *>::iterator it = sess_order.begin(); it != sess_order.end(); ++it) {
+            AddSession(it.value());
+        }
+
         SaveSummary();
         qDebug() << "Loaded" << info.model << "data in" << time.elapsed() << "ms";
         if (progress) { progress->setValue(size); }
@@ -821,34 +895,32 @@ void SaveTask::run()
 
 void Machine::queTask(ImportTask * task)
 {
-    if (0) { //p_profile->session->multithreading()) {
+    if (p_profile->session->multithreading()) {
         m_tasklist.push_back(task);
         return;
     }
 
     task->run();
-    return;
+    delete task;
 }
 
 void Machine::runTasks()
 {
-    if (0) { //!p_profile->session->multithreading()) {
-        Q_ASSERT(m_tasklist.isEmpty());
+    if (m_tasklist.isEmpty()) {
         return;
     }
-    QThreadPool * threadpool = QThreadPool::globalInstance();
-    int m_totaltasks=m_tasklist.size();
-    int m_currenttask=0;
+
+    // Store() is serialized by saveMutex. UpdateSummaries() runs in parallel and feeds this
+    // machine's channel and setting indexes through updateChannels(), which locks m_sortedMutex
+    QThreadPool pool;
+
     while (!m_tasklist.isEmpty()) {
-        if (threadpool->tryStart(m_tasklist.at(0))) {
-            m_tasklist.pop_front();
-            float f = float(m_currenttask) / float(m_totaltasks) * 100.0;
-            qprogress->setValue(f);
-            m_currenttask++;
-        }
-        QApplication::processEvents();
+        pool.start(m_tasklist.takeFirst());
     }
-    QThreadPool::globalInstance()->waitForDone(-1);
+
+    // No event pumping here. Tasks rewrite summaries and free events of sessions the GUI may be
+    // showing, so it must not repaint until they're done, just as when they ran inline
+    pool.waitForDone(-1);
 }
 
 bool Machine::hasModifiedSessions()
@@ -866,12 +938,53 @@ bool Machine::hasModifiedSessions()
 const QString summaryFileName = "Summaries.xml";
 const int summaryxml_version=1;
 
-bool Machine::LoadSummary(QProgressBar * progress)
+bool Machine::LoadSummary(QProgressBar * progress, QList<Session *> *index)
 {
+    TRACE_SCOPE(Trace::CAT_Machine, "Machine::LoadSummary");
+
     QTime time;
     time.start();
     qDebug() << "Loading Summaries";
 
+    QList<Session *> sessions;
+    if (index) {
+        sessions = *index;
+    } else if (!ReadSummaryIndex(sessions)) {
+        return false;
+    }
+
+    // Decode the summary files in parallel before any of the sessions are attached
+    if (p_profile->session->preloadSummaries()) {
+        QVector<bool> loaded;
+        LoadSessionSummaries(sessions, loaded, progress);
+    }
+
+    int size = sessions.size();
+
+    // Then add them in one ordered pass
+    progress->setMaximum(size);
+    for (int cnt = 0; cnt < size; ++cnt) {
+        if ((cnt % 100) == 0) {
+            progress->setValue(cnt);
+            QApplication::processEvents();
+        }
+        Session * sess = sessions.at(cnt);
+        if (!AddSession(sess)) {
+            delete sess;
+        }
+    }
+    progress->setValue(size);
+    QApplication::processEvents();
+
+    qDebug() << "Loaded" << info.series << info.model << "data in" << time.elapsed() << "ms";
+
+    return true;
+}
+
+bool Machine::ReadSummaryIndex(QList<Session *> &sessions)
+{
+    TRACE_SCOPE(Trace::CAT_Machine, "Machine::ReadSummaryIndex");
+
     QString filename = getDataPath() + summaryFileName + ".gz";
 
     QDomDocument doc;
@@ -934,6 +1047,7 @@ bool Machine::LoadSummary(QProgressBar * progress)
             sess->really_set_last(last);
             sess->setEnabled(enabled);
             sess->setSummaryOnly(!events);
+            sess->setSummaryOnDisk(true);
 
             if (e.hasChildNodes()) {
                 QList<ChannelID> available_channels;
@@ -969,34 +1083,15 @@ bool Machine::LoadSummary(QProgressBar * progress)
             sess_order[first] = sess;
         }
     }
-    QMap<qint64, Session *>::iterator it_end = sess_order.end();
-    QMap<qint64, Session *>::iterator it;
-    int cnt = 0;
-    bool loadSummaries = p_profile->session->preloadSummaries();
-
-    progress->setMaximum(sess_order.size());
-    for (it = sess_order.begin(); it != it_end; ++it, ++cnt) {
-        if ((cnt % 100) == 0) {
-            progress->setValue(cnt);
-            QApplication::processEvents();
-        }
-        Session * sess = it.value();
-        if (!AddSession(sess)) {
-            delete sess;
-        } else {
-            if (loadSummaries) sess->LoadSummary();
-        }
-    }
-    progress->setValue(sess_order.size());
-    QApplication::processEvents();
-
-    qDebug() << "Loaded" << info.series << info.model << "data in" << time.elapsed() << "ms";
 
+    sessions = sess_order.values();
     return true;
 }
 
 bool Machine::SaveSummary()
 {
+    TRACE_SCOPE(Trace::CAT_Machine, "Machine::SaveSummary");
+
     qDebug() << "Saving" << info.brand << info.model <<  "Summaries";
     QString filename = getDataPath() + summaryFileName;
 
@@ -1074,6 +1169,8 @@ bool Machine::SaveSummary()
 
 bool Machine::Save()
 {
+    TRACE_SCOPE(Trace::CAT_Machine, "Machine::Save");
+
     //int size;
     int cnt = 0;
 
@@ -1104,22 +1201,58 @@ bool Machine::Save()
 
 void Machine::updateChannels(Session * sess)
 {
-    int size = sess->m_availableChannels.size();
-    for (int i=0; i < size; ++i) {
-        ChannelID code = sess->m_availableChannels.at(i);
-        m_availableChannels[code] = true;
+    int size;
+    {
+        // Runs on loader, save and prefetch threads while the GUI asks for sortedChannels()
+        QMutexLocker lock(&m_sortedMutex);
+
+        bool added = false;
+        size = sess->m_availableChannels.size();
+        for (int i=0; i < size; ++i) {
+            ChannelID code = sess->m_availableChannels.at(i);
+            if (!m_availableChannels.contains(code)) {
+                m_availableChannels[code] = true;
+                added = true;
+            }
+        }
+
+        if (added) {
+            m_sortedChannels.clear();
+        }
+
+        size = sess->m_availableSettings.size();
+        for (int i=0; i < size; ++i) {
+            ChannelID code = sess->m_availableSettings.at(i);
+            m_availableSettings[code] = true;
+        }
+    }
+}
+
+QList<ChannelID> Machine::sortedChannels(quint32 chantype)
+{
+    // Day asks for these for every day drawn or summarised, from the statistics worker too
+    QMutexLocker lock(&m_sortedMutex);
+
+    int revision = schema::revision();
+    if (revision != m_sortedRevision) {
+        m_sortedChannels.clear();
+        m_sortedRevision = revision;
     }
 
-    size = sess->m_availableSettings.size();
-    for (int i=0; i < size; ++i) {
-        ChannelID code = sess->m_availableSettings.at(i);
-        m_availableSettings[code] = true;
+    QHash<quint32, QList<ChannelID> >::iterator it = m_sortedChannels.find(chantype);
+    if (it != m_sortedChannels.end()) {
+        return it.value();
     }
+
+    QList<ChannelID> list = schema::channel.sorted(m_availableChannels.keys(), chantype);
+    m_sortedChannels.insert(chantype, list);
+    return list;
 }
 
 QList<ChannelID> Machine::availableChannels(quint32 chantype)
 {
     QList<ChannelID> list;
+    QMutexLocker lock(&m_sortedMutex);
 
     QHash<ChannelID, bool>::iterator end = m_availableChannels.end();
     QHash<ChannelID, bool>::iterator it;
@@ -86,9 +86,17 @@ class Machine
     Machine(MachineID id = 0);
     virtual ~Machine();
 
-    //! \brief Load all Machine summary data
-    bool Load();
-    bool LoadSummary(QProgressBar * progress);
+    /*! \brief Load all Machine summary data
+        If index is given, it holds the sessions already parsed by ReadSummaryIndex() */
+    bool Load(QList<Session *> *index = nullptr);
+    bool LoadSummary(QProgressBar * progress, QList<Session *> *index = nullptr);
+
+    /*! \brief Parses the summary index into new Sessions sorted by start time, without attaching them.
+        Touches no Machine or Profile state, so machines can do this in parallel */
+    bool ReadSummaryIndex(QList<Session *> &sessions);
+
+    //! \brief Decodes summary files for unattached sessions across a thread pool, loaded[i] is set for each success
+    static void LoadSessionSummaries(const QList<Session *> &sessions, QVector<bool> &loaded, QProgressBar *progress);
 
     //! \brief Save all Sessions where changed bit is set.
     bool Save();
@@ -106,10 +114,12 @@ class Machine
     bool unlinkDay(Day * day);
 
     inline bool hasChannel(ChannelID code) {
+        QMutexLocker lock(&m_sortedMutex);
         return m_availableChannels.contains(code);
     }
 
     inline bool hasSetting(ChannelID code) {
+        QMutexLocker lock(&m_sortedMutex);
         return m_availableSettings.contains(code);
     }
 
@@ -219,6 +229,9 @@ class Machine
 
     QList<ChannelID> availableChannels(quint32 chantype);
 
+    //! \brief Returns the available channels of chantype in display order, cached until the schema or channels change
+    QList<ChannelID> sortedChannels(quint32 chantype);
+
     MachineLoader * loader() { return m_loader; }
 
     // much more simpler multithreading...
@@ -259,6 +272,13 @@ class Machine
     QHash<ChannelID, bool> m_availableChannels;
     QHash<ChannelID, bool> m_availableSettings;
 
+    //! \brief sortedChannels() results by chantype, valid for m_sortedRevision of the schema
+    QHash<quint32, QList<ChannelID> > m_sortedChannels;
+    int m_sortedRevision;
+
+    //! \brief Guards m_availableChannels, m_availableSettings and m_sortedChannels
+    QMutex m_sortedMutex;
+
     QString m_summaryPath;
     QString m_eventsPath;
     QString m_dataPath;
@@ -11,6 +11,7 @@
 #include <QFile>
 #include <QDir>
 #include <QThreadPool>
+#include <algorithm>
 
 extern QProgressBar *qprogress;
 
@@ -182,20 +183,35 @@ MachineLoader::~MachineLoader()
     }
 }
 
+// Day assignment order, so the outcome doesn't depend on which import thread finished first
+static bool sessionStartsBefore(Session *a, Session *b)
+{
+    qint64 fa = a->first(), fb = b->first();
+
+    if (fa != fb) {
+        return fa < fb;
+    }
+
+    return a->session() < b->session();
+}
+
 void MachineLoader::finishAddingSessions()
 {
-    QMap<SessionID, Session *>::iterator it;
-    QMap<SessionID, Session *>::iterator it_end = new_sessions.end();
+    // Phase two: tasks have parsed, calculated and stored their sessions independently, now
+    // assign them to days serially, on the main thread, as daySplitTime and combineCloseSessions
+    // look at neighbouring days. new_sessions is already in session id order, sorting by start
+    // time only matters for loaders whose ids don't follow the clock.
+    QList<Session *> sessions = new_sessions.values();
+    new_sessions.clear();
 
-    // Using a map specifically so they are inserted in order.
-    for (it = new_sessions.begin(); it != it_end; ++it) {
-        Session * sess = it.value();
+    std::sort(sessions.begin(), sessions.end(), sessionStartsBefore);
+
+    for (int i = 0; i < sessions.size(); ++i) {
+        Session * sess = sessions.at(i);
         Machine * mach = sess->machine();
         mach->AddSession(sess);
     }
 
-    new_sessions.clear();
-
     QHash<QString, QHash<QString, Machine *> >::iterator mlit = MachineList.find(loaderName());
 
     if (mlit != MachineList.end()) {
@@ -214,41 +230,31 @@ bool compressFile(QString inpath, QString outpath)
         outpath += ".gz";
     }
 
-    QFile f(inpath);
+    // inpath may be inside a zipped card
+    qint64 size = FileSource::size(inpath);
 
-    if (!f.exists(inpath)) {
+    if (size < 0) {
         qDebug() << "compressFile()" << inpath << "does not exist";
         return false;
     }
 
-    qint64 size = f.size();
-
-    if (!f.open(QFile::ReadOnly)) {
-        qDebug() << "compressFile() Couldn't open" << inpath;
-        return false;
-    }
-
-    char *buf = new char [size];
+    QByteArray buf = FileSource::read(inpath);
 
-    if (!f.read(buf, size)) {
-        delete buf;
+    if (buf.size() != size) {
         qDebug() << "compressFile() Couldn't read all of" << inpath;
         return false;
     }
 
-    f.close();
     gzFile gz = gzopen(outpath.toLatin1(), "wb");
 
     //gzbuffer(gz,65536*2);
     if (!gz) {
         qDebug() << "compressFile() Couldn't open" << outpath << "for writing";
-        delete buf;
         return false;
     }
 
-    gzwrite(gz, buf, size);
+    gzwrite(gz, buf.constData(), size);
     gzclose(gz);
-    delete buf;
     return true;
 }
 
@@ -16,6 +16,7 @@
 
 #include "profiles.h"
 #include "machine.h"
+#include "filesource.h"
 #include "zlib.h"
 
 
@@ -65,8 +66,10 @@ class MachineLoader: public QObject
         emit machineUnsupported(m);
     }
 
+    //! \brief Queue a parse task for runTasks(). Tasks must hand their sessions to addSession(), never Machine::AddSession
     void queTask(ImportTask * task);
 
+    //! \brief Collect a detached session from an import task, thread safe. Days get assigned in finishAddingSessions()
     void addSession(Session * sess)
     {
         sessionMutex.lock();
@@ -129,6 +132,7 @@ protected:
 
     DeviceStatus m_status;
 
+    //! \brief Adds collected sessions to their machines in start time order, then saves the summaries
     void finishAddingSessions();
     QMap<SessionID, Session *> new_sessions;
 
@@ -16,6 +16,9 @@
 #include <QDesktopServices>
 #include <QDebug>
 #include <QSettings>
+#include <QFile>
+#include <QFileInfo>
+#include <QDataStream>
 #ifdef Q_OS_WIN32
 #include "windows.h"
 #include "lmcons.h"
@@ -23,6 +26,7 @@
 
 #include "common.h"
 #include "preferences.h"
+#include "machine_common.h"
 
 const QString &getUserName()
 {
@@ -82,6 +86,102 @@ QString GetAppRoot()
     return HomeAppRoot;
 }
 
+// Bump this if the snapshot header, or what goes into a snapshot, changes
+const quint16 snapshot_version = 2;
+
+QString snapshotFilename(const QString &xmlfile)
+{
+    QString filename = xmlfile;
+
+    if (filename.endsWith(STR_ext_XML, Qt::CaseInsensitive)) {
+        filename.chop(STR_ext_XML.size());
+    }
+
+    return filename + ".bin";
+}
+
+quint32 fileStamp(const QString &filename)
+{
+    QFileInfo fi(filename);
+
+    if (!fi.exists()) {
+        return 0;
+    }
+
+    QByteArray ba;
+    QDataStream out(&ba, QIODevice::WriteOnly);
+    out << fi.size() << fi.lastModified().toMSecsSinceEpoch();
+
+    quint32 stamp = crc32buf(ba);
+    return stamp ? stamp : 1; // 0 means missing
+}
+
+bool writeSnapshot(const QString &filename, quint16 filetype, quint32 stamp, const QByteArray &payload)
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_6);
+    out << magic << filetype << snapshot_version << stamp << crc32buf(payload) << payload;
+
+    QFile file(filename);
+
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Could not write" << QDir::toNativeSeparators(filename);
+        return false;
+    }
+
+    bool ok = (file.write(data) == data.size());
+    file.close();
+
+    if (!ok) {
+        file.remove();
+    }
+
+    return ok;
+}
+
+QByteArray readSnapshot(const QString &filename, quint16 filetype, quint32 stamp)
+{
+    if (stamp == 0) {
+        // The file it was taken from is gone
+        return QByteArray();
+    }
+
+    QFile file(filename);
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+
+    QByteArray data = file.readAll();
+    file.close();
+
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_4_6);
+
+    quint32 mag32, st32, crc;
+    quint16 t16, version;
+    QByteArray payload;
+
+    in >> mag32 >> t16 >> version >> st32 >> crc >> payload;
+
+    if ((in.status() != QDataStream::Ok) || (mag32 != magic) || (t16 != filetype) || (version != snapshot_version)) {
+        return QByteArray();
+    }
+
+    if (st32 != stamp) {
+        // XML was written since, by us or by hand
+        return QByteArray();
+    }
+
+    if (crc32buf(payload) != crc) {
+        qWarning() << "Damaged snapshot" << QDir::toNativeSeparators(filename);
+        return QByteArray();
+    }
+
+    return payload;
+}
+
 
 Preferences::Preferences()
 {
@@ -182,6 +282,10 @@ bool Preferences::Open(QString filename)
         p_filename = filename;
     }
 
+    if (OpenSnapshot()) {
+        return true;
+    }
+
     QDomDocument doc(p_name);
     QFile file(p_filename);
     qDebug() << "Reading " << QDir::toNativeSeparators(p_filename);
@@ -338,7 +442,8 @@ bool Preferences::Save(QString filename)
         root.appendChild(cn);
     }
 
-    droot.appendChild(ExtraSave(doc));
+    QDomElement extra = ExtraSave(doc);
+    droot.appendChild(extra);
 
     QFile file(p_filename);
 
@@ -350,7 +455,100 @@ bool Preferences::Save(QString filename)
     ts << doc.toString();
     file.close();
 
+    // Custom sections only live in the XML, so they rule out a snapshot
+    SaveSnapshot(extra.isNull());
+
     return true;
 }
 
+bool Preferences::OpenSnapshot()
+{
+    QByteArray payload = readSnapshot(snapshotFilename(p_filename), filetype_prefsnapshot, fileStamp(p_filename));
+
+    if (payload.isEmpty()) {
+        return false;
+    }
+
+    QDataStream in(payload);
+    in.setVersion(QDataStream::Qt_4_6);
+
+    QString name;
+    QHash<QString, QVariant> prefs;
+    in >> name >> prefs;
+
+    if ((in.status() != QDataStream::Ok) || (name != p_name)) {
+        return false;
+    }
+
+    qDebug() << "Reading snapshot of" << QDir::toNativeSeparators(p_filename);
+    p_preferences = prefs;
+    return true;
+}
+
+void Preferences::SaveSnapshot(bool usable)
+{
+    QString filename = snapshotFilename(p_filename);
+    QHash<QString, QVariant> prefs;
+
+    for (QHash<QString, QVariant>::iterator i = p_preferences.begin(); usable && (i != p_preferences.end()); ++i) {
+        switch (i.value().type()) {
+        case QVariant::Invalid:
+            // Save() skips these too
+            break;
+
+        // The snapshot has to hand back exactly what Open() would have read from the XML
+        case QVariant::Bool:
+        case QVariant::Int:
+        case QVariant::LongLong:
+        case QVariant::Double:
+        case QVariant::String:
+            prefs[i.key()] = i.value();
+            break;
+
+        case QVariant::DateTime: {
+            // Only whole seconds survive the XML
+            QDateTime d = QDateTime::fromString(i.value().toDateTime().toString("yyyy-MM-dd HH:mm:ss"), "yyyy-MM-dd HH:mm:ss");
+            if (d.isValid()) {
+                prefs[i.key()] = d;
+            }
+            break;
+        }
+
+        case QVariant::Time: {
+            QTime d = QTime::fromString(i.value().toTime().toString("hh:mm:ss"), "hh:mm:ss");
+            if (d.isValid()) {
+                prefs[i.key()] = d;
+            }
+            break;
+        }
+
+        case QVariant::UInt:
+        case QVariant::ULongLong:
+        case QVariant::Date:
+        case QVariant::Color:
+            // Open() has no reader for these, so they come back from the XML as their text
+            prefs[i.key()] = i.value().toString();
+            break;
+
+        default:
+            // Anything fancier goes through the XML only
+            usable = false;
+        }
+    }
+
+    quint32 stamp = fileStamp(p_filename);
+
+    if (!usable || (stamp == 0)) {
+        QFile::remove(filename);
+        return;
+    }
+
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_6);
+    out << p_name << prefs;
+
+    writeSnapshot(filename, filetype_prefsnapshot, stamp, payload);
+}
+
 
@@ -28,6 +28,20 @@ inline QString PrefMacro(QString s)
 //! \brief Returns a QString containing the Username, according to the Operating System
 const QString &getUserName();
 
+//! \brief Returns the binary snapshot filename kept beside xmlfile, the same name ending in .bin
+QString snapshotFilename(const QString &xmlfile);
+
+//! \brief Returns a stamp of filename's size and modification time, or 0 if it doesn't exist
+quint32 fileStamp(const QString &filename);
+
+/*! \brief Writes payload to filename as a binary snapshot of the file whose fileStamp() is stamp.
+    The payload is checksummed, so a torn or damaged snapshot is never mistaken for a good one */
+bool writeSnapshot(const QString &filename, quint16 filetype, quint32 stamp, const QByteArray &payload);
+
+/*! \brief Reads a snapshot in a single read, returning its payload.
+    Returns an empty QByteArray if it's missing, damaged, or wasn't written for filetype and stamp */
+QByteArray readSnapshot(const QString &filename, quint16 filetype, quint32 stamp);
+
 
 /*! \class Preferences
     \author Mark Watkins <jedimark_at_users.sourceforge.net>
@@ -92,11 +106,12 @@ class Preferences
     virtual QDomElement ExtraSave(QDomDocument &doc) { doc = doc; QDomElement e; return e; }
 
     //! \brief Opens, processes the XML for this Preferences group, loading all preferences stored therein.
-    //! \note If filename is empty, it will use the one specified in the constructor
+    //! \note If filename is empty, it will use the one specified in the constructor.
+    //!       A binary snapshot written by Save() is used instead when it's still current with the XML
     //! \returns true if succesful
     virtual bool Open(QString filename = "");
 
-    //! \brief Saves all preferences to XML file.
+    //! \brief Saves all preferences to XML file, plus a binary snapshot of them for faster startup
     //! \note If filename is empty, it will use the one specified in the constructor
     //! \returns true if succesful
     virtual bool Save(QString filename = "");
@@ -127,6 +142,12 @@ class Preferences
     const QString name() { return p_name; }
 
   protected:
+    //! \brief Loads the preferences from the binary snapshot, returns false if there isn't a current one
+    bool OpenSnapshot();
+
+    //! \brief Writes the binary snapshot matching the XML just saved, or removes it if the preferences won't fit one
+    void SaveSnapshot(bool usable);
+
     //QHash<int,QString> p_codes;
     QString p_comment;
     QString p_name;
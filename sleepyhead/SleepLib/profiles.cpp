@@ -13,7 +13,11 @@
 #include <QDebug>
 #include <QProcess>
 #include <QByteArray>
+#include <QDataStream>
 #include <QHostInfo>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
 #include <algorithm>
 #include <cmath>
 
@@ -23,6 +27,7 @@
 #include "machine_common.h"
 
 #include "machine_loader.h"
+#include "journal.h"
 
 #include <QApplication>
 #include "mainwindow.h"
@@ -62,10 +67,14 @@ Profile::Profile(QString path)
     appearance = nullptr;
     session = nullptr;
     general = nullptr;
+
+    m_journalindex = nullptr;
 }
 
 Profile::~Profile()
 {
+    delete m_journalindex;
+
     QString lockfile=p_path+"/lockfile";
     QFile file(lockfile);
     file.remove();
@@ -173,6 +182,12 @@ bool Profile::OpenMachines()
     lockfile.close();
 
     QString filename = p_path+"machines.xml";
+
+    if (OpenMachineSnapshot(filename)) {
+        m_machopened = true;
+        return true;
+    }
+
     QFile file(filename);
     if (!file.open(QFile::ReadOnly)) {
         qWarning() << "Could not open" << QDir::toNativeSeparators(filename);
@@ -330,9 +345,79 @@ bool Profile::StoreMachines()
         return false;
     }
     file.write(doc.toByteArray());
+    file.close();
+
+    StoreMachineSnapshot(filename);
+    return true;
+}
+
+bool Profile::OpenMachineSnapshot(const QString &filename)
+{
+    QByteArray payload = readSnapshot(snapshotFilename(filename), filetype_machinesnapshot, fileStamp(filename));
+
+    if (payload.isEmpty()) {
+        return false;
+    }
+
+    QDataStream in(payload);
+    in.setVersion(QDataStream::Qt_4_6);
+
+    quint32 count;
+    in >> count;
+
+    QList<int> ids;
+    QList<MachineInfo> infos;
+    QList<QHash<QString, QString> > props;
+
+    // Read it all first, so a bad snapshot doesn't leave half the machines created
+    for (quint32 i = 0; (i < count) && (in.status() == QDataStream::Ok); ++i) {
+        qint32 id, type, version;
+        MachineInfo info;
+        QHash<QString, QString> prop;
+
+        in >> id >> type >> info.loadername >> info.brand >> info.model >> info.modelnumber
+           >> info.serial >> info.series >> version >> info.lastimported >> prop;
+
+        info.type = (MachineType)type;
+        info.version = version;
+
+        ids.push_back(id);
+        infos.push_back(info);
+        props.push_back(prop);
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        qWarning() << "Couldn't read snapshot of" << QDir::toNativeSeparators(filename);
+        return false;
+    }
+
+    for (int i = 0; i < ids.size(); ++i) {
+        Machine *m = MachineLoader::CreateMachine(infos[i], ids[i]);
+        if (m) m->properties = props[i];
+    }
+
     return true;
 }
 
+void Profile::StoreMachineSnapshot(const QString &filename)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_6);
+
+    out << (quint32)machlist.size();
+
+    for (QHash<MachineID, Machine *>::iterator i = machlist.begin(); i != machlist.end(); i++) {
+        Machine *m = i.value();
+
+        out << (qint32)m->id() << (qint32)m->type() << m->loaderName() << m->brand() << m->model()
+            << m->modelnumber() << m->serial() << m->series() << (qint32)m->version()
+            << m->lastImported() << m->properties;
+    }
+
+    writeSnapshot(snapshotFilename(filename), filetype_machinesnapshot, fileStamp(filename), payload);
+}
+
 
 #if defined(Q_OS_WIN)
 class Environment
@@ -569,31 +654,73 @@ void Profile::DataFormatError(Machine *m)
     return;
 
 }
+/*! \class SummaryIndexTask
+    \brief Parses one Machine's summary index on a worker thread
+    */
+class SummaryIndexTask : public QRunnable
+{
+  public:
+    SummaryIndexTask(Machine *mach, QList<Session *> *sessions, bool *ok)
+        : m_mach(mach), m_sessions(sessions), m_ok(ok) {}
+    virtual ~SummaryIndexTask() {}
+
+    virtual void run() {
+        *m_ok = m_mach->ReadSummaryIndex(*m_sessions);
+    }
+
+  protected:
+    Machine *m_mach;
+    QList<Session *> *m_sessions;
+    bool *m_ok;
+};
+
 void Profile::LoadMachineData()
 {
     if (!m_machopened) OpenMachines();
-    QHash<MachineID, QMap<QDate, QHash<ChannelID, EventDataType> > > cache;
+
+    QList<Machine *> machines;
 
     for (QHash<MachineID, Machine *>::iterator i = machlist.begin(); i != machlist.end(); i++) {
         Machine *m = i.value();
 
         MachineLoader *loader = lookupLoader(m);
 
-        if (loader) {
-            if (m->version() < loader->Version()) {
-                DataFormatError(m);
-            } else {
-                try {
-                    m->Load();
-                } catch (OldDBVersion& e) {
-                    Q_UNUSED(e)
-                    DataFormatError(m);
-                }
-            }
+        if (loader && (m->version() < loader->Version())) {
+            DataFormatError(m);
         } else {
-            m->Load();
+            machines.append(m);
         }
     }
+
+    // Each machine has its own summary index, so parse them all at once
+    int size = machines.size();
+    QVector<QList<Session *> > indexes(size);
+    QVector<bool> indexed(size, false);
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+    for (int i = 0; i < size; ++i) {
+        pool.start(new SummaryIndexTask(machines.at(i), &indexes[i], &indexed[i]));
+    }
+    while (!pool.waitForDone(50)) {
+        QApplication::processEvents();
+    }
+
+    // Then attach them machine by machine, any without a usable index get rebuilt the slow way
+    for (int i = 0; i < size; ++i) {
+        Machine *m = machines.at(i);
+        try {
+            m->Load(indexed[i] ? &indexes[i] : nullptr);
+        } catch (OldDBVersion& e) {
+            Q_UNUSED(e)
+            DataFormatError(m);
+        }
+    }
+
+    // Anything indexed before now missed these days
+    if (m_journalindex) {
+        m_journalindex->invalidate();
+    }
 }
 
 
@@ -650,6 +777,7 @@ Day *Profile::addDay(QDate date)
     QMap<QDate, Day *>::iterator dit = daylist.find(date);
     if (dit == daylist.end()) {
         dit = daylist.insert(date, new Day());
+        m_dayindex.invalidate();
     }
     Day * day = dit.value();
     day->setDate(date);
@@ -673,22 +801,11 @@ Day *Profile::addDay(QDate date)
 // and has enabled session data, else return nullptr
 Day *Profile::GetGoodDay(QDate date, MachineType type)
 {
-    Day *day = GetDay(date, type);
-    if (!day)
-        return nullptr;
-
-    // For a machine match, find at least one enabled Session.
-    for (int i = 0; i < day->size(); ++i) {
-        Session * sess = (*day)[i];
-        if (((type == MT_UNKNOWN) || (sess->type() == type)) && sess->enabled()) {
-            day->OpenSummary();
-
-            return day;
-        }
+    Day *day = FindGoodDay(date, type);
+    if (day) {
+        day->OpenSummary();
     }
-
-    // No enabled Sessions were found.
-    return nullptr;
+    return day;
 }
 
 Day *Profile::FindGoodDay(QDate date, MachineType type)
@@ -698,15 +815,9 @@ Day *Profile::FindGoodDay(QDate date, MachineType type)
         return nullptr;
 
     // For a machine match, find at least one enabled Session.
-    for (int i = 0; i < day->size(); ++i) {
-        Session * sess = (*day)[i];
-        if (((type == MT_UNKNOWN) || (sess->type() == type)) && sess->enabled()) {
-            return day;
-        }
-    }
+    bool enabled = (type == MT_UNKNOWN) ? day->hasEnabledSessions() : day->hasEnabledSessions(type);
 
-    // No enabled Sessions were found.
-    return nullptr;
+    return enabled ? day : nullptr;
 }
 
 
@@ -859,6 +970,7 @@ bool Profile::unlinkDay(Day * day)
     for (it = daylist.begin(); it != it_end; ++it) {
         if (it.value() == day) {
             daylist.erase(it);
+            m_dayindex.invalidate();
             return true;
         }
     }
@@ -1004,7 +1116,147 @@ void Scan()
 } // namespace Profiles
 
 
-// Returns a list of all days records matching machine type between start and end date
+void DayIndex::invalidate()
+{
+    QMutexLocker lock(&m_mutex);
+    m_valid = false;
+    m_types.clear();
+}
+
+DayIndex::Snapshot DayIndex::snapshot(const QMap<QDate, Day *> &daylist, MachineType mt, EventDataType compliance)
+{
+    QMutexLocker lock(&m_mutex);
+    update(daylist);
+
+    Snapshot snap;
+    snap.type = type(mt, compliance);
+    snap.base = m_base;
+    snap.days = m_days;
+    return snap;
+}
+
+void DayIndex::update(const QMap<QDate, Day *> &daylist)
+{
+    if (m_valid) {
+        return;
+    }
+
+    m_types.clear();
+    m_days.clear();
+    m_base = 0;
+    m_valid = true;
+
+    if (daylist.isEmpty()) {
+        return;
+    }
+
+    m_base = daylist.firstKey().toJulianDay();
+    m_days.fill(nullptr, int(daylist.lastKey().toJulianDay() - m_base + 1));
+
+    QMap<QDate, Day *>::const_iterator it;
+    QMap<QDate, Day *>::const_iterator it_end = daylist.end();
+
+    for (it = daylist.begin(); it != it_end; ++it) {
+        m_days[int(it.key().toJulianDay() - m_base)] = it.value();
+    }
+}
+
+const DayIndex::TypeIndex &DayIndex::type(MachineType mt, EventDataType compliance)
+{
+    TypeIndex &idx = m_types[int(mt)];
+    int size = m_days.size();
+
+    if ((idx.goodcount.size() == size + 1) && (idx.compliance == compliance)) {
+        return idx;
+    }
+
+    idx.good.fill(false, size);
+    idx.compliant.fill(false, size);
+    idx.goodcount.resize(size + 1);
+    idx.compliantcount.resize(size + 1);
+    idx.hours.resize(size + 1);
+    idx.compliance = compliance;
+
+    int good = 0, compliant = 0;
+    double hours = 0;
+
+    idx.goodcount[0] = idx.compliantcount[0] = 0;
+    idx.hours[0] = 0;
+
+    for (int i = 0; i < size; ++i) {
+        Day *day = m_days.at(i);
+
+        if (day && ((mt == MT_UNKNOWN) ? day->hasEnabledSessions() : day->hasEnabledSessions(mt))) {
+            idx.good.setBit(i);
+            good++;
+            hours += day->hours();
+
+            if (day->hours(mt) > compliance) {
+                idx.compliant.setBit(i);
+                compliant++;
+            }
+        }
+
+        idx.goodcount[i + 1] = good;
+        idx.compliantcount[i + 1] = compliant;
+        idx.hours[i + 1] = hours;
+    }
+
+    return idx;
+}
+
+bool DayIndex::Snapshot::range(QDate start, QDate end, int &first, int &last) const
+{
+    if (!start.isValid() || !end.isValid() || days.isEmpty()) {
+        return false;
+    }
+
+    qint64 f = qMax(start.toJulianDay() - base, qint64(0));
+    qint64 l = qMin(end.toJulianDay() - base, qint64(days.size() - 1));
+
+    if (f > l) {
+        return false;
+    }
+
+    first = int(f);
+    last = int(l);
+    return true;
+}
+
+DayIndex::Snapshot Profile::dayIndex(MachineType mt)
+{
+    return m_dayindex.snapshot(daylist, mt, cpap->complianceHours());
+}
+
+QList<Day *> Profile::summaryDays(MachineType mt, QDate start, QDate end)
+{
+    QList<Day *> list;
+    DayIndex::Snapshot index = dayIndex(mt);
+    int from, to;
+
+    if (!index.range(start, end, from, to)) {
+        return list;
+    }
+
+    for (int i = from; i <= to; ++i) {
+        if (index.type.good.testBit(i)) {
+            Day *day = index.day(i);
+            day->OpenSummary();
+            list.push_back(day);
+        }
+    }
+
+    return list;
+}
+
+JournalIndex *Profile::journalIndex()
+{
+    if (!m_journalindex) {
+        m_journalindex = new JournalIndex();
+    }
+    return m_journalindex;
+}
+
 QList<Day *> Profile::getDays(MachineType mt, QDate start, QDate end)
 {
     QList<Day *> list;
@@ -1047,67 +1299,30 @@ QList<Day *> Profile::getDays(MachineType mt, QDate start, QDate end)
 
 int Profile::countDays(MachineType mt, QDate start, QDate end)
 {
-    if (!start.isValid()) {
-        return 0;
-    }
-
-    if (!end.isValid()) {
-        return 0;
-    }
-
-    QDate date = start;
+    DayIndex::Snapshot index = dayIndex(mt);
+    int from, to;
 
-    if (date.isNull()) {
+    if (!index.range(start, end, from, to)) {
         return 0;
     }
 
-    int days = 0;
-
-    do {
-        Day *day = FindGoodDay(date, mt);
-
-        if (day) {
-            days++;
-        }
-
-        date = date.addDays(1);
-    } while (date <= end);
-
-    return days;
+    const DayIndex::TypeIndex &idx = index.type;
 
+    return idx.goodcount.at(to + 1) - idx.goodcount.at(from);
 }
 
 int Profile::countCompliantDays(MachineType mt, QDate start, QDate end)
 {
-    EventDataType compliance = cpap->complianceHours();
-
-    if (!start.isValid()) {
-        return 0;
-    }
-
-    if (!end.isValid()) {
-        return 0;
-    }
-
-    QDate date = start;
+    DayIndex::Snapshot index = dayIndex(mt);
+    int from, to;
 
-    if (date.isNull()) {
+    if (!index.range(start, end, from, to)) {
         return 0;
     }
 
-    int days = 0;
-
-    do {
-        Day *day = FindGoodDay(date, mt);
-
-        if (day) {
-            if (day->hours(mt) > compliance) { days++; }
-        }
+    const DayIndex::TypeIndex &idx = index.type;
 
-        date = date.addDays(1);
-    } while (date <= end);
-
-    return days;
+    return idx.compliantcount.at(to + 1) - idx.compliantcount.at(from);
 }
 
 
@@ -1121,23 +1336,15 @@ EventDataType Profile::calcCount(ChannelID code, MachineType mt, QDate start, QD
         end = LastGoodDay(mt);
     }
 
-    QDate date = start;
-
-    if (date.isNull()) {
-        return 0;
-    }
+    QList<Day *> days = summaryDays(mt, start, end);
 
     double val = 0;
 
-    do {
-        Day *day = GetGoodDay(date, mt);
-
-        if (day) {
-            val += day->count(code);
-        }
+    for (int i = 0; i < days.size(); ++i) {
+        Day *day = days.at(i);
 
-        date = date.addDays(1);
-    } while (date <= end);
+        val += day->count(code);
+    }
 
     return val;
 }
@@ -1152,19 +1359,15 @@ double Profile::calcSum(ChannelID code, MachineType mt, QDate start, QDate end)
         end = LastGoodDay(mt);
     }
 
-    QDate date = start;
+    QList<Day *> days = summaryDays(mt, start, end);
 
     double val = 0;
 
-    do {
-        Day *day = GetGoodDay(date, mt);
-
-        if (day) {
-            val += day->sum(code);
-        }
+    for (int i = 0; i < days.size(); ++i) {
+        Day *day = days.at(i);
 
-        date = date.addDays(1);
-    } while (date <= end);
+        val += day->sum(code);
+    }
 
     return val;
 }
@@ -1179,25 +1382,16 @@ EventDataType Profile::calcHours(MachineType mt, QDate start, QDate end)
         end = LastGoodDay(mt);
     }
 
-    QDate date = start;
+    DayIndex::Snapshot index = dayIndex(mt);
+    int from, to;
 
-    if (date.isNull()) {
+    if (!index.range(start, end, from, to)) {
         return 0;
     }
 
-    double val = 0;
+    const DayIndex::TypeIndex &idx = index.type;
 
-    do {
-        Day *day = GetGoodDay(date, mt);
-
-        if (day) {
-            val += day->hours();
-        }
-
-        date = date.addDays(1);
-    } while (date <= end);
-
-    return val;
+    return idx.hours.at(to + 1) - idx.hours.at(from);
 }
 
 EventDataType Profile::calcAboveThreshold(ChannelID code, EventDataType threshold, MachineType mt,
@@ -1211,23 +1405,15 @@ EventDataType Profile::calcAboveThreshold(ChannelID code, EventDataType threshol
         end = LastGoodDay(mt);
     }
 
-    QDate date = start;
-
-    if (date.isNull()) {
-        return 0;
-    }
+    QList<Day *> days = summaryDays(mt, start, end);
 
     EventDataType val = 0;
 
-    do {
-        Day *day = GetGoodDay(date, mt);
-
-        if (day) {
-            val += day->timeAboveThreshold(code, threshold);
-        }
+    for (int i = 0; i < days.size(); ++i) {
+        Day *day = days.at(i);
 
-        date = date.addDays(1);
-    } while (date <= end);
+        val += day->timeAboveThreshold(code, threshold);
+    }
 
     return val;
 }
@@ -1243,23 +1429,15 @@ EventDataType Profile::calcBelowThreshold(ChannelID code, EventDataType threshol
         end = LastGoodDay(mt);
     }
 
-    QDate date = start;
-
-    if (date.isNull()) {
-        return 0;
-    }
+    QList<Day *> days = summaryDays(mt, start, end);
 
     EventDataType val = 0;
 
-    do {
-        Day *day = GetGoodDay(date, mt);
-
-        if (day) {
-            val += day->timeBelowThreshold(code, threshold);
-        }
+    for (int i = 0; i < days.size(); ++i) {
+        Day *day = days.at(i);
 
-        date = date.addDays(1);
-    } while (date <= end);
+        val += day->timeBelowThreshold(code, threshold);
+    }
 
     return val;
 }
@@ -1293,27 +1471,19 @@ EventDataType Profile::calcAvg(ChannelID code, MachineType mt, QDate start, QDat
         end = LastGoodDay(mt);
     }
 
-    QDate date = start;
-
-    if (date.isNull()) {
-        return 0;
-    }
+    QList<Day *> days = summaryDays(mt, start, end);
 
     double val = 0;
     int cnt = 0;
 
-    do {
-        Day *day = GetGoodDay(date, mt);
+    for (int i = 0; i < days.size(); ++i) {
+        Day *day = days.at(i);
 
-        if (day) {
-            if (!day->summaryOnly() || day->hasData(code, ST_AVG)) {
-                val += day->sum(code);
-                cnt++;
-            }
+        if (!day->summaryOnly() || day->hasData(code, ST_AVG)) {
+            val += day->sum(code);
+            cnt++;
         }
-
-        date = date.addDays(1);
-    } while (date <= end);
+    }
 
     if (!cnt) {
         return 0;
@@ -1332,28 +1502,20 @@ EventDataType Profile::calcWavg(ChannelID code, MachineType mt, QDate start, QDa
         end = LastGoodDay(mt);
     }
 
-    QDate date = start;
-
-    if (date.isNull()) {
-        return 0;
-    }
+    QList<Day *> days = summaryDays(mt, start, end);
 
     double val = 0, tmp, tmph, hours = 0;
 
-    do {
-        Day *day = GetGoodDay(date, mt);
-
-        if (day) {
-            if (!day->summaryOnly() || day->hasData(code, ST_WAVG)) {
-                tmph = day->hours();
-                tmp = day->wavg(code);
-                val += tmp * tmph;
-                hours += tmph;
-            }
-        }
+    for (int i = 0; i < days.size(); ++i) {
+        Day *day = days.at(i);
 
-        date = date.addDays(1);
-    } while (date <= end);
+        if (!day->summaryOnly() || day->hasData(code, ST_WAVG)) {
+            tmph = day->hours();
+            tmp = day->wavg(code);
+            val += tmp * tmph;
+            hours += tmph;
+        }
+    }
 
     if (!hours) {
         return 0;
@@ -1373,33 +1535,24 @@ EventDataType Profile::calcMin(ChannelID code, MachineType mt, QDate start, QDat
         end = LastGoodDay(mt);
     }
 
-    QDate date = start;
-
-    if (date.isNull()) {
-        return 0;
-    }
+    QList<Day *> days = summaryDays(mt, start, end);
 
     bool first = true;
 
     double min = 0, tmp;
 
-    do {
-        Day *day = GetGoodDay(date, mt);
+    for (int i = 0; i < days.size(); ++i) {
+        Day *day = days.at(i);
 
-        if (day) {
-            if (!day->summaryOnly() || day->hasData(code, ST_MIN)) {
-                tmp = day->Min(code);
+        if (!day->summaryOnly() || day->hasData(code, ST_MIN)) {
+            tmp = day->Min(code);
 
-                if (first || (min > tmp)) {
-                    min = tmp;
-                    first = false;
-                }
+            if (first || (min > tmp)) {
+                min = tmp;
+                first = false;
             }
-
         }
-
-        date = date.addDays(1);
-    } while (date <= end);
+    }
 
     if (first) {
         min = 0;
@@ -1417,27 +1570,23 @@ EventDataType Profile::calcMax(ChannelID code, MachineType mt, QDate start, QDat
         end = LastGoodDay(mt);
     }
 
-    QDate date = start;
+    QList<Day *> days = summaryDays(mt, start, end);
 
     bool first = true;
     double max = 0, tmp;
 
-    do {
-        Day *day = GetGoodDay(date, mt);
+    for (int i = 0; i < days.size(); ++i) {
+        Day *day = days.at(i);
 
-        if (day) {
-            if (!day->summaryOnly() || day->hasData(code, ST_MAX)) {
-                tmp = day->Max(code);
+        if (!day->summaryOnly() || day->hasData(code, ST_MAX)) {
+            tmp = day->Max(code);
 
-                if (first || (max < tmp)) {
-                    max = tmp;
-                    first = false;
-                }
+            if (first || (max < tmp)) {
+                max = tmp;
+                first = false;
             }
         }
-
-        date = date.addDays(1);
-    } while (date <= end);
+    }
 
     if (first) {
         max = 0;
@@ -1455,29 +1604,21 @@ EventDataType Profile::calcSettingsMin(ChannelID code, MachineType mt, QDate sta
         end = LastGoodDay(mt);
     }
 
-    QDate date = start;
-
-    if (date.isNull()) {
-        return 0;
-    }
+    QList<Day *> days = summaryDays(mt, start, end);
 
     bool first = true;
     double min = 0, tmp;
 
-    do {
-        Day *day = GetGoodDay(date, mt);
+    for (int i = 0; i < days.size(); ++i) {
+        Day *day = days.at(i);
 
-        if (day) {
-            tmp = day->settings_min(code);
+        tmp = day->settings_min(code);
 
-            if (first || (min > tmp)) {
-                min = tmp;
-                first = false;
-            }
+        if (first || (min > tmp)) {
+            min = tmp;
+            first = false;
         }
-
-        date = date.addDays(1);
-    } while (date <= end);
+    }
 
     if (first) {
         min = 0;
@@ -1496,29 +1637,21 @@ EventDataType Profile::calcSettingsMax(ChannelID code, MachineType mt, QDate sta
         end = LastGoodDay(mt);
     }
 
-    QDate date = start;
-
-    if (date.isNull()) {
-        return 0;
-    }
+    QList<Day *> days = summaryDays(mt, start, end);
 
     bool first = true;
     double max = 0, tmp;
 
-    do {
-        Day *day = GetGoodDay(date, mt);
+    for (int i = 0; i < days.size(); ++i) {
+        Day *day = days.at(i);
 
-        if (day) {
-            tmp = day->settings_max(code);
+        tmp = day->settings_max(code);
 
-            if (first || (max < tmp)) {
-                max = tmp;
-                first = false;
-            }
+        if (first || (max < tmp)) {
+            max = tmp;
+            first = false;
         }
-
-        date = date.addDays(1);
-    } while (date <= end);
+    }
 
     if (first) {
         max = 0;
@@ -1545,11 +1678,7 @@ EventDataType Profile::calcPercentile(ChannelID code, EventDataType percent, Mac
         end = LastGoodDay(mt);
     }
 
-    QDate date = start;
-
-    if (date.isNull()) {
-        return 0;
-    }
+    QList<Day *> days = summaryDays(mt, start, end);
 
     QMap<EventDataType, qint64> wmap;
     QMap<EventDataType, qint64>::iterator wmi;
@@ -1565,70 +1694,67 @@ EventDataType Profile::calcPercentile(ChannelID code, EventDataType percent, Mac
     bool timeweight;
     bool summaryOnly = false;
 
-    do {
-        Day *day = GetGoodDay(date, mt);
+    for (int d = 0; d < days.size(); ++d) {
+        Day *day = days.at(d);
 
-        if (day) {
-            if (day->summaryOnly()) {
-                summaryOnly = true;
-                break;
-            }
-            for (int i = 0; i < day->size(); i++) {
-                for (QList<Session *>::iterator s = day->begin(); s != day->end(); s++) {
-                    if (!(*s)->enabled()) {
-                        continue;
-                    }
+        if (day->summaryOnly()) {
+            summaryOnly = true;
+            break;
+        }
+        for (int i = 0; i < day->size(); i++) {
+            for (QList<Session *>::iterator s = day->begin(); s != day->end(); s++) {
+                if (!(*s)->enabled()) {
+                    continue;
+                }
 
-                    Session *sess = *s;
-                    gain = sess->m_gain[code];
+                Session *sess = *s;
+                sess->requireSummary();
+                gain = sess->m_gain[code];
 
-                    if (!gain) { gain = 1; }
+                if (!gain) { gain = 1; }
 
-                    vsi = sess->m_valuesummary.find(code);
+                vsi = sess->m_valuesummary.find(code);
 
-                    if (vsi == sess->m_valuesummary.end()) { continue; }
+                if (vsi == sess->m_valuesummary.end()) { continue; }
 
-                    tsi = sess->m_timesummary.find(code);
-                    timeweight = (tsi != sess->m_timesummary.end());
+                tsi = sess->m_timesummary.find(code);
+                timeweight = (tsi != sess->m_timesummary.end());
 
-                    QHash<EventStoreType, EventStoreType> &vsum = vsi.value();
-                    QHash<EventStoreType, quint32> &tsum = tsi.value();
+                QHash<EventStoreType, EventStoreType> &vsum = vsi.value();
+                QHash<EventStoreType, quint32> &tsum = tsi.value();
 
-                    if (timeweight) {
-                        for (QHash<EventStoreType, quint32>::iterator k = tsum.begin(); k != tsum.end(); k++) {
-                            weight = k.value();
-                            value = EventDataType(k.key()) * gain;
+                if (timeweight) {
+                    for (QHash<EventStoreType, quint32>::iterator k = tsum.begin(); k != tsum.end(); k++) {
+                        weight = k.value();
+                        value = EventDataType(k.key()) * gain;
 
-                            SN += weight;
-                            wmi = wmap.find(value);
+                        SN += weight;
+                        wmi = wmap.find(value);
 
-                            if (wmi == wmap.end()) {
-                                wmap[value] = weight;
-                            } else {
-                                wmi.value() += weight;
-                            }
+                        if (wmi == wmap.end()) {
+                            wmap[value] = weight;
+                        } else {
+                            wmi.value() += weight;
                         }
-                    } else {
-                        for (QHash<EventStoreType, EventStoreType>::iterator k = vsum.begin(); k != vsum.end(); k++) {
-                            weight = k.value();
-                            value = EventDataType(k.key()) * gain;
-
-                            SN += weight;
-                            wmi = wmap.find(value);
-
-                            if (wmi == wmap.end()) {
-                                wmap[value] = weight;
-                            } else {
-                                wmi.value() += weight;
-                            }
+                    }
+                } else {
+                    for (QHash<EventStoreType, EventStoreType>::iterator k = vsum.begin(); k != vsum.end(); k++) {
+                        weight = k.value();
+                        value = EventDataType(k.key()) * gain;
+
+                        SN += weight;
+                        wmi = wmap.find(value);
+
+                        if (wmi == wmap.end()) {
+                            wmap[value] = weight;
+                        } else {
+                            wmi.value() += weight;
                         }
                     }
                 }
             }
         }
-
-        date = date.addDays(1);
-    } while (date <= end);
+    }
 
 
     if (summaryOnly) {
@@ -1747,46 +1873,43 @@ QDate Profile::FirstGoodDay(MachineType mt)
         return FirstDay();
     }
 
-    QDate d = FirstDay(mt);
-    QDate l = LastDay(mt);
+    DayIndex::Snapshot index = dayIndex(mt);
+    const DayIndex::TypeIndex &idx = index.type;
 
-    // No data will return invalid date records
-    if (!d.isValid() || !l.isValid()) {
-        return QDate();
+    // No enabled data falls back to the last day of this type, invalid if there's none at all
+    if (idx.goodcount.last() == 0) {
+        return LastDay(mt);
     }
 
-    do {
-        if (FindGoodDay(d, mt) != nullptr) {
-            return d;
+    for (int i = 0; i < index.size(); ++i) {
+        if (idx.good.testBit(i)) {
+            return index.date(i);
         }
+    }
 
-        d = d.addDays(1);
-    } while (d <= l);
-
-    return l; //m_last;
+    return LastDay(mt);
 }
+
 QDate Profile::LastGoodDay(MachineType mt)
 {
     if (mt == MT_UNKNOWN) {
         return FirstDay();
     }
 
-    QDate d = LastDay(mt);
-    QDate f = FirstDay(mt);
+    DayIndex::Snapshot index = dayIndex(mt);
+    const DayIndex::TypeIndex &idx = index.type;
 
-    if (!(d.isValid() && f.isValid())) {
-        return QDate();
+    if (idx.goodcount.last() == 0) {
+        return FirstDay(mt);
     }
 
-    do {
-        if (FindGoodDay(d, mt) != nullptr) {
-            return d;
+    for (int i = index.size() - 1; i >= 0; --i) {
+        if (idx.good.testBit(i)) {
+            return index.date(i);
         }
+    }
 
-        d = d.addDays(-1);
-    } while (d >= f);
-
-    return f;
+    return FirstDay(mt);
 }
 
 bool Profile::channelAvailable(ChannelID code)
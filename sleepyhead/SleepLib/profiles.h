@@ -12,6 +12,9 @@
 #include <QString>
 #include <QCryptographicHash>
 #include <QThread>
+#include <QBitArray>
+#include <QVector>
+#include <QMutex>
 
 #include "version.h"
 #include "machine.h"
@@ -32,6 +35,74 @@ class OxiSettings;
 class CPAPSettings;
 class AppearanceSettings;
 class SessionSettings;
+class JournalIndex;
+
+/*! \class DayIndex
+    \brief Dense, Julian day indexed view over a profile's day records
+
+    Each machine type gets "has enabled sessions" and "compliant" bitmaps, plus prefix sums
+    of day counts and usage hours, so range counts are O(1) and range aggregates walk an array
+    instead of doing a QMap lookup per date. Rebuilt lazily after it's invalidated.
+
+    The statistics worker and the GUI both read it while sessions are added or toggled, so
+    readers get a Snapshot copy, which the implicitly shared containers make cheap.
+    */
+class DayIndex
+{
+  public:
+    struct TypeIndex {
+        TypeIndex() : compliance(-1) {}
+
+        QBitArray good;
+        QBitArray compliant;
+
+        //! \brief Prefix sums, entry i covers days [0, i)
+        QVector<int> goodcount;
+        QVector<int> compliantcount;
+        QVector<double> hours;
+
+        //! \brief Compliance threshold the compliant bitmap was built with
+        EventDataType compliance;
+    };
+
+    //! \brief The index for one machine type, unaffected by later rebuilds
+    struct Snapshot {
+        Snapshot() : base(0) {}
+
+        //! \brief Clamps start..end to the indexed span, returning false if they don't overlap
+        bool range(QDate start, QDate end, int &first, int &last) const;
+
+        Day *day(int i) const { return days.at(i); }
+        QDate date(int i) const { return QDate::fromJulianDay(base + i); }
+        int size() const { return days.size(); }
+
+        qint64 base;
+        QVector<Day *> days;
+        TypeIndex type;
+    };
+
+    DayIndex() : m_base(0), m_valid(false) {}
+
+    void invalidate();
+
+    //! \brief Returns the index for machine type mt, rebuilding it from daylist first if it's stale
+    Snapshot snapshot(const QMap<QDate, Day *> &daylist, MachineType mt, EventDataType compliance);
+
+  protected:
+    //! \brief Lays out daylist densely, if it's changed since last time
+    void update(const QMap<QDate, Day *> &daylist);
+
+    //! \brief Returns the per-day bitmaps and prefix sums for machine type mt, building them if needed
+    const TypeIndex &type(MachineType mt, EventDataType compliance);
+
+    //! \brief Guards everything below, update() and type() run under it
+    QMutex m_mutex;
+
+    qint64 m_base;
+    QVector<Day *> m_days;
+    QHash<int, TypeIndex> m_types;
+    bool m_valid;
+};
 
 /*!
   \class Profile
@@ -90,6 +161,12 @@ class Profile : public Preferences
     //! \brief Add Day record to Profile Day list
     Day *addDay(QDate date);
 
+    //! \brief Marks the dense day index stale, after days, sessions or their enabled state change
+    void invalidateDayIndex() { m_dayindex.invalidate(); }
+
+    //! \brief Returns the journal bookmark & notes search index, built on first use
+    JournalIndex *journalIndex();
+
     //! \brief Get Day record if data available for date and machine type, else return nullptr
     Day *GetDay(QDate date, MachineType type = MT_UNKNOWN);
 
@@ -220,9 +297,24 @@ class Profile : public Preferences
     SessionSettings *session;
 
   protected:
+    //! \brief Creates the machines from the binary snapshot of filename, returns false if there isn't a current one
+    bool OpenMachineSnapshot(const QString &filename);
+
+    //! \brief Writes a binary snapshot of the machine list beside the just saved filename
+    void StoreMachineSnapshot(const QString &filename);
+
+    //! \brief Returns the dense day index for machine type mt, bringing it up to date first
+    DayIndex::Snapshot dayIndex(MachineType mt);
+
+    //! \brief Returns the days from start to end with enabled sessions of type mt, their summaries loaded
+    QList<Day *> summaryDays(MachineType mt, QDate start, QDate end);
+
     QDate m_first;
     QDate m_last;
 
+    DayIndex m_dayindex;
+    JournalIndex *m_journalindex;
+
     bool m_opened;
     bool m_machopened;
 };
@@ -313,6 +405,9 @@ const QString STR_CS_20cmH2OLeaks = "Custom20cmH2OLeaks";
 const QString STR_IS_DaySplitTime = "DaySplitTime";
 const QString STR_IS_PreloadSummaries = "PreloadSummaries";
 const QString STR_IS_CacheSessions = "MemoryHog";
+const QString STR_IS_EventCacheSize = "EventCacheSize";
+const QString STR_IS_PackedEventCacheSize = "PackedEventCacheSize";
+const QString STR_IS_SummaryCacheSize = "SummaryCacheSize";
 const QString STR_IS_CombineCloseSessions = "CombineCloserSessions";
 const QString STR_IS_IgnoreShorterSessions = "IgnoreShorterSessions";
 const QString STR_IS_Multithreading = "EnableMultithreading";
@@ -663,6 +758,9 @@ class SessionSettings : public ProfileSettings
     {
         initPref(STR_IS_DaySplitTime, QTime(12, 0, 0));
         initPref(STR_IS_CacheSessions, false);
+        initPref(STR_IS_EventCacheSize, 256);
+        initPref(STR_IS_PackedEventCacheSize, 64);
+        initPref(STR_IS_SummaryCacheSize, 2000);
         initPref(STR_IS_PreloadSummaries, false);
         initPref(STR_IS_CombineCloseSessions, 240);
         initPref(STR_IS_IgnoreShorterSessions, 5);
@@ -678,6 +776,9 @@ class SessionSettings : public ProfileSettings
 
     QTime daySplitTime() const { return getPref(STR_IS_DaySplitTime).toTime(); }
     bool cacheSessions() const { return getPref(STR_IS_CacheSessions).toBool(); }
+    int eventCacheSize() const { return getPref(STR_IS_EventCacheSize).toInt(); }
+    int packedEventCacheSize() const { return getPref(STR_IS_PackedEventCacheSize).toInt(); }
+    int summaryCacheSize() const { return getPref(STR_IS_SummaryCacheSize).toInt(); }
     bool preloadSummaries() const { return getPref(STR_IS_PreloadSummaries).toBool(); }
     double combineCloseSessions() const { return getPref(STR_IS_CombineCloseSessions).toDouble(); }
     double ignoreShortSessions() const { return getPref(STR_IS_IgnoreShorterSessions).toDouble(); }
@@ -691,6 +792,9 @@ class SessionSettings : public ProfileSettings
 
     void setDaySplitTime(QTime time) { setPref(STR_IS_DaySplitTime, time); }
     void setCacheSessions(bool c) { setPref(STR_IS_CacheSessions, c); }
+    void setEventCacheSize(int mb) { setPref(STR_IS_EventCacheSize, mb); }
+    void setPackedEventCacheSize(int mb) { setPref(STR_IS_PackedEventCacheSize, mb); }
+    void setSummaryCacheSize(int sessions) { setPref(STR_IS_SummaryCacheSize, sessions); }
     void setPreloadSummaries(bool b) { setPref(STR_IS_PreloadSummaries, b); }
     void setCombineCloseSessions(double val) { setPref(STR_IS_CombineCloseSessions, val); }
     void setIgnoreShortSessions(double val) { setPref(STR_IS_IgnoreShorterSessions, val); }
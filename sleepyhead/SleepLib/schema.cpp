@@ -7,12 +7,16 @@
  * distribution for more details. */
 
 #include <QFile>
+#include <QFileInfo>
+#include <QDataStream>
 #include <QDebug>
 #include <QDomDocument>
 #include <QDomElement>
 #include <QDomNode>
 #include <QMessageBox>
 #include <QApplication>
+#include <QAtomicInt>
+#include <algorithm>
 
 #include "common.h"
 #include "schema.h"
@@ -56,6 +60,18 @@ QHash<QString, ScopeType> Scopes;
 
 bool schema_initialized = false;
 
+QAtomicInt schema_revision;
+
+int revision()
+{
+    return schema_revision.load();
+}
+
+void bumpRevision()
+{
+    schema_revision.fetchAndAddOrdered(1);
+}
+
 void setOrders() {
     schema::channel[CPAP_PB].setOrder(1);
     schema::channel[CPAP_CSR].setOrder(1);
@@ -84,8 +100,7 @@ void init()
     EmptyChannel = Channel(0, DATA, MT_UNKNOWN, DAY, "Empty", "Empty", "Empty Channel", "", "");
     SessionEnabledChannel = new Channel(1, DATA, MT_UNKNOWN, DAY, "Enabled", "Enabled", "Session Enabled", "", "");
 
-    channel.channels[1] = SessionEnabledChannel;
-    channel.names["Enabled"] = SessionEnabledChannel;
+    channel.index(SessionEnabledChannel);
     SESSION_ENABLED = 1;
     ChanTypes["data"] = DATA;
     //Types["waveform"]=WAVEFORM;
@@ -580,9 +595,7 @@ void init()
 
 void resetChannels()
 {
-    schema::channel.channels.clear();
-    schema::channel.names.clear();
-    schema::channel.groups.clear();
+    schema::channel.clear();
 
     schema_initialized = false;
     init();
@@ -639,8 +652,96 @@ bool Channel::isNull()
 }
 
 ChannelList::ChannelList()
-    : m_doctype("channels")
+    : m_doctype("channels"), m_tableRevision(-1)
+{
+}
+
+void ChannelList::index(Channel *chan)
+{
+    ChannelID id = chan->id();
+
+    channels[id] = chan;
+    names[chan->code()] = chan;
+
+    if (id < DenseLimit) {
+        if (id >= ChannelID(m_dense.size())) {
+            m_dense.resize(id + 1);
+        }
+        m_dense[id] = chan;
+    }
+    bumpRevision();
+}
+
+void ChannelList::clear()
+{
+    channels.clear();
+    names.clear();
+    groups.clear();
+    m_dense.clear();
+    bumpRevision();
+}
+
+// Pack (order, id) into one key, which sorts far cheaper than building a QMultiMap
+static inline quint64 sortKey(const Channel &chan, ChannelID code)
+{
+    return (quint64(quint16(chan.order() + 0x8000)) << 32) | code;
+}
+
+void ChannelList::refreshTable()
+{
+    int revision = schema::revision();
+    if (revision == m_tableRevision) {
+        return;
+    }
+
+    // Type or order changes only bump the revision, so rebuild the lot rather than track them one by one
+    int size = m_dense.size();
+    m_denseTypes.resize(size);
+    m_denseKeys.resize(size);
+
+    for (int id = 0; id < size; ++id) {
+        const Channel *chan = m_dense.at(id) ? m_dense.at(id) : &EmptyChannel;
+        m_denseTypes[id] = chan->type();
+        m_denseKeys[id] = sortKey(*chan, ChannelID(id));
+    }
+    m_tableRevision = revision;
+}
+
+QList<ChannelID> ChannelList::sorted(const QList<ChannelID> &codes, quint32 chantype)
 {
+    QVector<quint64> keys;
+    keys.reserve(codes.size());
+
+    {
+        // Machines sort from the statistics worker as well as the GUI thread
+        QMutexLocker lock(&m_tableMutex);
+        refreshTable();
+
+        ChannelID size = m_denseTypes.size();
+
+        for (int i = 0; i < codes.size(); ++i) {
+            ChannelID code = codes.at(i);
+
+            if (code < size) {
+                if (m_denseTypes.at(code) & chantype) {
+                    keys.append(m_denseKeys.at(code));
+                }
+            } else {
+                const Channel & chan = (*this)[code];
+                if (chan.type() & chantype) {
+                    keys.append(sortKey(chan, code));
+                }
+            }
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+
+    QList<ChannelID> list;
+    list.reserve(keys.size());
+    for (int i = 0; i < keys.size(); ++i) {
+        list.append(ChannelID(keys.at(i) & 0xffffffff));
+    }
+    return list;
 }
 ChannelList::~ChannelList()
 {
@@ -648,9 +749,48 @@ ChannelList::~ChannelList()
         delete i.value();
     }
 }
+// One channel from the channels XML, as parsed, so it can be snapshotted and replayed without the DOM
+struct ChannelRecord {
+    QString group;
+    qint32 id;
+    qint32 type;
+    qint32 scope;
+    qint32 datatype;
+    qint32 linkid;
+    qint32 line;
+    QString name, details, label, unit;
+    QColor color;
+    QList<QPair<qint32, QString> > options;
+};
+
+QDataStream &operator<<(QDataStream &out, const ChannelRecord &rec)
+{
+    out << rec.group << rec.id << rec.type << rec.scope << rec.datatype << rec.linkid << rec.line
+        << rec.name << rec.details << rec.label << rec.unit << rec.color << rec.options;
+    return out;
+}
+
+// Appends a name table in a stable order, QHash iteration order changes between runs
+template <typename T>
+static void streamTable(QDataStream &out, const QHash<QString, T> &table)
+{
+    QStringList keys = table.keys();
+    keys.sort();
+
+    for (int i = 0; i < keys.size(); ++i) {
+        out << keys.at(i) << qint32(table.value(keys.at(i)));
+    }
+}
+
+QDataStream &operator>>(QDataStream &in, ChannelRecord &rec)
+{
+    in >> rec.group >> rec.id >> rec.type >> rec.scope >> rec.datatype >> rec.linkid >> rec.line
+       >> rec.name >> rec.details >> rec.label >> rec.unit >> rec.color >> rec.options;
+    return in;
+}
+
 bool ChannelList::Load(QString filename)
 {
-    QDomDocument doc(m_doctype);
     QFile file(filename);
     qDebug() << "Opening " << filename;
 
@@ -659,18 +799,103 @@ bool ChannelList::Load(QString filename)
         return false;
     }
 
+    QByteArray data = file.readAll();
+    file.close();
+
+    // The shipped channels.xml is a resource with no useful date, so snapshots are stamped by content,
+    // and kept in the data folder rather than beside it
+    QString snapfile = filename.startsWith(":") ? GetAppRoot() + "/" + QFileInfo(filename).fileName() : filename;
+    snapfile = snapshotFilename(snapfile);
+
+    // Records hold the enum values the type, scope and datatype names parsed to, so the tables count too
+    QByteArray layout;
+    QDataStream lout(&layout, QIODevice::WriteOnly);
+    lout.setVersion(QDataStream::Qt_4_6);
+    streamTable(lout, ChanTypes);
+    streamTable(lout, Scopes);
+    streamTable(lout, DataTypes);
+
+    quint32 stamp = crc32buf(data + layout);
+    if (stamp == 0) stamp = 1;
+
+    QList<ChannelRecord> records;
+    QByteArray payload = readSnapshot(snapfile, filetype_channelsnapshot, stamp);
+
+    if (!payload.isEmpty()) {
+        QDataStream in(payload);
+        in.setVersion(QDataStream::Qt_4_6);
+        in >> records;
+
+        if (in.status() != QDataStream::Ok) {
+            records.clear();
+            payload.clear();
+        }
+    }
+
+    if (payload.isEmpty()) {
+        if (!parse(data, filename, records)) {
+            return false;
+        }
+
+        QDataStream out(&payload, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_4_6);
+        out << records;
+
+        writeSnapshot(snapfile, filetype_channelsnapshot, stamp, payload);
+    }
+
+    Channel *chan;
+
+    for (int i = 0; i < records.size(); ++i) {
+        const ChannelRecord &rec = records.at(i);
+
+        if (channels.contains(rec.id)) {
+            qWarning() << "Schema already contains id" << rec.id << "in" << filename << "line" << rec.line;
+            continue;
+        }
+
+        if (names.contains(rec.name)) {
+            qWarning() << "Schema already contains name" << rec.name << "in" << filename << "line" << rec.line;
+            continue;
+        }
+
+        chan = new Channel(rec.id, (ChanType)rec.type, MT_UNKNOWN, (ScopeType)rec.scope, rec.name, rec.name, rec.details,
+                           rec.label, rec.unit, (DataType)rec.datatype, rec.color, rec.linkid);
+        index(chan);
+        //qDebug() << "Channel" << id << name << label;
+        groups[rec.group][rec.name] = chan;
+
+        if (rec.linkid > 0) {
+            if (channels.contains(rec.linkid)) {
+                Channel *it = channels[rec.linkid];
+                it->m_links.push_back(chan);
+                //int i=0;
+            } else {
+                qWarning() << "Linked channel must be defined first in" << filename << "line" << rec.line;
+            }
+        }
+
+        for (int j = 0; j < rec.options.size(); ++j) {
+            chan->addOption(rec.options.at(j).first, rec.options.at(j).second);
+        }
+    }
+
+    return true;
+}
+
+bool ChannelList::parse(const QByteArray &data, const QString &filename, QList<ChannelRecord> &records)
+{
+    QDomDocument doc(m_doctype);
+
     QString errorMsg;
     int errorLine;
 
-    if (!doc.setContent(&file, false, &errorMsg, &errorLine)) {
+    if (!doc.setContent(data, false, &errorMsg, &errorLine)) {
         qWarning() << "Invalid XML Content in" << filename;
         qWarning() << "Error line" << errorLine << ":" << errorMsg;
         return false;
     }
 
-    file.close();
-
-
     QDomElement root = doc.documentElement();
 
     if (root.tagName().toLower() != "channels") {
@@ -694,12 +919,8 @@ bool ChannelList::Load(QString filename)
     int id, linkid;
     QString chantype, scopestr, typestr, name, group, idtxt, details, label, unit, datatypestr,
             defcolor, link;
-    ChanType type;
-    DataType datatype;
-    Channel *chan;
     QColor color;
     //bool multi;
-    ScopeType scope;
     int line;
 
     for (int i = 0; i < grp.size(); i++) {
@@ -713,15 +934,15 @@ bool ChannelList::Load(QString filename)
             line = n.lineNumber();
             e = n.toElement();
 
+            ch = n.firstChild();
+            n = n.nextSibling();
+
             if (e.nodeName().toLower() != "channel") {
                 qWarning() << "Ignoring unrecognized schema type " << e.nodeName() << "in" << filename << "line" <<
                            line;
                 continue;
             }
 
-            ch = n.firstChild();
-            n = n.nextSibling();
-
             idtxt = e.attribute("id");
             id = idtxt.toInt(&ok, 16);
 
@@ -737,8 +958,6 @@ bool ChannelList::Load(QString filename)
                 continue;
             }
 
-            type = ChanTypes[chantype];
-
             scopestr = e.attribute("scope", "session");
 
             if (scopestr.at(0) == QChar('!')) {
@@ -751,8 +970,6 @@ bool ChannelList::Load(QString filename)
                 continue;
             }
 
-            scope = Scopes[scopestr];
-
 //            if (PREF[STR_PREF_AllowEventRenaming].toBool()) {
                 name = e.attribute("name", "");
                 details = e.attribute("details", "");
@@ -786,38 +1003,24 @@ bool ChannelList::Load(QString filename)
                 }
             } else { linkid = 0; }
 
-            if (DataTypes.contains(datatypestr)) {
-                datatype = DataTypes[typestr];
-            } else {
+            if (!DataTypes.contains(datatypestr)) {
                 qWarning() << "Ignoring unrecognized schema datatype in" << filename << "line" << line;
                 continue;
             }
 
-            if (channels.contains(id)) {
-                qWarning() << "Schema already contains id" << id << "in" << filename << "line" << line;
-                continue;
-            }
-
-            if (names.contains(name)) {
-                qWarning() << "Schema already contains name" << name << "in" << filename << "line" << line;
-                continue;
-            }
-
-            chan = new Channel(id, type, MT_UNKNOWN, scope, name, name, details, label, unit, datatype, color, linkid);
-            channels[id] = chan;
-            names[name] = chan;
-            //qDebug() << "Channel" << id << name << label;
-            groups[group][name] = chan;
-
-            if (linkid > 0) {
-                if (channels.contains(linkid)) {
-                    Channel *it = channels[linkid];
-                    it->m_links.push_back(chan);
-                    //int i=0;
-                } else {
-                    qWarning() << "Linked channel must be defined first in" << filename << "line" << line;
-                }
-            }
+            ChannelRecord rec;
+            rec.group = group;
+            rec.id = id;
+            rec.type = ChanTypes[chantype];
+            rec.scope = Scopes[scopestr];
+            rec.datatype = DataTypes[typestr];
+            rec.linkid = linkid;
+            rec.line = line;
+            rec.name = name;
+            rec.details = details;
+            rec.label = label;
+            rec.unit = unit;
+            rec.color = color;
 
             // process children
             while (!ch.isNull()) {
@@ -831,12 +1034,14 @@ bool ChannelList::Load(QString filename)
                     id2 = id2str.toInt(&ok, 10);
                     name2str = e.attribute("value");
                     //qDebug() << sub << id2 << name2str;
-                    chan->addOption(id2, name2str);
+                    rec.options.push_back(QPair<qint32, QString>(id2, name2str));
                 } else if (sub == "color") {
                 }
 
                 ch = ch.nextSibling();
             }
+
+            records.push_back(rec);
         }
     }
 
@@ -870,8 +1075,7 @@ void ChannelList::add(QString group, Channel *chan)
         return;
     }
 
-    channels[chan->id()] = chan;
-    names[chan->code()] = chan;
+    index(chan);
     groups[group][chan->code()] = chan;
 
     if (channels.contains(chan->linkid())) {
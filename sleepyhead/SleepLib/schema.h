@@ -11,6 +11,9 @@
 
 #include <QColor>
 #include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QVector>
 #include <QVariant>
 #include <QString>
 #include "machine_common.h"
@@ -57,6 +60,12 @@ namespace schema {
 void resetChannels();
 void setOrders();
 
+//! \brief Returns a counter bumped whenever a channel is added, or its type or order changes
+int revision();
+
+//! \brief Invalidates anything caching channel types or display order
+void bumpRevision();
+
 
 enum Function {
     NONE = 0, AVG, WAVG, MIN, MAX, SUM, CNT, P90, CPH, SPH, HOURS, SET
@@ -119,14 +128,14 @@ class Channel
 
     void setFullname(QString fullname) { m_fullname = fullname; }
     void setLabel(QString label) { m_label = label; }
-    void setType(ChanType type) { m_type = type; }
+    void setType(ChanType type) { m_type = type; bumpRevision(); }
     void setUnit(QString unit) { m_unit = unit; }
     void setDescription(QString desc) { m_description = desc; }
     void setUpperThreshold(EventDataType value) { m_upperThreshold = value; }
     void setUpperThresholdColor(QColor color) { m_upperThresholdColor = color; }
     void setLowerThreshold(EventDataType value) { m_lowerThreshold = value; }
     void setLowerThresholdColor(QColor color) { m_lowerThresholdColor = color; }
-    void setOrder(short order) { m_order = order; }
+    void setOrder(short order) { m_order = order; bumpRevision(); }
 
     void setShowInOverview(bool b) { m_showInOverview = b; }
     void resetStrings() {
@@ -192,6 +201,8 @@ class Channel
     bool m_showInOverview;
 };
 
+struct ChannelRecord;
+
 /*! \class ChannelList
     \brief A list containing a group of Channel objects, and XML storage and retrieval capability
     */
@@ -201,7 +212,7 @@ class ChannelList
     ChannelList();
     virtual ~ChannelList();
 
-    //! \brief Loads Channel list from XML file specified by filename
+    //! \brief Loads Channel list from XML file specified by filename, or from its binary snapshot if that's still current
     bool Load(QString filename);
 
     //! \brief Stores Channel list to XML file specified by filename
@@ -209,14 +220,29 @@ class ChannelList
 
     void add(QString group, Channel *chan);
 
+    //! \brief Adds chan to the id and name lookups only, without a group
+    void index(Channel *chan);
+
+    //! \brief Empties the list, without deleting the Channel objects
+    void clear();
+
     //! \brief Looks up Channel in this List with the index idx, returns EmptyChannel if not found
-    Channel & operator[](ChannelID idx) {
-        if (channels.contains(idx)) {
-            return *channels[idx];
-        } else {
-            return EmptyChannel;
+    inline Channel & operator[](ChannelID idx) {
+        Channel *chan = find(idx);
+        return chan ? *chan : EmptyChannel;
+    }
+
+    //! \brief Returns the Channel with id idx, or nullptr. The pointer stays valid for the life of the schema
+    inline Channel *find(ChannelID idx) const {
+        if (idx < ChannelID(m_dense.size())) {
+            return m_dense.at(idx);
         }
+        QHash<ChannelID, Channel *>::const_iterator it = channels.constFind(idx);
+        return (it != channels.constEnd()) ? it.value() : nullptr;
     }
+
+    //! \brief Returns the codes whose type matches any bit of chantype, sorted into display order
+    QList<ChannelID> sorted(const QList<ChannelID> &codes, quint32 chantype);
     //! \brief Looks up Channel from this list by name, returns Empty Channel if not found.
     Channel &operator[](QString name) {
         if (names.contains(name)) {
@@ -237,6 +263,27 @@ class ChannelList
     //! \brief Channel List indexed by group
     QHash<QString, QHash<QString, Channel *> > groups;
     QString m_doctype;
+
+  protected:
+    //! \brief Parses the channels XML in data into records, without touching the list
+    bool parse(const QByteArray &data, const QString &filename, QList<ChannelRecord> &records);
+
+    //! \brief Brings the per-id type bits and sort keys up to date with the schema revision. Needs m_tableMutex held
+    void refreshTable();
+
+    //! \brief Channels with ids below DenseLimit, addressed straight by id
+    QVector<Channel *> m_dense;
+    static const ChannelID DenseLimit = 0x10000;
+
+    //! \brief ChanType bits of each id in m_dense, so sorted() filters without touching the Channel
+    QVector<quint32> m_denseTypes;
+
+    //! \brief Packed (order, id) display sort key of each id in m_dense
+    QVector<quint64> m_denseKeys;
+
+    //! \brief Schema revision m_denseTypes and m_denseKeys were built at
+    int m_tableRevision;
+    QMutex m_tableMutex;
 };
 extern ChannelList channel;
 
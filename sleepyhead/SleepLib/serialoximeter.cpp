@@ -7,9 +7,109 @@
  * distribution for more details. */
 
 #include <QtSerialPort/QSerialPortInfo>
+#include <cstring>
 
 #include "serialoximeter.h"
 
+SerialRing::SerialRing(int size)
+    : m_size(size)
+{
+    Q_ASSERT((size & (size - 1)) == 0);
+    m_data = new char[size];
+    m_head.store(0);
+    m_tail.store(0);
+    m_overruns.store(0);
+}
+
+SerialRing::~SerialRing()
+{
+    delete [] m_data;
+}
+
+int SerialRing::write(const char *data, int size)
+{
+    quint32 head = quint32(m_head.load());
+    quint32 tail = quint32(m_tail.loadAcquire());
+
+    int space = m_size - int(head - tail);
+    int count = qMin(size, space);
+
+    if (count < size) {
+        m_overruns.fetchAndAddRelaxed(size - count);
+    }
+    if (count <= 0) {
+        return 0;
+    }
+
+    int pos = int(head & quint32(m_size - 1));
+    int first = qMin(count, m_size - pos);
+
+    memcpy(m_data + pos, data, first);
+    memcpy(m_data, data + first, count - first);
+
+    // Publish only once the bytes are in place
+    m_head.storeRelease(int(head + quint32(count)));
+    return count;
+}
+
+int SerialRing::read(char *data, int size)
+{
+    quint32 tail = quint32(m_tail.load());
+    quint32 head = quint32(m_head.loadAcquire());
+
+    int count = qMin(size, int(head - tail));
+    if (count <= 0) {
+        return 0;
+    }
+
+    int pos = int(tail & quint32(m_size - 1));
+    int first = qMin(count, m_size - pos);
+
+    memcpy(data, m_data + pos, first);
+    memcpy(data + first, m_data, count - first);
+
+    m_tail.storeRelease(int(tail + quint32(count)));
+    return count;
+}
+
+SerialReader::SerialReader(SerialRing *ring, QSerialPort *port)
+    : m_ring(ring), m_port(port), m_home(port->thread())
+{
+    m_stop.store(0);
+    m_notified.store(0);
+}
+
+void SerialReader::run()
+{
+    char chunk[1024];
+
+    while (!m_stop.load()) {
+        // Bytes may already be buffered from before the port was handed over
+        if ((m_port->bytesAvailable() == 0) && !m_port->waitForReadyRead(100)) {
+            QSerialPort::SerialPortError error = m_port->error();
+            if ((error != QSerialPort::NoError) && (error != QSerialPort::TimeoutError)) {
+                qWarning() << "SerialReader lost" << m_port->portName() << m_port->errorString();
+                break;
+            }
+            continue;
+        }
+
+        qint64 bytesread;
+        bool wrote = false;
+        while ((bytesread = m_port->read(chunk, sizeof(chunk))) > 0) {
+            m_ring->write(chunk, int(bytesread));
+            wrote = true;
+        }
+
+        if (wrote && m_notified.testAndSetOrdered(0, 1)) {
+            emit bytesReady();
+        }
+    }
+
+    // Only this thread can give it back. The GUI side closes it once stopReader() has waited for us
+    m_port->moveToThread(m_home);
+}
+
 // Possibly need to replan this to include oximetry
 
 QList<SerialOximeter *> GetOxiLoaders()
@@ -78,6 +178,7 @@ bool SerialOximeter::scanDevice(QString keyword, quint16 vendor_id, quint16 prod
 void SerialOximeter::closeDevice()
 {
     killTimers();
+    stopReader();
     disconnect(&serial,SIGNAL(readyRead()), this, SLOT(dataAvailable()));
     serial.close();
     m_streaming = false;
@@ -115,13 +216,11 @@ bool SerialOximeter::openDevice()
 
 void SerialOximeter::dataAvailable()
 {
-    QByteArray bytes;
-
     int available = serial.bytesAvailable();
-    bytes.resize(available);
+    m_readbuf.resize(available);
 
-    int bytesread = serial.read(bytes.data(), available);
-    if (bytesread == 0)
+    int bytesread = serial.read(m_readbuf.data(), available);
+    if (bytesread <= 0)
         return;
 
     if (m_abort) {
@@ -129,7 +228,74 @@ void SerialOximeter::dataAvailable()
         return;
     }
 
-    processBytes(bytes);
+    m_readbuf.resize(bytesread);
+    processBytes(m_readbuf);
+}
+
+bool SerialOximeter::startReader()
+{
+    if (m_reader || !serial.isOpen()) {
+        return false;
+    }
+
+    disconnect(&serial,SIGNAL(readyRead()), this, SLOT(dataAvailable()));
+
+    m_ring.clear();
+    m_reader = new SerialReader(&m_ring, &serial);
+
+    // The port stays open, it just lives on the reader thread until stopReader()
+    serial.moveToThread(m_reader);
+    connect(m_reader, SIGNAL(bytesReady()), this, SLOT(readerDataAvailable()), Qt::QueuedConnection);
+    m_reader->start(QThread::HighPriority);
+
+    return true;
+}
+
+void SerialOximeter::stopReader()
+{
+    if (!m_reader) {
+        return;
+    }
+
+    m_reader->stop();
+    m_reader->wait();
+    disconnect(m_reader, SIGNAL(bytesReady()), this, SLOT(readerDataAvailable()));
+    delete m_reader;
+    m_reader = nullptr;
+}
+
+void SerialOximeter::readerDataAvailable()
+{
+    if (!m_reader) {
+        return;
+    }
+
+    if (m_abort) {
+        closeDevice();
+        return;
+    }
+
+    // Clear first, so anything arriving while draining raises another signal
+    m_reader->clearNotify();
+
+    quint8 chunk[1024];
+    int bytesread;
+
+    while ((bytesread = m_ring.read((char *)chunk, sizeof(chunk))) > 0) {
+        processLiveBytes(chunk, bytesread);
+    }
+
+    int overruns = m_ring.takeOverruns();
+    if (overruns > 0) {
+        qWarning() << loaderName() << "live data fell behind, dropped" << overruns << "bytes";
+    }
+
+    if (!m_plethy.isEmpty()) {
+        emit updatePlethy(m_plethy);
+
+        // capacity was reserved, so this keeps the allocation for the next batch
+        m_plethy.resize(0);
+    }
 }
 
 void SerialOximeter::stopRecording()
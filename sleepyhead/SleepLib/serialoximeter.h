@@ -10,6 +10,8 @@
 #define SERIALOXIMETER_H
 
 #include <QTimer>
+#include <QThread>
+#include <QAtomicInt>
 #include <QtSerialPort/QSerialPort>
 
 #include "SleepLib/machine_loader.h"
@@ -29,6 +31,78 @@ struct OxiRecord
     OxiRecord(const OxiRecord & copy) { pulse = copy.pulse; spo2 = copy.spo2; perf = copy.perf; }
 };
 
+/*! \class SerialRing
+    \brief Lock-free single producer, single consumer byte queue between the serial reader thread and the GUI
+    */
+class SerialRing
+{
+public:
+    //! \brief size must be a power of two
+    SerialRing(int size = 65536);
+    ~SerialRing();
+
+    //! \brief Producer side. Copies up to size bytes in, returning how many fit
+    int write(const char *data, int size);
+
+    //! \brief Consumer side. Copies up to size bytes out, returning how many there were
+    int read(char *data, int size);
+
+    //! \brief Only safe while neither side is running
+    void clear() { m_head.store(0); m_tail.store(0); m_overruns.store(0); }
+
+    //! \brief Returns and resets the count of bytes dropped because the consumer fell behind
+    int takeOverruns() { return m_overruns.fetchAndStoreRelaxed(0); }
+
+protected:
+    char *m_data;
+    int m_size;
+
+    //! \brief Running totals of bytes written and read, wrapping. Each is only stored by its own side
+    QAtomicInt m_head;
+    QAtomicInt m_tail;
+    QAtomicInt m_overruns;
+
+private:
+    SerialRing(const SerialRing &);
+    SerialRing &operator=(const SerialRing &);
+};
+
+/*! \class SerialReader
+    \brief Reads a serial port on its own thread into a SerialRing, so a busy GUI can't make the port overrun
+
+    Takes over the loader's already open QSerialPort, moving it to this thread while it runs, as a port can
+    only be used from the thread it lives in. It's handed back as the thread finishes, and mustn't be touched
+    meanwhile, so devices that need commands mid-stream keep reading on the GUI thread.
+    */
+class SerialReader : public QThread
+{
+Q_OBJECT
+public:
+    SerialReader(SerialRing *ring, QSerialPort *port);
+
+    //! \brief Ask the thread to close the port and finish
+    void stop() { m_stop.store(1); }
+
+    //! \brief Called by the consumer before draining, so the next bytes raise bytesReady() again
+    void clearNotify() { m_notified.store(0); }
+
+signals:
+    //! \brief New bytes are in the ring. Only raised once until clearNotify()
+    void bytesReady();
+
+protected:
+    virtual void run();
+
+    SerialRing *m_ring;
+    QSerialPort *m_port;
+
+    //! \brief The thread m_port came from, and goes back to
+    QThread *m_home;
+
+    QAtomicInt m_stop;
+    QAtomicInt m_notified;
+};
+
 class SerialOximeter : public MachineLoader
 {
 Q_OBJECT
@@ -37,8 +111,10 @@ public:
         m_importing = m_streaming = false;
         m_productID = m_vendorID = 0;
         have_perfindex = false;
+        m_reader = nullptr;
+        m_plethy.reserve(4096);
     }
-    virtual ~SerialOximeter() {}
+    virtual ~SerialOximeter() { stopReader(); }
 
     virtual bool Detect(const QString &path)=0;
     virtual int Open(QString path)=0;
@@ -112,6 +188,9 @@ signals:
 
 protected slots:
     virtual void dataAvailable();
+
+    //! \brief Drains bytes queued by the reader thread into processLiveBytes()
+    void readerDataAvailable();
     virtual void resetImportTimeout() {}
     virtual void startImportTimeout() {}
 
@@ -122,12 +201,30 @@ protected slots:
 protected:
     virtual void processBytes(QByteArray buffer) { Q_UNUSED(buffer) }
 
+    /*! \brief Decode live mode bytes handed over from the reader thread. Implementations shouldn't allocate per call,
+        and should queue plethysmograph samples in m_plethy, which goes out as one updatePlethy() batch per drain */
+    virtual void processLiveBytes(const quint8 *bytes, int size) { Q_UNUSED(bytes) Q_UNUSED(size) }
+
+    /*! \brief Hands the open port over to a SerialReader thread, for streaming modes that no longer write to the device.
+        Returns false if reading stays on the GUI thread */
+    bool startReader();
+    void stopReader();
+
     virtual void killTimers() {}
     virtual void requestData() {}
 
     QString port;
     QSerialPort serial;
 
+    SerialRing m_ring;
+    SerialReader *m_reader;
+
+    //! \brief Reused between reads, so polling doesn't allocate
+    QByteArray m_readbuf;
+
+    //! \brief Plethysmograph samples decoded since the last updatePlethy()
+    QByteArray m_plethy;
+
     QTimer startTimer;
     QTimer resetTimer;
 
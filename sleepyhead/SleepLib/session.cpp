@@ -18,6 +18,9 @@
 
 #include "SleepLib/calcs.h"
 #include "SleepLib/profiles.h"
+#include "SleepLib/eventcache.h"
+#include "SleepLib/trace.h"
+#include "logger.h"
 
 using namespace std;
 
@@ -27,6 +30,7 @@ const quint16 summary_version = 17;
 const quint16 events_version = 10;
 
 Session::Session(Machine *m, SessionID session)
+    : s_events_mutex(QMutex::Recursive)
 {
     s_lonesession = false;
 
@@ -39,7 +43,9 @@ Session::Session(Machine *m, SessionID session)
     s_session = session;
     s_changed = false;
     s_events_loaded = false;
-    s_summary_loaded = false;
+    s_summary_loaded.storeRelease(0);
+    s_summary_on_disk = false;
+    s_summary_evicted = false;
     _first_session = true;
     s_enabled = true;
 
@@ -54,11 +60,20 @@ Session::Session(Machine *m, SessionID session)
 Session::~Session()
 {
     TrashEvents();
+    EventCache::instance()->forgetSummary(this);
     destroyed = true;
 }
 
 void Session::TrashEvents()
 // Trash this sessions Events and release memory.
+{
+    QMutexLocker lock(&s_events_mutex);
+    EventCache::instance()->forget(this);
+    DropPackedEvents();
+    releaseEvents();
+}
+
+void Session::releaseEvents()
 {
     QVector<EventList *>::iterator j;
     QVector<EventList *>::iterator j_end;
@@ -86,15 +101,79 @@ void Session::TrashEvents()
     eventlist.squeeze();
 }
 
+bool Session::PackEvents()
+{
+    QMutexLocker lock(&s_events_mutex);
+
+    if (!s_events_loaded || eventlist.isEmpty()) {
+        return false;
+    }
+
+    TRACE_SCOPE(Trace::CAT_Session, "Session::PackEvents");
+
+    QByteArray databytes;
+    databytes.reserve(int(qMin(eventMemoryUsage(), qint64(0x7fffffff))));
+
+    QDataStream out(&databytes, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_6);
+    out.setByteOrder(QDataStream::LittleEndian);
+    writeEventData(out);
+
+    // Fastest zlib level, this tier is about skipping disk reads, not squeezing every byte
+    s_packed_events = qCompress(databytes, 1);
+
+    EventCache *cache = EventCache::instance();
+    cache->forget(this);
+    releaseEvents();
+    cache->touchPacked(this, s_packed_events.size());
+    return true;
+}
+
+void Session::DropPackedEvents()
+{
+    QMutexLocker lock(&s_events_mutex);
+
+    if (s_packed_events.isEmpty()) {
+        return;
+    }
+
+    EventCache::instance()->forgetPacked(this);
+    s_packed_events.clear();
+}
+
+bool Session::unpackEvents()
+{
+    TRACE_SCOPE(Trace::CAT_Session, "Session::unpackEvents");
+
+    QByteArray databytes = qUncompress(s_packed_events);
+    DropPackedEvents();
+
+    if (databytes.isEmpty()) {
+        qDebug() << "Packed events for session" << s_session << "didn't inflate, reloading from disk";
+        return false;
+    }
+
+    QDataStream in(databytes);
+    in.setVersion(QDataStream::Qt_4_6);
+    in.setByteOrder(QDataStream::LittleEndian);
+    readEventData(in, events_version);
+    return true;
+}
+
 void Session::setEnabled(bool b)
 {
     s_enabled = b;
     // not so simple.. we have to invalidate the hours cache in the day record..
 
+    if (!p_profile) {
+        return;
+    }
+
     Day * day = p_profile->findSessionDay(this);
     if (day) {
         day->invalidate();
     }
+    p_profile->invalidateDayIndex();
 }
 
 QString Session::eventFile() const
@@ -102,30 +181,64 @@ QString Session::eventFile() const
     return s_machine->getEventsPath()+QString().sprintf("%08lx.001", s_session);
 }
 
+bool Session::eventsLoaded()
+{
+    QMutexLocker lock(&s_events_mutex);
+    return s_events_loaded;
+}
+
 //const int max_pack_size=128;
-bool Session::OpenEvents()
+bool Session::OpenEvents(bool upgrade)
 {
+    QMutexLocker lock(&s_events_mutex);
+
     if (s_events_loaded) {
+        EventCache::instance()->touch(this);
         return true;
     }
 
+    TRACE_SCOPE(Trace::CAT_Session, "Session::OpenEvents");
+
     s_events_loaded = eventlist.size() > 0;
 
     if (s_events_loaded) {
         return true;
     }
 
+    // Recently put away sessions are still held compressed in memory
+    if (!s_packed_events.isEmpty() && unpackEvents()) {
+        s_events_loaded = true;
+        EventCache::instance()->touch(this);
+        return true;
+    }
 
     QString filename = eventFile();
-    bool b = LoadEvents(filename);
+    bool b = LoadEvents(filename, upgrade);
 
     if (!b) {
 //        qWarning() << "Error Loading Events" << filename;
         return false;
     }
-    qDebug() << "Loading" << s_machine->loaderName() << "Events" << filename;
+    LOG_LIMITED(20, qDebug() << "Loading" << s_machine->loaderName() << "Events" << filename);
+
+    s_events_loaded = true;
+    EventCache::instance()->touch(this);
+    return true;
+}
+
+qint64 Session::eventMemoryUsage()
+{
+    qint64 bytes = 0;
+
+    QHash<ChannelID, QVector<EventList *> >::iterator it_end = eventlist.end();
+    for (QHash<ChannelID, QVector<EventList *> >::iterator it = eventlist.begin(); it != it_end; ++it) {
+        const QVector<EventList *> &list = it.value();
+        for (int i = 0; i < list.size(); ++i) {
+            bytes += list.at(i)->memoryUsage();
+        }
+    }
 
-    return s_events_loaded = true;
+    return bytes;
 }
 
 bool Session::Destroy()
@@ -299,6 +412,8 @@ QDataStream & operator<<(QDataStream & out, const SessionSlice & slice)
 
 bool Session::StoreSummary()
 {
+    TRACE_SCOPE(Trace::CAT_Session, "Session::StoreSummary");
+
     QString filename = s_machine->getSummariesPath() + QString().sprintf("%08lx.000", s_session);
 
     QFile file(filename);
@@ -372,7 +487,13 @@ bool Session::LoadSummary()
 {
     //static int sumcnt = 0;
 
-    if (s_summary_loaded) return true;
+    if (s_summary_loaded.loadAcquire()) return true;
+
+    // Summaries fault in from whichever thread touches them first
+    QMutexLocker lock(&s_events_mutex);
+    if (s_summary_loaded.loadAcquire()) return true;
+
+    TRACE_SCOPE(Trace::CAT_Session, "Session::LoadSummary");
     QString filename = s_machine->getSummariesPath() + QString().sprintf("%08lx.000", s_session);
 
 
@@ -435,11 +556,25 @@ bool Session::LoadSummary()
                    " I will try to load anyway in case you know what your doing.";
     }
 
+    // After unloadSummary(), only the hashes it cleared come back. Everything else never left,
+    // and the GUI reads it without a lock, so it's read into copies that are then thrown away
+    const bool reload = s_summary_evicted;
+
+    QHash<ChannelID, QVariant> sett = settings;
+    QList<ChannelID> available = m_availableChannels;
+    QHash<ChannelID, EventDataType> timeabove = m_timeAboveTheshold;
+    QHash<ChannelID, EventDataType> upper = m_upperThreshold;
+    QHash<ChannelID, EventDataType> timebelow = m_timeBelowTheshold;
+    QHash<ChannelID, EventDataType> lower = m_lowerThreshold;
+    QVector<SessionSlice> slices = m_slices;
+    bool summaryonly = s_summaryOnly;
+    qint64 first, last;
+
     in >> t32;      // Sessionid;
-    s_session = t32;
+    SessionID sessid = t32;
 
-    in >> s_first;  // Start time
-    in >> s_last;   // Duration // (16bit==Limited to 18 hours)
+    in >> first;  // Start time
+    in >> last;   // Duration // (16bit==Limited to 18 hours)
 
     QHash<ChannelID, EventDataType> cruft;
 
@@ -447,12 +582,12 @@ bool Session::LoadSummary()
         // This code is deprecated.. just here incase anyone tries anything crazy...
         QHash<QString, QVariant> v1;
         in >> v1;
-        settings.clear();
+        sett.clear();
         ChannelID code;
 
         for (QHash<QString, QVariant>::iterator i = v1.begin(); i != v1.end(); i++) {
             code = schema::channel[i.key()].id();
-            settings[code] = i.value();
+            sett[code] = i.value();
         }
 
         QHash<QString, int> zcnt;
@@ -540,7 +675,7 @@ bool Session::LoadSummary()
     } else {
         // version > 7
 
-        in >> settings;
+        in >> sett;
         if (version < 13) {
             QHash<ChannelID, int> cnt2;
             in >> cnt2;
@@ -594,34 +729,53 @@ bool Session::LoadSummary()
 
         // screwed up with version 14
         if (version >= 15) {
-            in >> m_availableChannels;
-            in >> m_timeAboveTheshold;
-            in >> m_upperThreshold;
-            in >> m_timeBelowTheshold;
-            in >> m_lowerThreshold;
+            in >> available;
+            in >> timeabove;
+            in >> upper;
+            in >> timebelow;
+            in >> lower;
         } // else this is ugly.. forced machine database upgrade will solve it though.
 
         if (version == 13) {
-            QHash<ChannelID, QVariant>::iterator it = settings.find(CPAP_SummaryOnly);
-            if (it != settings.end()) {
-                s_summaryOnly = (*it).toBool();
-            } else s_summaryOnly = false;
+            QHash<ChannelID, QVariant>::iterator it = sett.find(CPAP_SummaryOnly);
+            if (it != sett.end()) {
+                summaryonly = (*it).toBool();
+            } else summaryonly = false;
         } else if (version > 13) {
-            in >> s_summaryOnly;
+            in >> summaryonly;
         }
 
         if (version == 16) {
-            QList<SessionSlice> slices;
-            in >> slices;
-            m_slices.clear();
-            for (int i=0;i<slices.size(); ++i) {
-                m_slices.append(slices[i]);
+            QList<SessionSlice> slicelist;
+            in >> slicelist;
+            slices.clear();
+            for (int i=0;i<slicelist.size(); ++i) {
+                slices.append(slicelist[i]);
             }
         } else if (version >= 17) {
-            in >> m_slices;
+            in >> slices;
         }
     }
 
+    if (reload) {
+        // Any upgrade already happened on the first load
+        s_summary_loaded.storeRelease(1);
+        EventCache::instance()->touchSummary(this);
+        return true;
+    }
+
+    s_session = sessid;
+    s_first = first;
+    s_last = last;
+    settings = sett;
+    m_availableChannels = available;
+    m_timeAboveTheshold = timeabove;
+    m_upperThreshold = upper;
+    m_timeBelowTheshold = timebelow;
+    m_lowerThreshold = lower;
+    s_summaryOnly = summaryonly;
+    m_slices = slices;
+
     // not really a good idea to do this... should flag and do a reindex
     if (upgrade || (version < summary_version)) {
 
@@ -636,50 +790,68 @@ bool Session::LoadSummary()
         StoreSummary();
     }
 
-    s_summary_loaded = true;
+    s_summary_loaded.storeRelease(1);
+    s_summary_on_disk = true;
+    EventCache::instance()->touchSummary(this);
     return true;
 }
 
-const quint16 compress_method = 1;
-
-bool Session::StoreEvents()
+void Session::faultSummary()
 {
-    QString path = s_machine->getEventsPath();
-    QDir dir;
-    dir.mkpath(path);
-    QString filename = path+QString().sprintf("%08lx.001", s_session);
-
-    QFile file(filename);
-    file.open(QIODevice::WriteOnly);
-
-    QByteArray headerbytes;
-    QDataStream header(&headerbytes, QIODevice::WriteOnly);
-    header.setVersion(QDataStream::Qt_4_6);
-    header.setByteOrder(QDataStream::LittleEndian);
-
-    header << (quint32)magic;      // New Magic Number
-    header << (quint16)events_version; // File Version
-    header << (quint16)filetype_data;  // File type 1 == Event
-    header << (quint32)s_machine->id();// Machine Type
-    header << (quint32)s_session;      // This session's ID
-    header << s_first;
-    header << s_last;
+    if (!LoadSummary()) {
+        // Don't keep hitting the disk for a file that isn't there
+        s_summary_on_disk = false;
+    }
+}
 
-    quint16 compress = 0;
+bool Session::unloadSummary()
+{
+    QMutexLocker lock(&s_events_mutex);
 
-    if (p_profile->session->compressSessionData()) {
-        compress = compress_method;
+    // Anything modified, being viewed, or edited by hand (journal) stays put
+    if (!s_summary_loaded.loadAcquire() || !s_summary_on_disk || s_changed || s_events_loaded || (s_machtype == MT_JOURNAL)) {
+        return false;
     }
 
-    header << (quint16)compress;
+    // Settings, slices and thresholds are small and read directly all over the place, so they stay
+    m_cnt.clear();
+    m_sum.clear();
+    m_avg.clear();
+    m_wavg.clear();
+    m_min.clear();
+    m_max.clear();
+    m_physmin.clear();
+    m_physmax.clear();
+    m_cph.clear();
+    m_sph.clear();
+    m_firstchan.clear();
+    m_lastchan.clear();
+    m_valuesummary.clear();
+    m_timesummary.clear();
+    m_gain.clear();
+
+    s_summary_evicted = true;
+    s_summary_loaded.storeRelease(0);
+    EventCache::instance()->forgetSummary(this);
+    return true;
+}
 
-    header << (quint16)s_machine->type();// Machine Type
+const quint16 compress_method = 1;
 
-    QByteArray databytes;
-    QDataStream out(&databytes, QIODevice::WriteOnly);
-    out.setVersion(QDataStream::Qt_4_6);
-    out.setByteOrder(QDataStream::LittleEndian);
+void Session::finalizeEvents()
+{
+    QHash<ChannelID, QVector<EventList *> >::iterator it_end = eventlist.end();
+    for (QHash<ChannelID, QVector<EventList *> >::iterator it = eventlist.begin(); it != it_end; ++it) {
+        const QVector<EventList *> &list = it.value();
+        for (int i = 0; i < list.size(); ++i) {
+            list.at(i)->finalize();
+        }
+    }
+}
 
+// Read only, the lists were already finalized by UpdateSummaries() when the import finished
+void Session::writeEventData(QDataStream &out)
+{
     out << (qint16)eventlist.size(); // Number of event categories
 
     QHash<ChannelID, QVector<EventList *> >::iterator i;
@@ -722,9 +894,13 @@ bool Session::StoreEvents()
             EventList &e = *i.value()[j];
             // ****** This is assuming little endian ******
 
+            if (e.m_unsorted) {
+                qWarning() << "Session" << s_session << "stored an EventList that was never finalized";
+            }
+
             // Store the raw event list data in EventStoreType (16bit short)
-            EventStoreType *ptr = e.m_data.data();
-            out.writeRawData((char *)ptr, e.count() << 1);
+            const EventStoreType *ptr = e.m_data.constData();
+            out.writeRawData((const char *)ptr, e.count() << 1);
 
             //*** Don't delete these comments ***
             //            for (quint32 c=0;c<e.count();c++) {
@@ -733,8 +909,8 @@ bool Session::StoreEvents()
 
             // Store the second field, only if there
             if (e.hasSecondField()) {
-                ptr = e.m_data2.data();
-                out.writeRawData((char *)ptr, e.count() << 1);
+                ptr = e.m_data2.constData();
+                out.writeRawData((const char *)ptr, e.count() << 1);
                 //*** Don't delete these comments ***
                 //                for (quint32 c=0;c<e.count();c++) {
                 //                    out << *ptr++; //e.raw2(c);
@@ -743,8 +919,8 @@ bool Session::StoreEvents()
 
             // Store the time delta fields for non-waveform EventLists
             if (e.type() != EVL_Waveform) {
-                quint32 *tptr = e.m_time.data();
-                out.writeRawData((char *)tptr, e.count() << 2);
+                const quint32 *tptr = e.m_time.constData();
+                out.writeRawData((const char *)tptr, e.count() << 2);
                 //*** Don't delete these comments ***
                 //                for (quint32 c=0;c<e.count();c++) {
                 //                    out << *tptr++; //e.getTime()[c];
@@ -752,6 +928,162 @@ bool Session::StoreEvents()
             }
         }
     }
+}
+
+void Session::readEventData(QDataStream &in, quint16 version)
+{
+    quint8 t8;
+    qint16 mcsize;
+    in >> mcsize;   // number of Machine Code lists
+
+    ChannelID code;
+    qint64 ts1, ts2;
+    qint32 evcount;
+    EventListType elt;
+    EventDataType rate, gain, offset, mn, mx;
+    qint16 size2;
+    QVector<ChannelID> mcorder;
+    QVector<qint16> sizevec;
+    QString dim;
+
+    for (int i = 0; i < mcsize; i++) {
+        if (version < 8) {
+            QString txt;
+            in >> txt;
+            code = schema::channel[txt].id();
+        } else {
+            in >> code;
+        }
+
+        mcorder.push_back(code);
+        in >> size2;
+        sizevec.push_back(size2);
+
+        for (int j = 0; j < size2; j++) {
+            in >> ts1;
+            in >> ts2;
+            in >> evcount;
+            in >> t8;
+            elt = (EventListType)t8;
+            in >> rate;
+            in >> gain;
+            in >> offset;
+            in >> mn;
+            in >> mx;
+            in >> dim;
+            bool second_field = false;
+
+            if (version >= 7) { // version 7 added this field
+                in >> second_field;
+            }
+
+            EventList *elist = AddEventList(code, elt, gain, offset, mn, mx, rate, second_field);
+            elist->setDimension(dim);
+
+            //eventlist[code].push_back(elist);
+            elist->m_count = evcount;
+            elist->m_first = elist->m_base = ts1;
+            elist->m_last = ts2;
+
+            if (second_field) {
+                EventDataType min, max;
+                in >> min;
+                in >> max;
+                elist->setMin2(min);
+                elist->setMax2(max);
+            }
+        }
+    }
+
+    //EventStoreType t;
+    //quint32 x;
+
+    for (int i = 0; i < mcsize; i++) {
+        code = mcorder[i];
+        size2 = sizevec[i];
+
+        for (int j = 0; j < size2; j++) {
+            EventList &evec = *eventlist[code][j];
+            evec.m_data.resize(evec.m_count);
+            EventStoreType *ptr = evec.m_data.data();
+
+            // ****** This is assuming little endian ******
+
+            in.readRawData((char *)ptr, evec.m_count << 1);
+
+            //*** Don't delete these comments ***
+            //            for (quint32 c=0;c<evec.m_count;c++) {
+            //                in >> t;
+            //                *ptr++=t;
+            //            }
+            if (evec.hasSecondField()) {
+                evec.m_data2.resize(evec.m_count);
+                ptr = evec.m_data2.data();
+
+                in.readRawData((char *)ptr, evec.m_count << 1);
+                //*** Don't delete these comments ***
+                //                for (quint32 c=0;c<evec.m_count;c++) {
+                //                    in >> t;
+                //                    *ptr++=t;
+                //                }
+            }
+
+            if (evec.type() != EVL_Waveform) {
+                evec.m_time.resize(evec.m_count);
+                quint32 *tptr = evec.m_time.data();
+
+                in.readRawData((char *)tptr, evec.m_count << 2);
+                //*** Don't delete these comments ***
+                //                for (quint32 c=0;c<evec.m_count;c++) {
+                //                    in >> x;
+                //                    *tptr++=x;
+                //                }
+            }
+        }
+    }
+}
+
+bool Session::StoreEvents()
+{
+    TRACE_SCOPE(Trace::CAT_Session, "Session::StoreEvents");
+
+    QString path = s_machine->getEventsPath();
+    QDir dir;
+    dir.mkpath(path);
+    QString filename = path+QString().sprintf("%08lx.001", s_session);
+
+    QFile file(filename);
+    file.open(QIODevice::WriteOnly);
+
+    QByteArray headerbytes;
+    QDataStream header(&headerbytes, QIODevice::WriteOnly);
+    header.setVersion(QDataStream::Qt_4_6);
+    header.setByteOrder(QDataStream::LittleEndian);
+
+    header << (quint32)magic;      // New Magic Number
+    header << (quint16)events_version; // File Version
+    header << (quint16)filetype_data;  // File type 1 == Event
+    header << (quint32)s_machine->id();// Machine Type
+    header << (quint32)s_session;      // This session's ID
+    header << s_first;
+    header << s_last;
+
+    quint16 compress = 0;
+
+    if (p_profile->session->compressSessionData()) {
+        compress = compress_method;
+    }
+
+    header << (quint16)compress;
+
+    header << (quint16)s_machine->type();// Machine Type
+
+    QByteArray databytes;
+    QDataStream out(&databytes, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_6);
+    out.setByteOrder(QDataStream::LittleEndian);
+
+    writeEventData(out);
 
     qint32 datasize = databytes.size();
 
@@ -779,12 +1111,14 @@ bool Session::StoreEvents()
     file.close();
     return true;
 }
-bool Session::LoadEvents(QString filename)
+bool Session::LoadEvents(QString filename, bool upgrade)
 {
+    TRACE_SCOPE(Trace::CAT_Session, "Session::LoadEvents");
+
     quint32 magicnum, machid, sessid;
     quint16 version, type, crc16, machtype, compmethod;
-    quint8 t8;
     qint32 datasize;
+    qint64 first, last;
 
     if (filename.isEmpty()) {
         qDebug() << "Session::LoadEvents() Filename is empty";
@@ -809,8 +1143,8 @@ bool Session::LoadEvents(QString filename)
     header >> type;             // File type (quint16)
     header >> machid;           // Machine ID (quint32)
     header >> sessid;           //(quint32)
-    header >> s_first;          //(qint64)
-    header >> s_last;           //(qint64)
+    header >> first;            //(qint64)
+    header >> last;             //(qint64)
 
     if (type != filetype_data) {
         qDebug() << "Wrong File Type in " << filename;
@@ -827,6 +1161,10 @@ bool Session::LoadEvents(QString filename)
         return false;
     }
 
+    if (!upgrade && (version < events_version)) {
+        return false;
+    }
+
     if (version < 10) {
         file.seek(32);
     } else {
@@ -867,113 +1205,13 @@ bool Session::LoadEvents(QString filename)
     in.setVersion(QDataStream::Qt_4_6);
     in.setByteOrder(QDataStream::LittleEndian);
 
-    qint16 mcsize;
-    in >> mcsize;   // number of Machine Code lists
-
-    ChannelID code;
-    qint64 ts1, ts2;
-    qint32 evcount;
-    EventListType elt;
-    EventDataType rate, gain, offset, mn, mx;
-    qint16 size2;
-    QVector<ChannelID> mcorder;
-    QVector<qint16> sizevec;
-    QString dim;
-
-    for (int i = 0; i < mcsize; i++) {
-        if (version < 8) {
-            QString txt;
-            in >> txt;
-            code = schema::channel[txt].id();
-        } else {
-            in >> code;
-        }
-
-        mcorder.push_back(code);
-        in >> size2;
-        sizevec.push_back(size2);
-
-        for (int j = 0; j < size2; j++) {
-            in >> ts1;
-            in >> ts2;
-            in >> evcount;
-            in >> t8;
-            elt = (EventListType)t8;
-            in >> rate;
-            in >> gain;
-            in >> offset;
-            in >> mn;
-            in >> mx;
-            in >> dim;
-            bool second_field = false;
-
-            if (version >= 7) { // version 7 added this field
-                in >> second_field;
-            }
-
-            EventList *elist = AddEventList(code, elt, gain, offset, mn, mx, rate, second_field);
-            elist->setDimension(dim);
-
-            //eventlist[code].push_back(elist);
-            elist->m_count = evcount;
-            elist->m_first = ts1;
-            elist->m_last = ts2;
+    readEventData(in, version);
 
-            if (second_field) {
-                EventDataType min, max;
-                in >> min;
-                in >> max;
-                elist->setMin2(min);
-                elist->setMax2(max);
-            }
-        }
-    }
-
-    //EventStoreType t;
-    //quint32 x;
-
-    for (int i = 0; i < mcsize; i++) {
-        code = mcorder[i];
-        size2 = sizevec[i];
-
-        for (int j = 0; j < size2; j++) {
-            EventList &evec = *eventlist[code][j];
-            evec.m_data.resize(evec.m_count);
-            EventStoreType *ptr = evec.m_data.data();
-
-            // ****** This is assuming little endian ******
-
-            in.readRawData((char *)ptr, evec.m_count << 1);
-
-            //*** Don't delete these comments ***
-            //            for (quint32 c=0;c<evec.m_count;c++) {
-            //                in >> t;
-            //                *ptr++=t;
-            //            }
-            if (evec.hasSecondField()) {
-                evec.m_data2.resize(evec.m_count);
-                ptr = evec.m_data2.data();
-
-                in.readRawData((char *)ptr, evec.m_count << 1);
-                //*** Don't delete these comments ***
-                //                for (quint32 c=0;c<evec.m_count;c++) {
-                //                    in >> t;
-                //                    *ptr++=t;
-                //                }
-            }
-
-            if (evec.type() != EVL_Waveform) {
-                evec.m_time.resize(evec.m_count);
-                quint32 *tptr = evec.m_time.data();
-
-                in.readRawData((char *)tptr, evec.m_count << 2);
-                //*** Don't delete these comments ***
-                //                for (quint32 c=0;c<evec.m_count;c++) {
-                //                    in >> x;
-                //                    *tptr++=x;
-                //                }
-            }
-        }
+    // The summary already holds these bounds, only take them when it doesn't, or when rebuilding it.
+    // Prefetch loads run beside GUI readers of the summary
+    if ((s_first == 0) || (version < events_version)) {
+        s_first = first;
+        s_last = last;
     }
 
     if (version < events_version) {
@@ -1098,8 +1336,13 @@ void Session::updateCountSummary(ChannelID code)
 
 void Session::UpdateSummaries()
 {
+    TRACE_SCOPE(Trace::CAT_Session, "Session::UpdateSummaries");
+
     ChannelID id;
 
+    // Everything below reads events in time order
+    finalizeEvents();
+
     // Generate that AHI per hour graph in daily view.
     calcAHIGraph(this);
 
@@ -1250,6 +1493,7 @@ QString Session::dimension(ChannelID id)
 
 EventDataType Session::Min(ChannelID id)
 {
+    requireSummary();
     QHash<ChannelID, EventDataType>::iterator i = m_min.find(id);
 
     if (i != m_min.end()) {
@@ -1291,6 +1535,7 @@ EventDataType Session::Min(ChannelID id)
 
 EventDataType Session::Max(ChannelID id)
 {
+    requireSummary();
     QHash<ChannelID, EventDataType>::iterator i = m_max.find(id);
 
     if (i != m_max.end()) {
@@ -1333,6 +1578,7 @@ EventDataType Session::Max(ChannelID id)
 ////
 EventDataType Session::physMin(ChannelID id)
 {
+    requireSummary();
     QHash<ChannelID, EventDataType>::iterator i = m_physmin.find(id);
 
     if (i != m_physmin.end()) {
@@ -1353,6 +1599,7 @@ EventDataType Session::physMin(ChannelID id)
 
 EventDataType Session::physMax(ChannelID id)
 {
+    requireSummary();
     QHash<ChannelID, EventDataType>::iterator i = m_physmax.find(id);
 
     if (i != m_physmax.end()) {
@@ -1374,6 +1621,7 @@ EventDataType Session::physMax(ChannelID id)
 
 qint64 Session::first(ChannelID id)
 {
+    requireSummary();
     qint64 drift = qint64(p_profile->cpap->clockDrift()) * 1000L;
     qint64 tmp;
     QHash<ChannelID, quint64>::iterator i = m_firstchan.find(id);
@@ -1421,6 +1669,7 @@ qint64 Session::first(ChannelID id)
 }
 qint64 Session::last(ChannelID id)
 {
+    requireSummary();
     qint64 drift = qint64(p_profile->cpap->clockDrift()) * 1000L;
     qint64 tmp;
     QHash<ChannelID, quint64>::iterator i = m_lastchan.find(id);
@@ -1487,6 +1736,8 @@ bool Session::channelExists(ChannelID id)
 {
     if (!enabled()) { return false; }
 
+    requireSummary();
+
     if (s_events_loaded) {
         QHash<ChannelID, QVector<EventList *> >::iterator j = eventlist.find(id);
 
@@ -1837,6 +2088,7 @@ EventDataType Session::rangeMax(ChannelID id, qint64 first, qint64 last)
 
 EventDataType Session::count(ChannelID id)
 {
+    requireSummary();
     QHash<ChannelID, EventDataType>::iterator i = m_cnt.find(id);
 
     if (i != m_cnt.end()) {
@@ -1867,6 +2119,7 @@ EventDataType Session::count(ChannelID id)
 
 double Session::sum(ChannelID id)
 {
+    requireSummary();
     QHash<ChannelID, double>::iterator i = m_sum.find(id);
 
     if (i != m_sum.end()) {
@@ -1906,6 +2159,7 @@ double Session::sum(ChannelID id)
 
 EventDataType Session::avg(ChannelID id)
 {
+    requireSummary();
     QHash<ChannelID, EventDataType>::iterator i = m_avg.find(id);
 
     if (i != m_avg.end()) {
@@ -1947,6 +2201,7 @@ EventDataType Session::avg(ChannelID id)
 }
 EventDataType Session::cph(ChannelID id) // count per hour
 {
+    requireSummary();
     QHash<ChannelID, EventDataType>::iterator i = m_cph.find(id);
 
     if (i != m_cph.end()) {
@@ -1961,6 +2216,7 @@ EventDataType Session::cph(ChannelID id) // count per hour
 }
 EventDataType Session::sph(ChannelID id) // sum per hour, assuming id is a time field in seconds
 {
+    requireSummary();
     QHash<ChannelID, EventDataType>::iterator i = m_sph.find(id);
 
     if (i != m_sph.end()) {
@@ -1984,6 +2240,8 @@ EventDataType Session::timeAboveThreshold(ChannelID id, EventDataType threshold)
             }
         }
     }
+    // Statistics runs on a worker, don't let the GUI thread trash events mid-walk
+    QMutexLocker lock(&s_events_mutex);
     bool loaded = s_events_loaded;
 
     OpenEvents();
@@ -2001,22 +2259,33 @@ EventDataType Session::timeAboveThreshold(ChannelID id, EventDataType threshold)
     qint64 ti, started=0, total=0;
     EventDataType data;
     int elsize;
+
+    // Walk each list in blocks, converted in bulk
+    const quint32 blocksize = 1024;
+    EventDataType dblock[blocksize];
+    qint64 tblock[blocksize];
+
     for (int i = 0; i < evec_size; ++i) {
         EventList &ev = *(evec[i]);
         elsize = ev.count();
 
-        for (int j=0; j < elsize; ++j) {
-            ti=ev.time(j);
-            data=ev.data(j);
+        for (int j=0; j < elsize; j += blocksize) {
+            quint32 n = qMin(ev.dataRange(j, blocksize, dblock), ev.timeRange(j, blocksize, tblock));
+            if (n == 0) { break; }
 
-            if (started == 0) {
-                if (data >= threshold) {
-                    started=ti;
-                }
-            } else {
-                if (data < threshold) {
-                    total += ti-started;
-                    started = 0;
+            for (quint32 k=0; k < n; ++k) {
+                ti=tblock[k];
+                data=dblock[k];
+
+                if (started == 0) {
+                    if (data >= threshold) {
+                        started=ti;
+                    }
+                } else {
+                    if (data < threshold) {
+                        total += ti-started;
+                        started = 0;
+                    }
                 }
             }
         }
@@ -2043,6 +2312,7 @@ EventDataType Session::timeBelowThreshold(ChannelID id, EventDataType threshold)
             }
         }
     }
+    QMutexLocker lock(&s_events_mutex);
     bool loaded = s_events_loaded;
 
     QHash<ChannelID, QVector<EventList *> >::iterator j = eventlist.find(id);
@@ -2056,22 +2326,33 @@ EventDataType Session::timeBelowThreshold(ChannelID id, EventDataType threshold)
     qint64 ti, started=0, total=0;
     EventDataType data;
     int elsize;
+
+    // Walk each list in blocks, converted in bulk
+    const quint32 blocksize = 1024;
+    EventDataType dblock[blocksize];
+    qint64 tblock[blocksize];
+
     for (int i = 0; i < evec_size; ++i) {
         EventList &ev = *(evec[i]);
         elsize = ev.count();
 
-        for (int j=0; j < elsize; ++j) {
-            ti=ev.time(j);
-            data=ev.data(j);
+        for (int j=0; j < elsize; j += blocksize) {
+            quint32 n = qMin(ev.dataRange(j, blocksize, dblock), ev.timeRange(j, blocksize, tblock));
+            if (n == 0) { break; }
 
-            if (started == 0) {
-                if (data <= threshold) {
-                    started=ti;
-                }
-            } else {
-                if (data > threshold) {
-                    total += ti-started;
-                    started = 0;
+            for (quint32 k=0; k < n; ++k) {
+                ti=tblock[k];
+                data=dblock[k];
+
+                if (started == 0) {
+                    if (data <= threshold) {
+                        started=ti;
+                    }
+                } else {
+                    if (data > threshold) {
+                        total += ti-started;
+                        started = 0;
+                    }
                 }
             }
         }
@@ -2154,6 +2435,7 @@ EventDataType Session::percentile(ChannelID id, EventDataType percent)
 
 EventDataType Session::wavg(ChannelID id)
 {
+    requireSummary();
     QHash<EventStoreType, quint32> vtime;
     QHash<ChannelID, EventDataType>::iterator i = m_wavg.find(id);
 
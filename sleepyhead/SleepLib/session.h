@@ -16,6 +16,8 @@
 #include <QDebug>
 #include <QHash>
 #include <QVector>
+#include <QMutex>
+#include <QAtomicInt>
 
 #include "SleepLib/machine.h"
 #include "SleepLib/schema.h"
@@ -87,15 +89,40 @@ class Session
     //! \brief Loads the Sessions Summary Indexes from filename, from SleepLibs custom data format.
     bool LoadSummary();
 
+    //! \brief Flags this sessions summary as backed by a file on disk, so it can be faulted in (or put away) on demand
+    void setSummaryOnDisk(bool b) { s_summary_on_disk = b; }
+
+    //! \brief Returns true if the summary data is in memory
+    bool summaryLoaded() const { return s_summary_loaded.loadAcquire() != 0; }
+
+    //! \brief Loads the summary on first use, for anything reaching into the summary hashes directly
+    inline void requireSummary() {
+        if (!s_summary_loaded.loadAcquire() && s_summary_on_disk) { faultSummary(); }
+    }
+
+    //! \brief Frees the summary hashes of an unmodified session, they get faulted back in when next touched
+    bool unloadSummary();
+
     //! \brief Loads the Sessions EventLists from filename, from SleepLibs custom data format.
-    bool LoadEvents(QString filename);
+    //! \note With upgrade false, an old format file is left alone and false returned, as upgrading rewrites the summary
+    bool LoadEvents(QString filename, bool upgrade = true);
 
     //! \brief Loads the events for this session when requested (only the summaries are loaded at startup)
-    bool OpenEvents();
+    //! \note Background loads pass upgrade false, old format files are left for the GUI thread to upgrade
+    bool OpenEvents(bool upgrade = true);
 
     //! \brief Put the events away until needed again, freeing memory
     void TrashEvents();
 
+    //! \brief Compresses the loaded events into memory and frees them, OpenEvents() inflates them again
+    bool PackEvents();
+
+    //! \brief Discards the compressed copy made by PackEvents(), events come from disk next time
+    void DropPackedEvents();
+
+    //! \brief Returns the approximate number of bytes used by this sessions loaded events
+    qint64 eventMemoryUsage();
+
     //! \brief Returns true if session contains an empty duration
     inline bool isEmpty() { return (s_first == s_last); }
 
@@ -355,7 +382,11 @@ class Session
     bool IsLoneSession() { return s_lonesession; }
     void SetLoneSession(bool b) { s_lonesession = b; }
 
-    bool eventsLoaded() { return s_events_loaded; }
+    //! \brief Returns true if the events are in memory. Takes the events lock, as they may be loading on the prefetch thread
+    bool eventsLoaded();
+
+    //! \brief Hold this while walking eventlist off the GUI thread, so the events aren't trashed or reloaded underneath
+    QMutex *eventsMutex() { return &s_events_mutex; }
 
     //! \brief Update this sessions first time if it's less than the current record
     inline void updateFirst(qint64 v) { if (!s_first) { s_first = v; } else if (s_first > v) { s_first = v; } }
@@ -391,7 +422,7 @@ class Session
 
     void setOpened(bool b = true) {
         s_events_loaded = b;
-        s_summary_loaded = b;
+        s_summary_loaded.storeRelease(b ? 1 : 0);
     }
 
     //! \brief Completely purges Session from memory and disk.
@@ -428,10 +459,39 @@ protected:
     bool _first_session;
     bool s_summaryOnly;
 
-    bool s_summary_loaded;
+    //! \brief Checked without the events lock before faulting in, so set only once the hashes are filled
+    QAtomicInt s_summary_loaded;
+    bool s_summary_on_disk;
+
+    //! \brief Set by unloadSummary(), so faulting back in restores only the hashes it put away
+    bool s_summary_evicted;
     bool s_events_loaded;
     bool s_enabled;
 
+    void faultSummary();
+
+    //! \brief Frees the EventLists without touching cache bookkeeping or the packed copy
+    void releaseEvents();
+
+    //! \brief Restores the EventLists from s_packed_events, returns false if they couldn't be
+    bool unpackEvents();
+
+    //! \brief Sorts and trims every EventList once a loader is done adding to them
+    void finalizeEvents();
+
+    //! \brief Writes the EventList headers and sample data, as stored in the body of an events file
+    void writeEventData(QDataStream &out);
+
+    //! \brief Reads back what writeEventData() wrote, in a given events file version
+    void readEventData(QDataStream &in, quint16 version);
+
+    //! \brief Events compressed by PackEvents(), empty unless put away that way
+    QByteArray s_packed_events;
+
+    //! \brief Serializes opening and trashing events, which may happen on the prefetch thread.
+    //! Recursive, as summary updates done while loading may reopen events
+    QMutex s_events_mutex;
+
     // for debugging
     bool destroyed;
     MachineType s_machtype;
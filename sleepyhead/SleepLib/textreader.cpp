@@ -0,0 +1,396 @@
+/* SleepLib Text Reader Implementation
+ *
+ * Copyright (c) 2011-2016 Mark Watkins <jedimark@users.sourceforge.net>
+ *
+ * This file is subject to the terms and conditions of the GNU General Public
+ * License. See the file COPYING in the main directory of the Linux
+ * distribution for more details. */
+
+#include <cstring>
+#include <cmath>
+
+#include "textreader.h"
+#include "filesource.h"
+
+static inline bool isBlank(char c)
+{
+    return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n');
+}
+
+static inline char lowerLatin1(char c)
+{
+    return ((c >= 'A') && (c <= 'Z')) ? char(c + ('a' - 'A')) : c;
+}
+
+int TextRef::indexOf(char c, int from) const
+{
+    if ((from < 0) || (from >= m_size)) {
+        return -1;
+    }
+
+    const char *p = (const char *)memchr(m_data + from, c, m_size - from);
+    return p ? int(p - m_data) : -1;
+}
+
+TextRef TextRef::mid(int pos, int len) const
+{
+    if ((pos < 0) || (pos >= m_size)) {
+        return TextRef();
+    }
+
+    if ((len < 0) || (len > m_size - pos)) {
+        len = m_size - pos;
+    }
+
+    return TextRef(m_data + pos, len);
+}
+
+TextRef TextRef::trimmed() const
+{
+    int start = 0, end = m_size;
+
+    while ((start < end) && isBlank(m_data[start])) { ++start; }
+    while ((end > start) && isBlank(m_data[end - 1])) { --end; }
+
+    return TextRef(m_data + start, end - start);
+}
+
+bool TextRef::equals(const char *str, Qt::CaseSensitivity cs) const
+{
+    int len = int(strlen(str));
+
+    if (len != m_size) {
+        return false;
+    }
+
+    if (cs == Qt::CaseSensitive) {
+        return memcmp(m_data, str, len) == 0;
+    }
+
+    for (int i = 0; i < len; ++i) {
+        if (lowerLatin1(m_data[i]) != lowerLatin1(str[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int TextRef::split(char sep, QVector<TextRef> &out) const
+{
+    // resize(0) keeps the capacity for the next line
+    out.resize(0);
+
+    const char *p = m_data;
+    const char *end = m_data + m_size;
+
+    while (true) {
+        const char *q = (p < end) ? (const char *)memchr(p, sep, end - p) : nullptr;
+
+        if (!q) {
+            out.append(TextRef(p, int(end - p)));
+            break;
+        }
+
+        out.append(TextRef(p, int(q - p)));
+        p = q + 1;
+    }
+
+    return out.size();
+}
+
+int TextRef::toInt(bool *ok) const
+{
+    TextRef t = trimmed();
+    const char *p = t.m_data;
+    const char *end = p + t.m_size;
+
+    bool neg = false;
+    if ((p < end) && ((*p == '-') || (*p == '+'))) {
+        neg = (*p == '-');
+        ++p;
+    }
+
+    if (p == end) {
+        if (ok) { *ok = false; }
+        return 0;
+    }
+
+    qint64 val = 0;
+    for (; p < end; ++p) {
+        if ((*p < '0') || (*p > '9') || (val > 0x7fffffffLL)) {
+            if (ok) { *ok = false; }
+            return 0;
+        }
+        val = val * 10 + (*p - '0');
+    }
+
+    if (neg) { val = -val; }
+
+    if ((val > 0x7fffffffLL) || (val < -0x80000000LL)) {
+        if (ok) { *ok = false; }
+        return 0;
+    }
+
+    if (ok) { *ok = true; }
+    return int(val);
+}
+
+double TextRef::toDouble(bool *ok) const
+{
+    // Exactly representable powers of ten, so most values come out correctly rounded
+    static const double pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    TextRef t = trimmed();
+    const char *p = t.m_data;
+    const char *end = p + t.m_size;
+
+    bool neg = false;
+    if ((p < end) && ((*p == '-') || (*p == '+'))) {
+        neg = (*p == '-');
+        ++p;
+    }
+
+    quint64 mantissa = 0;
+    int exponent = 0, digits = 0;
+
+    for (; (p < end) && (*p >= '0') && (*p <= '9'); ++p, ++digits) {
+        if (mantissa < 100000000000000000ULL) {
+            mantissa = mantissa * 10 + (*p - '0');
+        } else {
+            ++exponent; // Past what a double holds anyway
+        }
+    }
+
+    if ((p < end) && (*p == '.')) {
+        for (++p; (p < end) && (*p >= '0') && (*p <= '9'); ++p, ++digits) {
+            if (mantissa < 100000000000000000ULL) {
+                mantissa = mantissa * 10 + (*p - '0');
+                --exponent;
+            }
+        }
+    }
+
+    if (digits == 0) {
+        if (ok) { *ok = false; }
+        return 0;
+    }
+
+    if ((p < end) && ((*p == 'e') || (*p == 'E'))) {
+        ++p;
+        bool eneg = false;
+        if ((p < end) && ((*p == '-') || (*p == '+'))) {
+            eneg = (*p == '-');
+            ++p;
+        }
+
+        if (p == end) {
+            if (ok) { *ok = false; }
+            return 0;
+        }
+
+        int e = 0;
+        for (; (p < end) && (*p >= '0') && (*p <= '9'); ++p) {
+            if (e < 10000) { e = e * 10 + (*p - '0'); }
+        }
+        exponent += eneg ? -e : e;
+    }
+
+    if (p != end) {
+        if (ok) { *ok = false; }
+        return 0;
+    }
+
+    double val = double(mantissa);
+
+    if ((exponent >= 0) && (exponent <= 22)) {
+        val *= pow10[exponent];
+    } else if ((exponent < 0) && (exponent >= -22)) {
+        val /= pow10[-exponent];
+    } else {
+        val *= pow(10.0, exponent);
+    }
+
+    if (ok) { *ok = true; }
+    return neg ? -val : val;
+}
+
+QDateTime TextRef::toDateTime(const char *format) const
+{
+    int year = 0, month = 1, day = 1, hour = 0, minute = 0, second = 0;
+
+    const char *p = m_data;
+    const char *end = m_data + m_size;
+    const char *f = format;
+
+    while (*f) {
+        int *field = nullptr;
+        int len = 0;
+
+        if (strncmp(f, "yyyy", 4) == 0) {
+            field = &year; len = 4;
+        } else if (strncmp(f, "MM", 2) == 0) {
+            field = &month; len = 2;
+        } else if (strncmp(f, "dd", 2) == 0) {
+            field = &day; len = 2;
+        } else if (strncmp(f, "HH", 2) == 0) {
+            field = &hour; len = 2;
+        } else if (strncmp(f, "mm", 2) == 0) {
+            field = &minute; len = 2;
+        } else if (strncmp(f, "ss", 2) == 0) {
+            field = &second; len = 2;
+        }
+
+        if (field) {
+            if (end - p < len) {
+                return QDateTime();
+            }
+
+            int val = 0;
+            for (int i = 0; i < len; ++i, ++p) {
+                if ((*p < '0') || (*p > '9')) {
+                    return QDateTime();
+                }
+                val = val * 10 + (*p - '0');
+            }
+            *field = val;
+            f += len;
+        } else {
+            if ((p == end) || (*p != *f)) {
+                return QDateTime();
+            }
+            ++p;
+            ++f;
+        }
+    }
+
+    if (p != end) {
+        return QDateTime();
+    }
+
+    QDate date(year, month, day);
+    QTime time(hour, minute, second);
+
+    if (!date.isValid() || !time.isValid()) {
+        return QDateTime();
+    }
+
+    return QDateTime(date, time);
+}
+
+TextReader::TextReader()
+{
+    m_map = nullptr;
+    m_data = nullptr;
+    m_size = m_pos = 0;
+}
+
+TextReader::~TextReader()
+{
+    close();
+}
+
+void TextReader::close()
+{
+    if (m_map) {
+        m_file.unmap(m_map);
+        m_map = nullptr;
+    }
+
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+
+    m_buffer.clear();
+    m_fields.resize(0);
+    setData(nullptr, 0);
+}
+
+bool TextReader::open(const QString &path)
+{
+    close();
+
+    if (FileSource::inArchive(path)) {
+        if (!FileSource::exists(path)) {
+            return false;
+        }
+        m_buffer = FileSource::read(path);
+        setData(m_buffer.constData(), m_buffer.size());
+        return true;
+    }
+
+    m_file.setFileName(path);
+
+    if (!m_file.open(QFile::ReadOnly)) {
+        return false;
+    }
+
+    qint64 size = m_file.size();
+
+    if ((size > 0) && (size < 0x7fffffff)) {
+        m_map = m_file.map(0, size);
+
+        if (m_map) {
+            setData((const char *)m_map, int(size));
+            return true;
+        }
+    }
+
+    // Some file systems can't be mapped, fall back to reading it in
+    m_buffer = m_file.readAll();
+    m_file.close();
+    setData(m_buffer.constData(), m_buffer.size());
+    return true;
+}
+
+void TextReader::setData(const QByteArray &data)
+{
+    close();
+    m_buffer = data;
+    setData(m_buffer.constData(), m_buffer.size());
+}
+
+void TextReader::setData(const char *data, int size)
+{
+    m_data = data;
+    m_size = size;
+    m_pos = 0;
+
+    // Skip a UTF-8 byte order mark
+    if ((size >= 3) && (memcmp(data, "\xEF\xBB\xBF", 3) == 0)) {
+        m_pos = 3;
+    }
+}
+
+bool TextReader::readLine(TextRef &line)
+{
+    if (m_pos >= m_size) {
+        line = TextRef();
+        return false;
+    }
+
+    const char *start = m_data + m_pos;
+    const char *nl = (const char *)memchr(start, '\n', m_size - m_pos);
+    int len = nl ? int(nl - start) : (m_size - m_pos);
+
+    m_pos += nl ? len + 1 : len;
+
+    if ((len > 0) && (start[len - 1] == '\r')) {
+        --len;
+    }
+
+    line = TextRef(start, len);
+    return true;
+}
+
+int TextReader::fieldIndex(const char *name, Qt::CaseSensitivity cs) const
+{
+    for (int i = 0; i < m_fields.size(); ++i) {
+        if (m_fields.at(i).trimmed().equals(name, cs)) {
+            return i;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,126 @@
+/* SleepLib Text Reader Header
+ *
+ * Copyright (c) 2011-2016 Mark Watkins <jedimark@users.sourceforge.net>
+ *
+ * This file is subject to the terms and conditions of the GNU General Public
+ * License. See the file COPYING in the main directory of the Linux
+ * distribution for more details. */
+
+#ifndef TEXTREADER_H
+#define TEXTREADER_H
+
+#include <QString>
+#include <QByteArray>
+#include <QDateTime>
+#include <QVector>
+#include <QFile>
+
+/*! \class TextRef
+    \brief A view of a run of bytes, usually a line or field inside a TextReader's buffer
+
+    Doesn't own anything, so it's only valid as long as the data it points into.
+    Numbers and dates are parsed straight from the bytes, without going through QString.
+    */
+class TextRef
+{
+  public:
+    TextRef() : m_data(nullptr), m_size(0) {}
+    TextRef(const char *data, int size) : m_data(data), m_size(size) {}
+
+    inline const char *data() const { return m_data; }
+    inline int size() const { return m_size; }
+    inline bool isEmpty() const { return m_size == 0; }
+    inline char at(int i) const { return m_data[i]; }
+
+    //! \brief Returns the position of the first c at or after from, or -1
+    int indexOf(char c, int from = 0) const;
+
+    //! \brief Returns len bytes starting at pos, or everything after pos if len is negative
+    TextRef mid(int pos, int len = -1) const;
+
+    //! \brief Returns this without leading and trailing spaces, tabs and line ends
+    TextRef trimmed() const;
+
+    //! \brief Compares against a nul terminated Latin-1 string
+    bool equals(const char *str, Qt::CaseSensitivity cs = Qt::CaseSensitive) const;
+    inline bool operator==(const char *str) const { return equals(str); }
+    inline bool operator!=(const char *str) const { return !equals(str); }
+
+    //! \brief Splits at every sep into out, reusing its storage. Returns the number of fields
+    int split(char sep, QVector<TextRef> &out) const;
+
+    //! \brief Parses a decimal integer, surrounding whitespace allowed, like QString::toInt()
+    int toInt(bool *ok = nullptr) const;
+
+    //! \brief Parses a plain or scientific decimal number, always with '.' as the decimal point
+    double toDouble(bool *ok = nullptr) const;
+
+    /*! \brief Parses a local date/time laid out exactly as format, which may use yyyy, MM, dd, HH, mm and ss.
+        Anything else in format has to match literally. Returns an invalid QDateTime on mismatch */
+    QDateTime toDateTime(const char *format) const;
+
+    //! \brief Decodes the bytes as UTF-8, the one place a TextRef allocates
+    QString toString() const { return QString::fromUtf8(m_data, m_size); }
+
+  protected:
+    const char *m_data;
+    int m_size;
+};
+
+/*! \class TextReader
+    \brief Hands out the lines and fields of a text file without allocating per line or field
+
+    Files on disk are memory mapped, anything inside an archive is read through FileSource in one go.
+    The TextRefs handed out point into that data, and stay valid until the reader is closed or destroyed.
+    */
+class TextReader
+{
+  public:
+    TextReader();
+    ~TextReader();
+
+    //! \brief Opens path for reading, returns false if it couldn't be opened
+    bool open(const QString &path);
+
+    //! \brief Reads from data already in memory instead of a file. data must outlive the reader
+    void setData(const QByteArray &data);
+
+    //! \brief Unmaps or releases the current file
+    void close();
+
+    //! \brief The whole contents, for callers that want to walk binary records themselves
+    TextRef contents() const { return TextRef(m_data, m_size); }
+
+    inline bool atEnd() const { return m_pos >= m_size; }
+
+    //! \brief Reads the next line, without its line ending. Returns false at the end of the data
+    bool readLine(TextRef &line);
+
+    //! \brief Splits line at sep into fields(), reusing storage between lines. Returns the number of fields
+    int split(const TextRef &line, char sep) { return line.split(sep, m_fields); }
+
+    //! \brief Returns field i from the last split(), or an empty ref if there aren't that many
+    inline TextRef field(int i) const { return ((i >= 0) && (i < m_fields.size())) ? m_fields.at(i) : TextRef(); }
+    inline int fieldCount() const { return m_fields.size(); }
+
+    //! \brief Returns which of the last split()'s fields matches name (trimmed), or -1
+    int fieldIndex(const char *name, Qt::CaseSensitivity cs = Qt::CaseSensitive) const;
+
+  protected:
+    void setData(const char *data, int size);
+
+    QFile m_file;
+    uchar *m_map;
+    QByteArray m_buffer;
+
+    const char *m_data;
+    int m_size;
+    int m_pos;
+
+    QVector<TextRef> m_fields;
+
+  private:
+    Q_DISABLE_COPY(TextReader)
+};
+
+#endif // TEXTREADER_H
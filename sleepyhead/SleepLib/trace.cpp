@@ -0,0 +1,219 @@
+/* SleepLib Hot-path Tracing Implementation
+ *
+ * Copyright (c) 2011-2016 Mark Watkins <jedimark@users.sourceforge.net>
+ *
+ * This file is subject to the terms and conditions of the GNU General Public
+ * License. See the file COPYING in the main directory of the Linux
+ * distribution for more details. */
+
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QThreadStorage>
+#include <QElapsedTimer>
+#include <QCoreApplication>
+#include <QDebug>
+#include <atomic>
+
+#include "trace.h"
+
+namespace Trace {
+
+const char *CAT_Loader = "loader";
+const char *CAT_Session = "session";
+const char *CAT_Calc = "calc";
+const char *CAT_Machine = "machine";
+const char *CAT_Render = "render";
+
+QAtomicInt enabled_flag(0);
+
+// Must be a power of two
+const int RingSize = 16384;
+const int RingMask = RingSize - 1;
+
+/*! \class ThreadBuffer
+    \brief Single producer ring. Only the owning thread writes, exporters only read
+    */
+class ThreadBuffer
+{
+  public:
+    ThreadBuffer(int id) : tid(id), head(0), in_use(true) {}
+
+    Event events[RingSize];
+    int tid;
+    QString name;
+
+    // Total number of events ever written, the slot is head & RingMask
+    QAtomicInt head;
+    bool in_use;
+};
+
+// Released back to the pool when its thread exits, so thread pool churn doesn't leak buffers
+class BufferHolder
+{
+  public:
+    BufferHolder(ThreadBuffer *b) : buffer(b) {}
+    ~BufferHolder();
+    ThreadBuffer *buffer;
+};
+
+static QMutex registryMutex;
+static QList<ThreadBuffer *> registry;
+static QThreadStorage<BufferHolder *> localBuffer;
+
+static QElapsedTimer epoch;
+static QAtomicInt epochStarted(0);
+
+BufferHolder::~BufferHolder()
+{
+    QMutexLocker lock(&registryMutex);
+    buffer->in_use = false;
+}
+
+static ThreadBuffer *threadBuffer()
+{
+    if (localBuffer.hasLocalData()) {
+        return localBuffer.localData()->buffer;
+    }
+
+    // Only happens once per thread
+    ThreadBuffer *buf = nullptr;
+    {
+        QMutexLocker lock(&registryMutex);
+        for (int i = 0; i < registry.size(); ++i) {
+            if (!registry[i]->in_use) {
+                buf = registry[i];
+                buf->in_use = true;
+                break;
+            }
+        }
+        if (!buf) {
+            buf = new ThreadBuffer(registry.size() + 1);
+            registry.push_back(buf);
+        }
+        QThread *thread = QThread::currentThread();
+        if (QCoreApplication::instance() && (thread == QCoreApplication::instance()->thread())) {
+            buf->name = "Main";
+        } else if (!thread->objectName().isEmpty()) {
+            buf->name = thread->objectName();
+        } else {
+            buf->name = QString("Worker %1").arg(buf->tid);
+        }
+    }
+    localBuffer.setLocalData(new BufferHolder(buf));
+    return buf;
+}
+
+void setEnabled(bool b)
+{
+    if (b && epochStarted.testAndSetOrdered(0, 1)) {
+        epoch.start();
+    }
+    enabled_flag.storeRelease(b ? 1 : 0);
+    qDebug() << "Performance tracing" << (b ? "enabled" : "disabled");
+}
+
+qint64 now()
+{
+    return epoch.nsecsElapsed();
+}
+
+void record(const char *category, const char *name, qint64 start, qint64 end)
+{
+    ThreadBuffer *buf = threadBuffer();
+
+    int idx = buf->head.load();
+    Event &ev = buf->events[idx & RingMask];
+    ev.name = name;
+    ev.category = category;
+    ev.start = start;
+    ev.duration = end - start;
+
+    // Publish after the slot is filled in
+    buf->head.storeRelease(idx + 1);
+}
+
+static QByteArray jsonEscape(const char *str)
+{
+    QByteArray out;
+    for (const char *p = str; *p; ++p) {
+        char c = *p;
+        if ((c == '"') || (c == '\\')) {
+            out += '\\';
+            out += c;
+        } else if (uchar(c) < 0x20) {
+            out += ' ';
+        } else {
+            out += c;
+        }
+    }
+    return out;
+}
+
+bool exportChromeTrace(const QString &filename)
+{
+    QFile file(filename);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+        qWarning() << "Could not open" << filename << "to write performance trace";
+        return false;
+    }
+
+    QByteArray out;
+    out.reserve(1024 * 1024);
+    out += "{\"traceEvents\":[\n";
+
+    bool first = true;
+    int written = 0;
+
+    QMutexLocker lock(&registryMutex);
+
+    for (int b = 0; b < registry.size(); ++b) {
+        ThreadBuffer *buf = registry[b];
+
+        if (!first) { out += ",\n"; }
+        first = false;
+
+        out += QString("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%1,\"args\":{\"name\":\"%2\"}}")
+                .arg(buf->tid).arg(buf->name).toUtf8();
+
+        int head = buf->head.loadAcquire();
+        int begin = qMax(0, head - RingSize);
+
+        for (int i = begin; i < head; ++i) {
+            Event ev = buf->events[i & RingMask];
+
+            // The owning thread may have lapped us while copying. Once head reaches i + RingSize
+            // slot i is being rewritten, so anything copied from it may be torn
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (buf->head.loadAcquire() - i >= RingSize) { continue; }
+
+            out += ",\n{\"name\":\"";
+            out += jsonEscape(ev.name);
+            out += "\",\"cat\":\"";
+            out += jsonEscape(ev.category);
+            out += "\",\"ph\":\"X\",\"pid\":1,\"tid\":";
+            out += QByteArray::number(buf->tid);
+            out += ",\"ts\":";
+            out += QByteArray::number(double(ev.start) / 1000.0, 'f', 3);
+            out += ",\"dur\":";
+            out += QByteArray::number(double(ev.duration) / 1000.0, 'f', 3);
+            out += "}";
+            written++;
+
+            if (out.size() > 1024 * 1024) {
+                file.write(out);
+                out.clear();
+            }
+        }
+    }
+
+    out += "\n],\"displayTimeUnit\":\"ms\"}\n";
+    file.write(out);
+    file.close();
+
+    qDebug() << "Wrote" << written << "trace events to" << filename;
+    return true;
+}
+
+} // namespace Trace
@@ -0,0 +1,86 @@
+/* SleepLib Hot-path Tracing Header
+ *
+ * Copyright (c) 2011-2016 Mark Watkins <jedimark@users.sourceforge.net>
+ *
+ * This file is subject to the terms and conditions of the GNU General Public
+ * License. See the file COPYING in the main directory of the Linux
+ * distribution for more details. */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QString>
+#include <QAtomicInt>
+
+/*! \namespace Trace
+    \brief Lightweight scoped timers recorded into per-thread ring buffers
+
+    Each thread owns a fixed size ring of completed scopes, so recording never takes a lock.
+    When tracing is switched off a TRACE_SCOPE costs a single relaxed atomic load.
+    The collected events can be written out in Chrome's trace JSON format (chrome://tracing)
+    */
+namespace Trace {
+
+//! \brief Category names used by the built in instrumentation
+extern const char *CAT_Loader;
+extern const char *CAT_Session;
+extern const char *CAT_Calc;
+extern const char *CAT_Machine;
+extern const char *CAT_Render;
+
+//! \brief One completed scope. name & category must point to static strings
+struct Event {
+    const char *name;
+    const char *category;
+    qint64 start;       // nanoseconds since the trace epoch
+    qint64 duration;    // nanoseconds
+};
+
+extern QAtomicInt enabled_flag;
+
+//! \brief Returns true when scopes are currently being recorded
+inline bool enabled() { return enabled_flag.load() != 0; }
+
+//! \brief Switch recording on or off. Switching on starts the trace clock if needed
+void setEnabled(bool b);
+
+//! \brief Nanoseconds elapsed since the trace epoch
+qint64 now();
+
+//! \brief Record a completed scope into the calling threads ring buffer
+void record(const char *category, const char *name, qint64 start, qint64 end);
+
+//! \brief Write all recorded events to filename as Chrome trace JSON
+bool exportChromeTrace(const QString &filename);
+
+/*! \class Scope
+    \brief RAII timer, records the time between construction and destruction
+    */
+class Scope
+{
+  public:
+    Scope(const char *category, const char *name)
+        : m_category(category), m_name(name) {
+        m_start = enabled() ? now() : -1;
+    }
+    ~Scope() {
+        if (m_start >= 0) {
+            record(m_category, m_name, m_start, now());
+        }
+    }
+  protected:
+    const char *m_category;
+    const char *m_name;
+    qint64 m_start;
+};
+
+} // namespace Trace
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+
+//! \brief Time the rest of the enclosing block under the given category and static name
+#define TRACE_SCOPE(category, name) \
+    Trace::Scope TRACE_CONCAT(trace_scope_, __LINE__)(category, name)
+
+#endif // TRACE_H
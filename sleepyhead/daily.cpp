@@ -31,6 +31,8 @@
 #include "common_gui.h"
 #include "SleepLib/profiles.h"
 #include "SleepLib/session.h"
+#include "SleepLib/eventcache.h"
+#include "SleepLib/journal.h"
 #include "Graphs/graphdata_custom.h"
 #include "Graphs/gLineOverlay.h"
 #include "Graphs/gFlagsLine.h"
@@ -458,6 +460,8 @@ Daily::~Daily()
 
     // Save any last minute changes..
 
+    EventCache::instance()->cancelPrefetch(true);
+
     delete ui;
     delete icon_on;
     delete icon_off;
@@ -484,10 +488,13 @@ void Daily::closeEvent(QCloseEvent *event)
 
 void Daily::doToggleSession(Session * sess)
 {
+    // The statistics worker walks the very sessions being toggled
+    mainwin->cancelStatistics(true);
     sess->setEnabled(!sess->enabled());
 
     LoadDate(previous_date);
     mainwin->getOverview()->graphView()->dataChanged();
+    mainwin->GenerateStatistics();
 }
 
 void Daily::Link_clicked(const QUrl &url)
@@ -504,22 +511,27 @@ void Daily::Link_clicked(const QUrl &url)
         if (!sess)
             return;
         int i=webView->page()->mainFrame()->scrollBarMaximum(Qt::Vertical)-webView->page()->mainFrame()->scrollBarValue(Qt::Vertical);
+        mainwin->cancelStatistics(true);
         sess->setEnabled(!sess->enabled());
 
         // Reload day
         LoadDate(previous_date);
         webView->page()->mainFrame()->setScrollBarValue(Qt::Vertical, webView->page()->mainFrame()->scrollBarMaximum(Qt::Vertical)-i);
+        mainwin->GenerateStatistics();
     } else  if (code=="toggleoxisession") { // Enable/Disable Oximetry session
         day=p_profile->GetDay(previous_date,MT_OXIMETER);
+        if (!day) return;
         Session *sess=day->find(sid);
         if (!sess)
             return;
         int i=webView->page()->mainFrame()->scrollBarMaximum(Qt::Vertical)-webView->page()->mainFrame()->scrollBarValue(Qt::Vertical);
+        mainwin->cancelStatistics(true);
         sess->setEnabled(!sess->enabled());
 
         // Reload day
         LoadDate(previous_date);
         webView->page()->mainFrame()->setScrollBarValue(Qt::Vertical, webView->page()->mainFrame()->scrollBarMaximum(Qt::Vertical)-i);
+        mainwin->GenerateStatistics();
     } else if (code=="cpap")  {
         day=p_profile->GetDay(previous_date,MT_CPAP);
         if (day) {
@@ -1350,6 +1362,7 @@ QString Daily::getSleepTime(Day * day)
 void Daily::Load(QDate date)
 {
     dateDisplay->setText("<i>"+date.toString(Qt::SystemLocaleLongDate)+"</i>");
+    int direction = (previous_date.isValid() && (date < previous_date)) ? -1 : 1;
     previous_date=date;
 
     Day * day = p_profile->GetDay(date);
@@ -1365,22 +1378,6 @@ void Daily::Load(QDate date)
         posit = day->machine(MT_POSITION);
     }
 
-    if (!p_profile->session->cacheSessions()) {
-        // Getting trashed on purge last day...
-
-        // lastcpapday can get purged and be invalid
-        if (lastcpapday && (lastcpapday!=day)) {
-            for (QMap<QDate, Day *>::iterator di = p_profile->daylist.begin(); di!= p_profile->daylist.end(); ++di) {
-                Day * d = di.value();
-                if (d->eventsLoaded()) {
-                    if (d->useCounter() == 0) {
-                        d->CloseEvents();
-                    }
-                }
-            }
-        }
-    }
-
     // Don't really see a point in unlinked oximetery sessions anymore... All I can say is BLEH...
 //    if ((cpap && oxi) && day->hasEnabledSessions(MT_OXIMETER)) {
 //        int gr;
@@ -1432,6 +1429,15 @@ void Daily::Load(QDate date)
     if (day) {
         day->OpenEvents();
     }
+
+    // Put away the least recently viewed days' events once over budget, then get ahead of the user
+    EventCache * cache = EventCache::instance();
+    cache->setBudget(p_profile->session->cacheSessions() ? 0 : qint64(p_profile->session->eventCacheSize()) * 1048576L);
+    cache->setPackedBudget(qint64(p_profile->session->packedEventCacheSize()) * 1048576L);
+    cache->setSummaryBudget(p_profile->session->preloadSummaries() ? 0 : p_profile->session->summaryCacheSize());
+    cache->trim(day);
+    prefetchDays(date, direction);
+
     GraphView->setDay(day);
 
 
@@ -1441,9 +1447,8 @@ void Daily::Load(QDate date)
 //    UpdatePOSGraphs(posit);
     UpdateEventsTree(ui->treeWidget, day);
 
-    // FIXME:
-    // Generating entire statistics because bookmarks may have changed.. (This updates the side panel too)
-    mainwin->GenerateStatistics();
+    // Bookmarks may have changed, only the side panel needs refreshing for that
+    mainwin->updateFavourites();
 
     snapGV->setDay(day);
 
@@ -1818,6 +1823,31 @@ void Daily::clearLastDay()
 }
 
 
+void Daily::prefetchDays(QDate date, int direction)
+{
+    QList<Session *> sessions;
+    QDate d = date;
+    int found = 0;
+
+    // Look a little past empty days, so SkipEmptyDays navigation benefits too
+    for (int i = 0; (i < 14) && (found < 2); ++i) {
+        d = d.addDays(direction);
+        Day * day = p_profile->GetDay(d);
+        if (!day) continue;
+
+        found++;
+        for (int j = 0; j < day->sessions.size(); ++j) {
+            Session * sess = day->sessions.at(j);
+            if ((sess->type() == MT_JOURNAL) || !sess->enabled() || sess->summaryOnly() || sess->eventsLoaded()) {
+                continue;
+            }
+            sessions.push_back(sess);
+        }
+    }
+
+    EventCache::instance()->prefetch(sessions);
+}
+
 void Daily::Unload(QDate date)
 {
     if (!date.isValid()) {
@@ -1857,6 +1887,7 @@ void Daily::Unload(QDate date)
         }
         if (journal->IsChanged()) {
             journal->settings[LastUpdated]=QDateTime::currentDateTime();
+            p_profile->journalIndex()->update(date, journal);
             // blah.. was updating overview graphs here.. Was too slow.
         }
         Machine *jm=p_profile->GetMachine(MT_JOURNAL);
@@ -1970,7 +2001,11 @@ Session * Daily::CreateJournalSession(QDate date)
     sess->SetSessionID(st / 1000L);
     sess->set_first(st);
     sess->set_last(et);
+
+    // Adding a session can add a day, which mustn't happen under the statistics worker
+    mainwin->cancelStatistics(true);
     m->AddSession(sess);
+    mainwin->GenerateStatistics();
     return sess;
 }
 Session * Daily::GetJournalSession(QDate date) // Get the first journal session
@@ -2275,6 +2310,7 @@ void Daily::update_Bookmarks()
     journal->settings[Bookmark_Notes]=notes;
     journal->settings[LastUpdated]=QDateTime::currentDateTime();
     journal->SetChanged(true);
+    p_profile->journalIndex()->update(previous_date, journal);
     BookmarksChanged=true;
     mainwin->updateFavourites();
 }
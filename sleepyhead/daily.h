@@ -306,6 +306,14 @@ private:
         \param QDate date
         */
     void Load(QDate date);
+
+    /*! \fn prefetchDays(QDate date, int direction)
+        \brief Starts loading events for the next days with data after date on a worker thread
+        \param QDate date
+        \param int direction, +1 when stepping forwards in time, -1 backwards
+        */
+    void prefetchDays(QDate date, int direction);
+
     /*! \fn UpdateCalendarDay(QDate date)
         \brief Updates the calendar visual information, changing a dates color depending on what data is available.
         \param QDate date
@@ -11,8 +11,15 @@
 #include <QMessageBox>
 #include <QCalendarWidget>
 #include <QTextCharFormat>
+#include <QThread>
+#include <QThreadPool>
+#include <QSemaphore>
+#include <QMutexLocker>
+#include <QReadLocker>
 #include "SleepLib/profiles.h"
 #include "SleepLib/day.h"
+#include "SleepLib/eventcache.h"
+#include "SleepLib/trace.h"
 #include "common_gui.h"
 #include "exportcsv.h"
 #include "ui_exportcsv.h"
@@ -141,6 +148,212 @@ void ExportCSV::on_quickRangeCombo_activated(const QString &arg1)
     }
 }
 
+/*! \struct ExportSettings
+    \brief What to export, shared read-only by every ExportTask
+    */
+struct ExportSettings
+{
+    enum Mode { Summary, Sessions, Details };
+
+    Mode mode;
+    QList<ChannelID> countlist, avglist, p90list;
+    QDate daily_date;
+};
+
+/*! \struct ExportChunk
+    \brief A run of dates, and the CSV rows they produced
+    */
+struct ExportChunk
+{
+    QDate first, last;
+    QByteArray data;
+    QAtomicInt ready;
+};
+
+static const char csv_sep = ',';
+static const char csv_newline = '\n';
+
+static void appendDuration(QByteArray &out, int time)
+{
+    char buf[32];
+    qsnprintf(buf, sizeof(buf), "%02i:%02i:%02i", time / 3600, int(time / 60) % 60, int(time) % 60);
+    out += csv_sep;
+    out += buf;
+}
+
+/*! \class ExportTask
+    \brief Builds the CSV rows for one chunk of dates on a worker thread
+    */
+class ExportTask : public QRunnable
+{
+  public:
+    ExportTask(const ExportSettings &settings, ExportChunk *chunk, QAtomicInt *days, QSemaphore *done)
+        : m_settings(settings), m_chunk(chunk), m_days(days), m_done(done) {}
+    virtual ~ExportTask() {}
+
+    virtual void run() {
+        TRACE_SCOPE(Trace::CAT_Calc, "ExportTask::run");
+        {
+            // Keep the EventCache from putting summaries away underneath us
+            QReadLocker lock(EventCache::instance()->summaryLock());
+
+            for (QDate date = m_chunk->first; date <= m_chunk->last; date = date.addDays(1)) {
+                Day *day = p_profile->GetDay(date, MT_CPAP);
+
+                if (day) {
+                    day->OpenSummary();
+
+                    if (m_settings.mode == ExportSettings::Summary) {
+                        summaryRow(date, day);
+                    } else if (m_settings.mode == ExportSettings::Sessions) {
+                        sessionRows(date, day);
+                    } else {
+                        detailRows(date, day);
+                    }
+                }
+                m_days->fetchAndAddRelaxed(1);
+            }
+        }
+        m_chunk->ready.storeRelease(1);
+        m_done->release();
+    }
+
+  protected:
+    void channelColumns(Day *day, Session *sess) {
+        QByteArray &out = m_chunk->data;
+
+        for (int i = 0; i < m_settings.countlist.size(); i++) {
+            EventDataType cnt = sess ? sess->count(m_settings.countlist.at(i)) : day->count(m_settings.countlist.at(i));
+            out += csv_sep;
+            out += QByteArray::number(cnt);
+        }
+
+        for (int i = 0; i < m_settings.avglist.size(); i++) {
+            out += csv_sep;
+            out += QByteArray::number(day->wavg(m_settings.avglist.at(i)));
+        }
+
+        for (int i = 0; i < m_settings.p90list.size(); i++) {
+            out += csv_sep;
+            out += QByteArray::number(day->p90(m_settings.p90list.at(i)));
+        }
+
+        out += csv_newline;
+    }
+
+    void summaryRow(QDate date, Day *day) {
+        QByteArray &out = m_chunk->data;
+
+        out += date.toString(Qt::ISODate).toLatin1();
+        out += csv_sep;
+        out += QByteArray::number(day->size());
+        out += csv_sep;
+        out += QDateTime::fromTime_t(day->first() / 1000L).toString(Qt::ISODate).toLatin1();
+        out += csv_sep;
+        out += QDateTime::fromTime_t(day->last() / 1000L).toString(Qt::ISODate).toLatin1();
+        appendDuration(out, day->total_time() / 1000L);
+
+        float ahi = day->count(CPAP_Obstructive) + day->count(CPAP_Hypopnea) + day->count(
+                        CPAP_Apnea) + day->count(CPAP_ClearAirway);
+        ahi /= day->hours();
+        out += csv_sep;
+        out += QByteArray::number(ahi, 'f', 3);
+
+        channelColumns(day, nullptr);
+    }
+
+    void sessionRows(QDate date, Day *day) {
+        QByteArray &out = m_chunk->data;
+        QByteArray datestr = date.toString(Qt::ISODate).toLatin1();
+
+        for (int i = 0; i < day->size(); i++) {
+            Session *sess = (*day)[i];
+
+            out += datestr;
+            out += csv_sep;
+            out += QByteArray::number(sess->session());
+            out += csv_sep;
+            out += QDateTime::fromTime_t(sess->first() / 1000L).toString(Qt::ISODate).toLatin1();
+            out += csv_sep;
+            out += QDateTime::fromTime_t(sess->last() / 1000L).toString(Qt::ISODate).toLatin1();
+            appendDuration(out, sess->length() / 1000L);
+
+            float ahi = sess->count(CPAP_Obstructive) + sess->count(CPAP_Hypopnea) + sess->count(
+                            CPAP_Apnea) + sess->count(CPAP_ClearAirway);
+            ahi /= sess->hours();
+            out += csv_sep;
+            out += QByteArray::number(ahi, 'f', 3);
+
+            channelColumns(day, sess);
+        }
+    }
+
+    void detailRows(QDate date, Day *day) {
+        QByteArray &out = m_chunk->data;
+
+        QList<ChannelID> all = m_settings.countlist;
+        all.append(m_settings.avglist);
+
+        // Timestamps only have second resolution, so neighbouring events share their text
+        qint64 lastsecs = -1;
+        QByteArray timestr;
+
+        for (int i = 0; i < day->size(); i++) {
+            Session *sess = (*day)[i];
+
+            // Other pool threads, the prefetch worker and the EventCache may all open or trash this session's events
+            QMutexLocker lock(sess->eventsMutex());
+            sess->OpenEvents();
+
+            QByteArray sessstr = QByteArray::number(sess->session());
+            QHash<ChannelID, QVector<EventList *> >::iterator fnd;
+
+            for (int j = 0; j < all.size(); j++) {
+                ChannelID key = all.at(j);
+                fnd = sess->eventlist.find(key);
+
+                if (fnd == sess->eventlist.end()) {
+                    continue;
+                }
+
+                QByteArray codestr = schema::channel[key].code().toLatin1();
+
+                for (int e = 0; e < fnd.value().size(); e++) {
+                    EventList *ev = fnd.value()[e];
+                    quint32 cnt = ev->count();
+
+                    for (quint32 q = 0; q < cnt; q++) {
+                        qint64 secs = ev->time(q) / 1000L;
+
+                        if (secs != lastsecs) {
+                            timestr = QDateTime::fromTime_t(secs).toString(Qt::ISODate).toLatin1();
+                            lastsecs = secs;
+                        }
+
+                        out += timestr;
+                        out += csv_sep;
+                        out += sessstr;
+                        out += csv_sep;
+                        out += codestr;
+                        out += csv_sep;
+                        out += QByteArray::number(ev->data(q), 'f', 2);
+                        out += csv_newline;
+                    }
+                }
+            }
+
+            if (m_settings.daily_date != date) {
+                sess->TrashEvents();
+            }
+        }
+    }
+
+    const ExportSettings &m_settings;
+    ExportChunk *m_chunk;
+    QAtomicInt *m_days;
+    QSemaphore *m_done;
+};
+
 void ExportCSV::on_exportButton_clicked()
 {
     QFile file(ui->filenameEdit->text());
@@ -163,7 +376,10 @@ void ExportCSV::on_exportButton_clicked()
     //    fields.append(DumpField(NoChannel,MT_CPAP,ST_SESSIONS));
 
 
-    QList<ChannelID> countlist, avglist, p90list;
+    ExportSettings settings;
+    QList<ChannelID> &countlist = settings.countlist;
+    QList<ChannelID> &avglist = settings.avglist;
+    QList<ChannelID> &p90list = settings.p90list;
     countlist.append(CPAP_Hypopnea);
     countlist.append(CPAP_Obstructive);
     countlist.append(CPAP_Apnea);
@@ -218,129 +434,75 @@ void ExportCSV::on_exportButton_clicked()
 
     header += newline;
     file.write(header.toLatin1());
-    QDate date = ui->startDate->date();
-    Daily *daily = mainwin->getDaily();
-    QDate daily_date = daily->getDate();
 
-    ui->progressBar->setValue(0);
-    ui->progressBar->setMaximum(p_profile->daylist.count());
+    if (ui->rb1_details->isChecked()) {
+        settings.mode = ExportSettings::Details;
+    } else if (ui->rb1_Sessions->isChecked()) {
+        settings.mode = ExportSettings::Sessions;
+    } else {
+        settings.mode = ExportSettings::Summary;
+    }
 
-    do {
-        ui->progressBar->setValue(ui->progressBar->value() + 1);
-        QApplication::processEvents();
+    Daily *daily = mainwin->getDaily();
+    settings.daily_date = daily->getDate();
+
+    ////////////////////////////////////////////////////////////////////////
+    // Split the range into chunks of dates, built on a worker pool and
+    // written out in date order as they complete
+    ////////////////////////////////////////////////////////////////////////
+    QDate start = ui->startDate->date();
+    int days = qMax(1, int(start.daysTo(ui->endDate->date())) + 1);
+
+    // Detail rows run to thousands per day, so keep their chunks short
+    int chunkdays = (settings.mode == ExportSettings::Details) ? 4 : 32;
+    int numchunks = (days + chunkdays - 1) / chunkdays;
+
+    QVector<ExportChunk> chunks(numchunks);
+    for (int i = 0; i < numchunks; ++i) {
+        chunks[i].first = start.addDays(i * chunkdays);
+        chunks[i].last = start.addDays(qMin(days, (i + 1) * chunkdays) - 1);
+    }
 
-        Day *day = p_profile->GetDay(date, MT_CPAP);
-
-        if (day) {
-            QString data;
-
-            if (ui->rb1_Summary->isChecked()) {
-                QDateTime start = QDateTime::fromTime_t(day->first() / 1000L);
-                QDateTime end = QDateTime::fromTime_t(day->last() / 1000L);
-                data = date.toString(Qt::ISODate);
-                data += sep + QString::number(day->size(), 10);
-                data += sep + start.toString(Qt::ISODate);
-                data += sep + end.toString(Qt::ISODate);
-                int time = day->total_time() / 1000L;
-                int h = time / 3600;
-                int m = int(time / 60) % 60;
-                int s = int(time) % 60;
-                data += sep + QString().sprintf("%02i:%02i:%02i", h, m, s);
-                float ahi = day->count(CPAP_Obstructive) + day->count(CPAP_Hypopnea) + day->count(
-                                CPAP_Apnea) + day->count(CPAP_ClearAirway);
-                ahi /= day->hours();
-                data += sep + QString::number(ahi, 'f', 3);
-
-                for (int i = 0; i < countlist.size(); i++) {
-                    data += sep + QString::number(day->count(countlist.at(i)));
-                }
+    ui->exportButton->setEnabled(false);
+    ui->progressBar->setValue(0);
+    ui->progressBar->setMaximum(days);
 
-                for (int i = 0; i < avglist.size(); i++) {
-                    data += sep + QString::number(day->wavg(avglist.at(i)));
-                }
+    // The export fills the same summary caches the statistics worker does, and loads events the prefetcher would
+    mainwin->cancelStatistics(true);
+    EventCache::instance()->cancelPrefetch(true);
 
-                for (int i = 0; i < p90list.size(); i++) {
-                    data += sep + QString::number(day->p90(p90list.at(i)));
-                }
+    QThreadPool pool;
+    pool.setMaxThreadCount(QThread::idealThreadCount());
 
-                data += newline;
-                file.write(data.toLatin1());
-
-            } else if (ui->rb1_Sessions->isChecked()) {
-                for (int i = 0; i < day->size(); i++) {
-                    Session *sess = (*day)[i];
-                    QDateTime start = QDateTime::fromTime_t(sess->first() / 1000L);
-                    QDateTime end = QDateTime::fromTime_t(sess->last() / 1000L);
-
-                    data = date.toString(Qt::ISODate);
-                    data += sep + QString::number(sess->session(), 10);
-                    data += sep + start.toString(Qt::ISODate);
-                    data += sep + end.toString(Qt::ISODate);
-                    int time = sess->length() / 1000L;
-                    int h = time / 3600;
-                    int m = int(time / 60) % 60;
-                    int s = int(time) % 60;
-                    data += sep + QString().sprintf("%02i:%02i:%02i", h, m, s);
-
-                    float ahi = sess->count(CPAP_Obstructive) + sess->count(CPAP_Hypopnea) + sess->count(
-                                    CPAP_Apnea) + sess->count(CPAP_ClearAirway);
-                    ahi /= sess->hours();
-                    data += sep + QString::number(ahi, 'f', 3);
-
-                    for (int j = 0; j < countlist.size(); j++) {
-                        data += sep + QString::number(sess->count(countlist.at(j)));
-                    }
+    // Don't let finished chunks pile up in memory behind a slow one
+    int window = pool.maxThreadCount() * 2;
 
-                    for (int j = 0; j < avglist.size(); j++) {
-                        data += sep + QString::number(day->wavg(avglist.at(j)));
-                    }
+    QAtomicInt daysdone;
+    QSemaphore done;
+    int next = 0, written = 0;
 
-                    for (int j = 0; j < p90list.size(); j++) {
-                        data += sep + QString::number(day->p90(p90list.at(j)));
-                    }
+    while (written < numchunks) {
+        while ((next < numchunks) && (next < written + window)) {
+            pool.start(new ExportTask(settings, &chunks[next], &daysdone, &done));
+            ++next;
+        }
 
-                    data += newline;
-                    file.write(data.toLatin1());
-                }
-            } else if (ui->rb1_details->isChecked()) {
-                QList<ChannelID> all = countlist;
-                all.append(avglist);
-
-                for (int i = 0; i < day->size(); i++) {
-                    Session *sess = (*day)[i];
-                    sess->OpenEvents();
-                    QHash<ChannelID, QVector<EventList *> >::iterator fnd;
-
-                    for (int j = 0; j < all.size(); j++) {
-                        ChannelID key = all.at(j);
-                        fnd = sess->eventlist.find(key);
-
-                        if (fnd != sess->eventlist.end()) {
-                            //header="DateTime"+sep+"Session"+sep+"Event"+sep+"Data/Duration";
-                            for (int e = 0; e < fnd.value().size(); e++) {
-                                EventList *ev = fnd.value()[e];
-
-                                for (quint32 q = 0; q < ev->count(); q++) {
-                                    data = QDateTime::fromTime_t(ev->time(q) / 1000L).toString(Qt::ISODate);
-                                    data += sep + QString::number(sess->session());
-                                    data += sep + schema::channel[key].code();
-                                    data += sep + QString::number(ev->data(q), 'f', 2);
-                                    data += newline;
-                                    file.write(data.toLatin1());
-                                }
-                            }
-                        }
-                    }
+        // Wakes as soon as any chunk finishes
+        done.tryAcquire(1, 50);
+        ui->progressBar->setValue(daysdone.load());
+        QApplication::processEvents();
 
-                    if (daily_date != date) {
-                        sess->TrashEvents();
-                    }
-                }
-            }
+        // Write out whatever is ready at the front, the rest waits its turn
+        for (; (written < next) && chunks.at(written).ready.loadAcquire(); ++written) {
+            file.write(chunks.at(written).data);
+            chunks[written].data.clear();
         }
+    }
+
+    pool.waitForDone();
+    ui->progressBar->setValue(days);
 
-        date = date.addDays(1);
-    } while (date <= ui->endDate->date());
+    mainwin->GenerateStatistics();
 
     file.close();
     ExportCSV::accept();
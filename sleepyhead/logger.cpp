@@ -8,6 +8,8 @@
 
 #include "logger.h"
 
+#include <QThread>
+
 QThreadPool * otherThreadPool = NULL;
 
 #if QT_VERSION < QT_VERSION_CHECK(5,0,0)
@@ -29,7 +31,13 @@ void MyOutputHandler(QtMsgType type, const QMessageLogContext &context, const QS
         return;
     }
 
-    QString msg, typestr;
+    if (logger->isRunning() && (type != QtFatalMsg)) {
+        // Formatting is deferred to the logging thread, keep the calling thread cheap
+        logger->append(msgtxt, type);
+        return;
+    }
+
+    QString typestr;
 
     switch (type) {
     case QtWarningMsg:
@@ -50,17 +58,13 @@ void MyOutputHandler(QtMsgType type, const QMessageLogContext &context, const QS
     }
 
 #if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
-    msg = typestr +
+    QString msg = typestr +
           msgtxt; //+QString(" (%1:%2, %3)").arg(context.file).arg(context.line).arg(context.function);
 #else
-    msg = typestr + msgtxt;
+    QString msg = typestr + msgtxt;
 #endif
 
-    if (logger && logger->isRunning()) {
-        logger->append(msg);
-    } else {
-        fprintf(stderr, "%s\n", msg.toLocal8Bit().data());
-    }
+    fprintf(stderr, "%s\n", msg.toLocal8Bit().data());
 
     if (type == QtFatalMsg) {
         abort();
@@ -98,49 +102,194 @@ void shutdownLogger()
 
 LogThread * logger = NULL;
 
-void LogThread::append(QString msg)
+LogRing::LogRing()
 {
-    QString tmp = QString("%1: %2").arg(logtime.elapsed(), 5, 10, QChar('0')).arg(msg);
-    //QStringList appears not to be threadsafe
-    strlock.lock();
-    buffer.append(tmp);
-    strlock.unlock();
+    for (int i = 0; i < Size; ++i) {
+        m_slots[i].sequence.storeRelease(i);
+    }
+    m_enqueue.storeRelease(0);
+    m_dequeue = 0;
+}
+
+bool LogRing::push(LogRecord &rec)
+{
+    Slot *slot;
+    int pos = m_enqueue.load();
+
+    forever {
+        slot = &m_slots[pos & Mask];
+        int diff = slot->sequence.loadAcquire() - pos;
+
+        if (diff == 0) {
+            // Slot is free for this position, try to claim it
+            if (m_enqueue.testAndSetRelaxed(pos, pos + 1)) {
+                break;
+            }
+            pos = m_enqueue.load();
+        } else if (diff < 0) {
+            // Consumer hasn't caught up, don't stall the caller
+            m_dropped.fetchAndAddRelaxed(1);
+            return false;
+        } else {
+            pos = m_enqueue.load();
+        }
+    }
+
+    slot->rec.time = rec.time;
+    slot->rec.type = rec.type;
+    slot->rec.clean = rec.clean;
+    slot->rec.text.swap(rec.text);
+    slot->sequence.storeRelease(pos + 1);
+    return true;
+}
+
+bool LogRing::pop(LogRecord &rec)
+{
+    Slot *slot = &m_slots[m_dequeue & Mask];
+
+    if (slot->sequence.loadAcquire() - (m_dequeue + 1) != 0) {
+        return false;
+    }
+
+    rec.time = slot->rec.time;
+    rec.type = slot->rec.type;
+    rec.clean = slot->rec.clean;
+    rec.text.swap(slot->rec.text);
+    slot->rec.text.clear();
+
+    slot->sequence.storeRelease(m_dequeue + Size);
+    m_dequeue++;
+    return true;
+}
+
+void LogThread::append(QString msg, QtMsgType type)
+{
+    LogRecord rec;
+    rec.time = logtime.elapsed();
+    rec.type = type;
+    rec.text.swap(msg);
+    ring.push(rec);
 }
 
 void LogThread::appendClean(QString msg)
 {
-    strlock.lock();
-    buffer.append(msg);
-    strlock.unlock();
+    LogRecord rec;
+    rec.clean = true;
+    rec.text.swap(msg);
+    ring.push(rec);
 }
 
+void LogThread::setLogFile(QString filename)
+{
+    if (logfile_ready.loadAcquire()) {
+        return;
+    }
+
+    // Keep the previous run's log around for bug reports
+    QFile::remove(filename + ".old");
+    QFile::rename(filename, filename + ".old");
+
+    logfile.setFileName(filename);
+    if (logfile.open(QFile::WriteOnly | QFile::Truncate | QFile::Text)) {
+        logfile_ready.storeRelease(1);
+    } else {
+        qWarning() << "Could not open log file" << filename;
+    }
+}
 
 void LogThread::quit() {
     qDebug() << "Shutting down logging thread";
     running = false;
-    strlock.lock();
-    while (!buffer.isEmpty()) {
-        QString msg = buffer.takeFirst();
-        fprintf(stderr, "%s\n", msg.toLocal8Bit().constData());
-    }
-    strlock.unlock();
 }
 
+bool LogThread::flush()
+{
+    static const char *typestr[] = { "Debug: ", "Warning: ", "Critical: ", "Fatal: " };
+
+    LogRecord rec;
+    QString batch;
+
+    while (ring.pop(rec)) {
+        if (!batch.isEmpty()) {
+            batch += '\n';
+        }
+
+        if (rec.clean) {
+            batch += rec.text;
+        } else {
+            int t = int(rec.type);
+            batch += QString("%1: %2%3").arg(rec.time, 5, 10, QChar('0'))
+                    .arg(((t >= 0) && (t <= 3)) ? typestr[t] : typestr[0]).arg(rec.text);
+        }
+    }
+
+    int dropped = ring.dropped();
+    if (dropped > 0) {
+        if (!batch.isEmpty()) {
+            batch += '\n';
+        }
+        batch += QString("%1: Warning: Logger overflowed, %2 messages were dropped")
+                .arg(logtime.elapsed(), 5, 10, QChar('0')).arg(dropped);
+    }
+
+    if (batch.isEmpty()) {
+        return false;
+    }
+
+    QByteArray bytes = batch.toLocal8Bit();
+    bytes += '\n';
+
+    // One write per sink per batch
+    fwrite(bytes.constData(), 1, bytes.size(), stderr);
+
+    if (logfile_ready.loadAcquire()) {
+        logfile.write(bytes);
+        logfile.flush();
+    }
+
+    emit outputLog(batch);
+    return true;
+}
 
 void LogThread::run()
 {
+    QThread::currentThread()->setObjectName("Logger");
     running = true;
     do {
-        strlock.lock();
-        //int r = receivers(SIGNAL(outputLog(QString())));
-        while (!buffer.isEmpty()) {
-            QString msg = buffer.takeFirst();
-                fprintf(stderr, "%s\n", msg.toLocal8Bit().data());
-                emit outputLog(msg);
+        if (!flush()) {
+            QThread::msleep(100);
         }
-        strlock.unlock();
-        QThread::msleep(1000);
     } while (running);
+
+    // Catch anything queued during shutdown
+    flush();
+
+    if (logfile_ready.loadAcquire()) {
+        logfile.close();
+    }
 }
 
+bool LogRateLimiter::allow()
+{
+    if (!logger) {
+        return true;
+    }
+
+    int window = int(logger->elapsed() / 1000);
+    int current = m_window.load();
+
+    if ((current != window) && m_window.testAndSetOrdered(current, window)) {
+        m_count.storeRelease(0);
+        int suppressed = m_suppressed.fetchAndStoreOrdered(0);
+        if (suppressed > 0) {
+            qDebug() << suppressed << "similar messages suppressed from" << QString("%1:%2").arg(m_file).arg(m_line);
+        }
+    }
+
+    if (m_count.fetchAndAddOrdered(1) < m_limit) {
+        return true;
+    }
 
+    m_suppressed.fetchAndAddRelaxed(1);
+    return false;
+}
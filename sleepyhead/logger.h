@@ -4,8 +4,9 @@
 #include <QDebug>
 #include <QRunnable>
 #include <QThreadPool>
-#include <QMutex>
-#include <QTime>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QFile>
 
 void initializeLogger();
 void shutdownLogger();
@@ -16,6 +17,50 @@ void MyOutputHandler(QtMsgType type, const char *msgtxt);
 void MyOutputHandler(QtMsgType type, const QMessageLogContext &context, const QString &msgtxt);
 #endif
 
+/*! \struct LogRecord
+    \brief A raw, unformatted log message. Timestamp & type prefix are applied on the logging thread
+    */
+struct LogRecord
+{
+    LogRecord() : time(0), type(QtDebugMsg), clean(false) {}
+    qint64 time;
+    QtMsgType type;
+    bool clean;
+    QString text;
+};
+
+/*! \class LogRing
+    \brief Bounded lock-free multi-producer, single-consumer queue of LogRecords
+
+    Any thread may push(), only the LogThread may pop(). Producers never block,
+    when the ring is full the message is dropped and counted instead.
+    */
+class LogRing
+{
+  public:
+    LogRing();
+
+    bool push(LogRecord &rec);
+    bool pop(LogRecord &rec);
+
+    int dropped() { return m_dropped.fetchAndStoreOrdered(0); }
+
+    // Must be a power of two
+    static const int Size = 8192;
+    static const int Mask = Size - 1;
+
+  protected:
+    struct Slot {
+        QAtomicInt sequence;
+        LogRecord rec;
+    };
+    Slot m_slots[Size];
+
+    QAtomicInt m_enqueue;
+    int m_dequeue;
+    QAtomicInt m_dropped;
+};
+
 class LogThread:public QObject, public QRunnable
 {
     Q_OBJECT
@@ -24,22 +69,61 @@ public:
     virtual ~LogThread() {}
 
     void run();
-    void append(QString msg);
+    void append(QString msg, QtMsgType type = QtDebugMsg);
     void appendClean(QString msg);
     bool isRunning() { return running; }
 
+    //! \brief Also write the log to filename, in batches from the logging thread
+    void setLogFile(QString filename);
+
+    //! \brief Milliseconds since the logger started
+    qint64 elapsed() const { return logtime.elapsed(); }
+
     void quit();
 
-    QStringList buffer;
-    QMutex strlock;
     QThreadPool *threadpool;
 signals:
     void outputLog(QString);
 protected:
+    //! \brief Drain the ring, returns false if there was nothing to write
+    bool flush();
+
+    LogRing ring;
     volatile bool running;
-    QTime logtime;
+    QElapsedTimer logtime;
+
+    QFile logfile;
+    QAtomicInt logfile_ready;
 };
 
+/*! \class LogRateLimiter
+    \brief Per call-site limiter for noisy messages, see LOG_LIMITED
+    */
+class LogRateLimiter
+{
+  public:
+    LogRateLimiter(int per_second, const char *file, int line)
+        : m_limit(per_second), m_file(file), m_line(line), m_window(-1), m_count(0), m_suppressed(0) {}
+
+    //! \brief Returns true if another message may be logged from this site in the current second
+    bool allow();
+
+  protected:
+    int m_limit;
+    const char *m_file;
+    int m_line;
+    QAtomicInt m_window;
+    QAtomicInt m_count;
+    QAtomicInt m_suppressed;
+};
+
+//! \brief Only run stmt (usually a qDebug()) at most per_second times a second from this site
+#define LOG_LIMITED(per_second, stmt) \
+    do { \
+        static LogRateLimiter log_limiter(per_second, __FILE__, __LINE__); \
+        if (log_limiter.allow()) { stmt; } \
+    } while (0)
+
 extern LogThread * logger;
 extern QThreadPool * otherThreadPool;
 
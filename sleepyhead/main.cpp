@@ -34,6 +34,7 @@
 #include "translation.h"
 #include "common_gui.h"
 #include "SleepLib/machine_loader.h"
+#include "SleepLib/trace.h"
 
 
 // Gah! I must add the real darn plugin system one day.
@@ -187,6 +188,7 @@ int main(int argc, char *argv[])
     bool force_login_screen = false;
     bool force_data_dir = false;
     bool changing_language = false;
+    QString trace_file;
 
     QApplication a(argc, argv);
     QStringList args = QCoreApplication::arguments();
@@ -210,11 +212,18 @@ int main(int argc, char *argv[])
             settings.setValue(LangSetting,"");
         } else if (args[i] == "-p") {
             sDelay(1);
+        } else if ((args[i] == "-trace") && (i + 1 < args.size())) {
+            // Record hot-path timings from startup and dump them as Chrome trace JSON on exit
+            trace_file = args[++i];
         }
     }
 
     initializeLogger();
 
+    if (!trace_file.isEmpty()) {
+        Trace::setEnabled(true);
+    }
+
 
     ////////////////////////////////////////////////////////////////////////////////////////////
     // Language Selection
@@ -366,6 +375,8 @@ retry_directory:
     p_pref = new Preferences("Preferences");
     PREF.Open();
 
+    logger->setLogFile(GetAppRoot() + "SleepyHead.log");
+
     initialize();
     PRS1Loader::Register();
     ResmedLoader::Register();
@@ -514,5 +525,11 @@ retry_directory:
 
     w.show();
 
-    return a.exec();
+    int result = a.exec();
+
+    if (!trace_file.isEmpty()) {
+        Trace::exportChromeTrace(trace_file);
+    }
+
+    return result;
 }
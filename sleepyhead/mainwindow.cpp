@@ -56,6 +56,10 @@
 #include "UpdaterWindow.h"
 #include "SleepLib/calcs.h"
 #include "SleepLib/progressdialog.h"
+#include "SleepLib/trace.h"
+#include "SleepLib/eventcache.h"
+#include "SleepLib/filesource.h"
+#include "SleepLib/journal.h"
 #include "version.h"
 
 #include "reports.h"
@@ -205,6 +209,7 @@ MainWindow::MainWindow(QWidget *parent) :
 
     m_inRecalculation = false;
     m_restartRequired = false;
+    statsThreadPool.setMaxThreadCount(1);
     // Initialize Status Bar objects
     qstatusbar = ui->statusbar;
     qprogress = new QProgressBar(this);
@@ -253,6 +258,7 @@ MainWindow::MainWindow(QWidget *parent) :
     }
 
     ui->actionShow_Performance_Counters->setChecked(p_profile->general->showPerformance());
+    ui->actionExport_Performance_Trace->setEnabled(Trace::enabled());
 
 #ifdef Q_OS_MAC
     p_profile->appearance->setAntiAliasing(false);
@@ -536,6 +542,9 @@ MainWindow::~MainWindow()
 
 //    if (systray) { delete systray; }
 
+    // The worker must not outlive the profile data it's reading
+    cancelStatistics(true);
+
     // Trash anything allocated by the Graph objects
     DestroyGraphGlobals();
 
@@ -710,6 +719,9 @@ int MainWindow::importCPAP(ImportPath import, const QString &message)
         return 0;
     }
 
+    // Loaders add days & sessions the statistics worker would be walking
+    cancelStatistics(true);
+
     QDialog * popup = new QDialog(this);
     QLabel * waitmsg = new QLabel(message);
     QHBoxLayout *hlayout = new QHBoxLayout;
@@ -1141,6 +1153,64 @@ void MainWindow::on_action_Import_Data_triggered()
 
 }
 
+void MainWindow::on_actionImport_Zipped_Card_triggered()
+{
+    if (m_inRecalculation) {
+        Notify(tr("Access to Import has been blocked while recalculations are in progress."),STR_MessageBox_Busy);
+        return;
+    }
+
+    QString folder;
+    if (p_profile->contains(STR_PREF_LastCPAPPath)) {
+        folder = (*p_profile)[STR_PREF_LastCPAPPath].toString();
+    }
+
+    QString filename = QFileDialog::getOpenFileName(this, tr("Select a zipped data card"), folder,
+                                                    tr("Zip Archives (*.zip)"));
+    if (filename.isEmpty()) {
+        return;
+    }
+
+    // Cards get zipped either from their root, or from the folder holding them
+    QStringList roots;
+    roots.push_back(filename);
+    QStringList dirs = FileSource::entryList(filename, QDir::Dirs);
+    for (int i = 0; i < dirs.size(); ++i) {
+        roots.push_back(filename + "/" + dirs.at(i));
+    }
+
+    QList<MachineLoader *> loaders = GetLoaders(MT_CPAP);
+    ImportPath import;
+
+    for (int i = 0; (i < roots.size()) && !import.loader; ++i) {
+        Q_FOREACH(MachineLoader * loader, loaders) {
+            if (loader->Detect(roots.at(i))) {
+                import = ImportPath(roots.at(i), loader);
+                break;
+            }
+        }
+    }
+
+    int c = -1;
+    if (import.loader) {
+        c = importCPAP(import, tr("Importing Data"));
+    } else {
+        Notify(tr("Couldn't find any valid Machine Data at\n\n%1").arg(filename),tr("Import Problem"));
+    }
+
+    // Done with the archive, close it and drop its index
+    FileSource::release(filename);
+
+    if (c >= 0) {
+        (*p_profile)[STR_PREF_LastCPAPPath] = QFileInfo(filename).absolutePath();
+    }
+
+    if (c > 0) {
+        finishCPAPImport();
+        PopulatePurgeMenu();
+    }
+}
+
 QMenu *MainWindow::CreateMenu(QString title)
 {
     QMenu *menu = new QMenu(title, ui->menubar);
@@ -1281,49 +1351,26 @@ void MainWindow::updateFavourites()
                    "</style></head><body>"
                    "<table width=100% cellpadding=2 cellspacing=0>";
 
-    do {
-        Day *journal = p_profile->GetDay(date, MT_JOURNAL);
-
-        if (journal) {
-            if (journal->size() > 0) {
-                Session *sess = journal->firstSession(MT_JOURNAL);
-                QString tmp;
-                bool filtered = !bookmarkFilter.isEmpty();
-                bool found = !filtered;
-
-                if (sess->settings.contains(Bookmark_Start)) {
-                    //QVariantList start=sess->settings[Bookmark_Start].toList();
-                    //QVariantList end=sess->settings[Bookmark_End].toList();
-                    QStringList notes = sess->settings[Bookmark_Notes].toStringList();
-
-                    if (notes.size() > 0) {
-                        tmp += QString("<tr><td><b><a href='daily=%1'>%2</a></b><br/>")
-                               .arg(date.toString(Qt::ISODate))
-                               .arg(date.toString());
-
-                        tmp += "<list>";
-
-                        for (int i = 0; i < notes.size(); i++) {
-                            //QDate d=start[i].toDate();
-                            QString note = notes[i];
+    // The journal index answers this without opening every day
+    JournalIndex *index = p_profile->journalIndex();
+    QList<QDate> days = index->bookmarkDays(bookmarkFilter);
 
-                            if (filtered && note.contains(bookmarkFilter, Qt::CaseInsensitive)) {
-                                found = true;
-                            }
+    for (int d = 0; d < days.size(); ++d) {
+        date = days.at(d);
+        QList<Bookmark> bookmarks = index->bookmarks(date);
 
-                            tmp += "<li>" + note + "</li>";
-                        }
+        html += QString("<tr><td><b><a href='daily=%1'>%2</a></b><br/>")
+               .arg(date.toString(Qt::ISODate))
+               .arg(date.toString());
 
-                        tmp += "</list></td>";
-                    }
-                }
+        html += "<list>";
 
-                if (found) { html += tmp; }
-            }
+        for (int i = 0; i < bookmarks.size(); i++) {
+            html += "<li>" + bookmarks.at(i).notes + "</li>";
         }
 
-        date = date.addDays(-1);
-    } while (date >= p_profile->FirstDay(MT_JOURNAL));
+        html += "</list></td>";
+    }
 
     html += "</table></body></html>";
     ui->bookmarkView->setHtml(html);
@@ -1531,14 +1578,11 @@ void MainWindow::on_actionDebug_toggled(bool checked)
 {
     p_profile->general->setShowDebug(checked);
 
-    logger->strlock.lock();
     if (checked) {
         ui->logText->show();
     } else {
         ui->logText->hide();
     }
-  //  QApplication::processEvents();
-    logger->strlock.unlock();
 }
 
 void MainWindow::on_action_Reset_Graph_Layout_triggered()
@@ -2032,6 +2076,7 @@ void MainWindow::on_actionPurge_Current_Day_triggered()
 {
     QDate date = getDaily()->getDate();
     getDaily()->Unload(date);
+    EventCache::instance()->cancelPrefetch(true);
     Day *day = p_profile->GetDay(date, MT_CPAP);
     Machine *cpap = nullptr;
     if (day) cpap = day->machine(MT_CPAP);
@@ -2210,6 +2255,8 @@ void MainWindow::on_actionPurgeMachine(QAction *action)
 
 void MainWindow::purgeMachine(Machine * mach)
 {
+    cancelStatistics(true);
+
     // detect backups
     daily->Unload(daily->getDate());
 
@@ -2385,6 +2432,7 @@ void MainWindow::doReprocessEvents()
         return;
     }
 
+    cancelStatistics(true);
     m_inRecalculation = true;
     QDate first = p_profile->FirstDay();
     QDate date = p_profile->LastDay();
@@ -2618,11 +2666,30 @@ void MainWindow::GenerateStatistics()
     ui->statEndDate->setMinimumDate(first);
     ui->statEndDate->setMaximumDate(last);
 
-    Statistics stats;
-    QString html = stats.GenerateHTML();
-
     updateFavourites();
 
+    // Supersedes anything still queued or running, it will bail out at its next check
+    int generation = StatisticsTask::invalidate();
+    statsThreadPool.start(new StatisticsTask(generation));
+}
+
+void MainWindow::cancelStatistics(bool wait)
+{
+    StatisticsTask::invalidate();
+
+    if (wait) {
+        statsThreadPool.waitForDone();
+    }
+}
+
+void MainWindow::applyStatistics(int generation, QString html, QString welcome, QString recbox)
+{
+    if (!StatisticsTask::isCurrent(generation)) {
+        return;
+    }
+
+    setRecBoxHTML(recbox);
+
     //QWebFrame *frame=ui->statisticsView->page()->currentFrame();
     //frame->addToJavaScriptWindowObject("mainwin",this);
     //ui->statisticsView->setHtml(html);
@@ -2633,7 +2700,7 @@ void MainWindow::GenerateStatistics()
 
 
     MyStatsPage *page2 = new MyStatsPage(this);
-    page2->currentFrame()->setHtml(GenerateWelcomeHTML());
+    page2->currentFrame()->setHtml(welcome);
     ui->welcomeView->setPage(page2);
 
     //    connect(ui->statisticsView->page()->currentFrame(),SIGNAL(javaScriptWindowObjectCleared())
@@ -2703,6 +2770,8 @@ void MainWindow::on_actionPurgeCurrentDaysOximetry_triggered()
         QList<Session *> sessionlist;
         sessionlist.append(day->sessions);
 
+        cancelStatistics(true);
+
         for (int i=0; i < sessionlist.size(); ++i) {
             Session * sess = sessionlist.at(i);
             sess->Destroy();
@@ -2713,6 +2782,7 @@ void MainWindow::on_actionPurgeCurrentDaysOximetry_triggered()
         daily->clearLastDay(); // otherwise Daily will crash
 
         getDaily()->ReloadGraphs();
+        GenerateStatistics();
     } else {
         QMessageBox::information(this, STR_MessageBox_Information,
             tr("Select the day with valid oximetry data in daily view first."),QMessageBox::Ok);
@@ -2745,8 +2815,6 @@ void MainWindow::on_actionDaily_Calendar_toggled(bool visible)
     getDaily()->setCalendarVisible(visible);
 }
 
-#include "SleepLib/journal.h"
-
 void MainWindow::on_actionExport_Journal_triggered()
 {
     QString folder;
@@ -2765,6 +2833,33 @@ void MainWindow::on_actionExport_Journal_triggered()
 void MainWindow::on_actionShow_Performance_Counters_toggled(bool arg1)
 {
     p_profile->general->setShowPerformance(arg1);
+
+    // Performance counters double as the switch for hot-path tracing
+    Trace::setEnabled(arg1);
+    ui->actionExport_Performance_Trace->setEnabled(arg1);
+}
+
+void MainWindow::on_actionExport_Performance_Trace_triggered()
+{
+    QString folder;
+#if QT_VERSION  < QT_VERSION_CHECK(5,0,0)
+    folder = QDesktopServices::storageLocation(QDesktopServices::DocumentsLocation);
+#else
+    folder = QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation);
+#endif
+    folder += QDir::separator() + QString("SleepyHead-trace-%1.json").arg(QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss"));
+
+    QString filename = QFileDialog::getSaveFileName(this, tr("Choose where to save performance trace"), folder, tr("Chrome Trace Files (*.json)"));
+
+    if (filename.isEmpty()) {
+        return;
+    }
+
+    if (Trace::exportChromeTrace(filename)) {
+        Notify(tr("Performance trace saved, open it in chrome://tracing to view it."));
+    } else {
+        QMessageBox::warning(this, STR_MessageBox_Warning, tr("Could not write performance trace to %1").arg(filename), QMessageBox::Ok);
+    }
 }
 
 void MainWindow::on_actionExport_CSV_triggered()
@@ -15,6 +15,7 @@
 #include <QNetworkReply>
 #include <QSystemTrayIcon>
 #include <QTimer>
+#include <QThreadPool>
 
 #include "daily.h"
 #include "overview.h"
@@ -86,9 +87,12 @@ class MainWindow : public QMainWindow
     //! \brief Update the list of Favourites (Bookmarks) in the right sidebar.
     void updateFavourites();
 
-    //! \brief Update statistics report
+    //! \brief Update statistics report & welcome page, the HTML is built on a background worker
     void GenerateStatistics();
 
+    //! \brief Abandon any statistics generation in progress, optionally waiting for the worker to stop
+    void cancelStatistics(bool wait = false);
+
     //! \brief Create a new menu object in the main menubar.
     QMenu *CreateMenu(QString title);
 
@@ -152,6 +156,9 @@ class MainWindow : public QMainWindow
 
     void MachineUnsupported(Machine * m);
 
+    //! \brief Show pages built by StatisticsTask, unless a newer request has been made since
+    void applyStatistics(int generation, QString html, QString welcome, QString recbox);
+
 
   protected:
     virtual void closeEvent(QCloseEvent *);
@@ -164,6 +171,9 @@ class MainWindow : public QMainWindow
         */
     void on_action_Import_Data_triggered();
 
+    //! \brief Import straight out of a .zip archive of a data card, without extracting it first
+    void on_actionImport_Zipped_Card_triggered();
+
     //! \brief Toggle Fullscreen (currently F11)
     void on_action_Fullscreen_triggered();
 
@@ -331,6 +341,9 @@ class MainWindow : public QMainWindow
     void on_actionExport_Journal_triggered();
 
     void on_actionShow_Performance_Counters_toggled(bool arg1);
+
+    void on_actionExport_Performance_Trace_triggered();
+
     void on_aboutToQuit();
 
     void on_actionExport_CSV_triggered();
@@ -360,6 +373,9 @@ private:
     bool m_restartRequired;
     volatile bool m_inRecalculation;
 
+    //! \brief Single worker thread, so statistics runs never overlap
+    QThreadPool statsThreadPool;
+
     void PopulatePurgeMenu();
 
     //! \brief Destroy ALL the CPAP data for the selected machine
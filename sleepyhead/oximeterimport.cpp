@@ -493,6 +493,9 @@ void OximeterImport::on_liveImportButton_clicked()
     plethyChart->setMinX(start_ti);
     plethyGraph->SetMinX(start_ti);
 
+    // Only draw newly arrived samples each tick, scrolling the rest
+    plethyChart->setStripChart(true);
+
     liveView->setDay(dummyday);
 
     updateTimer.setParent(this);
@@ -521,6 +524,7 @@ void OximeterImport::finishedRecording()
 
     ui->syncButton->setVisible(true);
 
+    plethyChart->setStripChart(false);
     plethyGraph->SetMinX(start_ti);
     liveView->SetXBounds(start_ti, ti, 0, true);
 
@@ -991,6 +995,7 @@ void OximeterImport::on_saveButton_clicked()
 
     session->setOpened(true);
 
+    mainwin->cancelStatistics(true);
     mach->AddSession(session);
     mach->Save();
     mach->SaveSummary();
@@ -998,6 +1003,7 @@ void OximeterImport::on_saveButton_clicked()
 
     mainwin->getDaily()->LoadDate(mainwin->getDaily()->getDate());
     mainwin->getOverview()->ReloadGraphs();
+    mainwin->GenerateStatistics();
 
     ELplethy = nullptr;
     session = nullptr;
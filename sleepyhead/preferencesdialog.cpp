@@ -163,6 +163,7 @@ PreferencesDialog::PreferencesDialog(QWidget *parent, Profile *_profile) :
     ui->showUnknownFlags->setChecked(profile->general->showUnknownFlags());
     ui->enableMultithreading->setChecked(profile->session->multithreading());
     ui->cacheSessionData->setChecked(profile->session->cacheSessions());
+    ui->eventCacheSize->setValue(profile->session->eventCacheSize());
     ui->preloadSummaries->setChecked(profile->session->preloadSummaries());
     ui->animationsAndTransitionsCheckbox->setChecked(profile->appearance->animations());
     ui->complianceCheckBox->setChecked(profile->cpap->showComplianceInfo());
@@ -731,6 +732,7 @@ bool PreferencesDialog::Save()
     profile->general->setShowUnknownFlags(ui->showUnknownFlags->isChecked());
     profile->session->setMultithreading(ui->enableMultithreading->isChecked());
     profile->session->setCacheSessions(ui->cacheSessionData->isChecked());
+    profile->session->setEventCacheSize(ui->eventCacheSize->value());
     profile->session->setPreloadSummaries(ui->preloadSummaries->isChecked());
     profile->appearance->setAnimations(ui->animationsAndTransitionsCheckbox->isChecked());
 
@@ -866,6 +868,10 @@ bool PreferencesDialog::Save()
         p_profile->removeLock();
         mainwin->RestartApplication();
     } else {
+        // Fonts, colours or antialiasing may have changed, so the glyph atlases are stale
+        mainwin->getDaily()->graphView()->clearTextCache();
+        mainwin->getOverview()->graphView()->clearTextCache();
+
         mainwin->getDaily()->LoadDate(mainwin->getDaily()->getDate());
         // Save early.. just in case..
         mainwin->getDaily()->graphView()->SaveSettings("Daily");
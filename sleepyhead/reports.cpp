@@ -595,9 +595,7 @@ void Report::PrintReport(gGraphView *gv, QString name, QDate date)
         //painter.beginNativePainting();
         //g->showTitle(false);
         int hhh = full_graph_height - normal_height;
-        QPixmap pm2 = g->renderPixmap(virt_width, hhh, 1);
-        QImage pm = pm2.toImage(); //fscale);
-        pm2.detach();
+        QImage pm = g->renderImage(virt_width, hhh, true);
         //g->showTitle(true);
         //painter.endNativePainting();
         g->m_marginbottom = tmb;
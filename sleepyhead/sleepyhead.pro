@@ -126,6 +126,7 @@ SOURCES += \
     Graphs/gGraph.cpp \
     Graphs/gGraphView.cpp \
     Graphs/glcommon.cpp \
+    Graphs/glyphatlas.cpp \
     Graphs/gLineChart.cpp \
     Graphs/gLineOverlay.cpp \
     Graphs/gSegmentChart.cpp \
@@ -138,13 +139,17 @@ SOURCES += \
     SleepLib/calcs.cpp \
     SleepLib/common.cpp \
     SleepLib/day.cpp \
+    SleepLib/eventcache.cpp \
     SleepLib/event.cpp \
+    SleepLib/filesource.cpp \
+    SleepLib/textreader.cpp \
     SleepLib/machine.cpp \
     SleepLib/machine_loader.cpp \
     SleepLib/preferences.cpp \
     SleepLib/profiles.cpp \
     SleepLib/schema.cpp \
     SleepLib/session.cpp \
+    SleepLib/trace.cpp \
     SleepLib/loader_plugins/cms50_loader.cpp \
     SleepLib/loader_plugins/icon_loader.cpp \
     SleepLib/loader_plugins/intellipap_loader.cpp \
@@ -188,6 +193,7 @@ HEADERS  += \
     Graphs/gGraph.h \
     Graphs/gGraphView.h \
     Graphs/glcommon.h \
+    Graphs/glyphatlas.h \
     Graphs/gLineChart.h \
     Graphs/gLineOverlay.h \
     Graphs/gSegmentChart.h\
@@ -200,7 +206,10 @@ HEADERS  += \
     SleepLib/calcs.h \
     SleepLib/common.h \
     SleepLib/day.h \
+    SleepLib/eventcache.h \
     SleepLib/event.h \
+    SleepLib/filesource.h \
+    SleepLib/textreader.h \
     SleepLib/machine.h \
     SleepLib/machine_common.h \
     SleepLib/machine_loader.h \
@@ -208,6 +217,7 @@ HEADERS  += \
     SleepLib/profiles.h \
     SleepLib/schema.h \
     SleepLib/session.h \
+    SleepLib/trace.h \
     SleepLib/loader_plugins/cms50_loader.h \
     SleepLib/loader_plugins/icon_loader.h \
     SleepLib/loader_plugins/intellipap_loader.h \
@@ -13,8 +13,11 @@
 
 #include "mainwindow.h"
 #include "statistics.h"
+#include "SleepLib/trace.h"
+#include "SleepLib/eventcache.h"
 
 extern MainWindow *mainwin;
+QString GenerateWelcomeHTML();
 
 QString formatTime(float time)
 {
@@ -490,6 +493,8 @@ void Statistics::updateRXChanges()
 Statistics::Statistics(QObject *parent) :
     QObject(parent)
 {
+    m_generation = -1;
+
     rows.push_back(StatisticsRow(tr("CPAP Statistics"), SC_HEADING, MT_CPAP));
     rows.push_back(StatisticsRow("",   SC_DAYS, MT_CPAP));
     rows.push_back(StatisticsRow("", SC_COLUMNHEADERS, MT_CPAP));
@@ -1209,6 +1214,9 @@ QString Statistics::GenerateHTML()
 
     bool skipsection = false;;
     for (QList<StatisticsRow>::iterator i = rows.begin(); i != rows.end(); ++i) {
+        if (cancelled()) {
+            return QString();
+        }
         StatisticsRow &row = (*i);
         QString name;
 
@@ -1848,6 +1856,9 @@ QString Statistics::GenerateHTML()
         html += "</div>";
 
    } */
+    if (cancelled()) {
+        return QString();
+    }
     html += GenerateRXChanges();
     html += GenerateMachineList();
 
@@ -1892,7 +1903,8 @@ void Statistics::UpdateRecordsBox()
         /// AHI Records
         /////////////////////////////////////////////////////////////////////////////////////
 
-        if (p_profile->session->preloadSummaries()) {
+        // Summaries fault in as needed, so the records no longer depend on preloading
+        {
             const int show_records = 5;
             QMultiMap<float, QDate>::iterator it;
             QMultiMap<float, QDate>::iterator it_end;
@@ -2146,7 +2158,45 @@ void Statistics::UpdateRecordsBox()
 
 
     html += "</body></html>";
-    mainwin->setRecBoxHTML(html);
+    recbox_html = html;
+}
+
+bool Statistics::cancelled() const
+{
+    return (m_generation >= 0) && !StatisticsTask::isCurrent(m_generation);
+}
+
+QAtomicInt StatisticsTask::s_generation;
+
+void StatisticsTask::run()
+{
+    TRACE_SCOPE(Trace::CAT_Calc, "StatisticsTask::run");
+
+    // Superseded while still queued
+    if (!isCurrent(m_generation)) {
+        return;
+    }
+
+    // Keep the EventCache from putting summaries away underneath us
+    QReadLocker lock(EventCache::instance()->summaryLock());
+
+    Statistics stats;
+    stats.setGeneration(m_generation);
+    QString html = stats.GenerateHTML();
+
+    if (!isCurrent(m_generation)) {
+        return;
+    }
+
+    QString welcome = GenerateWelcomeHTML();
+
+    if (!isCurrent(m_generation)) {
+        return;
+    }
+
+    QMetaObject::invokeMethod(mainwin, "applyStatistics", Qt::QueuedConnection,
+                              Q_ARG(int, m_generation), Q_ARG(QString, html),
+                              Q_ARG(QString, welcome), Q_ARG(QString, stats.recordsBoxHTML()));
 }
 
 
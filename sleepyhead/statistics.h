@@ -12,6 +12,8 @@
 #include <QObject>
 #include <QHash>
 #include <QList>
+#include <QRunnable>
+#include <QAtomicInt>
 #include "SleepLib/schema.h"
 #include "SleepLib/machine.h"
 
@@ -162,6 +164,14 @@ class Statistics : public QObject
 
     void UpdateRecordsBox();
 
+    //! \brief Returns the records box HTML built by the last UpdateRecordsBox()
+    const QString & recordsBoxHTML() const { return recbox_html; }
+
+    //! \brief Give up generating once StatisticsTask moves past this generation, -1 never gives up
+    void setGeneration(int gen) { m_generation = gen; }
+
+    //! \brief Returns true if a newer statistics request has superseded this one
+    bool cancelled() const;
 
   protected:
     // Using a map to maintain order
@@ -174,10 +184,40 @@ class Statistics : public QObject
     QList<QDate> record_best_ahi;
     QList<QDate> record_worst_ahi;
 
+    QString recbox_html;
+    int m_generation;
+
   signals:
 
   public slots:
 
 };
 
+/*! \class StatisticsTask
+    \brief Builds the Statistics and Welcome pages on a worker thread
+
+    Every request bumps the generation, so a run that has been superseded (or cancelled)
+    gives up between rows rather than finishing. Only the latest result is handed back
+    to MainWindow::applyStatistics()
+    */
+class StatisticsTask : public QRunnable
+{
+  public:
+    StatisticsTask(int generation) : m_generation(generation) {}
+    virtual ~StatisticsTask() {}
+
+    virtual void run();
+
+    //! \brief Supersede any request queued or in progress, returning the new generation
+    static int invalidate() { return s_generation.fetchAndAddOrdered(1) + 1; }
+
+    //! \brief Returns true if gen is still the latest request
+    static bool isCurrent(int gen) { return s_generation.load() == gen; }
+
+  protected:
+    int m_generation;
+
+    static QAtomicInt s_generation;
+};
+
 #endif // SUMMARY_H